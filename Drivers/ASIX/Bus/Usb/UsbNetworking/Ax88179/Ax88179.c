@@ -515,7 +515,7 @@ Ax88179Reset (
 
   if (EFI_ERROR(Status)) goto err;
 
-  Val = 12; //AX88179_BULKIN_SIZE_INK - 1;
+  Val = 12; // Aggregates of up to 14KB, see AX88179_MAX_BULKIN_SIZE
   Status =  Ax88179MacWrite (RXBINQSIZE,
                               0x01,
                               NicDevice,
@@ -1040,3 +1040,62 @@ done:
 no_pkt:
    return Status;
 }
+
+EFI_STATUS
+Ax88179RxRingFill (
+  IN NIC_DEVICE *NicDevice
+  )
+{
+  UINTN      Burst;
+  UINT16     PktLen;
+  BOOLEAN    Valid;
+  RX_PACKET  *Packet;
+  EFI_STATUS Status;
+
+  for (Burst = 0; Burst < AX88179_RX_BURST; ) {
+    if (NicDevice->PktCnt == 0) {
+      Burst++;
+      Status = Ax88179BulkIn (NicDevice);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+
+    //
+    //  Deaggregate, skipping only the frames that are invalid
+    //
+    while ((NicDevice->PktCnt != 0) && (NicDevice->RxRingCount < AX88179_RX_RING_SIZE)) {
+      PktLen = *((UINT16*) (NicDevice->CurPktHdrOff + 2));
+      Valid = ((PktLen & (RXHDR_DROP | RXHDR_CRCERR)) == 0);
+      PktLen &= 0x1fff;
+
+      if ((PktLen < 2) ||
+          (NicDevice->CurPktOff + PktLen > NicDevice->BulkInbuf + AX88179_MAX_BULKIN_SIZE) ||
+          (*((UINT16*)NicDevice->CurPktOff)) != 0xEEEE) {
+        //
+        //  The aggregate is corrupted, the remaining frames cannot be located
+        //
+        NicDevice->PktCnt = 0;
+        break;
+      }
+      PktLen -= 2; /*EEEE*/
+
+      if (Valid && (60 <= PktLen) && ((PktLen - 14) <= MAX_ETHERNET_PKT_SIZE)) {
+        Packet = &NicDevice->RxRing[(NicDevice->RxRingHead + NicDevice->RxRingCount) % AX88179_RX_RING_SIZE];
+        Packet->Length = PktLen;
+        CopyMem (Packet->Data, NicDevice->CurPktOff + 2, PktLen);
+        NicDevice->RxRingCount++;
+      }
+
+      NicDevice->PktCnt--;
+      NicDevice->CurPktHdrOff += 4;
+      NicDevice->CurPktOff += (PktLen + 2 + 7) & 0xfff8;
+    }
+
+    if (NicDevice->RxRingCount == AX88179_RX_RING_SIZE) {
+      break;
+    }
+  }
+
+  return (NicDevice->RxRingCount != 0) ? EFI_SUCCESS : EFI_NOT_READY;
+}
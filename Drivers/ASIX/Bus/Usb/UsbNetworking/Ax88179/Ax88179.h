@@ -69,8 +69,10 @@
 #define USB_NETWORK_CLASS   0x09    ///<  USB Network class code
 #define USB_BUS_TIMEOUT     1000    ///<  USB timeout in milliseconds
 
-#define AX88179_BULKIN_SIZE_INK     2
+#define AX88179_BULKIN_SIZE_INK     16
 #define AX88179_MAX_BULKIN_SIZE    (1024 * AX88179_BULKIN_SIZE_INK)
+#define AX88179_RX_RING_SIZE        64    ///<  Number of deaggregated frames buffered for SN_Receive
+#define AX88179_RX_BURST            4     ///<  Maximum number of bulk-in aggregates read per poll
 #define AX88179_MAX_PKT_SIZE  2048
 
 #define HC_DEBUG        0
@@ -279,6 +281,10 @@ typedef struct {
   UINT8                     *CurPktHdrOff;
   UINT8                     *CurPktOff;
 
+  RX_PACKET                 *RxRing;           ///<  Frames deaggregated from the bulk-in transfers
+  UINTN                     RxRingHead;        ///<  Index of the next frame to return
+  UINTN                     RxRingCount;       ///<  Number of frames in the ring
+
   TX_PACKET                 *TxTest;
 
   INT8                      MulticastHash[8];
@@ -1044,6 +1050,21 @@ Ax88179GetLinkStatus (
   IN NIC_DEVICE *NicDevice
 );
 
+/**
+  Fill the receive ring with the frames of the current bulk-in aggregate,
+  reading up to AX88179_RX_BURST further aggregates while there is room.
+
+  @param [in] NicDevice       Pointer to the NIC_DEVICE structure
+
+  @retval EFI_SUCCESS         At least one frame is available in the ring.
+  @retval EFI_NOT_READY       No frame has been received.
+
+**/
+EFI_STATUS
+Ax88179RxRingFill (
+  IN NIC_DEVICE *NicDevice
+  );
+
 EFI_STATUS
 Ax88179BulkIn(
   IN NIC_DEVICE *NicDevice
@@ -277,6 +277,10 @@ ERR:
     gBS->FreePool (NicDevice->BulkInbuf);
   }
 
+  if (NicDevice->RxRing != NULL) {
+    gBS->FreePool (NicDevice->RxRing);
+  }
+
   if (NicDevice->TxTest != NULL) {
     gBS->FreePool (NicDevice->TxTest);
   }
@@ -441,6 +445,10 @@ DriverStop (
         gBS->FreePool (NicDevice->BulkInbuf);
       }
 
+      if (NicDevice->RxRing != NULL) {
+        gBS->FreePool (NicDevice->RxRing);
+      }
+
       if (NicDevice->TxTest != NULL) {
         gBS->FreePool (NicDevice->TxTest);
       }
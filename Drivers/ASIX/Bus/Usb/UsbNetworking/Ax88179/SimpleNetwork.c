@@ -527,8 +527,7 @@ SN_Receive (
   NIC_DEVICE              *NicDevice;
   EFI_STATUS              Status;
   UINT16                  Type = 0;
-  UINT16                  CurrentPktLen;
-  BOOLEAN                 Valid = TRUE;
+  RX_PACKET               *Packet;
   EFI_TPL                 TplPrevious;
 
   TplPrevious = gBS->RaiseTPL (TPL_CALLBACK);
@@ -563,54 +562,43 @@ SN_Receive (
         }
 
         //
-        //  Attempt to do bulk in
+        //  Serve from the receive ring, refill it from the device when empty
         //
-        if (NicDevice->PktCnt == 0) {
-          Status = Ax88179BulkIn(NicDevice);
+        if (NicDevice->RxRingCount == 0) {
+          Status = Ax88179RxRingFill (NicDevice);
           if (EFI_ERROR(Status))
             goto  no_pkt;
         }
-        CurrentPktLen = *((UINT16*) (NicDevice->CurPktHdrOff + 2));
-        if (CurrentPktLen & (RXHDR_DROP | RXHDR_CRCERR))
-          Valid = FALSE;
-        CurrentPktLen &=  0x1fff;
-        CurrentPktLen -= 2; /*EEEE*/
-
-        if (Valid && (60 <= CurrentPktLen) &&
-        ((CurrentPktLen - 14) <= MAX_ETHERNET_PKT_SIZE) &&
-            (*((UINT16*)NicDevice->CurPktOff)) == 0xEEEE) {
-          if (*BufferSize < (UINTN)CurrentPktLen) {
-            gBS->RestoreTPL (TplPrevious);
-            return EFI_BUFFER_TOO_SMALL;
-          }
-          *BufferSize = CurrentPktLen;
-          CopyMem (Buffer, NicDevice->CurPktOff + 2, CurrentPktLen);
 
-          Header = (ETHERNET_HEADER *) NicDevice->CurPktOff + 2;
+        Packet = &NicDevice->RxRing[NicDevice->RxRingHead];
+        if (*BufferSize < (UINTN)Packet->Length) {
+          *BufferSize = Packet->Length;
+          gBS->RestoreTPL (TplPrevious);
+          return EFI_BUFFER_TOO_SMALL;
+        }
+        *BufferSize = Packet->Length;
+        CopyMem (Buffer, Packet->Data, Packet->Length);
 
-          if ((HeaderSize != NULL)  && ((*HeaderSize != 7720))) {
-            *HeaderSize = sizeof (*Header);
-          }
+        Header = (ETHERNET_HEADER *) Buffer;
 
-          if (DestAddr != NULL) {
-            CopyMem (DestAddr, &Header->DestAddr, PXE_HWADDR_LEN_ETHER);
-          }
-          if (SrcAddr != NULL) {
-            CopyMem (SrcAddr, &Header->SrcAddr, PXE_HWADDR_LEN_ETHER);
-          }
-          if (Protocol != NULL) {
-            Type = Header->Type;
-            Type = (UINT16)((Type >> 8) | (Type << 8));
-            *Protocol = Type;
-          }
-          NicDevice->PktCnt--;
-          NicDevice->CurPktHdrOff += 4;
-          NicDevice->CurPktOff += (CurrentPktLen + 2 + 7) & 0xfff8;
-          Status = EFI_SUCCESS;
-        } else {
-          NicDevice->PktCnt = 0;
-          Status = EFI_NOT_READY;
+        if ((HeaderSize != NULL)  && ((*HeaderSize != 7720))) {
+          *HeaderSize = sizeof (*Header);
         }
+
+        if (DestAddr != NULL) {
+          CopyMem (DestAddr, &Header->DestAddr, PXE_HWADDR_LEN_ETHER);
+        }
+        if (SrcAddr != NULL) {
+          CopyMem (SrcAddr, &Header->SrcAddr, PXE_HWADDR_LEN_ETHER);
+        }
+        if (Protocol != NULL) {
+          Type = Header->Type;
+          Type = (UINT16)((Type >> 8) | (Type << 8));
+          *Protocol = Type;
+        }
+        NicDevice->RxRingHead = (NicDevice->RxRingHead + 1) % AX88179_RX_RING_SIZE;
+        NicDevice->RxRingCount--;
+        Status = EFI_SUCCESS;
       } else {
         Status = EFI_NOT_READY;
       }
@@ -968,6 +956,8 @@ SN_Setup (
   NicDevice->Grub_f = FALSE;
   NicDevice->FirstRst = TRUE;
   NicDevice->PktCnt = 0;
+  NicDevice->RxRingHead = 0;
+  NicDevice->RxRingCount = 0;
   NicDevice->SkipRXCnt = 0;
   NicDevice->UsbMaxPktSize = 512;
   NicDevice->SetZeroLen = TRUE;
@@ -997,11 +987,21 @@ SN_Setup (
     return Status;
   }
 
+  Status = gBS->AllocatePool (EfiBootServicesData,
+                               sizeof (RX_PACKET) * AX88179_RX_RING_SIZE,
+                               (VOID **) &NicDevice->RxRing);
+
+  if (EFI_ERROR (Status)) {
+    gBS->FreePool (NicDevice->BulkInbuf);
+    return Status;
+  }
+
   Status = gBS->AllocatePool (EfiBootServicesData,
                                sizeof (TX_PACKET),
                                (VOID **) &NicDevice->TxTest);
   if (EFI_ERROR (Status)) {
     gBS->FreePool (NicDevice->BulkInbuf);
+    gBS->FreePool (NicDevice->RxRing);
   }
 
   //
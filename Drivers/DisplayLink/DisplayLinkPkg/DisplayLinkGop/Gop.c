@@ -69,6 +69,27 @@ CheckBounds (
   return EFI_SUCCESS;
 }
 
+/**
+ * Extend the area of the screen that is "dirty" - that we need to send in the next screen update.
+ * @param UsbDisplayLinkDev
+ * @param Y1               First line that has changed
+ * @param Y2               Line after the last line that has changed
+ */
+STATIC VOID
+MarkDirtyLines (
+  IN  USB_DISPLAYLINK_DEV                     *UsbDisplayLinkDev,
+  IN  UINTN                                   Y1,
+  IN  UINTN                                   Y2
+)
+{
+  if (Y1 < UsbDisplayLinkDev->LastY1) {
+    UsbDisplayLinkDev->LastY1 = Y1;
+  }
+  if (Y2 > UsbDisplayLinkDev->LastY2) {
+    UsbDisplayLinkDev->LastY2 = Y2;
+  }
+}
+
 /**
  * Update the local copy of the Frame Buffer. This local copy is periodically transmitted to the
  * DisplayLink device (via DlGopSendScreenUpdate)
@@ -121,25 +142,19 @@ BuildBackBuffer (
 
   case EfiBltBufferToVideo:
   {
-    // Update the store of the area of the screen that is "dirty" - that we need to send in the next screen update.
-    if (DestinationY < UsbDisplayLinkDev->LastY1) {
-      UsbDisplayLinkDev->LastY1 = DestinationY;
-    }
-    if ((DestinationY + Height) > UsbDisplayLinkDev->LastY2) {
-      UsbDisplayLinkDev->LastY2 = DestinationY + Height;
-    }
-
+    // Only lines whose contents really change need to be sent in the next screen update.
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* Blt;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
     Blt = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)(((UINT8 *)BltBuffer) + (SourceY * BltBufferStride) + SourceX * sizeof *Blt);
     DstB = UsbDisplayLinkDev->Screen + DestinationY * PixelsPerScanLine + DestinationX;
 
     for (H = 0; H < Height; H++) {
-      for (W = 0; W < Width; W++) {
-        *DstB++ = Blt[W];
+      if (CompareMem (DstB, Blt, Width * sizeof *Blt) != 0) {
+        CopyMem (DstB, Blt, Width * sizeof *Blt);
+        MarkDirtyLines (UsbDisplayLinkDev, DestinationY + H, DestinationY + H + 1);
       }
       Blt = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL*)(((UINT8*)Blt) + BltBufferStride);
-      DstB += PixelsPerScanLine - Width;
+      DstB += PixelsPerScanLine;
     }
   }
   break;
@@ -148,28 +163,48 @@ BuildBackBuffer (
   {
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* SrcB;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
-    SrcB = UsbDisplayLinkDev->Screen + SourceY * PixelsPerScanLine + SourceX;
-    DstB = UsbDisplayLinkDev->Screen + DestinationY * PixelsPerScanLine + DestinationX;
+    UINTN Line;
 
     for (H = 0; H < Height; H++) {
-      for (W = 0; W < Width; W++) {
-        *DstB++ = *SrcB++;
+      // Copy bottom-up when moving the area down, so that overlapping source lines are not overwritten before they are read
+      Line = (DestinationY > SourceY) ? (Height - 1 - H) : H;
+      SrcB = UsbDisplayLinkDev->Screen + (SourceY + Line) * PixelsPerScanLine + SourceX;
+      DstB = UsbDisplayLinkDev->Screen + (DestinationY + Line) * PixelsPerScanLine + DestinationX;
+
+      if (CompareMem (DstB, SrcB, Width * sizeof *SrcB) != 0) {
+        CopyMem (DstB, SrcB, Width * sizeof *SrcB);
+        MarkDirtyLines (UsbDisplayLinkDev, DestinationY + Line, DestinationY + Line + 1);
       }
-      SrcB += PixelsPerScanLine - Width;
-      DstB += PixelsPerScanLine - Width;
     }
   }
   break;
 
   case EfiBltVideoFill:
   {
+    // Scan each line once as 32-bit pixels: it only needs filling from the first pixel that differs.
+    // The lines that changed are marked dirty once, as a single range.
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
+    UINT32 Fill;
+    UINTN FirstDirty;
+    UINTN EndDirty;
+    CopyMem (&Fill, BltBuffer, sizeof Fill);
+    FirstDirty = Height;
+    EndDirty = 0;
     DstB = UsbDisplayLinkDev->Screen + DestinationY * PixelsPerScanLine + DestinationX;
     for (H = 0; H < Height; H++) {
-      for (W = 0; W < Width; W++) {
-        *DstB++ = *BltBuffer;
+      for (W = 0; (W < Width) && (*(UINT32*)&DstB[W] == Fill); W++) {
+      }
+      if (W < Width) {
+        SetMem32 (&DstB[W], (Width - W) * sizeof *DstB, Fill);
+        if (FirstDirty == Height) {
+          FirstDirty = H;
+        }
+        EndDirty = H + 1;
       }
-      DstB += PixelsPerScanLine - Width;
+      DstB += PixelsPerScanLine;
+    }
+    if (EndDirty > FirstDirty) {
+      MarkDirtyLines (UsbDisplayLinkDev, DestinationY + FirstDirty, DestinationY + EndDirty);
     }
   }
   break;
@@ -268,12 +303,11 @@ DlGopSendScreenUpdate (
   // If it has been a while since we sent an update, send a full screen.
   // This allows us to update a hot-plugged monitor quickly.
   if (UsbDisplayLinkDev->TimeSinceLastScreenUpdate > DISPLAYLINK_FULL_SCREEN_UPDATE_PERIOD) {
-    UsbDisplayLinkDev->LastY1 = 0;
-    UsbDisplayLinkDev->LastY2 = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution - 1;
+    MarkDirtyLines (UsbDisplayLinkDev, 0, UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution);
   }
 
-  // If there has been no BLT since the last update/poll, drop out quietly.
-  if (UsbDisplayLinkDev->LastY2 < UsbDisplayLinkDev->LastY1) {
+  // If there has been no BLT changing the screen since the last update/poll, drop out quietly.
+  if (UsbDisplayLinkDev->LastY2 <= UsbDisplayLinkDev->LastY1) {
     UsbDisplayLinkDev->TimeSinceLastScreenUpdate += (DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD / 1000);  // Convert us to ms
     return EFI_SUCCESS;
   }
@@ -287,20 +321,19 @@ DlGopSendScreenUpdate (
   UINTN Height;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL* SrcPtr;
   UINT8* DstPtr;
-  UINT8 DstBuffer[1920 * 3]; // Get rid of the magic numbers at some point
-                             // Could also use a buffer allocated at runtime to store the line, stored in the USB_DISPLAYLINK_DEV structure.
   UINTN H;
+  UINTN W;
 
   DataLen = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution * 3; // Send 1 line @ 24 bits per pixel
   Width = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution;
   Height = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution;
-  SrcPtr = UsbDisplayLinkDev->Screen;
-  DstPtr = DstBuffer;
 
-  for (H = 0; H < Height; H++) {
-    DstPtr = DstBuffer;
+  // Only the lines that have been BLTted to since the last update need converting to the device pixel format,
+  // the rest of the frame is still valid in the wire copy.
+  for (H = UsbDisplayLinkDev->LastY1; H < MIN (UsbDisplayLinkDev->LastY2, Height); H++) {
+    SrcPtr = UsbDisplayLinkDev->Screen + H * Width;
+    DstPtr = UsbDisplayLinkDev->WireFrame + H * DataLen;
 
-    UINTN W;
     for (W = 0; W < Width; W++) {
       // Need to swap round the RGB values
       DstPtr[0] = ((UINT8 *)SrcPtr)[2];
@@ -309,23 +342,31 @@ DlGopSendScreenUpdate (
       SrcPtr++;
       DstPtr += 3;
     }
+  }
 
-    Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, DataLen, &USBStatus);
+  // The device expects each line of the frame in its own bulk transfer.
+  DstPtr = UsbDisplayLinkDev->WireFrame;
+  for (H = 0; H < Height; H++) {
+    Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstPtr, DataLen, &USBStatus);
 
     // USBStatus values defined in usbio.h, e.g. EFI_USB_ERR_TIMEOUT 0x40
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", H, DataLen, Status, USBStatus));
       break;
     }
+    UsbDisplayLinkDev->DataSent += DataLen;
+
     // Need an extra DlUsbBulkWrite if the data length is divisible by USB MaxPacketSize. This spare data will just get written into the (invisible) stride area.
     // Note that the API doesn't let us do a bulk write of 0.
     if ((DataLen & (UsbDisplayLinkDev->BulkOutEndpointDescriptor.MaxPacketSize - 1)) == 0) {
-      Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, 2, &USBStatus);
+      Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstPtr, 2, &USBStatus);
       if (EFI_ERROR (Status)) {
         DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", H, DataLen, Status, USBStatus));
         break;
       }
+      UsbDisplayLinkDev->DataSent += 2;
     }
+    DstPtr += DataLen;
   }
 
   if (!EFI_ERROR (Status)) {
@@ -333,11 +374,13 @@ DlGopSendScreenUpdate (
     // If we haven't succeeded, this will mean we'll try to resend it after the next poll period.
     UsbDisplayLinkDev->LastY2 = 0;
     UsbDisplayLinkDev->LastY1 = (UINTN)-1;
+    UsbDisplayLinkDev->FramesSent++;
   }
 
   // Payload with length of 1 to terminate the frame
   // We need to do this even if we had an error, to indicate to the DL device that it should now expect a new frame.
-  DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, 1, &USBStatus);
+  DlUsbBulkWrite (UsbDisplayLinkDev, UsbDisplayLinkDev->WireFrame, 1, &USBStatus);
+  UsbDisplayLinkDev->DataSent += 1;
 
   gBS->RestoreTPL (OriginalTPL);
 
@@ -477,12 +520,28 @@ DisplayLinkSetMode (
     FreePool (UsbDisplayLinkDev->Screen);
   }
 
+  if (UsbDisplayLinkDev->WireFrame != NULL) {
+    FreePool (UsbDisplayLinkDev->WireFrame);
+  }
+
   UsbDisplayLinkDev->Screen = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL*)AllocateZeroPool (
     Gop->Mode->Info->HorizontalResolution *
     Gop->Mode->Info->VerticalResolution *
     sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
 
-  if (UsbDisplayLinkDev->Screen == NULL) {
+  UsbDisplayLinkDev->WireFrame = (UINT8*)AllocateZeroPool (
+    Gop->Mode->Info->HorizontalResolution *
+    Gop->Mode->Info->VerticalResolution * 3);
+
+  if ((UsbDisplayLinkDev->Screen == NULL) || (UsbDisplayLinkDev->WireFrame == NULL)) {
+    if (UsbDisplayLinkDev->Screen != NULL) {
+      FreePool (UsbDisplayLinkDev->Screen);
+      UsbDisplayLinkDev->Screen = NULL;
+    }
+    if (UsbDisplayLinkDev->WireFrame != NULL) {
+      FreePool (UsbDisplayLinkDev->WireFrame);
+      UsbDisplayLinkDev->WireFrame = NULL;
+    }
     return EFI_OUT_OF_RESOURCES;
   }
 
@@ -496,17 +555,11 @@ DisplayLinkSetMode (
     Gop->Mode->Mode = GRAPHICS_OUTPUT_INVALID_MODE_NUMBER;
     FreePool (UsbDisplayLinkDev->Screen);
     UsbDisplayLinkDev->Screen = NULL;
+    FreePool (UsbDisplayLinkDev->WireFrame);
+    UsbDisplayLinkDev->WireFrame = NULL;
   } else {
-    BuildBackBuffer (
-      UsbDisplayLinkDev,
-      UsbDisplayLinkDev->Screen,
-      EfiBltBufferToVideo,
-      0, 0,
-      0, 0,
-      Gop->Mode->Info->HorizontalResolution,
-      Gop->Mode->Info->VerticalResolution,
-      Gop->Mode->Info->HorizontalResolution * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL),
-      Gop->Mode->Info->HorizontalResolution);
+    // The new mode needs a complete frame to be sent
+    MarkDirtyLines (UsbDisplayLinkDev, 0, Gop->Mode->Info->VerticalResolution);
     // unlock the DisplayLinkPeriodicTimer
     Gop->Mode->Mode = ModeNumber;
   }
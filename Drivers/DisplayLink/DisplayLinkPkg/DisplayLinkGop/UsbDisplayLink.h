@@ -80,7 +80,9 @@ typedef struct {
   EFI_EDID_ACTIVE_PROTOCOL      EdidActive;
   EFI_UNICODE_STRING_TABLE      *ControllerNameTable;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Screen;
+  UINT8                         *WireFrame;                    /** Copy of Screen in the 24 bpp format sent to the device */
   UINTN                         DataSent;                       /** Debug - used to track the bandwidth */
+  UINTN                         FramesSent;                    /** Debug - used to track the frame rate */
   EFI_EVENT                     TimerEvent;
   EFI_EVENT                     DriverExitBootServicesEvent;
   BOOLEAN                       ShowBandwidth;                 /** Debugging - show the bandwidth on the screen */
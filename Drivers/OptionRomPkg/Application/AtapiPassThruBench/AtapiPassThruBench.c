@@ -0,0 +1,361 @@
+/** @file
+  Measure the read throughput of every CD-ROM device reachable through an
+  Extended SCSI Pass Thru instance.
+
+  To compare the PIO and the bus master DMA data paths of AtapiPassThruDxe,
+  run it once with the driver as built, and once with the driver built with
+  gOptionRomPkgTokenSpaceGuid.PcdSupportAtapiDma set to FALSE, which keeps
+  every device on PIO:
+
+    build -p OptionRomPkg/OptionRomPkg.dsc -a X64 \
+      -m OptionRomPkg/AtapiPassThruDxe/AtapiPassThruDxe.inf \
+      --pcd gOptionRomPkgTokenSpaceGuid.PcdSupportAtapiDma=FALSE
+
+  On QEMU, start OVMF with "-machine pc -cdrom <image>", so the CD-ROM is on
+  the PIIX IDE controller. In the shell, disconnect the firmware's drivers
+  from that controller, then load the driver and connect it:
+
+    disconnect <controller>
+    load AtapiPassThruDxe.efi
+    connect <controller> <driver>
+    AtapiPassThruBench.efi [MB]
+
+  The driver only uses DMA without an IDE Controller Init protocol if the
+  drive DMA capable bit of the device is set in the bus master status
+  register, which QEMU leaves clear. Set it before connecting, for the
+  master of the secondary channel with "mm <BAR4 + 0xA> 0x20 -IO -w 1".
+
+  MB is the amount of data to read from each device, 16 by default.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/Scsi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/ExtScsiPassThru.h>
+#include <Protocol/ShellParameters.h>
+
+//
+// Data read by each READ (10) command
+//
+#define BENCH_CHUNK_SIZE        SIZE_64KB
+#define BENCH_DEFAULT_MB        16
+#define BENCH_TIMEOUT           EFI_TIMER_PERIOD_SECONDS (10)
+#define BENCH_READY_RETRIES     5
+
+
+/**
+  Send a SCSI command that reads data from the device.
+
+  @param[in]       PassThru      The Extended SCSI Pass Thru instance.
+  @param[in]       Target        The target of the device.
+  @param[in]       Lun           The LUN of the device.
+  @param[in]       Cdb           The command descriptor block.
+  @param[in]       CdbLength     The size of Cdb in bytes.
+  @param[out]      Buffer        The buffer receiving the data.
+  @param[in, out]  Length        On input the size of Buffer, on return the
+                                 number of bytes read.
+
+  @return The status of the command.
+
+**/
+EFI_STATUS
+ScsiRead (
+  IN     EFI_EXT_SCSI_PASS_THRU_PROTOCOL  *PassThru,
+  IN     UINT8                            *Target,
+  IN     UINT64                           Lun,
+  IN     UINT8                            *Cdb,
+  IN     UINT8                            CdbLength,
+  OUT    VOID                             *Buffer,
+  IN OUT UINT32                           *Length
+  )
+{
+  EFI_STATUS                                  Status;
+  EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET  Packet;
+  EFI_SCSI_SENSE_DATA                         Sense;
+
+  ZeroMem (&Packet, sizeof (Packet));
+  Packet.Timeout          = BENCH_TIMEOUT;
+  Packet.InDataBuffer     = Buffer;
+  Packet.SenseData        = &Sense;
+  Packet.Cdb              = Cdb;
+  Packet.InTransferLength = *Length;
+  Packet.CdbLength        = CdbLength;
+  Packet.DataDirection    = EFI_EXT_SCSI_DATA_DIRECTION_READ;
+  Packet.SenseDataLength  = (UINT8) sizeof (Sense);
+
+  Status = PassThru->PassThru (PassThru, Target, Lun, &Packet, NULL);
+  *Length = Packet.InTransferLength;
+  if (!EFI_ERROR (Status) && Packet.TargetStatus != EFI_EXT_SCSI_STATUS_TARGET_GOOD) {
+    Status = EFI_DEVICE_ERROR;
+  }
+
+  return Status;
+}
+
+
+/**
+  Read the capacity of a CD-ROM device, retrying while it reports a unit
+  attention or is becoming ready.
+
+  @param[in]   PassThru      The Extended SCSI Pass Thru instance.
+  @param[in]   Target        The target of the device.
+  @param[in]   Lun           The LUN of the device.
+  @param[in]   Buffer        A scratch buffer of BENCH_CHUNK_SIZE bytes.
+  @param[out]  BlockSize     The size of a block in bytes.
+  @param[out]  BlockCount    The number of blocks on the medium.
+
+  @return The status of the last READ CAPACITY command.
+
+**/
+EFI_STATUS
+ReadCapacity (
+  IN  EFI_EXT_SCSI_PASS_THRU_PROTOCOL  *PassThru,
+  IN  UINT8                            *Target,
+  IN  UINT64                           Lun,
+  IN  VOID                             *Buffer,
+  OUT UINT32                           *BlockSize,
+  OUT UINT64                           *BlockCount
+  )
+{
+  EFI_STATUS                   Status;
+  UINT8                        Cdb[10];
+  UINT32                       Length;
+  UINTN                        Retry;
+  EFI_SCSI_DISK_CAPACITY_DATA  *Capacity;
+
+  Status   = EFI_DEVICE_ERROR;
+  Capacity = Buffer;
+  for (Retry = 0; Retry < BENCH_READY_RETRIES; Retry++) {
+    ZeroMem (Cdb, sizeof (Cdb));
+    Cdb[0] = EFI_SCSI_OP_READ_CAPACITY;
+    Length = sizeof (EFI_SCSI_DISK_CAPACITY_DATA);
+    Status = ScsiRead (PassThru, Target, Lun, Cdb, sizeof (Cdb), Capacity, &Length);
+    if (!EFI_ERROR (Status) && Length == sizeof (EFI_SCSI_DISK_CAPACITY_DATA)) {
+      *BlockSize  = ((UINT32) Capacity->BlockSize3 << 24) | (Capacity->BlockSize2 << 16) |
+                    (Capacity->BlockSize1 << 8) | Capacity->BlockSize0;
+      *BlockCount = (UINT64) (((UINT32) Capacity->LastLba3 << 24) | (Capacity->LastLba2 << 16) |
+                              (Capacity->LastLba1 << 8) | Capacity->LastLba0) + 1;
+      return (*BlockSize == 0) ? EFI_NO_MEDIA : EFI_SUCCESS;
+    }
+
+    gBS->Stall (500000);
+  }
+
+  return EFI_ERROR (Status) ? Status : EFI_DEVICE_ERROR;
+}
+
+
+/**
+  Read Size bytes from the start of a CD-ROM device and print how long it took.
+
+  @param[in]  PassThru      The Extended SCSI Pass Thru instance.
+  @param[in]  Target        The target of the device.
+  @param[in]  Lun           The LUN of the device.
+  @param[in]  Buffer        A buffer of BENCH_CHUNK_SIZE bytes.
+  @param[in]  Size          The number of bytes to read.
+
+**/
+VOID
+BenchDevice (
+  IN EFI_EXT_SCSI_PASS_THRU_PROTOCOL  *PassThru,
+  IN UINT8                            *Target,
+  IN UINT64                           Lun,
+  IN VOID                             *Buffer,
+  IN UINT64                           Size
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Cdb[10];
+  UINT32      BlockSize;
+  UINT64      BlockCount;
+  UINT64      Lba;
+  UINT32      Blocks;
+  UINT32      Length;
+  UINT64      Read;
+  UINT64      Start;
+  UINT64      Elapsed;
+
+  Status = ReadCapacity (PassThru, Target, Lun, Buffer, &BlockSize, &BlockCount);
+  if (!EFI_ERROR (Status) && BlockSize > BENCH_CHUNK_SIZE) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  if (EFI_ERROR (Status)) {
+    Print (L"  LUN %Lx: cannot read capacity: %r\n", Lun, Status);
+    return;
+  }
+
+  Size  = MIN (Size, MultU64x32 (BlockCount, BlockSize));
+  Read  = 0;
+  Lba   = 0;
+  Start = GetPerformanceCounter ();
+  while (Read < Size) {
+    Blocks = (UINT32) MIN (
+                        DivU64x32 (Size - Read + BlockSize - 1, BlockSize),
+                        BENCH_CHUNK_SIZE / BlockSize
+                        );
+    Length = Blocks * BlockSize;
+
+    ZeroMem (Cdb, sizeof (Cdb));
+    Cdb[0] = EFI_SCSI_OP_READ10;
+    Cdb[2] = (UINT8) RShiftU64 (Lba, 24);
+    Cdb[3] = (UINT8) RShiftU64 (Lba, 16);
+    Cdb[4] = (UINT8) RShiftU64 (Lba, 8);
+    Cdb[5] = (UINT8) Lba;
+    Cdb[7] = (UINT8) (Blocks >> 8);
+    Cdb[8] = (UINT8) Blocks;
+    Status = ScsiRead (PassThru, Target, Lun, Cdb, sizeof (Cdb), Buffer, &Length);
+    if (EFI_ERROR (Status)) {
+      Print (L"  LUN %Lx: read at LBA 0x%Lx failed: %r\n", Lun, Lba, Status);
+      return;
+    }
+
+    Read += Length;
+    Lba  += Blocks;
+  }
+
+  Elapsed = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+  if (Elapsed == 0) {
+    Elapsed = 1;
+  }
+
+  Print (
+    L"  LUN %Lx: %Lu KB in %Lu ms, %Lu KB/s\n",
+    Lun,
+    DivU64x32 (Read, SIZE_1KB),
+    DivU64x32 (Elapsed, 1000000),
+    DivU64x64Remainder (MultU64x32 (Read, 1000000000 / SIZE_1KB), Elapsed, NULL)
+    );
+}
+
+
+/**
+  Benchmark every CD-ROM device behind one Extended SCSI Pass Thru instance.
+
+  @param[in]  PassThru      The Extended SCSI Pass Thru instance.
+  @param[in]  Size          The number of bytes to read from each device.
+
+**/
+VOID
+BenchPassThru (
+  IN EFI_EXT_SCSI_PASS_THRU_PROTOCOL  *PassThru,
+  IN UINT64                           Size
+  )
+{
+  EFI_STATUS              Status;
+  UINT8                   TargetId[TARGET_MAX_BYTES];
+  UINT8                   *Target;
+  UINT64                  Lun;
+  UINT8                   Cdb[6];
+  UINT32                  Length;
+  VOID                    *Buffer;
+  EFI_SCSI_INQUIRY_DATA   *Inquiry;
+
+  //
+  // Page aligned, which satisfies any IoAlign a controller may ask for
+  //
+  Buffer = AllocatePages (EFI_SIZE_TO_PAGES (BENCH_CHUNK_SIZE));
+  if (Buffer == NULL) {
+    Print (L"  Out of memory\n");
+    return;
+  }
+
+  Inquiry = Buffer;
+  Target  = TargetId;
+  SetMem (TargetId, sizeof (TargetId), 0xFF);
+  while (!EFI_ERROR (PassThru->GetNextTargetLun (PassThru, &Target, &Lun))) {
+    ZeroMem (Cdb, sizeof (Cdb));
+    Cdb[0] = EFI_SCSI_OP_INQUIRY;
+    Cdb[4] = (UINT8) sizeof (EFI_SCSI_INQUIRY_DATA);
+    Length = sizeof (EFI_SCSI_INQUIRY_DATA);
+    Status = ScsiRead (PassThru, Target, Lun, Cdb, sizeof (Cdb), Inquiry, &Length);
+    if (EFI_ERROR (Status) || Inquiry->Peripheral_Type != EFI_SCSI_TYPE_CDROM) {
+      continue;
+    }
+
+    Print (L" Target %d:\n", Target[0]);
+    BenchDevice (PassThru, Target, Lun, Buffer, Size);
+  }
+
+  FreePages (Buffer, EFI_SIZE_TO_PAGES (BENCH_CHUNK_SIZE));
+}
+
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL    *Parameters;
+  EFI_EXT_SCSI_PASS_THRU_PROTOCOL  *PassThru;
+  EFI_HANDLE                       *Handles;
+  UINTN                            HandleCount;
+  UINTN                            Index;
+  UINTN                            MegaBytes;
+
+  MegaBytes = BENCH_DEFAULT_MB;
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &Parameters
+                  );
+  if (!EFI_ERROR (Status) && Parameters->Argc > 1) {
+    MegaBytes = StrDecimalToUintn (Parameters->Argv[1]);
+    if (MegaBytes == 0) {
+      Print (L"Usage: AtapiPassThruBench [MB]\n");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiExtScsiPassThruProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles
+                  );
+  if (EFI_ERROR (Status)) {
+    Print (L"No Extended SCSI Pass Thru instance found\n");
+    return Status;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (
+                    Handles[Index],
+                    &gEfiExtScsiPassThruProtocolGuid,
+                    (VOID **) &PassThru
+                    );
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Print (L"Pass Thru %Lu, reading %Lu MB from each CD-ROM:\n", (UINT64) Index, (UINT64) MegaBytes);
+    BenchPassThru (PassThru, MultU64x32 (MegaBytes, SIZE_1MB));
+  }
+
+  FreePool (Handles);
+  return EFI_SUCCESS;
+}
@@ -369,6 +369,8 @@ Returns:
     return Status;
   }
 
+  AtapiPassThruFreePrdTable (AtapiScsiPrivate);
+
   //
   // Restore original PCI attributes
   //
@@ -442,6 +444,29 @@ Returns:
 
   InitAtapiIoPortRegisters(AtapiScsiPrivate, IdeRegsBaseAddr);
 
+  //
+  // Both channels share one PRD table for bus master DMA. If the platform
+  // has an IDE Controller Init protocol on the controller, it is used to
+  // pick the DMA mode of each device and program the controller timings.
+  // Otherwise DMA is used only on devices the firmware already set the
+  // controller up for.
+  //
+  Status = gBS->OpenProtocol (
+                  Controller,
+                  &gEfiIdeControllerInitProtocolGuid,
+                  (VOID **) &AtapiScsiPrivate->IdeInit,
+                  This->DriverBindingHandle,
+                  Controller,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (EFI_ERROR (Status)) {
+    AtapiScsiPrivate->IdeInit = NULL;
+  }
+
+  if (IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr != 0) {
+    AtapiPassThruInitPrdTable (AtapiScsiPrivate);
+  }
+
   //
   // Initialize the LatestTargetId to MAX_TARGET_ID.
   //
@@ -449,6 +474,9 @@ Returns:
   AtapiScsiPrivate->LatestLun       = 0;
 
   Status = InstallScsiPassThruProtocols (&Controller, AtapiScsiPrivate);
+  if (EFI_ERROR (Status)) {
+    AtapiPassThruFreePrdTable (AtapiScsiPrivate);
+  }
 
   return Status;
 }
@@ -844,6 +872,15 @@ Returns:
     }
   }
 
+  //
+  // The reset put the devices back to their default transfer mode.
+  //
+  for (Index = 0; Index < ATAPI_MAX_CHANNEL * 2; Index++) {
+    if (AtapiScsiPrivate->DmaState[Index] == ATAPI_DMA_ENABLED) {
+      AtapiScsiPrivate->DmaState[Index] = ATAPI_DMA_UNKNOWN;
+    }
+  }
+
   if (ResetFlag) {
     return EFI_SUCCESS;
   }
@@ -1358,6 +1395,15 @@ Returns:
     }
   }
 
+  //
+  // The reset put the devices back to their default transfer mode.
+  //
+  for (Index = 0; Index < ATAPI_MAX_CHANNEL * 2; Index++) {
+    if (AtapiScsiPrivate->DmaState[Index] == ATAPI_DMA_ENABLED) {
+      AtapiScsiPrivate->DmaState[Index] = ATAPI_DMA_UNKNOWN;
+    }
+  }
+
   if (ResetFlag) {
     return EFI_SUCCESS;
   }
@@ -1617,6 +1663,22 @@ Returns:
     (UINT16) ((PciData.Device.Bar[3] & 0x0000fffc) + 2);
   }
 
+  //
+  // The bus master registers of both channels are in BAR4, which should be
+  // of IO type. The secondary channel's follow the primary channel's.
+  //
+  if ((PciData.Hdr.ClassCode[0] & IDE_BUS_MASTER_SUPPORTED) != 0 &&
+      (PciData.Device.Bar[4] & BIT0) != 0 &&
+      (PciData.Device.Bar[4] & 0x0000fff0) != 0) {
+    IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr     =
+    (UINT16) (PciData.Device.Bar[4] & 0x0000fff0);
+    IdeRegsBaseAddr[IdeSecondary].BusMasterBaseAddr   =
+    (UINT16) (IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr + BUS_MASTER_REG_SIZE);
+  } else {
+    IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr     = 0;
+    IdeRegsBaseAddr[IdeSecondary].BusMasterBaseAddr   = 0;
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -1671,8 +1733,110 @@ Returns:
 
     (*(UINT16 *) &RegisterPointer->Alt) = ControlBlockBaseAddr;
     RegisterPointer->DriveAddress = (UINT16) (ControlBlockBaseAddr + 0x01);
+
+    RegisterPointer->BusMasterBaseAddr = IdeRegsBaseAddr[IdeChannel].BusMasterBaseAddr;
+  }
+
+}
+
+EFI_STATUS
+AtapiPassThruInitPrdTable (
+  IN  ATAPI_SCSI_PASS_THRU_DEV     *AtapiScsiPrivate
+  )
+/*++
+
+Routine Description:
+
+  Allocate and map the PRD table used for bus master DMA. If that fails, bus
+  master DMA is disabled on both channels, so all transfers are done by PIO.
+
+Arguments:
+
+  AtapiScsiPrivate            - The pointer of ATAPI_SCSI_PASS_THRU_DEV
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+{
+  EFI_STATUS            Status;
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  VOID                  *PrdTable;
+  UINTN                 Bytes;
+  UINT8                 IdeChannel;
+
+  PciIo = AtapiScsiPrivate->PciIo;
+
+  Status = PciIo->AllocateBuffer (
+                    PciIo,
+                    AllocateAnyPages,
+                    EfiBootServicesData,
+                    ATAPI_PRD_TABLE_PAGES,
+                    &PrdTable,
+                    0
+                    );
+  if (!EFI_ERROR (Status)) {
+    Bytes  = EFI_PAGES_TO_SIZE (ATAPI_PRD_TABLE_PAGES);
+    Status = PciIo->Map (
+                      PciIo,
+                      EfiPciIoOperationBusMasterCommonBuffer,
+                      PrdTable,
+                      &Bytes,
+                      &AtapiScsiPrivate->PrdTableDeviceAddr,
+                      &AtapiScsiPrivate->PrdTableMapping
+                      );
+    if (!EFI_ERROR (Status) && Bytes != EFI_PAGES_TO_SIZE (ATAPI_PRD_TABLE_PAGES)) {
+      PciIo->Unmap (PciIo, AtapiScsiPrivate->PrdTableMapping);
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+
+    if (EFI_ERROR (Status)) {
+      PciIo->FreeBuffer (PciIo, ATAPI_PRD_TABLE_PAGES, PrdTable);
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    for (IdeChannel = 0; IdeChannel < ATAPI_MAX_CHANNEL; IdeChannel++) {
+      AtapiScsiPrivate->AtapiIoPortRegisters[IdeChannel].BusMasterBaseAddr = 0;
+    }
+    return Status;
+  }
+
+  AtapiScsiPrivate->PrdTable = PrdTable;
+  return EFI_SUCCESS;
+}
+
+VOID
+AtapiPassThruFreePrdTable (
+  IN  ATAPI_SCSI_PASS_THRU_DEV     *AtapiScsiPrivate
+  )
+/*++
+
+Routine Description:
+
+  Unmap and free the PRD table, if there is one.
+
+Arguments:
+
+  AtapiScsiPrivate            - The pointer of ATAPI_SCSI_PASS_THRU_DEV
+
+Returns:
+
+  None
+
+--*/
+{
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+
+  if (AtapiScsiPrivate->PrdTable == NULL) {
+    return;
   }
 
+  PciIo = AtapiScsiPrivate->PciIo;
+  PciIo->Unmap (PciIo, AtapiScsiPrivate->PrdTableMapping);
+  PciIo->FreeBuffer (PciIo, ATAPI_PRD_TABLE_PAGES, AtapiScsiPrivate->PrdTable);
+  AtapiScsiPrivate->PrdTable = NULL;
 }
 
 
@@ -2168,12 +2332,130 @@ Returns:
 
   EFI_STATUS
 
+--*/
+{
+  EFI_STATUS  Status;
+  UINTN       DeviceIndex;
+  UINT32      RequestedByteCount;
+  BOOLEAN     UseDma;
+
+  //
+  // Set the device up for DMA the first time it is used after a reset.
+  //
+  DeviceIndex = ATAPI_DEVICE_INDEX (AtapiScsiPrivate, Target);
+  if (AtapiScsiPrivate->DmaState[DeviceIndex] == ATAPI_DMA_UNKNOWN) {
+    AtapiPassThruDmaConfigure (AtapiScsiPrivate, Target);
+  }
+
+  RequestedByteCount = *ByteCount;
+  UseDma             = (BOOLEAN) (AtapiScsiPrivate->DmaState[DeviceIndex] == ATAPI_DMA_ENABLED);
+  Status = AtapiPassThruPacketCommand (
+             AtapiScsiPrivate,
+             Target,
+             PacketCommand,
+             Buffer,
+             ByteCount,
+             Direction,
+             TimeoutInMicroSeconds,
+             &UseDma
+             );
+  if (!UseDma || (Status != EFI_ABORTED && Status != EFI_BAD_BUFFER_SIZE)) {
+    return Status;
+  }
+
+  //
+  // EFI_ABORTED: the DMA transfer failed. EFI_BAD_BUFFER_SIZE: the device
+  // moved less data than asked for, and the bus master cannot tell how much.
+  // Either way, issue the command again by PIO, which reports what was
+  // transferred.
+  //
+  *ByteCount = RequestedByteCount;
+  UseDma     = FALSE;
+  if (Status == EFI_BAD_BUFFER_SIZE) {
+    return AtapiPassThruPacketCommand (
+             AtapiScsiPrivate,
+             Target,
+             PacketCommand,
+             Buffer,
+             ByteCount,
+             Direction,
+             TimeoutInMicroSeconds,
+             &UseDma
+             );
+  }
+
+  Status = AtapiPassThruPacketCommand (
+             AtapiScsiPrivate,
+             Target,
+             PacketCommand,
+             Buffer,
+             ByteCount,
+             Direction,
+             TimeoutInMicroSeconds,
+             &UseDma
+             );
+  if (!EFI_ERROR (Status)) {
+    //
+    // The command works by PIO, so the device cannot do DMA on this
+    // controller. Use PIO for it from now on.
+    //
+    DEBUG ((EFI_D_ERROR, "AtapiPacketCommand()-- DMA failed where PIO works, using PIO only\n"));
+    AtapiScsiPrivate->DmaState[DeviceIndex] = ATAPI_DMA_DISABLED;
+  }
+
+  return Status;
+}
+
+EFI_STATUS
+AtapiPassThruPacketCommand (
+  ATAPI_SCSI_PASS_THRU_DEV    *AtapiScsiPrivate,
+  UINT32                      Target,
+  UINT8                       *PacketCommand,
+  VOID                        *Buffer,
+  UINT32                      *ByteCount,
+  DATA_DIRECTION              Direction,
+  UINT64                      TimeoutInMicroSeconds,
+  BOOLEAN                     *UseDma
+  )
+/*++
+
+Routine Description:
+
+  Submits ATAPI command packet to the specified ATAPI device once, moving
+  the data by bus master DMA if allowed and possible, otherwise by PIO.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device to send the SCSI
+                      Request Packet.
+  PacketCommand:      Points to the ATAPI command packet.
+  Buffer:             Points to the transferred data.
+  ByteCount:          When input,indicates the buffer size; when output,
+                      indicates the actually transferred data size.
+  Direction:          Indicates the data transfer direction.
+  TimeoutInMicroSeconds:
+                      The timeout, in micro second units, to use for the
+                      execution of this ATAPI command.
+  UseDma:             When input, indicates whether the data may be moved
+                      by DMA; when output, indicates whether it was.
+
+Returns:
+
+  EFI_ABORTED         - The DMA transfer timed out or the bus master
+                        failed. The device is ready to take the command
+                        again by PIO.
+  EFI_BAD_BUFFER_SIZE - Less data than ByteCount was transferred. After a
+                        DMA transfer, ByteCount does not tell how much.
+  Others              - As AtapiPassThruPioReadWriteData().
+
 --*/
 {
 
   UINT16      *CommandIndex;
   UINT8       Count;
   EFI_STATUS  Status;
+  VOID        *Mapping;
 
   //
   // Set all the command parameters by fill related registers.
@@ -2210,12 +2492,30 @@ Returns:
   }
 
   //
-  // No OVL; No DMA (by setting feature register)
+  // Move the data by bus master DMA if the command and buffer allow it,
+  // otherwise by PIO.
+  //
+  Mapping = NULL;
+  if (*UseDma) {
+    Status  = AtapiPassThruDmaPrepare (
+                AtapiScsiPrivate,
+                Target,
+                PacketCommand,
+                Buffer,
+                *ByteCount,
+                Direction,
+                &Mapping
+                );
+    *UseDma = (BOOLEAN) !EFI_ERROR (Status);
+  }
+
+  //
+  // No OVL; DMA as decided above (by setting feature register)
   //
   WritePortB (
     AtapiScsiPrivate->PciIo,
     AtapiScsiPrivate->IoPort->Reg1.Feature,
-    0x00
+    (UINT8) (*UseDma ? DMA : 0x00)
     );
 
   //
@@ -2235,12 +2535,13 @@ Returns:
 
   //
   //  DEFAULT_CTL:0x0a (0000,1010)
-  //  Disable interrupt
+  //  Disable interrupt, unless the bus master needs it to tell
+  //  when the command completes
   //
   WritePortB (
     AtapiScsiPrivate->PciIo,
     AtapiScsiPrivate->IoPort->Alt.DeviceControl,
-    DEFAULT_CTL
+    (UINT8) (*UseDma ? (DEFAULT_CTL & ~IEN_L) : DEFAULT_CTL)
     );
 
   //
@@ -2260,6 +2561,10 @@ Returns:
   //
   Status = StatusDRQReady (AtapiScsiPrivate, TimeoutInMicroSeconds);
   if (EFI_ERROR (Status)) {
+    if (*UseDma) {
+      AtapiPassThruDmaStop (AtapiScsiPrivate, Mapping);
+    }
+
     if (Status == EFI_ABORTED) {
       Status = EFI_DEVICE_ERROR;
     }
@@ -2276,6 +2581,16 @@ Returns:
     WritePortW (AtapiScsiPrivate->PciIo, AtapiScsiPrivate->IoPort->Data, *CommandIndex);
   }
 
+  if (*UseDma) {
+    return AtapiPassThruDmaReadWriteData (
+             AtapiScsiPrivate,
+             Target,
+             ByteCount,
+             Mapping,
+             TimeoutInMicroSeconds
+             );
+  }
+
   //
   // call AtapiPassThruPioReadWriteData() function to get
   // requested transfer data form device.
@@ -2415,97 +2730,821 @@ Arguments:
   return Status;
 }
 
-
-UINT8
-ReadPortB (
-  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
-  IN  UINT16                Port
+EFI_STATUS
+AtapiPassThruDmaPrepare (
+  ATAPI_SCSI_PASS_THRU_DEV    *AtapiScsiPrivate,
+  UINT32                      Target,
+  UINT8                       *PacketCommand,
+  VOID                        *Buffer,
+  UINT32                      ByteCount,
+  DATA_DIRECTION              Direction,
+  VOID                        **Mapping
   )
 /*++
 
 Routine Description:
 
-  Read one byte from a specified I/O port.
+  Maps the data buffer, fills the PRD table and loads it into the bus master
+  of the current channel, if the ATAPI command packet can move its data by
+  bus master DMA. Only the read and write commands are done by DMA: they move
+  the bulk of the data, and their transfer size is fixed by the packet.
 
 Arguments:
 
-  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
-  Port       - IO port
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  PacketCommand:      Points to the ATAPI command packet.
+  Buffer:             Points to the transferred data.
+  ByteCount:          The buffer size.
+  Direction:          Indicates the data transfer direction.
+  Mapping:            Receives the mapping of the data buffer, which
+                      AtapiPassThruDmaStop() releases.
 
 Returns:
 
-  A byte read out
+  EFI_SUCCESS         - The bus master is ready to be started.
+  EFI_UNSUPPORTED     - The data must be moved by PIO.
 
 --*/
 {
-  UINT8 Data;
+  EFI_STATUS                    Status;
+  EFI_PCI_IO_PROTOCOL           *PciIo;
+  EFI_PCI_IO_PROTOCOL_OPERATION Operation;
+  EFI_PHYSICAL_ADDRESS          DeviceAddress;
+  UINTN                         MappedLength;
+  UINT16                        BusMasterBaseAddr;
+  ATAPI_PRD                     *Prd;
+  UINT32                        RegionBaseAddr;
+  UINT32                        Remaining;
+  UINT32                        Length;
+  UINT8                         Value;
+
+  BusMasterBaseAddr = AtapiScsiPrivate->IoPort->BusMasterBaseAddr;
+  if (BusMasterBaseAddr == 0 ||
+      AtapiScsiPrivate->DmaState[ATAPI_DEVICE_INDEX (AtapiScsiPrivate, Target)] != ATAPI_DMA_ENABLED) {
+    return EFI_UNSUPPORTED;
+  }
 
-  Data = 0;
-  PciIo->Io.Read (
-              PciIo,
-              EfiPciIoWidthUint8,
-              EFI_PCI_IO_PASS_THROUGH_BAR,
-              (UINT64) Port,
-              1,
-              &Data
-              );
-  return Data;
-}
+  if (PacketCommand[0] != OP_READ_10 && PacketCommand[0] != OP_READ_12 &&
+      PacketCommand[0] != OP_WRITE_10 && PacketCommand[0] != OP_WRITE_12) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // A PRD describes an even number of bytes at an even address.
+  //
+  if (Buffer == NULL || ByteCount == 0 || (ByteCount & 1) != 0 ||
+      ByteCount > ATAPI_MAX_DMA_BYTE_COUNT ||
+      (Direction != DataIn && Direction != DataOut)) {
+    return EFI_UNSUPPORTED;
+  }
 
+  PciIo = AtapiScsiPrivate->PciIo;
+  if (Direction == DataIn) {
+    Operation = EfiPciIoOperationBusMasterWrite;
+  } else {
+    Operation = EfiPciIoOperationBusMasterRead;
+  }
 
-UINT16
-ReadPortW (
-  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
-  IN  UINT16                Port
-  )
-/*++
+  MappedLength = ByteCount;
+  Status = PciIo->Map (
+                    PciIo,
+                    Operation,
+                    Buffer,
+                    &MappedLength,
+                    &DeviceAddress,
+                    Mapping
+                    );
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
 
-Routine Description:
+  if (MappedLength != ByteCount || (DeviceAddress & 1) != 0 ||
+      DeviceAddress + ByteCount > SIZE_4GB) {
+    PciIo->Unmap (PciIo, *Mapping);
+    return EFI_UNSUPPORTED;
+  }
 
-  Read one word from a specified I/O port.
+  //
+  // Split the buffer at 64KB boundaries, one PRD per region.
+  //
+  Prd            = AtapiScsiPrivate->PrdTable;
+  RegionBaseAddr = (UINT32) DeviceAddress;
+  Remaining      = ByteCount;
+  while (TRUE) {
+    Length = MIN (PRD_REGION_SIZE - (RegionBaseAddr & (PRD_REGION_SIZE - 1)), Remaining);
 
-Arguments:
+    Prd->RegionBaseAddr = RegionBaseAddr;
+    Prd->ByteCount      = (UINT16) Length;
+    Prd->EndOfTable     = 0;
 
-  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
-  Port       - IO port
+    RegionBaseAddr += Length;
+    Remaining      -= Length;
+    if (Remaining == 0) {
+      Prd->EndOfTable = PRD_END_OF_TABLE;
+      break;
+    }
 
-Returns:
+    Prd++;
+  }
 
-  A word read out
---*/
-{
-  UINT16  Data;
+  //
+  // Load the PRD table and the direction with the bus master stopped, and
+  // clear the interrupt and error bits of the last transfer.
+  //
+  WritePortDW (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIDTP_OFFSET),
+    (UINT32) AtapiScsiPrivate->PrdTableDeviceAddr
+    );
+  WritePortB (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIC_OFFSET),
+    (UINT8) ((Direction == DataIn) ? BMIC_NREAD : 0)
+    );
+  Value = ReadPortB (PciIo, (UINT16) (BusMasterBaseAddr + BMIS_OFFSET));
+  WritePortB (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIS_OFFSET),
+    (UINT8) (Value | BMIS_INTERRUPT | BMIS_ERROR)
+    );
 
-  Data = 0;
-  PciIo->Io.Read (
-              PciIo,
-              EfiPciIoWidthUint16,
-              EFI_PCI_IO_PASS_THROUGH_BAR,
-              (UINT64) Port,
-              1,
-              &Data
-              );
-  return Data;
+  return EFI_SUCCESS;
 }
 
-
-VOID
-WritePortB (
-  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
-  IN  UINT16                Port,
-  IN  UINT8                 Data
+EFI_STATUS
+AtapiPassThruDmaReadWriteData (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  UINT32                    *ByteCount,
+  VOID                      *Mapping,
+  UINT64                    TimeoutInMicroSeconds
   )
 /*++
 
 Routine Description:
 
-  Write one byte to a specified I/O port.
+  Performs the bus master DMA transfer set up by AtapiPassThruDmaPrepare()
+  after the ATAPI command packet is sent, and waits for the command to
+  complete.
 
 Arguments:
 
-  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
-  Port       - IO port
-  Data       - The data to write
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  ByteCount:          When input,indicates the buffer size; when output,
+                      indicates the actually transferred data size.
+  Mapping:            The mapping of the data buffer.
+  TimeoutInMicroSeconds:
+                      The timeout, in micro second units, to use for the
+                      execution of this ATAPI command.
+                      A TimeoutInMicroSeconds value of 0 means that
+                      this function will wait indefinitely for the ATAPI
+                      command to execute.
+ Returns:
+
+  EFI_SUCCESS         - All the data was transferred.
+  EFI_ABORTED         - The transfer timed out or the bus master failed.
+                        A timed out device has been reset.
+  EFI_DEVICE_ERROR    - The device reported an error in its status.
+  EFI_BAD_BUFFER_SIZE - The device transferred less data than ByteCount,
+                        and the bus master cannot tell how much.
+
+--*/
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT16               BusMasterBaseAddr;
+  UINT64               Delay;
+  UINT8                Value;
+  UINT32               RequestedByteCount;
+
+  PciIo              = AtapiScsiPrivate->PciIo;
+  BusMasterBaseAddr  = AtapiScsiPrivate->IoPort->BusMasterBaseAddr;
+  RequestedByteCount = *ByteCount;
+
+  //
+  // Drop any interrupt raised while the packet was sent, then start.
+  //
+  Value = ReadPortB (PciIo, (UINT16) (BusMasterBaseAddr + BMIS_OFFSET));
+  WritePortB (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIS_OFFSET),
+    (UINT8) (Value | BMIS_INTERRUPT)
+    );
+  Value = ReadPortB (PciIo, (UINT16) (BusMasterBaseAddr + BMIC_OFFSET));
+  WritePortB (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIC_OFFSET),
+    (UINT8) (Value | BMIC_START)
+    );
+
+  if (TimeoutInMicroSeconds == 0) {
+    Delay = 2;
+  } else {
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+  }
+
+  //
+  // The device interrupts when the command completes, whether or not
+  // it moved all the data the PRD table describes.
+  //
+  do {
+    Value = ReadPortB (PciIo, (UINT16) (BusMasterBaseAddr + BMIS_OFFSET));
+    if ((Value & (BMIS_INTERRUPT | BMIS_ERROR)) != 0) {
+      break;
+    }
+    //
+    //  Stall for 30 us
+    //
+    gBS->Stall (30);
+
+    //
+    // Loop infinitely if not meeting expected condition
+    //
+    if (TimeoutInMicroSeconds == 0) {
+      Delay = 2;
+    }
+
+    Delay--;
+  } while (Delay);
+
+  AtapiPassThruDmaStop (AtapiScsiPrivate, Mapping);
+
+  *ByteCount = 0;
+  if (Delay == 0 || (Value & BMIS_ERROR) != 0 ||
+      EFI_ERROR (StatusWaitForBSYClear (AtapiScsiPrivate, TimeoutInMicroSeconds))) {
+    //
+    // The device may still be in the middle of the command.
+    // Reset it so that the command can be issued again by PIO.
+    //
+    DEBUG (
+      (EFI_D_ERROR,
+      "AtapiPassThruDmaReadWriteData()-- %02x : DMA failed, resetting device\n",
+      Value)
+      );
+    AtapiPassThruDeviceReset (AtapiScsiPrivate, Target);
+    return EFI_ABORTED;
+  }
+
+  //
+  // read status register to check whether error happens.
+  // An error the device reports, such as CHECK CONDITION, is not a DMA
+  // failure: return it as PIO does, so the caller can read the sense data.
+  //
+  Status = AtapiPassThruCheckErrorStatus (AtapiScsiPrivate);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Still active means the device moved less data than the PRD table
+  // describes, and the bus master cannot tell how much.
+  //
+  if ((Value & BMIS_ACTIVE) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  *ByteCount = RequestedByteCount;
+  return EFI_SUCCESS;
+}
+
+VOID
+AtapiPassThruDmaStop (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  VOID                      *Mapping
+  )
+/*++
+
+Routine Description:
+
+  Stops the bus master of the current channel, clears its interrupt and
+  error bits, disables the device interrupt again and unmaps the data buffer.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Mapping:            The mapping of the data buffer.
+
+Returns:
+
+  None
+
+--*/
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT16               BusMasterBaseAddr;
+  UINT8                Value;
+
+  PciIo             = AtapiScsiPrivate->PciIo;
+  BusMasterBaseAddr = AtapiScsiPrivate->IoPort->BusMasterBaseAddr;
+
+  Value = ReadPortB (PciIo, (UINT16) (BusMasterBaseAddr + BMIC_OFFSET));
+  WritePortB (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIC_OFFSET),
+    (UINT8) (Value & ~BMIC_START)
+    );
+  Value = ReadPortB (PciIo, (UINT16) (BusMasterBaseAddr + BMIS_OFFSET));
+  WritePortB (
+    PciIo,
+    (UINT16) (BusMasterBaseAddr + BMIS_OFFSET),
+    (UINT8) (Value | BMIS_INTERRUPT | BMIS_ERROR)
+    );
+
+  WritePortB (
+    PciIo,
+    AtapiScsiPrivate->IoPort->Alt.DeviceControl,
+    DEFAULT_CTL
+    );
+
+  PciIo->Unmap (PciIo, Mapping);
+}
+
+EFI_STATUS
+AtapiPassThruDmaConfigure (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target
+  )
+/*++
+
+Routine Description:
+
+  Sets the device and the controller of the current channel to a DMA mode
+  both support, if the IDENTIFY PACKET DEVICE data says the device can do
+  DMA. The data of the device is moved by PIO unless this succeeds.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+
+Returns:
+
+  EFI_SUCCESS         - The device uses DMA.
+  EFI_UNSUPPORTED     - The device or the controller cannot do DMA.
+  Others              - Setting up the device failed.
+
+--*/
+{
+  EFI_STATUS         Status;
+  EFI_IDENTIFY_DATA  IdentifyData;
+  UINTN              DeviceIndex;
+
+  DeviceIndex = ATAPI_DEVICE_INDEX (AtapiScsiPrivate, Target);
+  AtapiScsiPrivate->DmaState[DeviceIndex] = ATAPI_DMA_DISABLED;
+
+  if (!FeaturePcdGet (PcdSupportAtapiDma) ||
+      AtapiScsiPrivate->IoPort->BusMasterBaseAddr == 0 ||
+      AtapiScsiPrivate->PrdTable == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = AtapiPassThruIdentifyPacketDevice (AtapiScsiPrivate, Target, &IdentifyData);
+  if (!EFI_ERROR (Status) &&
+      (((UINT16 *) &IdentifyData)[IDENTIFY_CAPABILITIES_WORD] & IDENTIFY_DMA_SUPPORTED) == 0) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    if (AtapiScsiPrivate->IdeInit != NULL) {
+      Status = AtapiPassThruDmaConfigureByIdeInit (AtapiScsiPrivate, Target, &IdentifyData);
+    } else {
+      Status = AtapiPassThruDmaConfigureByBmis (AtapiScsiPrivate, Target, &IdentifyData);
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    AtapiScsiPrivate->DmaState[DeviceIndex] = ATAPI_DMA_ENABLED;
+  }
+
+  DEBUG ((
+    EFI_D_INFO,
+    "AtapiPassThruDmaConfigure()-- Channel %d Device %d : %r\n",
+    (UINT8) (AtapiScsiPrivate->IoPort - AtapiScsiPrivate->AtapiIoPortRegisters),
+    Target,
+    Status
+    ));
+  return Status;
+}
+
+EFI_STATUS
+AtapiPassThruDmaConfigureByIdeInit (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  EFI_IDENTIFY_DATA         *IdentifyData
+  )
+/*++
+
+Routine Description:
+
+  Lets the IDE Controller Init protocol of the platform pick the fastest
+  DMA mode the controller and the device support, sets the device to it
+  and programs the controller timings for it.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  IdentifyData:       The IDENTIFY PACKET DEVICE data of the device.
+
+Returns:
+
+  EFI_SUCCESS         - The device and the controller are set to DMA.
+  EFI_UNSUPPORTED     - No DMA mode suits both.
+  Others              - Setting up the device or the controller failed.
+
+--*/
+{
+  EFI_STATUS                        Status;
+  EFI_IDE_CONTROLLER_INIT_PROTOCOL  *IdeInit;
+  EFI_ATA_COLLECTIVE_MODE           *SupportedModes;
+  UINT8                             Channel;
+  UINT8                             Device;
+  UINT8                             TransferMode;
+
+  IdeInit = AtapiScsiPrivate->IdeInit;
+  Channel = (UINT8) (AtapiScsiPrivate->IoPort - AtapiScsiPrivate->AtapiIoPortRegisters);
+  Device  = (UINT8) Target;
+
+  SupportedModes = NULL;
+  IdeInit->NotifyPhase (IdeInit, EfiIdeBeforeChannelEnumeration, Channel);
+
+  Status = IdeInit->SubmitData (IdeInit, Channel, Device, IdentifyData);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  Status = IdeInit->CalculateMode (IdeInit, Channel, Device, &SupportedModes);
+  if (EFI_ERROR (Status)) {
+    SupportedModes = NULL;
+    goto Done;
+  }
+
+  if (SupportedModes->UdmaMode.Valid) {
+    TransferMode = (UINT8) (TRANSFER_MODE_UDMA | SupportedModes->UdmaMode.Mode);
+    SupportedModes->MultiWordDmaMode.Valid = FALSE;
+  } else if (SupportedModes->MultiWordDmaMode.Valid) {
+    TransferMode = (UINT8) (TRANSFER_MODE_MWDMA | SupportedModes->MultiWordDmaMode.Mode);
+  } else {
+    Status = EFI_UNSUPPORTED;
+    goto Done;
+  }
+
+  Status = AtapiPassThruSetTransferMode (AtapiScsiPrivate, Target, TransferMode);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  //
+  // Program the controller timings for the DMA mode the device is now in.
+  //
+  SupportedModes->SingleWordDmaMode.Valid = FALSE;
+  Status = IdeInit->SetTiming (IdeInit, Channel, Device, SupportedModes);
+
+Done:
+  IdeInit->NotifyPhase (IdeInit, EfiIdeAfterChannelEnumeration, Channel);
+  if (SupportedModes != NULL) {
+    FreePool (SupportedModes);
+  }
+
+  return Status;
+}
+
+EFI_STATUS
+AtapiPassThruDmaConfigureByBmis (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  EFI_IDENTIFY_DATA         *IdentifyData
+  )
+/*++
+
+Routine Description:
+
+  Sets the device to a DMA mode when there is no IDE Controller Init
+  protocol to program the controller. The controller is taken to be set
+  up for DMA on the device if the drive DMA capable bit of the device is
+  set in the bus master status register, which is how the firmware that
+  programmed the timings reports it. The device keeps the DMA mode it has
+  selected, or else is set to its fastest multiword DMA mode, since Ultra
+  DMA needs controller specific setup.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  IdentifyData:       The IDENTIFY PACKET DEVICE data of the device.
+
+Returns:
+
+  EFI_SUCCESS         - The device is set to DMA.
+  EFI_UNSUPPORTED     - The controller is not set up for DMA on the device,
+                        or the device reports no DMA mode.
+  Others              - Setting up the device failed.
+
+--*/
+{
+  UINT16  *Words;
+  UINT8   Value;
+  UINT8   Modes;
+  UINT8   TransferMode;
+
+  Value = ReadPortB (
+            AtapiScsiPrivate->PciIo,
+            (UINT16) (AtapiScsiPrivate->IoPort->BusMasterBaseAddr + BMIS_OFFSET)
+            );
+  if ((Value & (Target == 0 ? BMIS_DRIVE0_DMA : BMIS_DRIVE1_DMA)) == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // The high byte of the Ultra DMA and multiword DMA words has the bit of
+  // the selected mode set, the low byte those of the supported modes.
+  //
+  Words = (UINT16 *) IdentifyData;
+  Modes = 0;
+  if ((Words[IDENTIFY_VALIDITY_WORD] & IDENTIFY_UDMA_WORD_VALID) != 0) {
+    Modes = (UINT8) (Words[IDENTIFY_UDMA_WORD] >> 8);
+  }
+
+  if (Modes != 0) {
+    TransferMode = (UINT8) (TRANSFER_MODE_UDMA | HighBitSet32 (Modes));
+  } else {
+    Modes = (UINT8) (Words[IDENTIFY_MWDMA_WORD] >> 8);
+    if (Modes == 0) {
+      Modes = (UINT8) (Words[IDENTIFY_MWDMA_WORD] & IDENTIFY_MWDMA_SUPPORTED);
+    }
+
+    if (Modes == 0) {
+      return EFI_UNSUPPORTED;
+    }
+
+    TransferMode = (UINT8) (TRANSFER_MODE_MWDMA | HighBitSet32 (Modes));
+  }
+
+  return AtapiPassThruSetTransferMode (AtapiScsiPrivate, Target, TransferMode);
+}
+
+EFI_STATUS
+AtapiPassThruIdentifyPacketDevice (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  EFI_IDENTIFY_DATA         *IdentifyData
+  )
+/*++
+
+Routine Description:
+
+  Reads the IDENTIFY PACKET DEVICE data of the specified ATAPI device by PIO.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  IdentifyData:       Receives the 512 bytes of identify data.
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+{
+  EFI_STATUS  Status;
+  UINT16      *Data;
+  UINTN       Index;
+
+  Status = StatusWaitForBSYClear (AtapiScsiPrivate, ATAPI_DMA_SETUP_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Head,
+    (UINT8) ((Target << 4) | DEFAULT_CMD)
+    );
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Alt.DeviceControl,
+    DEFAULT_CTL
+    );
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Reg.Command,
+    ATAPI_IDENTIFY_DEVICE_CMD
+    );
+
+  Status = StatusDRQReady (AtapiScsiPrivate, ATAPI_DMA_SETUP_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Data = (UINT16 *) IdentifyData;
+  for (Index = 0; Index < sizeof (EFI_IDENTIFY_DATA) / sizeof (UINT16); Index++) {
+    Data[Index] = ReadPortW (AtapiScsiPrivate->PciIo, AtapiScsiPrivate->IoPort->Data);
+  }
+
+  StatusDRQClear (AtapiScsiPrivate, ATAPI_DMA_SETUP_TIMEOUT);
+
+  return AtapiPassThruCheckErrorStatus (AtapiScsiPrivate);
+}
+
+EFI_STATUS
+AtapiPassThruSetTransferMode (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  UINT8                     TransferMode
+  )
+/*++
+
+Routine Description:
+
+  Sets the transfer mode of the specified ATAPI device with SET FEATURES.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  TransferMode:       The transfer type in bits 7:3 and the mode in bits 2:0.
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+{
+  EFI_STATUS  Status;
+
+  Status = StatusWaitForBSYClear (AtapiScsiPrivate, ATAPI_DMA_SETUP_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Head,
+    (UINT8) ((Target << 4) | DEFAULT_CMD)
+    );
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Reg1.Feature,
+    SET_FEATURES_TRANSFER_MODE
+    );
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->SectorCount,
+    TransferMode
+    );
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Reg.Command,
+    ATA_SET_FEATURES_CMD
+    );
+
+  Status = StatusWaitForBSYClear (AtapiScsiPrivate, ATAPI_DMA_SETUP_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return AtapiPassThruCheckErrorStatus (AtapiScsiPrivate);
+}
+
+EFI_STATUS
+AtapiPassThruDeviceReset (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target
+  )
+/*++
+
+Routine Description:
+
+  Stops the command in progress on the specified ATAPI device with DEVICE
+  RESET. The device keeps its transfer mode.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+
+Returns:
+
+  EFI_SUCCESS         - The device is ready for the next command.
+  EFI_TIMEOUT         - The device is still busy.
+
+--*/
+{
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Head,
+    (UINT8) ((Target << 4) | DEFAULT_CMD)
+    );
+  WritePortB (
+    AtapiScsiPrivate->PciIo,
+    AtapiScsiPrivate->IoPort->Reg.Command,
+    ATAPI_SOFT_RESET_CMD
+    );
+
+  //
+  // slave device needs at most 31s to clear BSY
+  //
+  if (EFI_ERROR (StatusWaitForBSYClear (AtapiScsiPrivate, 31000000))) {
+    return EFI_TIMEOUT;
+  }
+
+  return EFI_SUCCESS;
+}
+
+
+UINT8
+ReadPortB (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port
+  )
+/*++
+
+Routine Description:
+
+  Read one byte from a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+
+Returns:
+
+  A byte read out
+
+--*/
+{
+  UINT8 Data;
+
+  Data = 0;
+  PciIo->Io.Read (
+              PciIo,
+              EfiPciIoWidthUint8,
+              EFI_PCI_IO_PASS_THROUGH_BAR,
+              (UINT64) Port,
+              1,
+              &Data
+              );
+  return Data;
+}
+
+
+UINT16
+ReadPortW (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port
+  )
+/*++
+
+Routine Description:
+
+  Read one word from a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+
+Returns:
+
+  A word read out
+--*/
+{
+  UINT16  Data;
+
+  Data = 0;
+  PciIo->Io.Read (
+              PciIo,
+              EfiPciIoWidthUint16,
+              EFI_PCI_IO_PASS_THROUGH_BAR,
+              (UINT64) Port,
+              1,
+              &Data
+              );
+  return Data;
+}
+
+
+VOID
+WritePortB (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port,
+  IN  UINT8                 Data
+  )
+/*++
+
+Routine Description:
+
+  Write one byte to a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+  Data       - The data to write
 
 Returns:
 
@@ -2558,6 +3597,41 @@ Returns:
               );
 }
 
+
+VOID
+WritePortDW (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port,
+  IN  UINT32                Data
+  )
+/*++
+
+Routine Description:
+
+  Write one dword to a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+  Data       - The data to write
+
+Returns:
+
+   NONE
+
+--*/
+{
+  PciIo->Io.Write (
+              PciIo,
+              EfiPciIoWidthUint32,
+              EFI_PCI_IO_PASS_THROUGH_BAR,
+              (UINT64) Port,
+              1,
+              &Data
+              );
+}
+
 EFI_STATUS
 StatusDRQClear (
   ATAPI_SCSI_PASS_THRU_DEV        *AtapiScsiPrivate,
@@ -16,6 +16,7 @@
 #include <Protocol/ScsiPassThru.h>
 #include <Protocol/ScsiPassThruExt.h>
 #include <Protocol/PciIo.h>
+#include <Protocol/IdeControllerInit.h>
 #include <Protocol/DriverSupportedEfiVersion.h>
 
 #include <Library/DebugLib.h>
@@ -68,6 +69,7 @@ typedef enum {
 #define IDE_PRIMARY_PROGRAMMABLE_INDICATOR    BIT1
 #define IDE_SECONDARY_OPERATING_MODE          BIT2
 #define IDE_SECONDARY_PROGRAMMABLE_INDICATOR  BIT3
+#define IDE_BUS_MASTER_SUPPORTED              BIT7
 
 
 #define ATAPI_MAX_CHANNEL 2
@@ -86,8 +88,47 @@ typedef struct {
   IDE_CMD_OR_STATUS               Reg;
   IDE_AltStatus_OR_DeviceControl  Alt;
   UINT16                          DriveAddress;
+  UINT16                          BusMasterBaseAddr;
 } IDE_BASE_REGISTERS;
 
+//
+// Bus master IDE registers, relative to BusMasterBaseAddr of the channel
+//
+#define BMIC_OFFSET           0x00  ///< Bus Master IDE Command Register
+#define BMIS_OFFSET           0x02  ///< Bus Master IDE Status Register
+#define BMIDTP_OFFSET         0x04  ///< Bus Master IDE Descriptor Table Pointer
+#define BUS_MASTER_REG_SIZE   0x08
+
+#define BMIC_START            BIT0  ///< Start/Stop Bus Master
+#define BMIC_NREAD            BIT3  ///< Bus master writes to memory
+
+#define BMIS_ACTIVE           BIT0  ///< Bus Master IDE Active
+#define BMIS_ERROR            BIT1  ///< Error
+#define BMIS_INTERRUPT        BIT2  ///< IDE device raised an interrupt
+#define BMIS_DRIVE0_DMA       BIT5  ///< Controller set up for DMA on device 0
+#define BMIS_DRIVE1_DMA       BIT6  ///< Controller set up for DMA on device 1
+
+///
+/// Physical Region Descriptor. A region must not cross a 64KB boundary and
+/// a ByteCount of 0 stands for 64KB.
+///
+typedef struct {
+  UINT32  RegionBaseAddr;
+  UINT16  ByteCount;
+  UINT16  EndOfTable;
+} ATAPI_PRD;
+
+#define PRD_END_OF_TABLE      BIT15
+#define PRD_REGION_SIZE       SIZE_64KB
+
+//
+// The PRD table takes one page, so it never crosses a 64KB boundary. Any
+// transfer up to ATAPI_MAX_DMA_BYTE_COUNT fits in it however it is aligned.
+//
+#define ATAPI_PRD_TABLE_PAGES     1
+#define ATAPI_MAX_PRD_COUNT       (EFI_PAGES_TO_SIZE (ATAPI_PRD_TABLE_PAGES) / sizeof (ATAPI_PRD))
+#define ATAPI_MAX_DMA_BYTE_COUNT  ((ATAPI_MAX_PRD_COUNT - 1) * PRD_REGION_SIZE)
+
 #define ATAPI_SCSI_PASS_THRU_DEV_SIGNATURE  SIGNATURE_32 ('a', 's', 'p', 't')
 
 typedef struct {
@@ -104,16 +145,39 @@ typedef struct {
   IDE_BASE_REGISTERS               AtapiIoPortRegisters[2];
   UINT32                           LatestTargetId;
   UINT64                           LatestLun;
+  //
+  // Bus master DMA. PrdTable is NULL if no channel can do DMA. DmaState
+  // tells, for each device, whether it has been set up for DMA.
+  //
+  EFI_IDE_CONTROLLER_INIT_PROTOCOL *IdeInit;
+  ATAPI_PRD                        *PrdTable;
+  EFI_PHYSICAL_ADDRESS             PrdTableDeviceAddr;
+  VOID                             *PrdTableMapping;
+  UINT8                            DmaState[ATAPI_MAX_CHANNEL * 2];
 } ATAPI_SCSI_PASS_THRU_DEV;
 
+//
+// DmaState values
+//
+#define ATAPI_DMA_UNKNOWN     0   ///< Not set up yet, or reset since
+#define ATAPI_DMA_ENABLED     1   ///< Device and controller set to a DMA mode
+#define ATAPI_DMA_DISABLED    2   ///< Device uses PIO only
+
 //
 // IDE registers' base addresses
 //
 typedef struct {
   UINT16  CommandBlockBaseAddr;
   UINT16  ControlBlockBaseAddr;
+  UINT16  BusMasterBaseAddr;
 } IDE_REGISTERS_BASE_ADDR;
 
+//
+// Index of the device selected by Target on the channel of the current IoPort
+//
+#define ATAPI_DEVICE_INDEX(Private, Target) \
+  ((UINTN) ((Private)->IoPort - (Private)->AtapiIoPortRegisters) * 2 + (Target))
+
 #define ATAPI_SCSI_PASS_THRU_DEV_FROM_THIS(a) \
   CR (a, \
       ATAPI_SCSI_PASS_THRU_DEV, \
@@ -176,7 +240,32 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gAtapiScsiPassThruDriverSuppor
 //
 // ATA Command
 //
-#define ATAPI_SOFT_RESET_CMD  0x08
+#define ATAPI_SOFT_RESET_CMD      0x08
+#define ATAPI_IDENTIFY_DEVICE_CMD 0xA1
+#define ATA_SET_FEATURES_CMD      0xEF
+
+//
+// SET FEATURES subcommand, and transfer modes for its Sector Count register
+//
+#define SET_FEATURES_TRANSFER_MODE  0x03
+#define TRANSFER_MODE_MWDMA         0x20
+#define TRANSFER_MODE_UDMA          0x40
+
+//
+// IDENTIFY PACKET DEVICE data
+//
+#define IDENTIFY_CAPABILITIES_WORD  49
+#define IDENTIFY_DMA_SUPPORTED      BIT8
+#define IDENTIFY_VALIDITY_WORD      53
+#define IDENTIFY_UDMA_WORD_VALID    BIT2
+#define IDENTIFY_MWDMA_WORD         63
+#define IDENTIFY_MWDMA_SUPPORTED    0x07
+#define IDENTIFY_UDMA_WORD          88
+
+//
+// Time, in microseconds, allowed to each command setting up DMA on a device
+//
+#define ATAPI_DMA_SETUP_TIMEOUT     3000000
 
 typedef enum {
   DataIn  = 0,
@@ -1176,6 +1265,51 @@ Returns:
 --*/
 ;
 
+EFI_STATUS
+AtapiPassThruPacketCommand (
+  ATAPI_SCSI_PASS_THRU_DEV    *AtapiScsiPrivate,
+  UINT32                      Target,
+  UINT8                       *PacketCommand,
+  VOID                        *Buffer,
+  UINT32                      *ByteCount,
+  DATA_DIRECTION              Direction,
+  UINT64                      TimeoutInMicroSeconds,
+  BOOLEAN                     *UseDma
+  )
+/*++
+
+Routine Description:
+
+  Submits ATAPI command packet to the specified ATAPI device once, moving
+  the data by bus master DMA if allowed and possible, otherwise by PIO.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device to send the SCSI
+                      Request Packet.
+  PacketCommand:      Points to the ATAPI command packet.
+  Buffer:             Points to the transferred data.
+  ByteCount:          When input,indicates the buffer size; when output,
+                      indicates the actually transferred data size.
+  Direction:          Indicates the data transfer direction.
+  TimeoutInMicroSeconds:
+                      The timeout, in micro second units, to use for the
+                      execution of this ATAPI command.
+  UseDma:             When input, indicates whether the data may be moved
+                      by DMA; when output, indicates whether it was.
+
+Returns:
+
+  EFI_ABORTED         - The DMA transfer failed. The device is ready to
+                        take the command again by PIO.
+  EFI_BAD_BUFFER_SIZE - Less data than ByteCount was transferred. After a
+                        DMA transfer, ByteCount does not tell how much.
+  Others              - As AtapiPassThruPioReadWriteData().
+
+--*/
+;
+
 
 UINT8
 ReadPortB (
@@ -1276,6 +1410,32 @@ Returns:
 --*/
 ;
 
+
+VOID
+WritePortDW (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port,
+  IN  UINT32                Data
+  )
+/*++
+
+Routine Description:
+
+  Write one dword to a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+  Data       - The data to write
+
+Returns:
+
+   NONE
+
+--*/
+;
+
 EFI_STATUS
 StatusDRQClear (
   ATAPI_SCSI_PASS_THRU_DEV        *AtapiScsiPrivate,
@@ -1526,6 +1686,270 @@ Arguments:
 --*/
 ;
 
+EFI_STATUS
+AtapiPassThruDmaPrepare (
+  ATAPI_SCSI_PASS_THRU_DEV    *AtapiScsiPrivate,
+  UINT32                      Target,
+  UINT8                       *PacketCommand,
+  VOID                        *Buffer,
+  UINT32                      ByteCount,
+  DATA_DIRECTION              Direction,
+  VOID                        **Mapping
+  )
+/*++
+
+Routine Description:
+
+  Maps the data buffer, fills the PRD table and loads it into the bus master
+  of the current channel, if the ATAPI command packet can move its data by
+  bus master DMA. Only the read and write commands are done by DMA: they move
+  the bulk of the data, and their transfer size is fixed by the packet.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  PacketCommand:      Points to the ATAPI command packet.
+  Buffer:             Points to the transferred data.
+  ByteCount:          The buffer size.
+  Direction:          Indicates the data transfer direction.
+  Mapping:            Receives the mapping of the data buffer, which
+                      AtapiPassThruDmaStop() releases.
+
+Returns:
+
+  EFI_SUCCESS         - The bus master is ready to be started.
+  EFI_UNSUPPORTED     - The data must be moved by PIO.
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDmaReadWriteData (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  UINT32                    *ByteCount,
+  VOID                      *Mapping,
+  UINT64                    TimeoutInMicroSeconds
+  )
+/*++
+
+Routine Description:
+
+  Performs the bus master DMA transfer set up by AtapiPassThruDmaPrepare()
+  after the ATAPI command packet is sent, and waits for the command to
+  complete.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  ByteCount:          When input,indicates the buffer size; when output,
+                      indicates the actually transferred data size.
+  Mapping:            The mapping of the data buffer.
+  TimeoutInMicroSeconds:
+                      The timeout, in micro second units, to use for the
+                      execution of this ATAPI command.
+                      A TimeoutInMicroSeconds value of 0 means that
+                      this function will wait indefinitely for the ATAPI
+                      command to execute.
+ Returns:
+
+  EFI_SUCCESS         - All the data was transferred.
+  EFI_ABORTED         - The transfer timed out, the bus master failed, or
+                        the device reported an error. A timed out device
+                        has been reset.
+  EFI_BAD_BUFFER_SIZE - The device transferred less data than ByteCount,
+                        and the bus master cannot tell how much.
+
+--*/
+;
+
+VOID
+AtapiPassThruDmaStop (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  VOID                      *Mapping
+  )
+/*++
+
+Routine Description:
+
+  Stops the bus master of the current channel, clears its interrupt and
+  error bits, disables the device interrupt again and unmaps the data buffer.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Mapping:            The mapping of the data buffer.
+
+Returns:
+
+  None
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDmaConfigure (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target
+  )
+/*++
+
+Routine Description:
+
+  Sets the device and the controller of the current channel to a DMA mode
+  both support, if the IDENTIFY PACKET DEVICE data says the device can do
+  DMA. The data of the device is moved by PIO unless this succeeds.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+
+Returns:
+
+  EFI_SUCCESS         - The device uses DMA.
+  EFI_UNSUPPORTED     - The device or the controller cannot do DMA.
+  Others              - Setting up the device failed.
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDmaConfigureByIdeInit (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  EFI_IDENTIFY_DATA         *IdentifyData
+  )
+/*++
+
+Routine Description:
+
+  Lets the IDE Controller Init protocol of the platform pick the fastest
+  DMA mode the controller and the device support, sets the device to it
+  and programs the controller timings for it.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  IdentifyData:       The IDENTIFY PACKET DEVICE data of the device.
+
+Returns:
+
+  EFI_SUCCESS         - The device and the controller are set to DMA.
+  EFI_UNSUPPORTED     - No DMA mode suits both.
+  Others              - Setting up the device or the controller failed.
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDmaConfigureByBmis (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  EFI_IDENTIFY_DATA         *IdentifyData
+  )
+/*++
+
+Routine Description:
+
+  Sets the device to a DMA mode when there is no IDE Controller Init
+  protocol, if the bus master status register says the controller is
+  set up for DMA on the device.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  IdentifyData:       The IDENTIFY PACKET DEVICE data of the device.
+
+Returns:
+
+  EFI_SUCCESS         - The device is set to DMA.
+  EFI_UNSUPPORTED     - The controller is not set up for DMA on the device,
+                        or the device reports no DMA mode.
+  Others              - Setting up the device failed.
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruIdentifyPacketDevice (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  EFI_IDENTIFY_DATA         *IdentifyData
+  )
+/*++
+
+Routine Description:
+
+  Reads the IDENTIFY PACKET DEVICE data of the specified ATAPI device by PIO.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  IdentifyData:       Receives the 512 bytes of identify data.
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruSetTransferMode (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  UINT8                     TransferMode
+  )
+/*++
+
+Routine Description:
+
+  Sets the transfer mode of the specified ATAPI device with SET FEATURES.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+  TransferMode:       The transfer type in bits 7:3 and the mode in bits 2:0.
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDeviceReset (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target
+  )
+/*++
+
+Routine Description:
+
+  Stops the command in progress on the specified ATAPI device with DEVICE
+  RESET. The device keeps its transfer mode.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The Target ID of the ATAPI device on the channel.
+
+Returns:
+
+  EFI_SUCCESS         - The device is ready for the next command.
+  EFI_TIMEOUT         - The device is still busy.
+
+--*/
+;
+
 EFI_STATUS
 AtapiPassThruCheckErrorStatus (
   ATAPI_SCSI_PASS_THRU_DEV        *AtapiScsiPrivate
@@ -1596,6 +2020,49 @@ Returns:
 --*/  
 ;
 
+EFI_STATUS
+AtapiPassThruInitPrdTable (
+  IN  ATAPI_SCSI_PASS_THRU_DEV     *AtapiScsiPrivate
+  )
+/*++
+
+Routine Description:
+
+  Allocate and map the PRD table used for bus master DMA. If that fails, bus
+  master DMA is disabled on both channels, so all transfers are done by PIO.
+
+Arguments:
+
+  AtapiScsiPrivate            - The pointer of ATAPI_SCSI_PASS_THRU_DEV
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+;
+
+VOID
+AtapiPassThruFreePrdTable (
+  IN  ATAPI_SCSI_PASS_THRU_DEV     *AtapiScsiPrivate
+  )
+/*++
+
+Routine Description:
+
+  Unmap and free the PRD table, if there is one.
+
+Arguments:
+
+  AtapiScsiPrivate            - The pointer of ATAPI_SCSI_PASS_THRU_DEV
+
+Returns:
+
+  None
+
+--*/
+;
+
 /**
   Installs Scsi Pass Thru and/or Ext Scsi Pass Thru 
   protocols based on feature flags. 
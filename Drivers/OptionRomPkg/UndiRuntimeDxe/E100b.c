@@ -1059,7 +1059,7 @@ E100bTransmit (
   if ((opflags & PXE_OPFLAGS_TRANSMIT_FRAGMENTED) != 0) {
 
     if (tx_ptr_f->FragCnt > MAX_XMIT_FRAGMENTS) {
-      SetFreeCB (AdapterInfo, tcb_ptr);
+      PutBackFreeCB (AdapterInfo, tcb_ptr);
       AdapterInfo->in_transmit = FALSE;
       return PXE_STATCODE_INVALID_PARAMETER;
     }
@@ -1075,13 +1075,16 @@ E100bTransmit (
               (UINT64)(UINTN) &Tmp_ptr
               );
       if (stat != 0) {
-        SetFreeCB (AdapterInfo, tcb_ptr);
+        tcb_ptr->TBDCount = (UINT8) Index;
+        UnMapTxCB (AdapterInfo, tcb_ptr);
+        PutBackFreeCB (AdapterInfo, tcb_ptr);
         AdapterInfo->in_transmit = FALSE;
         return PXE_STATCODE_INVALID_PARAMETER;
       }
 
       tcb_ptr->TBDArray[Index].phys_buf_addr  = (UINT32) Tmp_ptr;
       tcb_ptr->TBDArray[Index].buf_len        = tx_ptr_f->FragDesc[Index].FragLen;
+      tcb_ptr->TBDVirtualAddr[Index]          = tx_ptr_f->FragDesc[Index].FragAddr;
     }
 
     tcb_ptr->free_data_ptr = tx_ptr_f->FragDesc[0].FragAddr;
@@ -1099,13 +1102,14 @@ E100bTransmit (
             (UINT64)(UINTN) &Tmp_ptr
             );
     if (stat != 0) {
-      SetFreeCB (AdapterInfo, tcb_ptr);
+      PutBackFreeCB (AdapterInfo, tcb_ptr);
       AdapterInfo->in_transmit = FALSE;
       return PXE_STATCODE_INVALID_PARAMETER;
     }
 
     tcb_ptr->TBDArray[0].phys_buf_addr  = (UINT32) (Tmp_ptr);
     tcb_ptr->TBDArray[0].buf_len        = tx_ptr_1->DataLen + tx_ptr_1->MediaheaderLen;
+    tcb_ptr->TBDVirtualAddr[0]          = tx_ptr_1->FrameAddr;
     tcb_ptr->free_data_ptr              = tx_ptr_1->FrameAddr;
   }
 
@@ -1132,38 +1136,25 @@ E100bTransmit (
       }
     }
     //
-    // we need to un-map any mapped buffers here
+    // we need to un-map any mapped buffers here, the buffer is given back
+    // to the caller now rather than through get_status
     //
-    if ((opflags & PXE_OPFLAGS_TRANSMIT_FRAGMENTED) != 0) {
-
-      for (Index = 0; Index < tx_ptr_f->FragCnt; Index++) {
-        Tmp_ptr = tcb_ptr->TBDArray[Index].phys_buf_addr;
-        UnMapIt (
-          AdapterInfo,
-          tx_ptr_f->FragDesc[Index].FragAddr,
-          tx_ptr_f->FragDesc[Index].FragLen,
-          TO_DEVICE,
-          (UINT64) Tmp_ptr
-          );
-      }
-    } else {
-      Tmp_ptr = tcb_ptr->TBDArray[0].phys_buf_addr;
-      UnMapIt (
-        AdapterInfo,
-        tx_ptr_1->FrameAddr,
-        tx_ptr_1->DataLen + tx_ptr_1->MediaheaderLen,
-        TO_DEVICE,
-        (UINT64) Tmp_ptr
-        );
-    }
+    UnMapTxCB (AdapterInfo, tcb_ptr);
+    tcb_ptr->free_data_ptr = 0;
 
     if (tcb_ptr->cb_header.status == 0) {
-      SetFreeCB (AdapterInfo, tcb_ptr);
+      //
+      // the CB stays on the used list until the CU gets to it
+      //
       AdapterInfo->in_transmit = FALSE;
       return PXE_STATCODE_DEVICE_FAILURE;
     }
 
-    SetFreeCB (AdapterInfo, tcb_ptr);
+    //
+    // CBs are freed in the order they were issued, so also reclaim the
+    // transmits that completed before this one
+    //
+    CheckCBList (AdapterInfo);
   }
   //
   // CB will be set free later in get_status (or when we run out of xmit buffers
@@ -1200,6 +1191,7 @@ E100bReceive (
   UINT16          ret_code;
   PXE_FRAME_TYPE  pkt_type;
   UINT16          Tmp_len;
+  UINT16          free_ind;
   EtherHeader     *hdr_ptr;
   ret_code  = PXE_STATCODE_NO_DATA;
   pkt_type  = PXE_FRAME_TYPE_NONE;
@@ -1343,12 +1335,31 @@ FreeRFD:
   if ((status & SCB_RUS_NO_RESOURCES) != 0) {
     //
     // start the receive unit here!
-    // leave all the filled frames,
+    // leave all the filled frames, the RU is restarted at the first RFD
+    // recycled since it ran out of them. If the frames fill the whole
+    // ring, wait for the next call to free one.
     //
-    SetupReceiveQueues (AdapterInfo);
-    OutLong (AdapterInfo, (UINT32) AdapterInfo->rx_phy_addr, AdapterInfo->ioaddr + SCBPointer);
-    OutWord (AdapterInfo, RX_START, AdapterInfo->ioaddr + SCBCmd);
-    AdapterInfo->cur_rx_ind = 0;
+    free_ind = AdapterInfo->cur_rx_ind;
+    for (Index = 0; Index < AdapterInfo->RxBufCnt; Index++) {
+      if ((AdapterInfo->rx_ring[free_ind].cb_header.status & RX_COMPLETE) == 0) {
+        break;
+      }
+
+      free_ind++;
+      if (free_ind == AdapterInfo->RxBufCnt) {
+        free_ind = 0;
+      }
+    }
+
+    if (Index < AdapterInfo->RxBufCnt) {
+      wait_for_cmd_done (AdapterInfo->ioaddr + SCBCmd);
+      OutLong (
+        AdapterInfo,
+        (UINT32) (AdapterInfo->rx_phy_addr + (free_ind * sizeof (RxFD))),
+        AdapterInfo->ioaddr + SCBPointer
+        );
+      OutWord (AdapterInfo, RX_START, AdapterInfo->ioaddr + SCBCmd);
+    }
   }
 
   return ret_code;
@@ -1525,6 +1536,33 @@ GetFreeCB (
 }
 
 
+/**
+  Gives back the CB just taken by GetFreeCB when it was never issued. It
+  goes back to the head of the free list, so the CBs issued before it stay
+  in use until CheckCBList reclaims them.
+
+  @param  AdapterInfo                     Pointer to the NIC data structure
+                                          information which the UNDI driver is
+                                          layering on..
+  @param  cb_ptr                          The CB returned by the last GetFreeCB.
+
+**/
+VOID
+PutBackFreeCB (
+  IN NIC_DATA_INSTANCE *AdapterInfo,
+  IN TxCB              *cb_ptr
+  )
+{
+  cb_ptr->cb_header.status    = 0;
+  cb_ptr->free_data_ptr       = (UINT64) 0;
+
+  BlockIt (AdapterInfo, TRUE);
+  AdapterInfo->FreeTxHeadPtr  = cb_ptr;
+  ++AdapterInfo->FreeCBCount;
+  BlockIt (AdapterInfo, FALSE);
+}
+
+
 /**
   TODO: Add function description
 
@@ -1593,35 +1631,85 @@ CheckCBList (
   TxCB    *Tmp_ptr;
   UINT16  cnt;
 
+  //
+  // The CU completes the CBs in order, so reclaim the completed ones from
+  // the start of the used list up to the first one still pending.
+  //
   cnt = 0;
-  while (1) {
+  while (AdapterInfo->FreeCBCount < AdapterInfo->TxBufCnt) {
     Tmp_ptr = AdapterInfo->FreeTxTailPtr->NextTCBVirtualLinkPtr;
-    if ((Tmp_ptr->cb_header.status & CMD_STATUS_MASK) != 0) {
-      //
-      // check if Q is full
-      //
-      if (next (AdapterInfo->xmit_done_tail) != AdapterInfo->xmit_done_head) {
-        ASSERT (AdapterInfo->xmit_done_tail < TX_BUFFER_COUNT << 1);
-        AdapterInfo->xmit_done[AdapterInfo->xmit_done_tail] = Tmp_ptr->free_data_ptr;
+    if ((Tmp_ptr->cb_header.status & CMD_STATUS_MASK) == 0) {
+      break;
+    }
 
-        UnMapIt (
-          AdapterInfo,
-          Tmp_ptr->free_data_ptr,
-          Tmp_ptr->TBDArray[0].buf_len,
-          TO_DEVICE,
-          (UINT64) Tmp_ptr->TBDArray[0].phys_buf_addr
-          );
+    ReclaimCB (AdapterInfo, Tmp_ptr);
+    cnt++;
+  }
 
-        AdapterInfo->xmit_done_tail = next (AdapterInfo->xmit_done_tail);
-      }
+  return cnt;
+}
 
-      SetFreeCB (AdapterInfo, Tmp_ptr);
-    } else {
-      break;
+
+/**
+  Unmaps the buffers of a transmit CB.
+
+  @param  AdapterInfo                     Pointer to the NIC data structure
+                                          information which the UNDI driver is
+                                          layering on..
+  @param  cb_ptr                          The transmit CB.
+
+**/
+VOID
+UnMapTxCB (
+  IN NIC_DATA_INSTANCE *AdapterInfo,
+  IN TxCB              *cb_ptr
+  )
+{
+  UINT8 Index;
+
+  for (Index = 0; Index < cb_ptr->TBDCount; Index++) {
+    UnMapIt (
+      AdapterInfo,
+      cb_ptr->TBDVirtualAddr[Index],
+      cb_ptr->TBDArray[Index].buf_len,
+      TO_DEVICE,
+      (UINT64) cb_ptr->TBDArray[Index].phys_buf_addr
+      );
+  }
+}
+
+
+/**
+  Returns the CB at the start of the used list to the free list. The
+  buffers of a transmit still owned by the UNDI are unmapped and queued
+  to be reported by get_status.
+
+  @param  AdapterInfo                     Pointer to the NIC data structure
+                                          information which the UNDI driver is
+                                          layering on..
+  @param  cb_ptr                          The CB to reclaim.
+
+**/
+VOID
+ReclaimCB (
+  IN NIC_DATA_INSTANCE *AdapterInfo,
+  IN TxCB              *cb_ptr
+  )
+{
+  if (cb_ptr->free_data_ptr != 0) {
+    UnMapTxCB (AdapterInfo, cb_ptr);
+
+    //
+    // check if Q is full
+    //
+    if (next (AdapterInfo->xmit_done_tail) != AdapterInfo->xmit_done_head) {
+      ASSERT (AdapterInfo->xmit_done_tail < TX_BUFFER_COUNT << 1);
+      AdapterInfo->xmit_done[AdapterInfo->xmit_done_tail] = cb_ptr->free_data_ptr;
+      AdapterInfo->xmit_done_tail = next (AdapterInfo->xmit_done_tail);
     }
   }
 
-  return cnt;
+  SetFreeCB (AdapterInfo, cb_ptr);
 }
 //
 // Description : Initialize the RFD list list by linking each element together
@@ -3295,7 +3383,7 @@ XmitWaitForCompletion (
   TxPtr = AdapterInfo->FreeTxTailPtr->NextTCBVirtualLinkPtr;
   while (TxPtr != AdapterInfo->FreeTxHeadPtr) {
     CommandWaitForCompletion (TxPtr, AdapterInfo);
-    SetFreeCB (AdapterInfo, TxPtr);
+    ReclaimCB (AdapterInfo, TxPtr);
     TxPtr = TxPtr->NextTCBVirtualLinkPtr;
   }
 }
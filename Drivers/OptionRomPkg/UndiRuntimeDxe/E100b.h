@@ -11,7 +11,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 // pci config offsets:
 
-#define RX_BUFFER_COUNT 32
+#define RX_BUFFER_COUNT 64
 #define TX_BUFFER_COUNT 32
 
 #define PCI_VENDOR_ID_INTEL 0x8086
@@ -407,6 +407,7 @@ typedef struct s_TxCB {
   struct s_TxCB *NextTCBVirtualLinkPtr;
   struct s_TxCB *PrevTCBVirtualLinkPtr;
   UINT64 free_data_ptr;  // to be given to the upper layer when this xmit completes1
+  UINT64 TBDVirtualAddr[MAX_XMIT_FRAGMENTS];  // unmapped when this xmit completes
 }TxCB;
 
 /* The Speedo3 Rx and Tx buffer descriptors. */
@@ -121,7 +121,10 @@ UINT16 next(UINT16);
 UINT8 SetupCBlink (NIC_DATA_INSTANCE *AdapterInfo);
 VOID SetFreeCB (NIC_DATA_INSTANCE *AdapterInfo,TxCB *);
 TxCB *GetFreeCB (NIC_DATA_INSTANCE *AdapterInfo);
+VOID PutBackFreeCB (NIC_DATA_INSTANCE *AdapterInfo, TxCB *);
 UINT16 CheckCBList (NIC_DATA_INSTANCE *AdapterInfo);
+VOID UnMapTxCB (NIC_DATA_INSTANCE *AdapterInfo, TxCB *);
+VOID ReclaimCB (NIC_DATA_INSTANCE *AdapterInfo, TxCB *);
 
 UINT8 SelectiveReset (NIC_DATA_INSTANCE *AdapterInfo);
 UINT16 InitializeChip (NIC_DATA_INSTANCE *AdapterInfo);
@@ -379,4 +379,77 @@ BootMonGetFileFromPosition (
   OUT BOOTMON_FS_FILE       **File
   );
 
+/**
+  Find the first run of free blocks large enough for an image.
+
+  @param[in]   Instance    Volume to search.
+  @param[in]   BlockCount  Number of blocks needed.
+  @param[out]  BlockStart  First block of the run.
+
+  @retval  EFI_SUCCESS      A run was found.
+  @retval  EFI_VOLUME_FULL  No run is large enough.
+
+**/
+EFI_STATUS
+BootMonFsFindFreeBlocks (
+  IN  BOOTMON_FS_INSTANCE   *Instance,
+  IN  UINT32                BlockCount,
+  OUT UINT32                *BlockStart
+  );
+
+/**
+  Check whether a range of blocks is free.
+
+  @param[in]  Instance    Volume to check.
+  @param[in]  BlockStart  First block of the range.
+  @param[in]  BlockCount  Number of blocks in the range.
+
+  @retval  TRUE   No image uses any block of the range.
+  @retval  FALSE  At least one block of the range is in use.
+
+**/
+BOOLEAN
+BootMonFsIsRangeFree (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  );
+
+/**
+  Mark a range of free blocks as used by an image.
+
+  @param[in]  Instance    Volume the blocks belong to.
+  @param[in]  BlockStart  First block of the range.
+  @param[in]  BlockCount  Number of blocks in the range.
+
+  @retval  EFI_SUCCESS           The range is now in use.
+  @retval  EFI_VOLUME_FULL       Part of the range was already in use.
+  @retval  EFI_OUT_OF_RESOURCES  The free extent could not be split.
+
+**/
+EFI_STATUS
+BootMonFsReserveBlocks (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  );
+
+/**
+  Return a range of blocks no longer used by an image to the free map.
+
+  @param[in]  Instance    Volume the blocks belong to.
+  @param[in]  BlockStart  First block of the range.
+  @param[in]  BlockCount  Number of blocks in the range.
+
+  @retval  EFI_SUCCESS           The range is free.
+  @retval  EFI_OUT_OF_RESOURCES  No memory to describe the free extent.
+
+**/
+EFI_STATUS
+BootMonFsReleaseBlocks (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  );
+
 #endif
@@ -139,41 +139,15 @@ GetFileSystemVolumeLabelInfo (
   return Status;
 }
 
-// Helper function that calculates a rough "free space" by:
-// - Taking the media size
-// - Subtracting the sum of all file sizes
-// - Subtracting the block size times the number of files
-//    (To account for the blocks containing the HW_IMAGE_INFO
+// Helper function that returns the free space: the blocks in the free map,
+// which do not belong to any image on the media.
 STATIC
 UINT64
 ComputeFreeSpace (
   IN BOOTMON_FS_INSTANCE *Instance
   )
 {
-  LIST_ENTRY   *FileLink;
-  UINT64        FileSizeSum;
-  UINT64        MediaSize;
-  UINTN         NumFiles;
-  EFI_BLOCK_IO_MEDIA *Media;
-  BOOTMON_FS_FILE *File;
-
-  Media = Instance->BlockIo->Media;
-  MediaSize = Media->BlockSize * (Media->LastBlock + 1);
-
-  NumFiles = 0;
-  FileSizeSum = 0;
-  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
-         !IsNull (&Instance->RootFile->Link, FileLink);
-         FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
-         )
-  {
-    File = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
-    FileSizeSum += BootMonFsGetImageLength (File);
-
-    NumFiles++;
-  }
-
-  return MediaSize - (FileSizeSum + (Media->BlockSize + NumFiles));
+  return MultU64x32 (Instance->FreeBlocks, Instance->BlockIo->Media->BlockSize);
 }
 
 STATIC
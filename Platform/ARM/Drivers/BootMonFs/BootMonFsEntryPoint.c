@@ -353,6 +353,7 @@ BootMonFsDriverStart (
   Instance->ControllerHandle = ControllerHandle;
   Instance->Media = Instance->BlockIo->Media;
   Instance->Binding = DriverBinding;
+  InitializeListHead (&Instance->FreeExtents);
 
     // Initialize the Simple File System Protocol
   Instance->Fs.Revision = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION;
@@ -438,6 +439,7 @@ BootMonFsDriverStop (
   LIST_ENTRY          *Link;
   EFI_STATUS           Status;
   BOOLEAN              InstanceFound;
+  BOOTMON_FS_FREE_EXTENT *Extent;
 
   // Find instance from ControllerHandle.
   Instance = NULL;
@@ -476,6 +478,12 @@ BootMonFsDriverStop (
       &gEfiSimpleFileSystemProtocolGuid, &Instance->Fs,
       NULL);
 
+  while (!IsListEmpty (&Instance->FreeExtents)) {
+    Extent = (BOOTMON_FS_FREE_EXTENT*)GetFirstNode (&Instance->FreeExtents);
+    RemoveEntryList (&Extent->Link);
+    FreePool (Extent);
+  }
+
   FreePool (Instance->RootFile->Info);
   FreePool (Instance->RootFile);
   FreePool (Instance);
@@ -10,6 +10,7 @@
 #include <Library/NorFlashPlatformLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PerformanceLib.h>
 
 #include <Protocol/SimpleFileSystem.h>
 
@@ -129,11 +130,14 @@ BootMonFsIsImageValid (
   return TRUE;
 }
 
+// Look for the last image that ends below *LbaEnd, scanning down. An image
+// description is at the end of the image's last block, so once one is found
+// the blocks of the image can be skipped: they only hold its data.
 STATIC
 EFI_STATUS
-BootMonFsDiscoverNextImage (
+BootMonFsDiscoverPreviousImage (
   IN     BOOTMON_FS_INSTANCE      *Instance,
-  IN OUT EFI_LBA                  *LbaStart,
+  IN OUT EFI_LBA                  *LbaEnd,
   IN OUT BOOTMON_FS_FILE          *File
   )
 {
@@ -144,10 +148,11 @@ BootMonFsDiscoverNextImage (
 
   DiskIo = Instance->DiskIo;
 
-  CurrentLba = *LbaStart;
+  CurrentLba = *LbaEnd;
+
+  while (CurrentLba > 0) {
+    CurrentLba--;
 
-  // Look for images in the rest of this block
-  while (CurrentLba <= Instance->Media->LastBlock) {
     // Work out the byte offset into media of the image description in this block
     // If present, the image description is at the very end of the block.
     DescOffset = ((CurrentLba + 1) * Instance->Media->BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
@@ -171,17 +176,220 @@ BootMonFsDiscoverNextImage (
         ));
       File->HwDescAddress = DescOffset;
 
-      *LbaStart = CurrentLba + 1;
+      *LbaEnd = Instance->Media->LowestAlignedLba + File->HwDescription.BlockStart;
       return EFI_SUCCESS;
-    } else {
-      CurrentLba++;
     }
   }
 
-  *LbaStart = CurrentLba;
+  *LbaEnd = CurrentLba;
   return EFI_NOT_FOUND;
 }
 
+STATIC
+BOOTMON_FS_FREE_EXTENT *
+BootMonFsFindFreeExtent (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  )
+{
+  LIST_ENTRY              *Link;
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+
+  for (Link = GetFirstNode (&Instance->FreeExtents);
+       !IsNull (&Instance->FreeExtents, Link);
+       Link = GetNextNode (&Instance->FreeExtents, Link)
+       )
+  {
+    Extent = (BOOTMON_FS_FREE_EXTENT*)Link;
+    if (Extent->BlockStart > BlockStart) {
+      break;
+    }
+    if ((UINT64)BlockStart + BlockCount <= (UINT64)Extent->BlockStart + Extent->BlockCount) {
+      return Extent;
+    }
+  }
+
+  return NULL;
+}
+
+EFI_STATUS
+BootMonFsFindFreeBlocks (
+  IN  BOOTMON_FS_INSTANCE   *Instance,
+  IN  UINT32                BlockCount,
+  OUT UINT32                *BlockStart
+  )
+{
+  LIST_ENTRY              *Link;
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+
+  for (Link = GetFirstNode (&Instance->FreeExtents);
+       !IsNull (&Instance->FreeExtents, Link);
+       Link = GetNextNode (&Instance->FreeExtents, Link)
+       )
+  {
+    Extent = (BOOTMON_FS_FREE_EXTENT*)Link;
+    if (Extent->BlockCount >= BlockCount) {
+      *BlockStart = Extent->BlockStart;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_VOLUME_FULL;
+}
+
+BOOLEAN
+BootMonFsIsRangeFree (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  )
+{
+  return BootMonFsFindFreeExtent (Instance, BlockStart, BlockCount) != NULL;
+}
+
+EFI_STATUS
+BootMonFsReserveBlocks (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  )
+{
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+  BOOTMON_FS_FREE_EXTENT  *Tail;
+  UINT32                   End;
+
+  Extent = BootMonFsFindFreeExtent (Instance, BlockStart, BlockCount);
+  if (Extent == NULL) {
+    return EFI_VOLUME_FULL;
+  }
+
+  End = Extent->BlockStart + Extent->BlockCount;
+  if (BlockStart + BlockCount < End) {
+    if (BlockStart == Extent->BlockStart) {
+      Extent->BlockStart += BlockCount;
+      Extent->BlockCount -= BlockCount;
+    } else {
+      // The range is in the middle of the extent: split it
+      Tail = AllocatePool (sizeof (BOOTMON_FS_FREE_EXTENT));
+      if (Tail == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      Tail->BlockStart = BlockStart + BlockCount;
+      Tail->BlockCount = End - Tail->BlockStart;
+      InsertHeadList (&Extent->Link, &Tail->Link);
+      Extent->BlockCount = BlockStart - Extent->BlockStart;
+    }
+  } else if (BlockStart == Extent->BlockStart) {
+    RemoveEntryList (&Extent->Link);
+    FreePool (Extent);
+  } else {
+    Extent->BlockCount -= BlockCount;
+  }
+
+  Instance->FreeBlocks -= BlockCount;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+BootMonFsReleaseBlocks (
+  IN BOOTMON_FS_INSTANCE    *Instance,
+  IN UINT32                 BlockStart,
+  IN UINT32                 BlockCount
+  )
+{
+  LIST_ENTRY              *Link;
+  BOOTMON_FS_FREE_EXTENT  *Previous;
+  BOOTMON_FS_FREE_EXTENT  *Next;
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+
+  // Find the first extent after the range
+  for (Link = GetFirstNode (&Instance->FreeExtents);
+       !IsNull (&Instance->FreeExtents, Link);
+       Link = GetNextNode (&Instance->FreeExtents, Link)
+       )
+  {
+    if (((BOOTMON_FS_FREE_EXTENT*)Link)->BlockStart > BlockStart) {
+      break;
+    }
+  }
+
+  Next = IsNull (&Instance->FreeExtents, Link) ? NULL : (BOOTMON_FS_FREE_EXTENT*)Link;
+  Previous = NULL;
+  if (GetPreviousNode (&Instance->FreeExtents, Link) != &Instance->FreeExtents) {
+    Previous = (BOOTMON_FS_FREE_EXTENT*)GetPreviousNode (&Instance->FreeExtents, Link);
+  }
+
+  ASSERT ((Previous == NULL) || (Previous->BlockStart + Previous->BlockCount <= BlockStart));
+  ASSERT ((Next == NULL) || (BlockStart + BlockCount <= Next->BlockStart));
+
+  // Merge with the free neighbours rather than fragmenting the map
+  if ((Previous != NULL) && (Previous->BlockStart + Previous->BlockCount == BlockStart)) {
+    Previous->BlockCount += BlockCount;
+    if ((Next != NULL) && (Previous->BlockStart + Previous->BlockCount == Next->BlockStart)) {
+      Previous->BlockCount += Next->BlockCount;
+      RemoveEntryList (&Next->Link);
+      FreePool (Next);
+    }
+  } else if ((Next != NULL) && (BlockStart + BlockCount == Next->BlockStart)) {
+    Next->BlockStart = BlockStart;
+    Next->BlockCount += BlockCount;
+  } else {
+    Extent = AllocatePool (sizeof (BOOTMON_FS_FREE_EXTENT));
+    if (Extent == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Extent->BlockStart = BlockStart;
+    Extent->BlockCount = BlockCount;
+    // Insert before the next extent, or at the end of the map
+    InsertTailList (Link, &Extent->Link);
+  }
+
+  Instance->FreeBlocks += BlockCount;
+  return EFI_SUCCESS;
+}
+
+// Build the free map from the gaps between the images, which are in
+// disk order.
+STATIC
+EFI_STATUS
+BootMonFsBuildFreeMap (
+  IN BOOTMON_FS_INSTANCE *Instance
+  )
+{
+  EFI_STATUS               Status;
+  LIST_ENTRY              *FileLink;
+  BOOTMON_FS_FILE         *File;
+  UINT32                   NextFree;
+  UINT32                   BlockCount;
+
+  InitializeListHead (&Instance->FreeExtents);
+  Instance->FreeBlocks = 0;
+  BlockCount = (UINT32)(Instance->Media->LastBlock + 1);
+
+  NextFree = 0;
+  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
+       !IsNull (&Instance->RootFile->Link, FileLink);
+       FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
+       )
+  {
+    File = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    if (File->HwDescription.BlockStart > NextFree) {
+      Status = BootMonFsReleaseBlocks (Instance, NextFree, File->HwDescription.BlockStart - NextFree);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+    NextFree = MAX (NextFree, File->HwDescription.BlockEnd + 1);
+  }
+
+  if (NextFree < BlockCount) {
+    return BootMonFsReleaseBlocks (Instance, NextFree, BlockCount - NextFree);
+  }
+
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 BootMonFsInitialize (
   IN BOOTMON_FS_INSTANCE *Instance
@@ -192,8 +400,10 @@ BootMonFsInitialize (
   UINT32                   ImageCount;
   BOOTMON_FS_FILE          *NewFile;
 
+  PERF_START (Instance->ControllerHandle, "BootMonFsMount", NULL, 0);
+
   ImageCount = 0;
-  Lba = 0;
+  Lba = Instance->Media->LastBlock + 1;
 
   while (1) {
     Status = BootMonFsCreateFile (Instance, &NewFile);
@@ -201,16 +411,26 @@ BootMonFsInitialize (
       return Status;
     }
 
-    Status = BootMonFsDiscoverNextImage (Instance, &Lba, NewFile);
+    Status = BootMonFsDiscoverPreviousImage (Instance, &Lba, NewFile);
     if (EFI_ERROR (Status)) {
       // Free NewFile allocated by BootMonFsCreateFile ()
       FreePool (NewFile);
       break;
     }
-    InsertTailList (&Instance->RootFile->Link, &NewFile->Link);
+    // Images are found from the end of the media, keep the list in disk order
+    InsertHeadList (&Instance->RootFile->Link, &NewFile->Link);
     ImageCount++;
   }
 
+  Status = BootMonFsBuildFreeMap (Instance);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  PERF_END (Instance->ControllerHandle, "BootMonFsMount", NULL, 0);
+
+  DEBUG ((DEBUG_INFO, "BootMonFs: %d images, %ld free blocks\n", ImageCount, Instance->FreeBlocks));
+
   Instance->Initialized = TRUE;
   return EFI_SUCCESS;
 }
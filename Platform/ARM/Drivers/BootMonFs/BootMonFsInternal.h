@@ -38,6 +38,17 @@ typedef struct {
   UINT64                Offset; // Offset from the start of the file
 } BOOTMON_FS_FILE_REGION;
 
+// A run of blocks not used by any image
+typedef struct {
+  LIST_ENTRY            Link;
+  UINT32                BlockStart;
+  UINT32                BlockCount;
+} BOOTMON_FS_FREE_EXTENT;
+
+// Number of blocks used by an image of FileSize bytes, description included
+#define BOOTMON_FS_BLOCK_COUNT(FileSize, BlockSize) \
+  ((UINT32)((FileSize) / (BlockSize)) + 1)
+
 typedef struct {
   UINT32                Signature;
   LIST_ENTRY            Link;
@@ -83,6 +94,12 @@ struct _BOOTMON_FS_INSTANCE {
 
   BOOTMON_FS_FILE                     *RootFile; // All the other files are linked to this root
   BOOLEAN                              Initialized;
+
+  // Blocks not used by any image, in disk order. Built when the volume is
+  // initialized and kept up to date as image descriptions are written or
+  // invalidated, so that finding space never walks the media.
+  LIST_ENTRY                           FreeExtents;
+  UINT64                               FreeBlocks;
 };
 
 #define BOOTMON_FS_SIGNATURE            SIGNATURE_32('b', 'o', 't', 'm')
@@ -16,8 +16,9 @@
 // and wrongly detected by BootMonFsImageInBlock.
 STATIC
 EFI_STATUS
-InvalidateImageDescription (
-  IN  BOOTMON_FS_FILE  *File
+InvalidateImageDescriptionAt (
+  IN  BOOTMON_FS_INSTANCE  *Instance,
+  IN  UINT64                DescAddress
   )
 {
   EFI_DISK_IO_PROTOCOL   *DiskIo;
@@ -26,8 +27,8 @@ InvalidateImageDescription (
   VOID                   *Buffer;
   EFI_STATUS              Status;
 
-  DiskIo = File->Instance->DiskIo;
-  BlockIo = File->Instance->BlockIo;
+  DiskIo = Instance->DiskIo;
+  BlockIo = Instance->BlockIo;
   MediaId = BlockIo->Media->MediaId;
 
   Buffer = AllocateZeroPool (sizeof (HW_IMAGE_DESCRIPTION));
@@ -38,7 +39,7 @@ InvalidateImageDescription (
 
   Status = DiskIo->WriteDisk (DiskIo,
                     MediaId,
-                    File->HwDescAddress,
+                    DescAddress,
                     sizeof (HW_IMAGE_DESCRIPTION),
                     Buffer
                     );
@@ -48,6 +49,15 @@ InvalidateImageDescription (
   return Status;
 }
 
+STATIC
+EFI_STATUS
+InvalidateImageDescription (
+  IN  BOOTMON_FS_FILE  *File
+  )
+{
+  return InvalidateImageDescriptionAt (File->Instance, File->HwDescAddress);
+}
+
 /**
   Write the description of a file to storage media.
 
@@ -81,20 +91,49 @@ WriteFileDescription (
   UINTN                 BlockSize;
   UINT32                FileSize;
   HW_IMAGE_DESCRIPTION  *Description;
+  UINT32                BlockStart;
+  UINT32                BlockCount;
+  UINT64                OldDescAddress;
+  EFI_STATUS            ReserveStatus;
 
   DiskIo    = File->Instance->DiskIo;
   BlockSize = File->Instance->BlockIo->Media->BlockSize;
   ASSERT (FileStart % BlockSize == 0);
 
+  FileSize = DataSize + sizeof (HW_IMAGE_DESCRIPTION);
+  Description = &File->HwDescription;
+  BlockStart = (UINT32)(FileStart / BlockSize);
+  BlockCount = BOOTMON_FS_BLOCK_COUNT (FileSize, BlockSize);
+
+  //
+  // Move the file's blocks in the free map from its old extent to its new
+  // one, putting the old extent back if the new one is not free.
+  //
+  if (Description->RegionCount > 0) {
+    Status = BootMonFsReleaseBlocks (File->Instance, Description->BlockStart,
+               Description->BlockEnd - Description->BlockStart + 1);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  ReserveStatus = BootMonFsReserveBlocks (File->Instance, BlockStart, BlockCount);
+  if (EFI_ERROR (ReserveStatus)) {
+    if (Description->RegionCount > 0) {
+      Status = BootMonFsReserveBlocks (File->Instance, Description->BlockStart,
+                 Description->BlockEnd - Description->BlockStart + 1);
+      ASSERT_EFI_ERROR (Status);
+    }
+    return ReserveStatus;
+  }
+
   //
   // Construct the file description
   //
 
-  FileSize = DataSize + sizeof (HW_IMAGE_DESCRIPTION);
-  Description = &File->HwDescription;
   Description->Attributes = 1;
-  Description->BlockStart = FileStart / BlockSize;
-  Description->BlockEnd   = Description->BlockStart + (FileSize / BlockSize);
+  Description->BlockStart = BlockStart;
+  Description->BlockEnd   = BlockStart + BlockCount - 1;
   AsciiStrCpyS (Description->Footer.Filename,
     sizeof Description->Footer.Filename, FileName);
 
@@ -117,6 +156,7 @@ WriteFileDescription (
     return Status;
   }
 
+  OldDescAddress = File->HwDescAddress;
   File->HwDescAddress = ((Description->BlockEnd + 1) * BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
 
   // Update the file description on the media
@@ -129,21 +169,23 @@ WriteFileDescription (
                     );
   ASSERT_EFI_ERROR (Status);
 
+  // If the file shrank, its old description is now in free space where
+  // the next mount would find it again
+  if (!EFI_ERROR (Status) && (OldDescAddress > File->HwDescAddress)) {
+    Status = InvalidateImageDescriptionAt (File->Instance, OldDescAddress);
+  }
+
   return Status;
 }
 
 // Find a space on media for a file that has not yet been flushed to disk.
-// Just returns the first space that's big enough.
-// This function could easily be adapted to:
-// - Find space for moving an existing file that has outgrown its space
-//   (We do not currently move files, just return EFI_VOLUME_FULL)
-// - Find space for a fragment of a file that has outgrown its space
-//   (We do not currently fragment files - it's not clear whether fragmentation
-//    is actually part of BootMonFs as there is no spec)
-// - Be more clever about finding space (choosing the largest or smallest
-//   suitable space)
+// Just returns the first space in the free map that's big enough; the space
+// is only taken from the map once the file's description is written.
+// We do not currently move or fragment files that outgrow their space, see
+// BootMonFsFlushFile.
 // Parameters:
 // File - the new (not yet flushed) file for which we need to find space.
+// FileSize - the size of the file on media, description included.
 // FileStart - the position on media of the file (in bytes).
 STATIC
 EFI_STATUS
@@ -153,55 +195,47 @@ BootMonFsFindSpaceForNewFile (
   OUT UINT64              *FileStart
   )
 {
+  EFI_STATUS               Status;
   LIST_ENTRY              *FileLink;
   BOOTMON_FS_FILE         *RootFile;
   BOOTMON_FS_FILE         *FileEntry;
   UINTN                    BlockSize;
-  EFI_BLOCK_IO_MEDIA      *Media;
+  UINT32                   BlockStart;
 
-  Media = File->Instance->BlockIo->Media;
-  BlockSize = Media->BlockSize;
+  BlockSize = File->Instance->BlockIo->Media->BlockSize;
   RootFile = File->Instance->RootFile;
 
   // This function must only be called for file which has not been flushed into
   // Flash yet
   ASSERT (File->HwDescription.RegionCount == 0);
 
-  *FileStart = 0;
-  // Go through all the files in the list
+  Status = BootMonFsFindFreeBlocks (
+             File->Instance,
+             BOOTMON_FS_BLOCK_COUNT (FileSize, BlockSize),
+             &BlockStart
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  *FileStart = (UINT64)BlockStart * BlockSize;
+
+  // The file list must be in disk-order: insert the file before the first
+  // file on disk that follows it
+  RemoveEntryList (&File->Link);
   for (FileLink = GetFirstNode (&RootFile->Link);
          !IsNull (&RootFile->Link, FileLink);
          FileLink = GetNextNode (&RootFile->Link, FileLink)
          )
   {
     FileEntry = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
-    // Skip files that aren't on disk yet
-    if (FileEntry->HwDescription.RegionCount == 0) {
-      continue;
-    }
-
-    // If the free space preceding the file is big enough to contain the new
-    // file then use it!
-    if (((FileEntry->HwDescription.BlockStart * BlockSize) - *FileStart)
-        >= FileSize) {
-      // The file list must be in disk-order
-      RemoveEntryList (&File->Link);
-      File->Link.BackLink = FileLink->BackLink;
-      File->Link.ForwardLink = FileLink;
-      FileLink->BackLink->ForwardLink = &File->Link;
-      FileLink->BackLink = &File->Link;
-
-      return EFI_SUCCESS;
-    } else {
-      *FileStart = (FileEntry->HwDescription.BlockEnd + 1) * BlockSize;
+    if ((FileEntry->HwDescription.RegionCount != 0) &&
+        (FileEntry->HwDescription.BlockStart > BlockStart)) {
+      break;
     }
   }
-  // See if there's space after the last file
-  if ((((Media->LastBlock + 1) * BlockSize) - *FileStart) >= FileSize) {
-    return EFI_SUCCESS;
-  } else {
-    return EFI_VOLUME_FULL;
-  }
+  InsertTailList (FileLink, &File->Link);
+
+  return EFI_SUCCESS;
 }
 
 // Free the resources in the file's Region list.
@@ -256,17 +290,15 @@ BootMonFsFlushFile (
   CHAR8                    AsciiFileName[MAX_NAME_LENGTH];
   LIST_ENTRY              *RegionToFlushLink;
   BOOTMON_FS_FILE         *File;
-  BOOTMON_FS_FILE         *NextFile;
   BOOTMON_FS_FILE_REGION  *Region;
-  LIST_ENTRY              *FileLink;
-  UINTN                    CurrentPhysicalSize;
+  UINT32                   CurrentBlockCount;
+  UINT32                   NewBlockCount;
   UINT64                   FileStart;
   UINT64                   FileEnd;
   UINT64                   RegionStart;
   UINT64                   RegionEnd;
   UINT64                   NewDataSize;
   UINT64                   NewFileSize;
-  UINT64                   EndOfAppendSpace;
   BOOLEAN                  HasSpace;
 
   if (This == NULL) {
@@ -344,28 +376,19 @@ BootMonFsFlushFile (
       //  the file"), we just leave garbage in the gap.
 
       // Check if there is space to append the new region
-      HasSpace = FALSE;
       NewDataSize = RegionEnd - FileStart;
       NewFileSize = NewDataSize + sizeof (HW_IMAGE_DESCRIPTION);
-      CurrentPhysicalSize = BootMonFsGetPhysicalSize (File);
-      if (NewFileSize <= CurrentPhysicalSize) {
+      NewBlockCount = BOOTMON_FS_BLOCK_COUNT (NewFileSize, BlockSize);
+      CurrentBlockCount = (UINT32)(BootMonFsGetPhysicalSize (File) / BlockSize);
+      if (NewBlockCount <= CurrentBlockCount) {
         HasSpace = TRUE;
       } else {
-        // Get the File Description for the next file
-        FileLink = GetNextNode (&Instance->RootFile->Link, &File->Link);
-        if (!IsNull (&Instance->RootFile->Link, FileLink)) {
-          NextFile = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
-
-          // If there is space between the beginning of the current file and the
-          // beginning of the next file then use it
-          EndOfAppendSpace = NextFile->HwDescription.BlockStart * BlockSize;
-        } else {
-          // We are flushing the last file.
-          EndOfAppendSpace = (Media->LastBlock + 1) * BlockSize;
-        }
-        if (EndOfAppendSpace - FileStart >= NewFileSize) {
-          HasSpace = TRUE;
-        }
+        // The file can grow if the blocks following it are free
+        HasSpace = BootMonFsIsRangeFree (
+                     Instance,
+                     (UINT32)(FileStart / BlockSize) + CurrentBlockCount,
+                     NewBlockCount - CurrentBlockCount
+                     );
       }
 
       if (HasSpace == TRUE) {
@@ -778,6 +801,12 @@ BootMonFsDelete (
     if (EFI_ERROR (Status)) {
       return  EFI_WARN_DELETE_FAILURE;
     }
+
+    BootMonFsReleaseBlocks (
+      File->Instance,
+      File->HwDescription.BlockStart,
+      File->HwDescription.BlockEnd - File->HwDescription.BlockStart + 1
+      );
   }
 
   // Remove the entry from the list
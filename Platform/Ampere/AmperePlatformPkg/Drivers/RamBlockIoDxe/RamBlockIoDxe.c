@@ -8,12 +8,17 @@
 
 #include <Uefi/UefiBaseType.h>
 
+#include <Guid/EventGroup.h>
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/DiskIo.h>
 
@@ -21,15 +26,30 @@ typedef struct _RAMDISK_BLOCKIO_INSTANCE RAMDISK_BLOCKIO_INSTANCE;
 
 const EFI_GUID gRamBlockIoGuid = { 0xc84d8a80, 0xcc28, 0x4cea, { 0x9b, 0xc5, 0x1f, 0x9a, 0xb5, 0x00, 0xa0, 0x77 } };
 
-/* Start address of the Ram Block Io */
+/* Start address of the image the Ram Block Io is seeded from */
 #define RAM_BLOCKIO_START_ADDRESS   0x80000000000
 
-/* Size of the Ram Block Io */
+/* Size of the image the Ram Block Io is seeded from */
 #define RAM_BLOCKIO_SIZE            0x32000000
 
+/*
+ * Size of the Ram Block Io, RAM_BLOCKIO_SIZE unless PcdRamBlockIoDiskSize
+ * asks for more. Anything past the seed image reads as zeroes until it is
+ * written, and only the chunks written there take memory.
+ */
+#define RAM_BLOCKIO_DISK_SIZE \
+  MAX (RAM_BLOCKIO_SIZE, FixedPcdGet64 (PcdRamBlockIoDiskSize))
+
 /* The size of a block. */
 #define RAM_BLOCKIO_BLOCKSIZE       0x200
 
+/*
+ * Granularity at which memory is committed on write. The seed image
+ * is never written: the first write to a chunk copies it.
+ */
+#define RAM_BLOCKIO_CHUNK_SIZE      SIZE_64KB
+#define RAM_BLOCKIO_CHUNK_SHIFT     16
+
 
 typedef struct {
   VENDOR_DEVICE_PATH       Vendor;
@@ -38,16 +58,32 @@ typedef struct {
 
 #define RAMDISK_BLOCKIO_SIGNATURE     SIGNATURE_32('r', 'b', 'i', 'o')
 #define INSTANCE_FROM_BLKIO_THIS(a)   CR(a, RAMDISK_BLOCKIO_INSTANCE, BlockIoProtocol, RAMDISK_BLOCKIO_SIGNATURE)
+#define INSTANCE_FROM_BLKIO2_THIS(a)  CR(a, RAMDISK_BLOCKIO_INSTANCE, BlockIo2Protocol, RAMDISK_BLOCKIO_SIGNATURE)
 
 struct _RAMDISK_BLOCKIO_INSTANCE {
   UINT32                      Signature;
   EFI_HANDLE                  Handle;
   UINTN                       StartAddress;
-  UINTN                       Size;
+  UINT64                      StartSize;
+  UINT64                      Size;
   EFI_LBA                     StartLba;
   EFI_BLOCK_IO_PROTOCOL       BlockIoProtocol;
+  EFI_BLOCK_IO2_PROTOCOL      BlockIo2Protocol;
   EFI_BLOCK_IO_MEDIA          Media;
   RAMDISK_BLOCKIO_DEVICE_PATH DevicePath;
+
+  //
+  // Committed chunks, NULL until first written.
+  //
+  UINT8                       **Chunks;
+  UINTN                       ChunkCount;
+  UINTN                       CommittedChunks;
+
+  UINT64                      BytesRead;
+  UINT64                      BytesWritten;
+  UINT64                      ReadTicks;
+  UINT64                      WriteTicks;
+  EFI_EVENT                   ExitBootServicesEvent;
 };
 
 //
@@ -95,11 +131,60 @@ RamBlockIoFlushBlocks (
   IN EFI_BLOCK_IO_PROTOCOL *This
   );
 
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.Reset
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL *This,
+  IN BOOLEAN                ExtendedVerification
+  );
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSizeInBytes,
+  OUT    VOID                   *Buffer
+  );
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSizeInBytes,
+  IN     VOID                   *Buffer
+  );
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  );
+
 RAMDISK_BLOCKIO_INSTANCE mRamBlockIoInstanceTemplate = {
   RAMDISK_BLOCKIO_SIGNATURE, // Signature
   NULL,                      // Handle ... NEED TO BE FILLED
 
   0, // StartAddress ... NEED TO BE FILLED
+  0, // StartSize ... NEED TO BE FILLED
   0, // Size ... NEED TO BE FILLED
   0, // StartLba
 
@@ -112,6 +197,14 @@ RAMDISK_BLOCKIO_INSTANCE mRamBlockIoInstanceTemplate = {
     RamBlockIoFlushBlocks            // FlushBlocks
   },                                 // BlockIoProtocol
 
+  {
+    NULL,                            // Media ... NEED TO BE FILLED
+    RamBlockIoResetEx,               // Reset
+    RamBlockIoReadBlocksEx,          // ReadBlocksEx
+    RamBlockIoWriteBlocksEx,         // WriteBlocksEx
+    RamBlockIoFlushBlocksEx          // FlushBlocksEx
+  },                                 // BlockIo2Protocol
+
   {
     0,     // MediaId ... NEED TO BE FILLED
     FALSE, // RemovableMedia
@@ -143,6 +236,136 @@ RAMDISK_BLOCKIO_INSTANCE mRamBlockIoInstanceTemplate = {
   } // DevicePath
 };
 
+STATIC
+UINT64
+RamBlockIoElapsed (
+  IN UINT64 StartTicks
+  )
+{
+  UINT64 EndTicks;
+
+  EndTicks = GetPerformanceCounter ();
+  return (EndTicks > StartTicks) ? EndTicks - StartTicks : StartTicks - EndTicks;
+}
+
+/**
+  Read from the disk, one chunk at a time. Chunks that have not been
+  written come from the seed image, or read as zeroes past its end.
+**/
+STATIC
+VOID
+RamBlockIoReadChunks (
+  IN  RAMDISK_BLOCKIO_INSTANCE *Instance,
+  IN  UINT64                   Offset,
+  IN  UINTN                    Length,
+  OUT UINT8                    *Buffer
+  )
+{
+  UINTN  Chunk;
+  UINTN  ChunkOffset;
+  UINTN  Count;
+  UINTN  Seeded;
+
+  while (Length > 0) {
+    Chunk = (UINTN)RShiftU64 (Offset, RAM_BLOCKIO_CHUNK_SHIFT);
+    ChunkOffset = (UINTN)(Offset & (RAM_BLOCKIO_CHUNK_SIZE - 1));
+    Count = MIN (Length, RAM_BLOCKIO_CHUNK_SIZE - ChunkOffset);
+
+    if (Instance->Chunks[Chunk] != NULL) {
+      CopyMem (Buffer, Instance->Chunks[Chunk] + ChunkOffset, Count);
+    } else {
+      Seeded = 0;
+      if (Offset < Instance->StartSize) {
+        Seeded = (UINTN)MIN (Count, Instance->StartSize - Offset);
+        CopyMem (Buffer, (VOID *)(Instance->StartAddress + (UINTN)Offset), Seeded);
+      }
+
+      ZeroMem (Buffer + Seeded, Count - Seeded);
+    }
+
+    Offset += Count;
+    Buffer += Count;
+    Length -= Count;
+  }
+}
+
+/**
+  Allocate the memory backing a chunk. Unless the write about to
+  happen covers the whole chunk, fill it from the seed image first.
+**/
+STATIC
+EFI_STATUS
+RamBlockIoCommitChunk (
+  IN RAMDISK_BLOCKIO_INSTANCE *Instance,
+  IN UINTN                    Chunk,
+  IN BOOLEAN                  WholeChunk
+  )
+{
+  UINT8  *Memory;
+
+  Memory = AllocatePages (EFI_SIZE_TO_PAGES (RAM_BLOCKIO_CHUNK_SIZE));
+  if (Memory == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (!WholeChunk) {
+    RamBlockIoReadChunks (
+      Instance,
+      LShiftU64 (Chunk, RAM_BLOCKIO_CHUNK_SHIFT),
+      RAM_BLOCKIO_CHUNK_SIZE,
+      Memory
+      );
+  }
+
+  Instance->Chunks[Chunk] = Memory;
+  Instance->CommittedChunks++;
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+RamBlockIoWriteChunks (
+  IN RAMDISK_BLOCKIO_INSTANCE *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    Length,
+  IN UINT8                    *Buffer
+  )
+{
+  EFI_STATUS Status;
+  UINTN      Chunk;
+  UINTN      ChunkOffset;
+  UINTN      Count;
+
+  while (Length > 0) {
+    Chunk = (UINTN)RShiftU64 (Offset, RAM_BLOCKIO_CHUNK_SHIFT);
+    ChunkOffset = (UINTN)(Offset & (RAM_BLOCKIO_CHUNK_SIZE - 1));
+    Count = MIN (Length, RAM_BLOCKIO_CHUNK_SIZE - ChunkOffset);
+
+    if (Instance->Chunks[Chunk] == NULL) {
+      Status = RamBlockIoCommitChunk (Instance, Chunk, Count == RAM_BLOCKIO_CHUNK_SIZE);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a: Fail to commit chunk %Lu, %Lu chunks in use\n",
+          __FUNCTION__,
+          (UINT64)Chunk,
+          (UINT64)Instance->CommittedChunks
+          ));
+        return EFI_DEVICE_ERROR;
+      }
+    }
+
+    CopyMem (Instance->Chunks[Chunk] + ChunkOffset, Buffer, Count);
+
+    Offset += Count;
+    Buffer += Count;
+    Length -= Count;
+  }
+
+  return EFI_SUCCESS;
+}
+
 //
 // BlockIO Protocol function EFI_BLOCK_IO_PROTOCOL.Reset
 //
@@ -172,7 +395,8 @@ RamBlockIoReadBlocks (
   RAMDISK_BLOCKIO_INSTANCE *Instance;
   EFI_STATUS               Status;
   EFI_BLOCK_IO_MEDIA       *Media;
-  UINT32                   NumBlocks;
+  UINT64                   NumBlocks;
+  UINT64                   StartTicks;
 
   DEBUG ((
     DEBUG_BLKIO,
@@ -207,7 +431,7 @@ RamBlockIoReadBlocks (
   }
 
   // All blocks must be within the device
-  NumBlocks = ((UINT32)BufferSizeInBytes) / Instance->Media.BlockSize;
+  NumBlocks = BufferSizeInBytes / Instance->Media.BlockSize;
 
   if ((Lba + NumBlocks) > (Instance->Media.LastBlock + 1)) {
     DEBUG ((DEBUG_ERROR, "%a: Read will exceed last block\n", __FUNCTION__));
@@ -225,13 +449,15 @@ RamBlockIoReadBlocks (
   } else if ((Media->IoAlign > 2) && (((UINTN)Buffer & (Media->IoAlign - 1)) != 0)) {
     Status = EFI_INVALID_PARAMETER;
   } else {
-    DEBUG ((
-      DEBUG_ERROR,
-      "%a: Read from address %p\n",
-      __FUNCTION__,
-      (VOID *)(Instance->StartAddress + Lba * Instance->Media.BlockSize)
-      ));
-    CopyMem (Buffer, (VOID *)(Instance->StartAddress + Lba * Instance->Media.BlockSize), BufferSizeInBytes);
+    StartTicks = GetPerformanceCounter ();
+    RamBlockIoReadChunks (
+      Instance,
+      MultU64x32 (Lba, Instance->Media.BlockSize),
+      BufferSizeInBytes,
+      Buffer
+      );
+    Instance->ReadTicks += RamBlockIoElapsed (StartTicks);
+    Instance->BytesRead += BufferSizeInBytes;
     Status = EFI_SUCCESS;
   }
 
@@ -252,7 +478,8 @@ RamBlockIoWriteBlocks (
   )
 {
   RAMDISK_BLOCKIO_INSTANCE *Instance;
-  UINT32                   NumBlocks = 0;
+  UINT64                   NumBlocks = 0;
+  UINT64                   StartTicks;
   EFI_STATUS               Status;
 
   if (This == NULL) {
@@ -292,7 +519,7 @@ RamBlockIoWriteBlocks (
   }
 
   // All blocks must be within the device
-  NumBlocks = ((UINT32)BufferSizeInBytes) / Instance->Media.BlockSize;
+  NumBlocks = BufferSizeInBytes / Instance->Media.BlockSize;
 
   if ((Lba + NumBlocks) > (Instance->Media.LastBlock + 1)) {
     DEBUG ((DEBUG_ERROR, "%a: Write will exceed last block.\n", __FUNCTION__));
@@ -316,8 +543,17 @@ RamBlockIoWriteBlocks (
   } else if(This->Media->ReadOnly) {
     Status = EFI_WRITE_PROTECTED;
   } else {
-    CopyMem ((VOID *)(Instance->StartAddress + Lba * Instance->Media.BlockSize), Buffer, BufferSizeInBytes);
-    Status = EFI_SUCCESS;
+    StartTicks = GetPerformanceCounter ();
+    Status = RamBlockIoWriteChunks (
+               Instance,
+               MultU64x32 (Lba, Instance->Media.BlockSize),
+               BufferSizeInBytes,
+               Buffer
+               );
+    Instance->WriteTicks += RamBlockIoElapsed (StartTicks);
+    if (!EFI_ERROR (Status)) {
+      Instance->BytesWritten += BufferSizeInBytes;
+    }
   }
 
   return Status;
@@ -335,11 +571,152 @@ RamBlockIoFlushBlocks (
   return EFI_SUCCESS;
 }
 
+//
+// Requests complete before returning, so the token is signaled
+// straight away.
+//
+STATIC
+EFI_STATUS
+RamBlockIoCompleteToken (
+  IN OUT EFI_BLOCK_IO2_TOKEN *Token,
+  IN     EFI_STATUS          Status
+  )
+{
+  if ((Token != NULL) && (Token->Event != NULL) && !EFI_ERROR (Status)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.Reset
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL *This,
+  IN BOOLEAN                ExtendedVerification
+  )
+{
+  return EFI_SUCCESS;
+}
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSizeInBytes,
+  OUT    VOID                   *Buffer
+  )
+{
+  RAMDISK_BLOCKIO_INSTANCE *Instance;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = INSTANCE_FROM_BLKIO2_THIS (This);
+
+  return RamBlockIoCompleteToken (
+           Token,
+           RamBlockIoReadBlocks (&Instance->BlockIoProtocol, MediaId, Lba, BufferSizeInBytes, Buffer)
+           );
+}
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSizeInBytes,
+  IN     VOID                   *Buffer
+  )
+{
+  RAMDISK_BLOCKIO_INSTANCE *Instance;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = INSTANCE_FROM_BLKIO2_THIS (This);
+
+  return RamBlockIoCompleteToken (
+           Token,
+           RamBlockIoWriteBlocks (&Instance->BlockIoProtocol, MediaId, Lba, BufferSizeInBytes, Buffer)
+           );
+}
+
+//
+// BlockIO2 Protocol function EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx
+//
+EFI_STATUS
+EFIAPI
+RamBlockIoFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  )
+{
+  return RamBlockIoCompleteToken (Token, EFI_SUCCESS);
+}
+
+//
+// Report how much memory the disk ended up using and how fast it was.
+//
+STATIC
+VOID
+EFIAPI
+RamBlockIoOnExitBootServices (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  )
+{
+  RAMDISK_BLOCKIO_INSTANCE *Instance;
+  UINT64                   ReadNs;
+  UINT64                   WriteNs;
+
+  Instance = Context;
+  ReadNs = GetTimeInNanoSecond (Instance->ReadTicks);
+  WriteNs = GetTimeInNanoSecond (Instance->WriteTicks);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: %lu of %lu chunks (%lu MB of %lu MB) committed\n",
+    __FUNCTION__,
+    (UINT64)Instance->CommittedChunks,
+    (UINT64)Instance->ChunkCount,
+    RShiftU64 (MultU64x32 (Instance->CommittedChunks, RAM_BLOCKIO_CHUNK_SIZE), 20),
+    RShiftU64 (Instance->Size, 20)
+    ));
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: read %lu MB in %lu ms, wrote %lu MB in %lu ms\n",
+    __FUNCTION__,
+    RShiftU64 (Instance->BytesRead, 20),
+    DivU64x32 (ReadNs, 1000000),
+    RShiftU64 (Instance->BytesWritten, 20),
+    DivU64x32 (WriteNs, 1000000)
+    ));
+}
+
 EFI_STATUS
 RamBlockIoCreateInstance (
   IN       UINT32 MediaId,
   IN       UINT64 StartAddress,
-  IN       UINT32 Size,
+  IN       UINT64 StartSize,
+  IN       UINT64 Size,
   IN       UINT32 BlockSize,
   IN CONST GUID   *Guid
   )
@@ -347,17 +724,30 @@ RamBlockIoCreateInstance (
   EFI_STATUS               Status;
   RAMDISK_BLOCKIO_INSTANCE *Instance;
 
+  if ((Size < StartSize) || (Size < BlockSize)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
   Instance = AllocateCopyPool (sizeof (RAMDISK_BLOCKIO_INSTANCE), &mRamBlockIoInstanceTemplate);
   if (Instance == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
 
-  Instance->StartAddress = StartAddress;
+  Instance->StartAddress = (UINTN)StartAddress;
+  Instance->StartSize = StartSize;
   Instance->Size = Size;
   Instance->BlockIoProtocol.Media = &Instance->Media;
+  Instance->BlockIo2Protocol.Media = &Instance->Media;
   Instance->Media.MediaId = MediaId;
   Instance->Media.BlockSize = BlockSize;
-  Instance->Media.LastBlock = (Instance->Size / BlockSize) - 1;
+  Instance->Media.LastBlock = DivU64x32 (Instance->Size, BlockSize) - 1;
+
+  Instance->ChunkCount = (UINTN)RShiftU64 (Size + RAM_BLOCKIO_CHUNK_SIZE - 1, RAM_BLOCKIO_CHUNK_SHIFT);
+  Instance->Chunks = AllocateZeroPool (Instance->ChunkCount * sizeof (UINT8 *));
+  if (Instance->Chunks == NULL) {
+    FreePool (Instance);
+    return EFI_OUT_OF_RESOURCES;
+  }
 
   CopyGuid (&Instance->DevicePath.Vendor.Guid, Guid);
 
@@ -367,14 +757,27 @@ RamBlockIoCreateInstance (
                   &Instance->DevicePath,
                   &gEfiBlockIoProtocolGuid,
                   &Instance->BlockIoProtocol,
+                  &gEfiBlockIo2ProtocolGuid,
+                  &Instance->BlockIo2Protocol,
                   NULL
                   );
   if (EFI_ERROR (Status)) {
+    FreePool (Instance->Chunks);
     FreePool (Instance);
     return Status;
   }
 
-  return Status;
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  RamBlockIoOnExitBootServices,
+                  Instance,
+                  &gEfiEventExitBootServicesGuid,
+                  &Instance->ExitBootServicesEvent
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  return EFI_SUCCESS;
 }
 
 EFI_STATUS
@@ -390,6 +793,7 @@ RamBlockIoInitialise (
              0,
              RAM_BLOCKIO_START_ADDRESS,
              RAM_BLOCKIO_SIZE,
+             RAM_BLOCKIO_DISK_SIZE,
              RAM_BLOCKIO_BLOCKSIZE,
              &gRamBlockIoGuid
              );
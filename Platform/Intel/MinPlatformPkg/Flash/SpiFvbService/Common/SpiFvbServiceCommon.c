@@ -263,6 +263,44 @@ FvbReadBlock (
   }
 }
 
+/**
+  Check whether a flash range is in the erased state.
+
+  @param[in]  Address     The memory mapped address of the range.
+  @param[in]  Length      The length of the range.
+
+  @retval     TRUE        Every byte in the range reads back as erased.
+  @retval     FALSE       The range holds programmed data.
+
+**/
+BOOLEAN
+FvbIsRangeErased (
+  IN UINTN                                Address,
+  IN UINTN                                Length
+  )
+{
+  UINT8                                   *Ptr;
+
+  Ptr = (UINT8 *) Address;
+  while (Length >= sizeof (UINT64) && ((UINTN) Ptr & (sizeof (UINT64) - 1)) == 0) {
+    if (*(UINT64 *) Ptr != MAX_UINT64) {
+      return FALSE;
+    }
+    Ptr    += sizeof (UINT64);
+    Length -= sizeof (UINT64);
+  }
+
+  while (Length > 0) {
+    if (*Ptr != 0xFF) {
+      return FALSE;
+    }
+    Ptr++;
+    Length--;
+  }
+
+  return TRUE;
+}
+
 /**
   Writes specified number of bytes from the input buffer to the block.
 
@@ -298,6 +336,10 @@ FvbWriteBlock (
   UINTN                                   LbaLength;
   EFI_STATUS                              Status;
   BOOLEAN                                 BadBufferSize = FALSE;
+  UINT8                                   *Flash;
+  UINTN                                   Start;
+  UINTN                                   End;
+  UINT32                                  Length;
 
   if ((NumBytes == NULL) || (Buffer == NULL)) {
     return EFI_INVALID_PARAMETER;
@@ -336,17 +378,40 @@ FvbWriteBlock (
     BadBufferSize = TRUE;
   }
 
-  Status = SpiFlashWrite (LbaAddress + BlockOffset, (UINT32 *)NumBytes, Buffer);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
+  mFvbModuleGlobal.Stats.WriteRequests++;
 
-  Status = SpiFlashLock ();
-  if (EFI_ERROR (Status)) {
-    return Status;
+  //
+  // The flash is memory mapped, so leading and trailing bytes that already
+  // hold the requested data need not be programmed again. Variable updates
+  // rewrite headers and state bytes that mostly match what is on flash.
+  //
+  Flash = (UINT8 *) (LbaAddress + BlockOffset);
+  Start = 0;
+  End   = *NumBytes;
+  while (Start < End && Flash[Start] == Buffer[Start]) {
+    Start++;
+  }
+  while (End > Start && Flash[End - 1] == Buffer[End - 1]) {
+    End--;
   }
 
-  WriteBackInvalidateDataCacheRange ((VOID *) (LbaAddress + BlockOffset), *NumBytes);
+  if (Start == End) {
+    mFvbModuleGlobal.Stats.WritesElided++;
+  } else {
+    Length = (UINT32) (End - Start);
+    Status = SpiFlashWrite (LbaAddress + BlockOffset + Start, &Length, Buffer + Start);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Status = SpiFlashLock ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    mFvbModuleGlobal.Stats.FlashBytesWritten += Length;
+    WriteBackInvalidateDataCacheRange ((VOID *) (LbaAddress + BlockOffset + Start), Length);
+  }
 
   if (!EFI_ERROR (Status) && BadBufferSize) {
     return EFI_BAD_BUFFER_SIZE;
@@ -358,10 +423,51 @@ FvbWriteBlock (
 
 
 /**
-  Erases and initializes a firmware volume block.
+  Erases a physically contiguous range of flash with a single erase command.
+
+  @param[in]    Address           The memory mapped address of the range
+  @param[in]    Length            The length of the range
+
+  @retval   EFI_SUCCESS           The range was erased
+  @retval   EFI_DEVICE_ERROR      The block device is not functioning correctly and
+                                  could not be written. Firmware device may have been
+                                  partially erased
+
+**/
+EFI_STATUS
+FvbEraseRange (
+  IN UINTN                      Address,
+  IN UINTN                      Length
+  )
+{
+  EFI_STATUS                              Status;
+
+  Status = SpiFlashBlockErase (Address, &Length);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = SpiFlashLock ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  mFvbModuleGlobal.Stats.FlashEraseOps++;
+  mFvbModuleGlobal.Stats.FlashBytesErased += Length;
+  WriteBackInvalidateDataCacheRange ((VOID *) Address, Length);
+
+  return Status;
+}
+
+/**
+  Erases and initializes a run of firmware volume blocks.
+
+  Blocks that are already erased are skipped, and the remaining blocks are
+  erased in as few physically contiguous ranges as possible.
 
   @param[in]    FvbInstance       The pointer to the EFI_FVB_INSTANCE
-  @param[in]    Lba               The logical block index to be erased
+  @param[in]    Lba               The first logical block index to be erased
+  @param[in]    NumOfLba          The number of blocks to be erased
 
   @retval   EFI_SUCCESS           The erase request was successfully completed
   @retval   EFI_ACCESS_DENIED     The firmware volume is in the WriteDisabled state
@@ -374,13 +480,16 @@ FvbWriteBlock (
 EFI_STATUS
 FvbEraseBlock (
   IN EFI_FVB_INSTANCE           *FvbInstance,
-  IN EFI_LBA                    Lba
+  IN EFI_LBA                    Lba,
+  IN UINTN                      NumOfLba
   )
 {
 
   EFI_FVB_ATTRIBUTES_2                    Attributes;
   UINTN                                   LbaAddress;
   UINTN                                   LbaLength;
+  UINTN                                   RunAddress;
+  UINTN                                   RunLength;
   EFI_STATUS                              Status;
 
   //
@@ -392,27 +501,46 @@ FvbEraseBlock (
     return EFI_ACCESS_DENIED;
   }
 
-  //
-  // Get the starting address of the block for erase.
-  //
-  Status = FvbGetLbaAddress (FvbInstance, Lba, &LbaAddress, &LbaLength, NULL);
-  if (EFI_ERROR(Status)) {
-    return Status;
-  }
+  RunAddress = 0;
+  RunLength  = 0;
 
-  Status = SpiFlashBlockErase (LbaAddress, &LbaLength);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
+  while (NumOfLba > 0) {
+    //
+    // Get the starting address of the block for erase.
+    //
+    Status = FvbGetLbaAddress (FvbInstance, Lba, &LbaAddress, &LbaLength, NULL);
+    if (EFI_ERROR(Status)) {
+      return Status;
+    }
 
-  Status = SpiFlashLock ();
-  if (EFI_ERROR (Status)) {
-    return Status;
+    mFvbModuleGlobal.Stats.EraseRequests++;
+
+    if (FvbIsRangeErased (LbaAddress, LbaLength)) {
+      mFvbModuleGlobal.Stats.ErasesElided++;
+    } else {
+      if (RunLength != 0 && RunAddress + RunLength != LbaAddress) {
+        Status = FvbEraseRange (RunAddress, RunLength);
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+        RunLength = 0;
+      }
+
+      if (RunLength == 0) {
+        RunAddress = LbaAddress;
+      }
+      RunLength += LbaLength;
+    }
+
+    Lba++;
+    NumOfLba--;
   }
 
-  WriteBackInvalidateDataCacheRange ((VOID *) LbaAddress, LbaLength);
+  if (RunLength != 0) {
+    return FvbEraseRange (RunAddress, RunLength);
+  }
 
-  return Status;
+  return EFI_SUCCESS;
 }
 
 /**
@@ -783,20 +911,27 @@ FvbProtocolEraseBlocks (
 
     NumOfLba = VA_ARG (Args, UINT32);
 
-    while ( NumOfLba > 0 ) {
-      Status = FvbEraseBlock (FvbInstance, StartingLba);
-      if ( EFI_ERROR(Status)) {
-        VA_END (Args);
-        return Status;
-      }
-      StartingLba ++;
-      NumOfLba --;
+    Status = FvbEraseBlock (FvbInstance, StartingLba, NumOfLba);
+    if ( EFI_ERROR(Status)) {
+      VA_END (Args);
+      return Status;
     }
 
   } while ( 1 );
 
   VA_END (Args);
 
+  DEBUG ((DEBUG_INFO,
+    "FvbProtocolEraseBlocks: Erase requests 0x%lx (elided 0x%lx, ops 0x%lx, bytes 0x%lx), Write requests 0x%lx (elided 0x%lx, bytes 0x%lx)\n",
+    mFvbModuleGlobal.Stats.EraseRequests,
+    mFvbModuleGlobal.Stats.ErasesElided,
+    mFvbModuleGlobal.Stats.FlashEraseOps,
+    mFvbModuleGlobal.Stats.FlashBytesErased,
+    mFvbModuleGlobal.Stats.WriteRequests,
+    mFvbModuleGlobal.Stats.WritesElided,
+    mFvbModuleGlobal.Stats.FlashBytesWritten)
+    );
+
   return EFI_SUCCESS;
 }
 
@@ -54,9 +54,24 @@ typedef struct {
   EFI_FIRMWARE_VOLUME_HEADER            FvHeader;
 } EFI_FVB_INSTANCE;
 
+//
+// Flash access counters. Elided requests are served without touching the
+// flash because its current contents already match the request.
+//
+typedef struct {
+  UINT64                      WriteRequests;
+  UINT64                      WritesElided;
+  UINT64                      FlashBytesWritten;
+  UINT64                      EraseRequests;
+  UINT64                      ErasesElided;
+  UINT64                      FlashEraseOps;
+  UINT64                      FlashBytesErased;
+} FVB_FLASH_STATISTICS;
+
 typedef struct {
   EFI_FVB_INSTANCE            *FvbInstance;
   UINT32                      NumFv;
+  FVB_FLASH_STATISTICS        Stats;
 } FVB_GLOBAL;
 
 //
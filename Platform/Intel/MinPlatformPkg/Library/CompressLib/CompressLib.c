@@ -16,6 +16,7 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Uefi/UefiBaseType.h>
+#include <Library/CompressLib.h>
 
 #define SHELL_FREE_NON_NULL(Pointer)  \
   do {                                \
@@ -46,6 +47,21 @@ typedef INT16             NODE;
 #define CRCPOLY           0xA001
 #define UPDATE_CRC(LoopVar5)     mCrc = mCrcTable[(mCrc ^ (LoopVar5)) & 0xFF] ^ (mCrc >> UINT8_BIT)
 
+//
+// Hash chain match finder: chains are keyed by the next THRESHOLD bytes and
+// searched newest first, giving up after HC_CHAIN_LIMIT candidates.
+//
+#define HC_HASH_BITS      14
+#define HC_HASH_SIZE      (1U << HC_HASH_BITS)
+#define HC_HASH(Ptr)      (((((UINT32) (Ptr)[0]) << 10) ^ (((UINT32) (Ptr)[1]) << 5) ^ (Ptr)[2]) & (HC_HASH_SIZE - 1))
+#define HC_CHAIN_LIMIT    16
+
+//
+// Source data staged by the streaming interface: enough to prime the sliding
+// dictionary, which is also more than one refill needs.
+//
+#define STAGE_SIZE        (WNDSIZ + MAXMATCH)
+
 //
 // C: the Char&Len Set; P: the Position Set; T: the exTra Set
 //
@@ -123,8 +139,21 @@ STATIC NODE   *mPosition;
 STATIC NODE   *mParent;
 STATIC NODE   *mPrev;
 STATIC NODE   *mNext = NULL;
+STATIC NODE   *mHashHead;
+STATIC NODE   *mHashPrev;
 INT32         mHuffmanDepth = 0;
 
+STATIC COMPRESS_MATCH_FINDER  mMatchFinder;
+STATIC BOOLEAN                mPrimed;
+STATIC BOOLEAN                mFlush;
+STATIC INT32                  mPendingSkip;
+
+STATIC BOOLEAN  mStreamActive = FALSE;
+STATIC UINT8    *mStage;
+STATIC UINT32   mStageLen;
+STATIC UINT8    *mStreamDst;
+STATIC UINT64   mStreamDstSize;
+
 /**
   Make a CRC table.
 
@@ -196,12 +225,28 @@ AllocateMemory (
   )
 {
   mText       = AllocateZeroPool (WNDSIZ * 2 + MAXMATCH);
-  mLevel      = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mLevel));
-  mChildCount = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mChildCount));
-  mPosition   = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mPosition));
-  mParent     = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mParent));
-  mPrev       = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mPrev));
-  mNext       = AllocateZeroPool ((MAX_HASH_VAL + 1) * sizeof (*mNext));
+  if (mText == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (mMatchFinder == CompressMatchFinderHashChain) {
+    mHashHead   = AllocateZeroPool (HC_HASH_SIZE * sizeof (*mHashHead));
+    mHashPrev   = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mHashPrev));
+    if (mHashHead == NULL || mHashPrev == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  } else {
+    mLevel      = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mLevel));
+    mChildCount = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mChildCount));
+    mPosition   = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mPosition));
+    mParent     = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mParent));
+    mPrev       = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mPrev));
+    mNext       = AllocateZeroPool ((MAX_HASH_VAL + 1) * sizeof (*mNext));
+    if (mLevel == NULL || mChildCount == NULL || mPosition == NULL ||
+        mParent == NULL || mPrev == NULL || mNext == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
 
   mBufSiz     = BLKSIZ;
   mBuf        = AllocateZeroPool (mBufSiz);
@@ -236,7 +281,10 @@ FreeMemory (
   SHELL_FREE_NON_NULL (mParent);
   SHELL_FREE_NON_NULL (mPrev);
   SHELL_FREE_NON_NULL (mNext);
+  SHELL_FREE_NON_NULL (mHashHead);
+  SHELL_FREE_NON_NULL (mHashPrev);
   SHELL_FREE_NON_NULL (mBuf);
+  SHELL_FREE_NON_NULL (mStage);
 }
 
 /**
@@ -574,6 +622,105 @@ DeleteNode (
   mAvail              = LoopVar4;
 }
 
+/**
+  Find the longest match for the current position with the hash chain match
+  finder, then link the current position into its chain.
+
+  Stale links are never unlinked: a slot is simply reused when the window
+  wraps around, and a chain walk stops as soon as a candidate is not older
+  than the previous one.
+
+**/
+VOID
+EFIAPI
+HashInsertNode (
+  VOID
+  )
+{
+  UINT32  Hash;
+  UINT32  Limit;
+  NODE    Candidate;
+  NODE    Location;
+  INT32   Age;
+  INT32   LastAge;
+  INT32   Length;
+
+  Hash      = HC_HASH (&mText[mPos]);
+  Candidate = mHashHead[Hash];
+  LastAge   = 0;
+
+  //
+  // A long match at the previous position carries over one byte shorter,
+  // which saves rescanning runs byte by byte.
+  //
+  if (mMatchLen > THRESHOLD) {
+    Location = (NODE) (mMatchPos + 1);
+    Length   = mMatchLen - 1;
+    while (Length < MAXMATCH && mText[Location + Length] == mText[mPos + Length]) {
+      Length++;
+    }
+
+    mMatchLen = Length;
+    mMatchPos = Location;
+    if (mMatchLen >= MAXMATCH) {
+      Candidate = NIL;
+    }
+  } else {
+    mMatchLen = 0;
+  }
+
+  for (Limit = HC_CHAIN_LIMIT; Candidate != NIL && Limit > 0; Limit--) {
+    Age = (mPos - Candidate) & (WNDSIZ - 1);
+    if (Age <= LastAge) {
+      break;
+    }
+    LastAge = Age;
+
+    //
+    // Positions past the current one were inserted before the last slide.
+    //
+    Location = (NODE) ((Candidate < mPos) ? Candidate : Candidate - WNDSIZ);
+    if (mText[Location + mMatchLen] == mText[mPos + mMatchLen]) {
+      Length = 0;
+      while (Length < MAXMATCH && mText[Location + Length] == mText[mPos + Length]) {
+        Length++;
+      }
+
+      if (Length > mMatchLen) {
+        mMatchLen = Length;
+        mMatchPos = Location;
+        if (mMatchLen >= MAXMATCH) {
+          break;
+        }
+      }
+    }
+
+    Candidate = mHashPrev[Candidate];
+  }
+
+  mHashPrev[mPos] = mHashHead[Hash];
+  mHashHead[Hash] = mPos;
+}
+
+/**
+  Update the String Info Log for the current position with the selected
+  match finder.
+
+**/
+VOID
+EFIAPI
+FindMatch (
+  VOID
+  )
+{
+  if (mMatchFinder == CompressMatchFinderHashChain) {
+    HashInsertNode ();
+  } else {
+    DeleteNode ();
+    InsertNode ();
+  }
+}
+
 /**
   Read in source data
 
@@ -613,38 +760,31 @@ FreadCrc (
   Advance the current position (read in new data if needed).
   Delete outdated string info. Find a match string for current position.
 
-  @retval TRUE      The operation was successful.
-  @retval FALSE     The operation failed due to insufficient memory.
-
 **/
-BOOLEAN
+VOID
 EFIAPI
 GetNextMatch (
   VOID
   )
 {
   INT32 LoopVar8;
-  VOID  *Temp;
 
   mRemainder--;
   mPos++;
   if (mPos == WNDSIZ * 2) {
-    Temp = AllocateZeroPool (WNDSIZ + MAXMATCH);
-    if (Temp == NULL) {
-      return (FALSE);
-    }
-    CopyMem (Temp, &mText[WNDSIZ], WNDSIZ + MAXMATCH);
-    CopyMem (&mText[0], Temp, WNDSIZ + MAXMATCH);
-    FreePool (Temp);
+    //
+    // CopyMem() handles the overlap between the two halves.
+    //
+    CopyMem (&mText[0], &mText[WNDSIZ], WNDSIZ + MAXMATCH);
     LoopVar8 = FreadCrc (&mText[WNDSIZ + MAXMATCH], WNDSIZ);
     mRemainder += LoopVar8;
     mPos = WNDSIZ;
+    if (mMatchFinder == CompressMatchFinderHashChain) {
+      mMatchPos = (NODE) (mMatchPos - WNDSIZ);
+    }
   }
 
-  DeleteNode ();
-  InsertNode ();
-
-  return (TRUE);
+  FindMatch ();
 }
 
 /**
@@ -1275,46 +1415,84 @@ HufEncodeEnd (
 }
 
 /**
-  The main controlling routine for compression process.
+  Check whether the current position can be advanced without running past
+  the source data that is available so far. Unless the encoder is flushing,
+  a refill of the sliding dictionary must get a full window of new data so
+  that a stream produces the same output as a single-shot compression.
 
-  @retval EFI_SUCCESS           The compression is successful.
-  @retval EFI_OUT_0F_RESOURCES  Not enough memory for compression process.
+  @retval TRUE      GetNextMatch() may be called.
+  @retval FALSE     More source data is needed first.
 **/
-EFI_STATUS
+BOOLEAN
 EFIAPI
-Encode (
+CanAdvance (
+  VOID
+  )
+{
+  return (BOOLEAN) (mFlush ||
+                    mPos + 1 < WNDSIZ * 2 ||
+                    (UINTN) (mSrcUpperLimit - mSrc) >= WNDSIZ);
+}
+
+/**
+  Run the LZ77 stage over the source data available so far. Returns early,
+  with its progress recorded in mPendingSkip, when more source data is needed.
+
+**/
+VOID
+EFIAPI
+EncodeRun (
   VOID
   )
 {
-  EFI_STATUS  Status;
   INT32       LastMatchLen;
   NODE        LastMatchPos;
 
-  Status = AllocateMemory ();
-  if (EFI_ERROR (Status)) {
-    FreeMemory ();
-    return Status;
-  }
-
-  InitSlide ();
+  if (!mPrimed) {
+    if (!mFlush && (UINTN) (mSrcUpperLimit - mSrc) < WNDSIZ + MAXMATCH) {
+      return;
+    }
 
-  HufEncodeStart ();
+    mRemainder  = FreadCrc (&mText[WNDSIZ], WNDSIZ + MAXMATCH);
 
-  mRemainder  = FreadCrc (&mText[WNDSIZ], WNDSIZ + MAXMATCH);
+    mMatchLen   = 0;
+    mPos        = WNDSIZ;
+    if (mMatchFinder == CompressMatchFinderHashChain) {
+      HashInsertNode ();
+    } else {
+      InsertNode ();
+    }
+    if (mMatchLen > mRemainder) {
+      mMatchLen = mRemainder;
+    }
 
-  mMatchLen   = 0;
-  mPos        = WNDSIZ;
-  InsertNode ();
-  if (mMatchLen > mRemainder) {
-    mMatchLen = mRemainder;
+    mPendingSkip = 0;
+    mPrimed      = TRUE;
   }
 
-  while (mRemainder > 0) {
+  for (;;) {
+    //
+    // Skip over the rest of the string a pointer was output for.
+    //
+    while (mPendingSkip > 0) {
+      if (!CanAdvance ()) {
+        return;
+      }
+
+      GetNextMatch ();
+      mPendingSkip--;
+      if (mPendingSkip == 0 && mMatchLen > mRemainder) {
+        mMatchLen = mRemainder;
+      }
+    }
+
+    if (mRemainder <= 0 || !CanAdvance ()) {
+      return;
+    }
+
     LastMatchLen = mMatchLen;
     LastMatchPos = mMatchPos;
-    if (!GetNextMatch ()) {
-      Status = EFI_OUT_OF_RESOURCES;
-    }
+    GetNextMatch ();
     if (mMatchLen > mRemainder) {
       mMatchLen = mRemainder;
     }
@@ -1332,51 +1510,85 @@ Encode (
 
       CompressOutput (LastMatchLen + (MAX_UINT8 + 1 - THRESHOLD),
         (mPos - LastMatchPos - 2) & (WNDSIZ - 1));
-      LastMatchLen--;
-      while (LastMatchLen > 0) {
-        if (!GetNextMatch ()) {
-          Status = EFI_OUT_OF_RESOURCES;
-        }
-        LastMatchLen--;
-      }
-
-      if (mMatchLen > mRemainder) {
-        mMatchLen = mRemainder;
-      }
+      mPendingSkip = LastMatchLen - 1;
     }
   }
+}
+
+/**
+  Allocate and initialize the encoder state for the selected match finder.
+
+  @retval EFI_SUCCESS           The encoder is ready.
+  @retval EFI_OUT_0F_RESOURCES  Not enough memory for compression process.
+**/
+EFI_STATUS
+EFIAPI
+EncodeStart (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = AllocateMemory ();
+  if (EFI_ERROR (Status)) {
+    FreeMemory ();
+    return Status;
+  }
+
+  if (mMatchFinder == CompressMatchFinderBinaryTree) {
+    InitSlide ();
+  }
+
+  HufEncodeStart ();
+
+  mPrimed       = FALSE;
+  mFlush        = FALSE;
+  mPendingSkip  = 0;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  The main controlling routine for compression process.
+
+  @retval EFI_SUCCESS           The compression is successful.
+  @retval EFI_OUT_0F_RESOURCES  Not enough memory for compression process.
+**/
+EFI_STATUS
+EFIAPI
+Encode (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = EncodeStart ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  mFlush = TRUE;
+  EncodeRun ();
 
   HufEncodeEnd ();
   FreeMemory ();
-  return (Status);
+  return EFI_SUCCESS;
 }
 
 /**
-  The compression routine.
+  Reset the global state and reserve room for the header of the compressed
+  image.
 
-  @param[in]       SrcBuffer     The buffer containing the source data.
-  @param[in]       SrcSize       The number of bytes in SrcBuffer.
   @param[in]       DstBuffer     The buffer to put the compressed image in.
-  @param[in, out]  DstSize       On input the size (in bytes) of DstBuffer, on
-                                return the number of bytes placed in DstBuffer.
-
-  @retval EFI_SUCCESS           The compression was sucessful.
-  @retval EFI_BUFFER_TOO_SMALL  The buffer was too small.  DstSize is required.
+  @param[in]       DstSize       The size (in bytes) of DstBuffer.
 **/
-EFI_STATUS
+VOID
 EFIAPI
-Compress (
-  IN       VOID   *SrcBuffer,
-  IN       UINT64 SrcSize,
+CompressStart (
   IN       VOID   *DstBuffer,
-  IN OUT   UINT64 *DstSize
+  IN       UINT64 DstSize
   )
 {
-  EFI_STATUS  Status;
-
-  //
-  // Initializations
-  //
   mBufSiz         = 0;
   mBuf            = NULL;
   mText           = NULL;
@@ -1386,11 +1598,12 @@ Compress (
   mParent         = NULL;
   mPrev           = NULL;
   mNext           = NULL;
+  mHashHead       = NULL;
+  mHashPrev       = NULL;
+  mStage          = NULL;
 
-  mSrc            = SrcBuffer;
-  mSrcUpperLimit  = mSrc + SrcSize;
   mDst            = DstBuffer;
-  mDstUpperLimit  = mDst + *DstSize;
+  mDstUpperLimit  = mDst + DstSize;
 
   PutDword (0L);
   PutDword (0L);
@@ -1399,14 +1612,25 @@ Compress (
 
   mOrigSize       = mCompSize = 0;
   mCrc            = INIT_CRC;
+}
 
-  //
-  // Compress it
-  //
-  Status = Encode ();
-  if (EFI_ERROR (Status)) {
-    return EFI_OUT_OF_RESOURCES;
-  }
+/**
+  Terminate the compressed image and fill in its header.
+
+  @param[in]       DstBuffer     The buffer the compressed image was put in.
+  @param[in, out]  DstSize       On input the size (in bytes) of DstBuffer, on
+                                 return the number of bytes placed in DstBuffer.
+
+  @retval EFI_SUCCESS           The compression was sucessful.
+  @retval EFI_BUFFER_TOO_SMALL  The buffer was too small.  DstSize is required.
+**/
+EFI_STATUS
+EFIAPI
+CompressFinish (
+  IN       VOID   *DstBuffer,
+  IN OUT   UINT64 *DstSize
+  )
+{
   //
   // Null terminate the compressed data
   //
@@ -1430,6 +1654,208 @@ Compress (
     *DstSize = mCompSize + 1 + 8;
     return EFI_SUCCESS;
   }
+}
+
+/**
+  The compression routine.
+
+  @param[in]       SrcBuffer     The buffer containing the source data.
+  @param[in]       SrcSize       The number of bytes in SrcBuffer.
+  @param[in]       DstBuffer     The buffer to put the compressed image in.
+  @param[in, out]  DstSize       On input the size (in bytes) of DstBuffer, on
+                                return the number of bytes placed in DstBuffer.
+
+  @retval EFI_SUCCESS           The compression was sucessful.
+  @retval EFI_BUFFER_TOO_SMALL  The buffer was too small.  DstSize is required.
+**/
+EFI_STATUS
+EFIAPI
+Compress (
+  IN       VOID   *SrcBuffer,
+  IN       UINT64 SrcSize,
+  IN       VOID   *DstBuffer,
+  IN OUT   UINT64 *DstSize
+  )
+{
+  EFI_STATUS  Status;
+
+  ASSERT (!mStreamActive);
+
+  //
+  // Initializations
+  //
+  CompressStart (DstBuffer, *DstSize);
+
+  mMatchFinder    = CompressMatchFinderBinaryTree;
+  mSrc            = SrcBuffer;
+  mSrcUpperLimit  = mSrc + SrcSize;
+
+  //
+  // Compress it
+  //
+  Status = Encode ();
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return CompressFinish (DstBuffer, DstSize);
+}
+
+/**
+  Run the encoder over the staged source data and keep whatever it could not
+  consume yet.
+
+**/
+VOID
+EFIAPI
+StreamRun (
+  VOID
+  )
+{
+  UINT32  Consumed;
+
+  mSrc            = mStage;
+  mSrcUpperLimit  = mStage + mStageLen;
+
+  EncodeRun ();
+
+  Consumed   = (UINT32) (mSrc - mStage);
+  mStageLen -= Consumed;
+  CopyMem (mStage, mSrc, mStageLen);
+}
+
+/**
+  Start a streaming compression.
+
+  The source data is supplied in pieces of any size with CompressStreamUpdate()
+  and the stream is closed with CompressStreamFinal(). Working memory does not
+  depend on the size of the source data. Only one compression, streaming or
+  not, may be in progress at a time.
+
+  @param[in]  MatchFinder   The string matcher to use.
+  @param[in]  DstBuffer     The buffer to put the compressed image in.
+  @param[in]  DstSize       The size (in bytes) of DstBuffer.
+
+  @retval EFI_SUCCESS           The stream was started.
+  @retval EFI_INVALID_PARAMETER DstBuffer is NULL or MatchFinder is not valid.
+  @retval EFI_OUT_OF_RESOURCES  Not enough memory for the compression process.
+**/
+EFI_STATUS
+EFIAPI
+CompressStreamInit (
+  IN      COMPRESS_MATCH_FINDER  MatchFinder,
+  IN      VOID                   *DstBuffer,
+  IN      UINT64                 DstSize
+  )
+{
+  EFI_STATUS  Status;
+
+  if (DstBuffer == NULL || MatchFinder >= CompressMatchFinderMax) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (mStreamActive) {
+    FreeMemory ();
+    mStreamActive = FALSE;
+  }
+
+  CompressStart (DstBuffer, DstSize);
+
+  mMatchFinder = MatchFinder;
+  Status = EncodeStart ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  mStage = AllocatePool (STAGE_SIZE);
+  if (mStage == NULL) {
+    FreeMemory ();
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  mStageLen       = 0;
+  mStreamDst      = DstBuffer;
+  mStreamDstSize  = DstSize;
+  mStreamActive   = TRUE;
 
+  return EFI_SUCCESS;
 }
 
+/**
+  Feed more source data to a streaming compression.
+
+  @param[in]  SrcBuffer     The buffer containing the next piece of source data.
+  @param[in]  SrcSize       Number of bytes in SrcBuffer.
+
+  @retval EFI_SUCCESS           The data was consumed.
+  @retval EFI_INVALID_PARAMETER SrcBuffer is NULL and SrcSize is not zero.
+  @retval EFI_NOT_READY         No stream was started with CompressStreamInit().
+**/
+EFI_STATUS
+EFIAPI
+CompressStreamUpdate (
+  IN      VOID    *SrcBuffer,
+  IN      UINT64  SrcSize
+  )
+{
+  UINT8   *Src;
+  UINT32  Copy;
+
+  if (!mStreamActive) {
+    return EFI_NOT_READY;
+  }
+
+  if (SrcBuffer == NULL && SrcSize != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Src = SrcBuffer;
+  while (SrcSize > 0) {
+    Copy = (UINT32) MIN (SrcSize, STAGE_SIZE - mStageLen);
+    CopyMem (mStage + mStageLen, Src, Copy);
+    mStageLen += Copy;
+    Src       += Copy;
+    SrcSize   -= Copy;
+
+    StreamRun ();
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Flush a streaming compression and release its resources.
+
+  @param[out]  DstSize      The number of bytes placed in the buffer passed to
+                            CompressStreamInit(), or the number of bytes required
+                            if it was too small.
+
+  @retval EFI_SUCCESS           The compression was sucessful.
+  @retval EFI_BUFFER_TOO_SMALL  The buffer was too small.  DstSize is required.
+  @retval EFI_INVALID_PARAMETER DstSize is NULL.
+  @retval EFI_NOT_READY         No stream was started with CompressStreamInit().
+**/
+EFI_STATUS
+EFIAPI
+CompressStreamFinal (
+  OUT     UINT64  *DstSize
+  )
+{
+  if (!mStreamActive) {
+    return EFI_NOT_READY;
+  }
+
+  if (DstSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mFlush = TRUE;
+  StreamRun ();
+
+  HufEncodeEnd ();
+  FreeMemory ();
+  mStreamActive = FALSE;
+
+  *DstSize = mStreamDstSize;
+  return CompressFinish (mStreamDst, DstSize);
+}
@@ -0,0 +1,220 @@
+/** @file
+  Application that measures the read throughput of USB mass storage devices.
+
+  Every Block I/O instance of a whole USB device is read from LBA 0 in 64KB
+  requests, which UsbMassStorageDxe passes on as bulk transfers of the same
+  size, and the rate is printed with the device path of the device.
+
+  Full and low speed devices are driven by the OHCI controller, high speed
+  devices by the EHCI controller. To measure OHCI bulk throughput, plug a
+  USB 1.1 device, or a USB 2.0 device through a USB 1.1 hub, into a Quark
+  host port; the device path then goes through the OHCI function. Run the
+  application on firmware built with and without a change to the OHCI
+  driver to compare the two.
+
+    UsbReadBench.efi [MB]
+
+  MB is the amount of data to read from each device, 16 by default.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/ShellParameters.h>
+
+//
+// Data read by each ReadBlocks () call
+//
+#define USB_BENCH_CHUNK_SIZE  SIZE_64KB
+#define USB_BENCH_DEFAULT_MB  16
+
+/**
+  Check whether a device path goes through a USB device.
+
+  @param[in] DevicePath     The device path to check.
+
+  @retval TRUE              The device path has a USB node.
+  @retval FALSE             The device path has no USB node.
+
+**/
+BOOLEAN
+IsUsbDevicePath (
+  IN EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  while (!IsDevicePathEnd (DevicePath)) {
+    if (DevicePathType (DevicePath) == MESSAGING_DEVICE_PATH &&
+        (DevicePathSubType (DevicePath) == MSG_USB_DP ||
+         DevicePathSubType (DevicePath) == MSG_USB_CLASS_DP ||
+         DevicePathSubType (DevicePath) == MSG_USB_WWID_DP)) {
+      return TRUE;
+    }
+    DevicePath = NextDevicePathNode (DevicePath);
+  }
+
+  return FALSE;
+}
+
+/**
+  Read from the start of a block device and print the throughput.
+
+  @param[in] BlockIo        The Block I/O instance of the device.
+  @param[in] Buffer         A buffer of USB_BENCH_CHUNK_SIZE bytes.
+  @param[in] Size           The number of bytes to read.
+
+**/
+VOID
+BenchBlockIo (
+  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN VOID                   *Buffer,
+  IN UINT64                 Size
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      BlockSize;
+  UINTN       Length;
+  EFI_LBA     Lba;
+  UINT64      Read;
+  UINT64      Start;
+  UINT64      Elapsed;
+
+  BlockSize = BlockIo->Media->BlockSize;
+  if (!BlockIo->Media->MediaPresent || BlockSize == 0 || BlockSize > USB_BENCH_CHUNK_SIZE) {
+    Print (L"  Skipped: no media or unsupported block size\n");
+    return;
+  }
+
+  Size  = MIN (Size, MultU64x32 (BlockIo->Media->LastBlock + 1, BlockSize));
+  Read  = 0;
+  Lba   = 0;
+  Start = GetPerformanceCounter ();
+  while (Read < Size) {
+    Length = (UINTN) MIN (Size - Read, USB_BENCH_CHUNK_SIZE);
+    Length = ((Length + BlockSize - 1) / BlockSize) * BlockSize;
+    Status = BlockIo->ReadBlocks (
+                        BlockIo,
+                        BlockIo->Media->MediaId,
+                        Lba,
+                        Length,
+                        Buffer
+                        );
+    if (EFI_ERROR (Status)) {
+      Print (L"  Read at LBA 0x%Lx failed: %r\n", Lba, Status);
+      return;
+    }
+
+    Read += Length;
+    Lba  += Length / BlockSize;
+  }
+
+  Elapsed = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+  if (Elapsed == 0) {
+    Elapsed = 1;
+  }
+
+  Print (
+    L"  %Lu KB in %Lu ms, %Lu KB/s\n",
+    DivU64x32 (Read, SIZE_1KB),
+    DivU64x32 (Elapsed, 1000000),
+    DivU64x64Remainder (MultU64x32 (Read, 1000000000 / SIZE_1KB), Elapsed, NULL)
+    );
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                     Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL  *Parameters;
+  EFI_BLOCK_IO_PROTOCOL          *BlockIo;
+  EFI_DEVICE_PATH_PROTOCOL       *DevicePath;
+  EFI_HANDLE                     *Handles;
+  UINTN                          HandleCount;
+  UINTN                          Index;
+  UINTN                          MegaBytes;
+  CHAR16                         *Text;
+  VOID                           *Buffer;
+
+  MegaBytes = USB_BENCH_DEFAULT_MB;
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &Parameters
+                  );
+  if (!EFI_ERROR (Status) && Parameters->Argc > 1) {
+    MegaBytes = StrDecimalToUintn (Parameters->Argv[1]);
+    if (MegaBytes == 0) {
+      Print (L"Usage: UsbReadBench [MB]\n");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiBlockIoProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles
+                  );
+  if (EFI_ERROR (Status)) {
+    Print (L"No Block I/O instance found\n");
+    return Status;
+  }
+
+  //
+  // Page aligned, which satisfies any IoAlign a device may ask for
+  //
+  Buffer = AllocatePages (EFI_SIZE_TO_PAGES (USB_BENCH_CHUNK_SIZE));
+  if (Buffer == NULL) {
+    FreePool (Handles);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (Handles[Index], &gEfiBlockIoProtocolGuid, (VOID **) &BlockIo);
+    if (EFI_ERROR (Status) || BlockIo->Media->LogicalPartition) {
+      continue;
+    }
+
+    Status = gBS->HandleProtocol (Handles[Index], &gEfiDevicePathProtocolGuid, (VOID **) &DevicePath);
+    if (EFI_ERROR (Status) || !IsUsbDevicePath (DevicePath)) {
+      continue;
+    }
+
+    Text = ConvertDevicePathToText (DevicePath, TRUE, TRUE);
+    Print (L"%s, reading %Lu MB:\n", (Text != NULL) ? Text : L"USB device", (UINT64) MegaBytes);
+    if (Text != NULL) {
+      FreePool (Text);
+    }
+
+    BenchBlockIo (BlockIo, Buffer, MultU64x32 (MegaBytes, SIZE_1MB));
+  }
+
+  FreePages (Buffer, EFI_SIZE_TO_PAGES (USB_BENCH_CHUNK_SIZE));
+  FreePool (Handles);
+  return EFI_SUCCESS;
+}
@@ -101,7 +101,8 @@ MemoryDiscoveredPpiNotifyCallback (
   UINT32                                RegData32;
   UINT8                                 CpuAddressWidth;
   UINT32                                RegEax;
-  MTRR_SETTINGS                         MtrrSettings;
+  MTRR_MEMORY_RANGE                     MemoryRanges[2];
+  UINTN                                 ScratchSize;
   EFI_PEI_READ_ONLY_VARIABLE2_PPI       *VariableServices;
   UINT8                                 MorControl;
   UINTN                                 DataSize;
@@ -123,28 +124,27 @@ MemoryDiscoveredPpiNotifyCallback (
   Status = PeiServicesGetBootMode (&BootMode);
   ASSERT_EFI_ERROR (Status);
 
-  //
-  // Get current MTRR settings
-  //
-  MtrrGetAllMtrrs (&MtrrSettings);
-
   //
   // Set all DRAM cachability to CacheWriteBack
   //
-  Status = MtrrSetMemoryAttributeInMtrrSettings (&MtrrSettings, 0, MemoryLength, CacheWriteBack);
-  ASSERT_EFI_ERROR (Status);
+  MemoryRanges[0].BaseAddress = 0;
+  MemoryRanges[0].Length      = MemoryLength;
+  MemoryRanges[0].Type        = CacheWriteBack;
 
   //
   // RTC:28208 - System hang/crash when entering probe mode(ITP) when relocating SMBASE
   //             Workaround to make default SMRAM UnCachable
   //
-  Status = MtrrSetMemoryAttributeInMtrrSettings (&MtrrSettings, 0x30000, SIZE_64KB, CacheUncacheable);
-  ASSERT_EFI_ERROR (Status);
+  MemoryRanges[1].BaseAddress = 0x30000;
+  MemoryRanges[1].Length      = SIZE_64KB;
+  MemoryRanges[1].Type        = CacheUncacheable;
 
   //
-  // Set new MTRR settings
+  // Calculate and set the new MTRR settings for both ranges at once
   //
-  MtrrSetAllMtrrs (&MtrrSettings);
+  ScratchSize = 0;
+  Status = MtrrSetMemoryAttributesInMtrrSettings (NULL, NULL, &ScratchSize, MemoryRanges, ARRAY_SIZE (MemoryRanges));
+  ASSERT_EFI_ERROR (Status);
 
   PERF_END (NULL, "SetCache", NULL, 0);
 
@@ -601,6 +601,45 @@ MMCReceiveResponse (
   return EFI_SUCCESS;
 }
 
+/**
+   Moves whole blocks of card data through the system DMA controller. Sets
+   Started unless the transfer could not be set up, in which case the caller
+   may still fall back to PIO.
+**/
+STATIC
+EFI_STATUS
+MMCDmaTransfer (
+  IN  BCM2836_DMA_DIRECTION Direction,
+  IN  UINTN                 Length,
+  IN  UINT32                *Buffer,
+  OUT BOOLEAN               *Started
+  )
+{
+  EFI_STATUS Status;
+
+  *Started = FALSE;
+  if (Length < BLEN_512BYTES || (Length % BLEN_512BYTES) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  mFwProtocol->SetLed (TRUE);
+  Status = Bcm2836DmaTransfer (FixedPcdGet32 (PcdMmcDmaChannel),
+             BCM2836_DMA_DREQ_EMMC, Direction, MMCHS_DATA,
+             Buffer, Length);
+  mFwProtocol->SetLed (FALSE);
+
+  *Started = !EFI_ERROR (Status) ||
+             Status == EFI_TIMEOUT ||
+             Status == EFI_DEVICE_ERROR;
+  if (EFI_ERROR (Status)) {
+    DEBUG ((*Started ? DEBUG_ERROR : DEBUG_MMCHOST_SD,
+      "%a(%u): DMA of 0x%Lx bytes failed: %r MMCHS_INT_STAT: %08x\n",
+      __FUNCTION__, __LINE__, (UINT64)Length, Status, MmioRead32 (MMCHS_INT_STAT)));
+  }
+
+  return Status;
+}
+
 EFI_STATUS
 MMCReadBlockData (
   IN EFI_MMC_HOST_PROTOCOL    *This,
@@ -609,6 +648,8 @@ MMCReadBlockData (
   IN UINT32*                  Buffer
   )
 {
+  EFI_STATUS Status;
+  BOOLEAN Started;
   UINTN MmcStatus;
   UINTN RemLength;
   UINTN Count;
@@ -626,6 +667,12 @@ MMCReadBlockData (
     return EFI_INVALID_PARAMETER;
   }
 
+  Status = MMCDmaTransfer (Bcm2836DmaFromDevice, Length, Buffer, &Started);
+  if (Started) {
+    MmioWrite32 (MMCHS_INT_STAT, BRR);
+    return Status;
+  }
+
   RemLength = Length;
   while (RemLength != 0) {
     UINTN RetryCount = 0;
@@ -673,6 +720,8 @@ MMCWriteBlockData (
   IN UINT32*                  Buffer
   )
 {
+  EFI_STATUS Status;
+  BOOLEAN Started;
   UINTN MmcStatus;
   UINTN RemLength;
   UINTN Count;
@@ -690,6 +739,12 @@ MMCWriteBlockData (
     return EFI_INVALID_PARAMETER;
   }
 
+  Status = MMCDmaTransfer (Bcm2836DmaToDevice, Length, Buffer, &Started);
+  if (Started) {
+    MmioWrite32 (MMCHS_INT_STAT, BWR);
+    return Status;
+  }
+
   RemLength = Length;
   while (RemLength != 0) {
     UINTN RetryCount = 0;
@@ -19,6 +19,7 @@
 #include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/Bcm2836DmaLib.h>
 #include <Library/DmaLib.h>
 
 #include <Protocol/EmbeddedExternalDevice.h>
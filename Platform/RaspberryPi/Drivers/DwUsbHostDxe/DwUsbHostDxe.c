@@ -222,12 +222,117 @@ DwCoreReset (
   return EFI_SUCCESS;
 }
 
+STATIC
+EFI_STATUS
+DwHcAllocateChannel (
+  IN  DWUSB_OTGHC_DEV *DwHc,
+  OUT UINT32          *Channel
+  )
+{
+  EFI_TPL Tpl;
+  UINT32  Index;
+
+  Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  for (Index = 0; Index < DwHc->NumChannels; Index++) {
+    if ((DwHc->BusyChannels & (1U << Index)) == 0) {
+      DwHc->BusyChannels |= 1U << Index;
+      break;
+    }
+  }
+  gBS->RestoreTPL (Tpl);
+
+  if (Index == DwHc->NumChannels) {
+    DEBUG ((DEBUG_ERROR, "DwHcAllocateChannel: all %u channels busy\n",
+      DwHc->NumChannels));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *Channel = Index;
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+DwHcFreeChannel (
+  IN  DWUSB_OTGHC_DEV *DwHc,
+  IN  UINT32          Channel
+  )
+{
+  EFI_TPL Tpl;
+
+  Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  DwHc->BusyChannels &= ~(1U << Channel);
+  gBS->RestoreTPL (Tpl);
+}
+
+STATIC
+VOID
+DwHcUpdateStats (
+  IN  DWUSB_OTGHC_DEV *DwHc,
+  IN  UINT8           DeviceAddress,
+  IN  UINT32          EpAddress,
+  IN  UINT32          TransferDirection,
+  IN  UINTN           Length,
+  IN  UINT32          TransferResult,
+  IN  UINT64          StartTicks
+  )
+{
+  UINT64               EndTicks;
+  DWUSB_ENDPOINT_STATS *Stats;
+
+  if (DeviceAddress >= MAX_DEVICE || EpAddress >= MAX_ENDPOINT) {
+    return;
+  }
+
+  /*
+   * Works whichever way the counter counts.
+   */
+  EndTicks = GetPerformanceCounter ();
+  Stats = &DwHc->EndpointStats[DeviceAddress][EpAddress][TransferDirection & 1];
+  Stats->Transfers++;
+  Stats->Bytes += Length;
+  Stats->Nanoseconds += GetTimeInNanoSecond (EndTicks > StartTicks ?
+                          EndTicks - StartTicks : StartTicks - EndTicks);
+  if (TransferResult == EFI_USB_ERR_NAK) {
+    Stats->Naks++;
+  } else if (TransferResult != EFI_USB_NOERROR) {
+    Stats->Errors++;
+  }
+}
+
+STATIC
+VOID
+DwHcDumpStats (
+  IN  DWUSB_OTGHC_DEV *DwHc
+  )
+{
+  UINTN                Device;
+  UINTN                Endpoint;
+  UINTN                Direction;
+  DWUSB_ENDPOINT_STATS *Stats;
+
+  for (Device = 0; Device < MAX_DEVICE; Device++) {
+    for (Endpoint = 0; Endpoint < MAX_ENDPOINT; Endpoint++) {
+      for (Direction = 0; Direction < 2; Direction++) {
+        Stats = &DwHc->EndpointStats[Device][Endpoint][Direction];
+        if (Stats->Transfers == 0) {
+          continue;
+        }
+
+        DEBUG ((DEBUG_INFO, "DwUsb %Lu:%Lu %a: %lu xfers %lu NAKs %lu errors, "
+          "%lu bytes in %lu us\n", (UINT64)Device, (UINT64)Endpoint, Direction ? "in" : "out",
+          Stats->Transfers, Stats->Naks, Stats->Errors, Stats->Bytes,
+          DivU64x32 (Stats->Nanoseconds, 1000)));
+      }
+    }
+  }
+}
+
 STATIC
 EFI_STATUS
 DwHcTransfer (
   IN      DWUSB_OTGHC_DEV        *DwHc,
   IN      EFI_EVENT              Timeout,
-  IN      UINT32                 Channel,
   IN      EFI_USB2_HC_TRANSACTION_TRANSLATOR *Translator,
   IN      UINT8                  DeviceSpeed,
   IN      UINT8                  DeviceAddress,
@@ -248,13 +353,36 @@ DwHcTransfer (
   UINT32                          Sub;
   UINT32                          Ret = 0;
   UINT32                          StopTransfer = 0;
+  UINT32                          Channel;
+  UINT64                          StartTicks;
+  DWUSB_CHANNEL                   *Chan;
+  BOOLEAN                         Preemptible;
   EFI_STATUS                      Status = EFI_SUCCESS;
   SPLIT_CONTROL                   Split = { 0 };
-
-  EFI_TPL Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  EFI_TPL                         Tpl = TPL_APPLICATION;
 
   *TransferResult = EFI_USB_NOERROR;
 
+  Status = DwHcAllocateChannel (DwHc, &Channel);
+  if (EFI_ERROR (Status)) {
+    *TransferResult = EFI_USB_ERR_SYSTEM;
+    return Status;
+  }
+
+  Chan = &DwHc->Channels[Channel];
+  StartTicks = GetPerformanceCounter ();
+
+  /*
+   * Split transactions must follow each other closely, so don't
+   * let anything else in. A high-speed transfer owns its channel
+   * and buffer, and may be overlapped by transfers on other
+   * channels, such as the periodic schedule.
+   */
+  Preemptible = DeviceSpeed == EFI_USB_SPEED_HIGH;
+  if (!Preemptible) {
+    Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  }
+
   do {
   RestartXfer:
     if (DeviceSpeed == EFI_USB_SPEED_LOW ||
@@ -287,13 +415,13 @@ DwHcTransfer (
     if (TransferDirection) { // in
       TxferLen = NumPackets * MaximumPacketLength;
     } else {
-      CopyMem (DwHc->AlignedBuffer, Data + Done, TxferLen);
+      CopyMem (Chan->Buffer, Data + Done, TxferLen);
       ArmDataSynchronizationBarrier ();
     }
 
   RestartChannel:
     MmioWrite32 (DwHc->DwUsbBase + HCDMA (Channel),
-      (UINTN)DwHc->AlignedBufferBusAddress);
+      (UINT32)Chan->BufferBusAddress);
 
     DwOtgHcInit (DwHc, Channel, Translator, DeviceSpeed,
       DeviceAddress, EpAddress,
@@ -368,7 +496,7 @@ DwHcTransfer (
     if (TransferDirection) { // in
       ArmDataSynchronizationBarrier ();
       TxferLen -= Sub;
-      CopyMem (Data + Done, DwHc->AlignedBuffer, TxferLen);
+      CopyMem (Data + Done, Chan->Buffer, TxferLen);
       if (Sub) {
         StopTransfer = 1;
       }
@@ -382,13 +510,36 @@ DwHcTransfer (
 
   *DataLength = Done;
 
-  gBS->RestoreTPL (Tpl);
+  if (!Preemptible) {
+    gBS->RestoreTPL (Tpl);
+  }
+
+  DwHcFreeChannel (DwHc, Channel);
+  DwHcUpdateStats (DwHc, DeviceAddress, EpAddress, TransferDirection,
+    Done, *TransferResult, StartTicks);
 
   ASSERT (!EFI_ERROR (Status) || *TransferResult != EFI_USB_NOERROR);
 
   return Status;
 }
 
+/*
+ * Must be called at TPL_NOTIFY.
+ */
+STATIC
+VOID
+DwHcScheduleDeferredTransfer (
+  IN  DWUSB_OTGHC_DEV    *DwHc,
+  IN  DWUSB_DEFERRED_REQ *Req,
+  IN  UINTN              TargetFrame
+  )
+{
+  Req->TargetFrame = (UINT32)TargetFrame;
+  RemoveEntryList (&Req->ScheduleLink);
+  InsertTailList (&DwHc->PeriodicSchedule[TargetFrame % PERIODIC_SCHEDULE_SIZE],
+    &Req->ScheduleLink);
+}
+
 STATIC
 DWUSB_DEFERRED_REQ *
 DwHcFindDeferredTransfer (
@@ -436,7 +587,7 @@ DwHcDeferredTransfer (
 
   Req->TransferResult = EFI_USB_NOERROR;
   Status = DwHcTransfer (Req->DwHc, TimeoutEvt,
-             Req->Channel, Req->Translator,
+             Req->Translator,
              Req->DeviceSpeed, Req->DeviceAddress,
              Req->MaximumPacketLength, &Req->Pid,
              Req->TransferDirection, Req->Data, &Req->DataLength,
@@ -851,7 +1002,7 @@ DwHcControlTransfer (
   Pid = DWC2_HC_PID_SETUP;
   Length = 8;
   Status = DwHcTransfer (DwHc, TimeoutEvt,
-             DWC2_HC_CHANNEL, Translator, DeviceSpeed,
+             Translator, DeviceSpeed,
              DeviceAddress, MaximumPacketLength, &Pid, 0,
              Request, &Length, 0, DWC2_HCCHAR_EPTYPE_CONTROL,
              TransferResult, 1);
@@ -872,7 +1023,7 @@ DwHcControlTransfer (
     }
 
     Status = DwHcTransfer (DwHc, TimeoutEvt,
-               DWC2_HC_CHANNEL, Translator, DeviceSpeed,
+               Translator, DeviceSpeed,
                DeviceAddress, MaximumPacketLength, &Pid,
                Direction, Data, DataLength, 0,
                DWC2_HCCHAR_EPTYPE_CONTROL,
@@ -895,7 +1046,7 @@ DwHcControlTransfer (
   Pid = DWC2_HC_PID_DATA1;
   Length = 0;
   Status = DwHcTransfer (DwHc, TimeoutEvt,
-             DWC2_HC_CHANNEL, Translator, DeviceSpeed,
+             Translator, DeviceSpeed,
              DeviceAddress, MaximumPacketLength, &Pid,
              StatusDirection, DwHc->StatusBuffer, &Length, 0,
              DWC2_HCCHAR_EPTYPE_CONTROL, TransferResult, 1);
@@ -985,7 +1136,7 @@ DwHcBulkTransfer (
   Pid = (*DataToggle << 1);
 
   Status = DwHcTransfer (DwHc, TimeoutEvt,
-             DWC2_HC_CHANNEL_BULK, Translator, DeviceSpeed,
+             Translator, DeviceSpeed,
              DeviceAddress, MaximumPacketLength, &Pid,
              TransferDirection, Data[0], DataLength, EpAddress,
              DWC2_HCCHAR_EPTYPE_BULK, TransferResult, 1);
@@ -1071,6 +1222,7 @@ DwHcAsyncInterruptTransfer (
     FreePool (FoundReq->Data);
 
     RemoveEntryList (&FoundReq->List);
+    RemoveEntryList (&FoundReq->ScheduleLink);
     FreePool (FoundReq);
 
     Status = EFI_SUCCESS;
@@ -1092,13 +1244,11 @@ DwHcAsyncInterruptTransfer (
   }
 
   InitializeListHead (&NewReq->List);
+  InitializeListHead (&NewReq->ScheduleLink);
 
   NewReq->FrameInterval = PollingInterval;
-  NewReq->TargetFrame = DwHc->CurrentFrame +
-    NewReq->FrameInterval;
 
   NewReq->DwHc = DwHc;
-  NewReq->Channel = DWC2_HC_CHANNEL_ASYNC;
   NewReq->Translator = Translator;
   NewReq->DeviceSpeed = DeviceSpeed;
   NewReq->DeviceAddress = DeviceAddress;
@@ -1115,6 +1265,8 @@ DwHcAsyncInterruptTransfer (
   NewReq->TimeOut = 1000; /* 1000 ms */
 
   InsertTailList (&DwHc->DeferredList, &NewReq->List);
+  DwHcScheduleDeferredTransfer (DwHc, NewReq,
+    DwHc->CurrentFrame + NewReq->FrameInterval);
   Status = EFI_SUCCESS;
 
 Done:
@@ -1188,8 +1340,7 @@ DwHcSyncInterruptTransfer (
   EpAddress = EndPointAddress & 0x0F;
   Pid = (*DataToggle << 1);
   Status = DwHcTransfer (DwHc, TimeoutEvt,
-             DWC2_HC_CHANNEL_SYNC, Translator,
-             DeviceSpeed, DeviceAddress,
+             Translator, DeviceSpeed, DeviceAddress,
              MaximumPacketLength,
              &Pid, TransferDirection, Data,
              DataLength, EpAddress,
@@ -1328,11 +1479,7 @@ DwHcInit (
   DwFlushTxFifo (DwHc, Timeout, 0x10);
   DwFlushRxFifo (DwHc, Timeout);
 
-  NumChannels = MmioRead32 (DwHc->DwUsbBase + GHWCFG2);
-  NumChannels &= DWC2_HWCFG2_NUM_HOST_CHAN_MASK;
-  NumChannels >>= DWC2_HWCFG2_NUM_HOST_CHAN_OFFSET;
-  NumChannels += 1;
-  DEBUG ((DEBUG_INFO, "Host has %u channels\n", NumChannels));
+  NumChannels = DwHc->NumChannels;
 
   for (i = 0; i < NumChannels; i++)
     MmioAndThenOr32 (DwHc->DwUsbBase + HCCHAR (i),
@@ -1419,6 +1566,7 @@ DestroyDwUsbHc (
   )
 {
   UINT32 Pages;
+  UINT32 Index;
   EFI_TPL PreviousTpl;
 
   if (DwHc == NULL) {
@@ -1436,8 +1584,14 @@ DestroyDwUsbHc (
   }
 
   Pages = EFI_SIZE_TO_PAGES (DWC2_DATA_BUF_SIZE);
-  DmaUnmap (DwHc->AlignedBufferMapping);
-  DmaFreeBuffer (Pages, DwHc->AlignedBuffer);
+  for (Index = 0; Index < MAX_CHANNEL; Index++) {
+    if (DwHc->Channels[Index].BufferMapping != NULL) {
+      DmaUnmap (DwHc->Channels[Index].BufferMapping);
+    }
+    if (DwHc->Channels[Index].Buffer != NULL) {
+      DmaFreeBuffer (Pages, DwHc->Channels[Index].Buffer);
+    }
+  }
 
   Pages = EFI_SIZE_TO_PAGES (DWC2_STATUS_BUF_SIZE);
   FreePages (DwHc->StatusBuffer, Pages);
@@ -1499,7 +1653,9 @@ DwHcPeriodicHandler (
   IN VOID      *Context
   )
 {
-  UINT32 Frame;
+  UINTN Frame;
+  UINTN Slot;
+  UINTN Slots;
   LIST_ENTRY *Entry;
   LIST_ENTRY *NextEntry;
   DWUSB_OTGHC_DEV *DwHc = Context;
@@ -1507,15 +1663,25 @@ DwHcPeriodicHandler (
   DwHc->CurrentFrame += FramesPassed (DwHc);
   Frame = DwHc->CurrentFrame;
 
-  EFI_LIST_FOR_EACH_SAFE (Entry, NextEntry,
-    &DwHc->DeferredList) {
-    DWUSB_DEFERRED_REQ *Req = EFI_LIST_CONTAINER (Entry, DWUSB_DEFERRED_REQ, List);
-
-    if (Frame >= Req->TargetFrame) {
-      Req->TargetFrame = Frame + Req->FrameInterval;
-      DwHcDeferredTransfer (Req);
+  /*
+   * Only look at the slots for the frames that passed since
+   * the last tick. A request rescheduled into a slot that is
+   * yet to be visited is not due until a later tick.
+   */
+  Slots = MIN (Frame - DwHc->ScheduledFrame, PERIODIC_SCHEDULE_SIZE);
+  for (Slot = Frame - Slots + 1; Slot <= Frame; Slot++) {
+    EFI_LIST_FOR_EACH_SAFE (Entry, NextEntry,
+      &DwHc->PeriodicSchedule[Slot % PERIODIC_SCHEDULE_SIZE]) {
+      DWUSB_DEFERRED_REQ *Req = EFI_LIST_CONTAINER (Entry, DWUSB_DEFERRED_REQ, ScheduleLink);
+
+      if (Frame >= Req->TargetFrame) {
+        DwHcScheduleDeferredTransfer (DwHc, Req, Frame + Req->FrameInterval);
+        DwHcDeferredTransfer (Req);
+      }
     }
   }
+
+  DwHc->ScheduledFrame = Frame;
 }
 
 EFI_STATUS
@@ -1524,7 +1690,9 @@ CreateDwUsbHc (
   )
 {
   DWUSB_OTGHC_DEV *DwHc;
+  DWUSB_CHANNEL   *Chan;
   UINT32          Pages;
+  UINT32          Index;
   UINTN           BufferSize;
   EFI_STATUS      Status;
 
@@ -1558,22 +1726,34 @@ CreateDwUsbHc (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  DwHc->NumChannels = MmioRead32 (DwHc->DwUsbBase + GHWCFG2);
+  DwHc->NumChannels &= DWC2_HWCFG2_NUM_HOST_CHAN_MASK;
+  DwHc->NumChannels >>= DWC2_HWCFG2_NUM_HOST_CHAN_OFFSET;
+  DwHc->NumChannels = MIN (DwHc->NumChannels + 1, MAX_CHANNEL);
+  DEBUG ((DEBUG_INFO, "Host has %u channels\n", DwHc->NumChannels));
+
   Pages = EFI_SIZE_TO_PAGES (DWC2_DATA_BUF_SIZE);
-  Status = DmaAllocateBuffer (EfiBootServicesData, Pages, (VOID**)&DwHc->AlignedBuffer);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "CreateDwUsbHc: DmaAllocateBuffer: %r\n", Status));
-    return Status;
-  }
+  for (Index = 0; Index < DwHc->NumChannels; Index++) {
+    Chan = &DwHc->Channels[Index];
+    Status = DmaAllocateBuffer (EfiBootServicesData, Pages, (VOID**)&Chan->Buffer);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "CreateDwUsbHc: DmaAllocateBuffer: %r\n", Status));
+      return Status;
+    }
 
-  BufferSize = EFI_PAGES_TO_SIZE (Pages);
-  Status = DmaMap (MapOperationBusMasterCommonBuffer, DwHc->AlignedBuffer, &BufferSize,
-             &DwHc->AlignedBufferBusAddress, &DwHc->AlignedBufferMapping);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "CreateDwUsbHc: DmaMap: %r\n", Status));
-    return Status;
+    BufferSize = EFI_PAGES_TO_SIZE (Pages);
+    Status = DmaMap (MapOperationBusMasterCommonBuffer, Chan->Buffer, &BufferSize,
+               &Chan->BufferBusAddress, &Chan->BufferMapping);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "CreateDwUsbHc: DmaMap: %r\n", Status));
+      return Status;
+    }
   }
 
   InitializeListHead (&DwHc->DeferredList);
+  for (Index = 0; Index < PERIODIC_SCHEDULE_SIZE; Index++) {
+    InitializeListHead (&DwHc->PeriodicSchedule[Index]);
+  }
 
   Status = gBS->CreateEventEx (
                   EVT_NOTIFY_SIGNAL,
@@ -1624,6 +1804,8 @@ DwHcQuiesce (
     gBS->RestoreTPL (PreviousTpl);
   }
 
+  DwHcDumpStats (DwHc);
+
   MmioAndThenOr32 (DwHc->DwUsbBase + HPRT0,
     ~(DWC2_HPRT0_PRTENA | DWC2_HPRT0_PRTCONNDET |
       DWC2_HPRT0_PRTENCHNG | DWC2_HPRT0_PRTOVRCURRCHNG),
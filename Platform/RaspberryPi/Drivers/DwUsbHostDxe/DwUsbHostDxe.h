@@ -38,6 +38,14 @@
 
 #define MAX_DEVICE                      16
 #define MAX_ENDPOINT                    16
+#define MAX_CHANNEL                     16
+
+/*
+ * Periodic schedule slots, one per 1ms frame. Must be larger than
+ * the longest interrupt polling interval (255ms), so that a request
+ * is never due in more than one slot.
+ */
+#define PERIODIC_SCHEDULE_SIZE          256
 
 #define DWUSB_OTGHC_DEV_SIGNATURE       SIGNATURE_32 ('d', 'w', 'h', 'c')
 #define DWHC_FROM_THIS(a)               CR(a, DWUSB_OTGHC_DEV, DwUsbOtgHc, DWUSB_OTGHC_DEV_SIGNATURE)
@@ -73,8 +81,8 @@ typedef struct {
 
 typedef struct _DWUSB_DEFERRED_REQ {
   IN OUT LIST_ENTRY                         List;
+  IN OUT LIST_ENTRY                         ScheduleLink;
   IN     struct _DWUSB_OTGHC_DEV            *DwHc;
-  IN     UINT32                             Channel;
   IN     UINT32                             FrameInterval;
   IN     UINT32                             TargetFrame;
   IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR *Translator;
@@ -94,6 +102,24 @@ typedef struct _DWUSB_DEFERRED_REQ {
   IN     UINTN                              TimeOut;
 } DWUSB_DEFERRED_REQ;
 
+/*
+ * Each host channel owns a bounce buffer, so transfers on
+ * different channels can be in flight at the same time.
+ */
+typedef struct {
+  UINT8                           *Buffer;
+  VOID                            *BufferMapping;
+  EFI_PHYSICAL_ADDRESS            BufferBusAddress;
+} DWUSB_CHANNEL;
+
+typedef struct {
+  UINT64                          Transfers;
+  UINT64                          Naks;
+  UINT64                          Errors;
+  UINT64                          Bytes;
+  UINT64                          Nanoseconds;
+} DWUSB_ENDPOINT_STATS;
+
 typedef struct _DWUSB_OTGHC_DEV {
   UINTN                           Signature;
 
@@ -108,18 +134,29 @@ typedef struct _DWUSB_OTGHC_DEV {
   EFI_PHYSICAL_ADDRESS            DwUsbBase;
   UINT8                           *StatusBuffer;
 
-  UINT8                           *AlignedBuffer;
-  VOID *                          AlignedBufferMapping;
-  UINTN                           AlignedBufferBusAddress;
+  UINT32                          NumChannels;
+  UINT32                          BusyChannels;
+  DWUSB_CHANNEL                   Channels[MAX_CHANNEL];
+
   LIST_ENTRY                      DeferredList;
+  /*
+   * Deferred requests, by the slot of the frame they are next due in.
+   */
+  LIST_ENTRY                      PeriodicSchedule[PERIODIC_SCHEDULE_SIZE];
   /*
    * 1ms frames.
    */
   UINTN                           CurrentFrame;
+  UINTN                           ScheduledFrame;
   /*
    * 125us frames;
    */
   UINT16                          LastMicroFrame;
+
+  /*
+   * Indexed by device address, endpoint number and direction.
+   */
+  DWUSB_ENDPOINT_STATS            EndpointStats[MAX_DEVICE][MAX_ENDPOINT][2];
 } DWUSB_OTGHC_DEV;
 
 extern EFI_COMPONENT_NAME_PROTOCOL  gComponentName;
@@ -13,10 +13,14 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseLib.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
 
 #include "Mmc.h"
 
 #define DIAGNOSTIC_LOGBUFFER_MAXCHAR  1024
+#define DIAGNOSTIC_THROUGHPUT_SIZE    SIZE_1MB
+#define DIAGNOSTIC_THROUGHPUT_PASSES  8
 
 CHAR16* mLogBuffer = NULL;
 UINTN   mLogRemainChar = 0;
@@ -168,6 +172,87 @@ MmcReadWriteDataTest (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+MmcReadThroughputTest (
+  MMC_HOST_INSTANCE *MmcHostInstance
+  )
+{
+  VOID                        *Buffer;
+  UINTN                       BufferSize;
+  UINTN                       Pass;
+  UINT64                      Start;
+  UINT64                      End;
+  UINT64                      CounterStart;
+  UINT64                      CounterEnd;
+  UINT64                      ElapsedNs;
+  UINT64                      KiBPerSecond;
+  CHAR16                      Line[80];
+  EFI_STATUS                  Status;
+
+  if (!MmcHostInstance->BlockIo.Media->MediaPresent) {
+    DiagnosticLog (L"ERROR: No Media Present\n");
+    return EFI_NO_MEDIA;
+  }
+
+  if (MmcHostInstance->State != MmcTransferState) {
+    DiagnosticLog (L"ERROR: Not ready for Transfer state\n");
+    return EFI_NOT_READY;
+  }
+
+  BufferSize = DIAGNOSTIC_THROUGHPUT_SIZE;
+  if (BufferSize / MmcHostInstance->BlockIo.Media->BlockSize >
+      MmcHostInstance->BlockIo.Media->LastBlock) {
+    BufferSize = (UINTN)MmcHostInstance->BlockIo.Media->LastBlock *
+                 MmcHostInstance->BlockIo.Media->BlockSize;
+  }
+
+  Buffer = AllocatePool (BufferSize);
+  if (Buffer == NULL) {
+    DiagnosticLog (L"ERROR: Out of memory\n");
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_SUCCESS;
+  Start = GetPerformanceCounter ();
+  for (Pass = 0; Pass < DIAGNOSTIC_THROUGHPUT_PASSES; Pass++) {
+    Status = MmcReadBlocks (&(MmcHostInstance->BlockIo),
+               MmcHostInstance->BlockIo.Media->MediaId, 0, BufferSize, Buffer);
+    if (Status != EFI_SUCCESS) {
+      DiagnosticLog (L"ERROR: Fail to Read Block\n");
+      break;
+    }
+  }
+  End = GetPerformanceCounter ();
+  FreePool (Buffer);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // The counter may count down.
+  //
+  GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+  if (CounterStart > CounterEnd) {
+    ElapsedNs = GetTimeInNanoSecond (Start - End);
+  } else {
+    ElapsedNs = GetTimeInNanoSecond (End - Start);
+  }
+
+  if (ElapsedNs == 0) {
+    ElapsedNs = 1;
+  }
+
+  KiBPerSecond = DivU64x64Remainder (
+                   MultU64x32 ((UINT64)BufferSize * DIAGNOSTIC_THROUGHPUT_PASSES, 1000000000 / SIZE_1KB),
+                   ElapsedNs, NULL);
+  UnicodeSPrint (Line, sizeof (Line), L"Read %Lu KiB x %u: %Lu KiB/s\n",
+    (UINT64)(BufferSize / SIZE_1KB), DIAGNOSTIC_THROUGHPUT_PASSES, KiBPerSecond);
+  DiagnosticLog (Line);
+
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 EFIAPI
 MmcDriverDiagnosticsRunDiagnostics (
@@ -245,6 +330,10 @@ MmcDriverDiagnosticsRunDiagnostics (
   DiagnosticLog (L"MMC Driver Diagnostics - Test: First Block / 2 BlockSSize\n");
   Status = MmcReadWriteDataTest (MmcHostInstance, 1, 2 * MmcHostInstance->BlockIo.Media->BlockSize);
 
+  // LBA=0 Size=1MB, repeatedly
+  DiagnosticLog (L"MMC Driver Diagnostics - Test: Read Throughput\n");
+  Status = MmcReadThroughputTest (MmcHostInstance);
+
   return Status;
 }
 
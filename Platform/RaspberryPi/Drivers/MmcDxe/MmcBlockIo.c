@@ -7,12 +7,18 @@
  **/
 
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
 
 #include "Mmc.h"
 
 #define MMCI0_BLOCKLEN 512
 #define MMCI0_TIMEOUT  1000
 
+//
+// How often queued BlockIo2 requests are serviced, in 100ns units.
+//
+#define MMC_REQUEST_PERIOD  (10 * 1000)
+
 STATIC
 EFI_STATUS
 R1TranAndReady (
@@ -314,35 +320,28 @@ MmcTransferBlock (
   return Status;
 }
 
+STATIC
 EFI_STATUS
-MmcIoBlocks (
+MmcValidateIo (
   IN EFI_BLOCK_IO_PROTOCOL    *This,
   IN UINTN                    Transfer,
   IN UINT32                   MediaId,
   IN EFI_LBA                  Lba,
   IN UINTN                    BufferSize,
-  OUT VOID                    *Buffer
+  IN VOID                     *Buffer
   )
 {
-  EFI_STATUS              Status;
-  UINTN                   Cmd;
   MMC_HOST_INSTANCE       *MmcHostInstance;
-  EFI_MMC_HOST_PROTOCOL   *MmcHost;
-  UINTN                   BytesRemainingToBeTransfered;
-  UINTN                   BlockCount;
-  UINTN                   ConsumeSize;
 
-  BlockCount = 1;
   MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
   ASSERT (MmcHostInstance != NULL);
-  MmcHost = MmcHostInstance->MmcHost;
-  ASSERT (MmcHost);
+  ASSERT (MmcHostInstance->MmcHost);
 
   if (This->Media->MediaId != MediaId) {
     return EFI_MEDIA_CHANGED;
   }
 
-  if ((MmcHost == NULL) || (Buffer == NULL)) {
+  if ((MmcHostInstance->MmcHost == NULL) || (Buffer == NULL)) {
     return EFI_INVALID_PARAMETER;
   }
 
@@ -351,12 +350,6 @@ MmcIoBlocks (
     return EFI_NO_MEDIA;
   }
 
-  if (PcdGet32 (PcdMmcDisableMulti) == 0 &&
-      MMC_HOST_HAS_ISMULTIBLOCK (MmcHost) &&
-      MmcHost->IsMultiBlock (MmcHost)) {
-    BlockCount = (BufferSize + This->Media->BlockSize - 1) / This->Media->BlockSize;
-  }
-
   // All blocks must be within the device
   if ((Lba + (BufferSize / This->Media->BlockSize)) > (This->Media->LastBlock + 1)) {
     return EFI_INVALID_PARAMETER;
@@ -381,14 +374,55 @@ MmcIoBlocks (
     return EFI_INVALID_PARAMETER;
   }
 
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+MmcDoIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  )
+{
+  EFI_STATUS              Status;
+  UINTN                   Cmd;
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+  UINTN                   BytesRemainingToBeTransfered;
+  UINTN                   BlockCount;
+  UINTN                   ConsumeSize;
+
+  Status = MmcValidateIo (This, Transfer, MediaId, Lba, BufferSize, Buffer);
+  if (EFI_ERROR (Status) || BufferSize == 0) {
+    return Status;
+  }
+
+  BlockCount = 1;
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
+  MmcHost = MmcHostInstance->MmcHost;
+
+  if (PcdGet32 (PcdMmcDisableMulti) == 0 &&
+      MMC_HOST_HAS_ISMULTIBLOCK (MmcHost) &&
+      MmcHost->IsMultiBlock (MmcHost)) {
+    BlockCount = (BufferSize + This->Media->BlockSize - 1) / This->Media->BlockSize;
+  }
+
+  //
+  // MmcTransferBlock leaves the card in TRAN, so only the first
+  // chunk needs to wait for it.
+  //
+  Status = WaitUntilTran (MmcHostInstance);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "WaitUntilTran before IO failed"));
+    return Status;
+  }
+
   BytesRemainingToBeTransfered = BufferSize;
   while (BytesRemainingToBeTransfered > 0) {
-    Status = WaitUntilTran (MmcHostInstance);
-    if (EFI_ERROR (Status)) {
-      DEBUG ((DEBUG_ERROR, "WaitUntilTran before IO failed"));
-      return Status;
-    }
-
     if (Transfer == MMC_IOBLOCKS_READ) {
       if (BlockCount == 1) {
         // Read a single block
@@ -420,7 +454,7 @@ MmcIoBlocks (
 
     BytesRemainingToBeTransfered -= ConsumeSize;
     if (BytesRemainingToBeTransfered > 0) {
-      Lba += BlockCount;
+      Lba += ConsumeSize / This->Media->BlockSize;
       Buffer = (UINT8*)Buffer + ConsumeSize;
     }
   }
@@ -428,6 +462,219 @@ MmcIoBlocks (
   return EFI_SUCCESS;
 }
 
+STATIC
+VOID
+MmcCompleteRequest (
+  IN MMC_BLOCK_IO2_REQUEST  *Request,
+  IN EFI_STATUS             Status
+  )
+{
+  Request->Token->TransactionStatus = Status;
+  gBS->SignalEvent (Request->Token->Event);
+  FreePool (Request);
+}
+
+STATIC
+VOID
+MmcServiceRequest (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  EFI_STATUS            Status;
+  MMC_BLOCK_IO2_REQUEST *Request;
+
+  Request = MMC_BLOCK_IO2_REQUEST_FROM_LINK (GetFirstNode (&MmcHostInstance->RequestQueue));
+  RemoveEntryList (&Request->Link);
+
+  if (Request->Transfer == MMC_IOBLOCKS_FLUSH) {
+    Status = EFI_SUCCESS;
+  } else {
+    Status = MmcDoIoBlocks (&MmcHostInstance->BlockIo, Request->Transfer,
+               Request->MediaId, Request->Lba, Request->BufferSize,
+               Request->Buffer);
+  }
+
+  MmcCompleteRequest (Request, Status);
+}
+
+/**
+  Services the oldest queued BlockIo2 request. Only one request is handled
+  per timer tick, so that the caller gets to run between transfers.
+**/
+VOID
+EFIAPI
+MmcProcessRequests (
+  IN  EFI_EVENT   Event,
+  IN  VOID        *Context
+  )
+{
+  MMC_HOST_INSTANCE *MmcHostInstance;
+
+  MmcHostInstance = Context;
+
+  if (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    MmcServiceRequest (MmcHostInstance);
+  }
+
+  if (IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    gBS->SetTimer (MmcHostInstance->RequestEvent, TimerCancel, 0);
+  }
+}
+
+/**
+  Completes all queued BlockIo2 requests. Must be called at TPL_CALLBACK.
+**/
+STATIC
+VOID
+MmcDrainRequests (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  while (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    MmcServiceRequest (MmcHostInstance);
+  }
+
+  gBS->SetTimer (MmcHostInstance->RequestEvent, TimerCancel, 0);
+}
+
+VOID
+MmcAbortRequests (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  EFI_TPL               OldTpl;
+  MMC_BLOCK_IO2_REQUEST *Request;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  while (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    Request = MMC_BLOCK_IO2_REQUEST_FROM_LINK (GetFirstNode (&MmcHostInstance->RequestQueue));
+    RemoveEntryList (&Request->Link);
+    MmcCompleteRequest (Request, EFI_ABORTED);
+  }
+
+  gBS->SetTimer (MmcHostInstance->RequestEvent, TimerCancel, 0);
+  gBS->RestoreTPL (OldTpl);
+}
+
+STATIC
+EFI_STATUS
+MmcQueueRequest (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN EFI_BLOCK_IO2_TOKEN      *Token,
+  IN UINTN                    BufferSize,
+  IN VOID                     *Buffer
+  )
+{
+  EFI_STATUS            Status;
+  EFI_TPL               OldTpl;
+  MMC_BLOCK_IO2_REQUEST *Request;
+
+  Request = AllocatePool (sizeof (MMC_BLOCK_IO2_REQUEST));
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Request->Signature = MMC_BLOCK_IO2_REQUEST_SIGNATURE;
+  Request->Transfer = Transfer;
+  Request->MediaId = MediaId;
+  Request->Lba = Lba;
+  Request->BufferSize = BufferSize;
+  Request->Buffer = Buffer;
+  Request->Token = Token;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Status = EFI_SUCCESS;
+  if (IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    Status = gBS->SetTimer (MmcHostInstance->RequestEvent, TimerPeriodic,
+                    MMC_REQUEST_PERIOD);
+  }
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Request);
+  } else {
+    Token->TransactionStatus = EFI_NOT_READY;
+    InsertTailList (&MmcHostInstance->RequestQueue, &Request->Link);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+EFI_STATUS
+MmcIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  )
+{
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
+
+  //
+  // Keep the BlockIo2 request timer off the host while we use it, and
+  // complete anything queued ahead of us first.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequests (MmcHostInstance);
+  if (Transfer == MMC_IOBLOCKS_FLUSH) {
+    Status = EFI_SUCCESS;
+  } else {
+    Status = MmcDoIoBlocks (This, Transfer, MediaId, Lba, BufferSize, Buffer);
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+MmcIoBlocksEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN  *Token,
+  IN UINTN                    BufferSize,
+  IN VOID                     *Buffer
+  )
+{
+  EFI_STATUS              Status;
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  if (Token == NULL || Token->Event == NULL) {
+    return MmcIoBlocks (&MmcHostInstance->BlockIo, Transfer, MediaId, Lba,
+             BufferSize, Buffer);
+  }
+
+  Status = MmcValidateIo (&MmcHostInstance->BlockIo, Transfer, MediaId, Lba,
+             BufferSize, Buffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (BufferSize == 0) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+    return EFI_SUCCESS;
+  }
+
+  return MmcQueueRequest (MmcHostInstance, Transfer, MediaId, Lba, Token,
+           BufferSize, Buffer);
+}
+
 EFI_STATUS
 EFIAPI
 MmcReadBlocks (
@@ -462,3 +709,74 @@ MmcFlushBlocks (
 {
   return EFI_SUCCESS;
 }
+
+EFI_STATUS
+EFIAPI
+MmcResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN BOOLEAN                  ExtendedVerification
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  MmcAbortRequests (MmcHostInstance);
+  return MmcReset (&MmcHostInstance->BlockIo, ExtendedVerification);
+}
+
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN  *Token,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  )
+{
+  return MmcIoBlocksEx (This, MMC_IOBLOCKS_READ, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN  *Token,
+  IN UINTN                    BufferSize,
+  IN VOID                     *Buffer
+  )
+{
+  return MmcIoBlocksEx (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN  *Token
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  if (!MmcHostInstance->BlockIo.Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+
+  //
+  // Writes complete before they are signaled, so a flush only needs
+  // to wait for the requests queued ahead of it.
+  //
+  if (Token == NULL || Token->Event == NULL) {
+    return MmcIoBlocks (&MmcHostInstance->BlockIo, MMC_IOBLOCKS_FLUSH,
+             0, 0, 0, NULL);
+  }
+
+  return MmcQueueRequest (MmcHostInstance, MMC_IOBLOCKS_FLUSH,
+           0, 0, Token, 0, NULL);
+}
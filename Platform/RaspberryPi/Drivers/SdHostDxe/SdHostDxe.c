@@ -16,6 +16,7 @@
 #include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/Bcm2836DmaLib.h>
 #include <Library/DmaLib.h>
 #include <Library/TimerLib.h>
 
@@ -42,6 +43,12 @@
 
 #define IDENT_MODE_SD_CLOCK_FREQ_HZ         400000 // 400KHz
 
+//
+// SdHost doesn't raise DREQ reliably for the last few words of a
+// multi-block read, so these are always drained from the FIFO by PIO.
+//
+#define SDHOST_DMA_READ_DRAIN_WORDS         4
+
 // Macros adopted from MmcDxe internal header
 #define SDHOST_R0_READY_FOR_DATA            BIT8
 #define SDHOST_R0_CURRENTSTATE(Response)    ((Response >> 9) & 0xF)
@@ -495,6 +502,52 @@ SdReceiveResponse (
   return EFI_SUCCESS;
 }
 
+STATIC BOOLEAN
+SdUseDma (
+  IN UINTN Length
+  )
+{
+  //
+  // Only whole blocks of card data, not the short register reads
+  // (SCR, SSR, switch status...) that also come through here.
+  //
+  return Length >= SDHOST_BLOCK_BYTE_LENGTH &&
+         (Length % SDHOST_BLOCK_BYTE_LENGTH) == 0;
+}
+
+STATIC EFI_STATUS
+SdDmaTransfer (
+  IN BCM2836_DMA_DIRECTION    Direction,
+  IN UINTN                    Length,
+  IN UINT32*                  Buffer,
+  OUT BOOLEAN                 *Started
+  )
+{
+  EFI_STATUS Status;
+
+  Status = Bcm2836DmaTransfer (FixedPcdGet32 (PcdMmcDmaChannel),
+             BCM2836_DMA_DREQ_SDHOST, Direction, SDHOST_DATA,
+             Buffer, Length);
+
+  //
+  // Timeouts and controller errors happen with the transfer under way,
+  // anything else means PIO can still be used instead.
+  //
+  *Started = !EFI_ERROR (Status) ||
+             Status == EFI_TIMEOUT ||
+             Status == EFI_DEVICE_ERROR;
+  if (EFI_ERROR (Status)) {
+    DEBUG ((*Started ? DEBUG_MMCHOST_SD_ERROR : DEBUG_MMCHOST_SD,
+      "SdHost: DMA of 0x%Lx bytes failed: %r\n", (UINT64)Length, Status));
+    if (*Started) {
+      SdHostDumpStatus ();
+      MmioWrite32 (SDHOST_HSTS, SDHOST_HSTS_CLEAR);
+    }
+  }
+
+  return Status;
+}
+
 STATIC EFI_STATUS
 SdReadBlockData (
   IN EFI_MMC_HOST_PROTOCOL    *This,
@@ -514,9 +567,23 @@ SdReadBlockData (
   mFwProtocol->SetLed (TRUE);
   {
     UINT32 NumWords = Length / 4;
-    UINT32 WordIdx;
+    UINT32 WordIdx = 0;
+
+    if (SdUseDma (Length)) {
+      BOOLEAN Started;
+
+      Status = SdDmaTransfer (Bcm2836DmaFromDevice,
+                 Length - SDHOST_DMA_READ_DRAIN_WORDS * 4, Buffer, &Started);
+      if (!EFI_ERROR (Status)) {
+        WordIdx = NumWords - SDHOST_DMA_READ_DRAIN_WORDS;
+      } else if (Started) {
+        mFwProtocol->SetLed (FALSE);
+        return Status;
+      }
+      Status = EFI_SUCCESS;
+    }
 
-    for (WordIdx = 0; WordIdx < NumWords; ++WordIdx) {
+    for (; WordIdx < NumWords; ++WordIdx) {
       UINT32 PollCount = 0;
       while (PollCount < FIFO_MAX_POLL_COUNT) {
         UINT32 Hsts = MmioRead32 (SDHOST_HSTS);
@@ -565,9 +632,20 @@ SdWriteBlockData (
   mFwProtocol->SetLed (TRUE);
   {
     UINT32 NumWords = Length / 4;
-    UINT32 WordIdx;
+    UINT32 WordIdx = 0;
+
+    if (SdUseDma (Length)) {
+      BOOLEAN Started;
+
+      Status = SdDmaTransfer (Bcm2836DmaToDevice, Length, Buffer, &Started);
+      if (!EFI_ERROR (Status) || Started) {
+        mFwProtocol->SetLed (FALSE);
+        return Status;
+      }
+      Status = EFI_SUCCESS;
+    }
 
-    for (WordIdx = 0; WordIdx < NumWords; ++WordIdx) {
+    for (; WordIdx < NumWords; ++WordIdx) {
       UINT32 PollCount = 0;
       while (PollCount < FIFO_MAX_POLL_COUNT) {
         if (MmioRead32 (SDHOST_HSTS) & SDHOST_HSTS_DATA_FLAG) {
@@ -30,6 +30,56 @@ FileWrite (
 }
 
 
+EFI_STATUS
+FileRead (
+  IN EFI_FILE_PROTOCOL *File,
+  IN UINTN Offset,
+  IN UINTN Buffer,
+  IN UINTN Size
+  )
+{
+  EFI_STATUS Status;
+  UINTN ReadSize;
+
+  Status = File->SetPosition (File, Offset);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ReadSize = Size;
+  Status = File->Read (File, &ReadSize, (VOID*)Buffer);
+  if (!EFI_ERROR (Status) && ReadSize != Size) {
+    //
+    // The file is shorter than expected.
+    //
+    Status = EFI_END_OF_FILE;
+  }
+  return Status;
+}
+
+
+EFI_STATUS
+FileDelete (
+  IN EFI_DEVICE_PATH_PROTOCOL *Device,
+  IN CHAR16 *MappedFile
+  )
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *File;
+
+  Status = FileOpen (Device, MappedFile, &File,
+             EFI_FILE_MODE_WRITE | EFI_FILE_MODE_READ);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Delete closes the handle, even when it fails.
+  //
+  return File->Delete (File);
+}
+
+
 VOID
 FileClose (
   IN  EFI_FILE_PROTOCOL *File
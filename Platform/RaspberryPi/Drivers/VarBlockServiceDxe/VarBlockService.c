@@ -86,6 +86,47 @@ EFI_FW_VOL_BLOCK_DEVICE mFvbDeviceTemplate = {
 };
 
 
+STATIC
+VOID
+VarStoreMarkDirty (
+  IN UINTN Address,
+  IN UINTN Length
+  )
+/*++
+
+  Routine Description:
+    Records that the blocks overlapping [Address, Address + Length) differ
+    from the copy in the backing file, so that only they get written back.
+
+  Arguments:
+    Address               - Start of the modified range
+    Length                - Size of the modified range in bytes
+
+  Returns:
+    None
+
+--*/
+{
+  UINTN Lba;
+  UINTN LastLba;
+
+  mFvInstance->Dirty = TRUE;
+  if (Length == 0) {
+    return;
+  }
+
+  ASSERT (Address >= mFvInstance->FvBase);
+  ASSERT (Address + Length <= mFvInstance->FvBase + mFvInstance->FvLength);
+
+  Lba = (Address - mFvInstance->FvBase) / mFvInstance->BlockSize;
+  LastLba = (Address + Length - 1 - mFvInstance->FvBase) /
+    mFvInstance->BlockSize;
+  for (; Lba <= LastLba; Lba++) {
+    MARK_BLOCK_DIRTY (mFvInstance, Lba);
+  }
+}
+
+
 EFI_STATUS
 VarStoreWrite (
   IN     UINTN Address,
@@ -94,7 +135,7 @@ VarStoreWrite (
   )
 {
   CopyMem ((VOID*)Address, Buffer, *NumBytes);
-  mFvInstance->Dirty = TRUE;
+  VarStoreMarkDirty (Address, *NumBytes);
 
   return EFI_SUCCESS;
 }
@@ -107,7 +148,7 @@ VarStoreErase (
   )
 {
   SetMem ((VOID*)Address, LbaLength, 0xff);
-  mFvInstance->Dirty = TRUE;
+  VarStoreMarkDirty (Address, LbaLength);
 
   return EFI_SUCCESS;
 }
@@ -847,6 +888,17 @@ FvbInitialize (
    * Should I parse config.txt instead and find the real name?
    */
   mFvInstance->MappedFile = L"RPI_EFI.FD";
+  mFvInstance->JournalFile = L"RPI_EFI.JNL";
+
+  mFvInstance->BlockSize = PcdGet32 (PcdFirmwareBlockSize);
+  ASSERT (mFvInstance->BlockSize != 0);
+  ASSERT ((Length % mFvInstance->BlockSize) == 0);
+  mFvInstance->DirtyMap = AllocateRuntimeZeroPool (
+                            DIRTY_MAP_SIZE (Length / mFvInstance->BlockSize));
+  if (mFvInstance->DirtyMap == NULL) {
+    FreePool (mFvInstance);
+    return EFI_OUT_OF_RESOURCES;
+  }
 
   Status = ValidateFvHeader (mFvInstance->VolumeHeader);
   if (!EFI_ERROR (Status)) {
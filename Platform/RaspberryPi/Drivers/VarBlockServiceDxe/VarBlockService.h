@@ -14,6 +14,7 @@
 #include <Library/DebugLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeLib.h>
 #include <Protocol/DevicePath.h>
@@ -32,11 +33,46 @@ typedef struct {
   UINTN                      NumOfBlocks;
   EFI_DEVICE_PATH_PROTOCOL   *Device;
   CHAR16                     *MappedFile;
+  CHAR16                     *JournalFile;
   BOOLEAN                    Dirty;
+  UINTN                      BlockSize;
+  UINT8                      *DirtyMap;
 } EFI_FW_VOL_INSTANCE;
 
 extern EFI_FW_VOL_INSTANCE *mFvInstance;
 
+//
+// One bit per PcdFirmwareBlockSize block of the store, set by the write and
+// erase paths and cleared once the block has made it into the backing file.
+//
+#define DIRTY_MAP_SIZE(Blocks)  (((Blocks) + 7) / 8)
+
+#define IS_BLOCK_DIRTY(Instance, Lba) \
+          (((Instance)->DirtyMap[(Lba) / 8] & (1 << ((Lba) % 8))) != 0)
+
+#define MARK_BLOCK_DIRTY(Instance, Lba) \
+          ((Instance)->DirtyMap[(Lba) / 8] |= (UINT8)(1 << ((Lba) % 8)))
+
+//
+// Write-ahead journal, kept in a separate file next to the FD image when
+// PcdVarStoreJournal is set. The header is followed by BlockCount UINT32
+// LBAs and then by BlockCount blocks of data. Crc32 covers the whole journal
+// with the Crc32 field itself taken as zero.
+//
+#define VAR_STORE_JOURNAL_SIGNATURE  SIGNATURE_32 ('R', 'P', 'V', 'J')
+
+typedef struct {
+  UINT32 Signature;
+  UINT32 Crc32;
+  UINT64 Offset;
+  UINT32 BlockSize;
+  UINT32 BlockCount;
+} VAR_STORE_JOURNAL_HEADER;
+
+#define VAR_STORE_JOURNAL_SIZE(BlockSize, BlockCount) \
+          (sizeof (VAR_STORE_JOURNAL_HEADER) + \
+           (BlockCount) * (sizeof (UINT32) + (BlockSize)))
+
 typedef struct {
   MEDIA_FW_VOL_DEVICE_PATH  FvDevPath;
   EFI_DEVICE_PATH_PROTOCOL  EndDevPath;
@@ -184,6 +220,20 @@ FileWrite (
   IN UINTN             Size
   );
 
+EFI_STATUS
+FileRead (
+  IN EFI_FILE_PROTOCOL *File,
+  IN UINTN             Offset,
+  IN UINTN             Buffer,
+  IN UINTN             Size
+  );
+
+EFI_STATUS
+FileDelete (
+  IN EFI_DEVICE_PATH_PROTOCOL *Device,
+  IN CHAR16                   *MappedFile
+  );
+
 EFI_STATUS
 CheckStore (
   IN  EFI_HANDLE SimpleFileSystemHandle,
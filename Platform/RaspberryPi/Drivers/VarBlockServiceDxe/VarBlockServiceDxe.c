@@ -8,6 +8,10 @@
  *
  **/
 
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
 #include "VarBlockService.h"
 
 VOID *mSFSRegistration;
@@ -94,6 +98,7 @@ FvbVirtualAddressChangeEvent (
 {
   EfiConvertPointer (0x0, (VOID**)&mFvInstance->FvBase);
   EfiConvertPointer (0x0, (VOID**)&mFvInstance->VolumeHeader);
+  EfiConvertPointer (0x0, (VOID**)&mFvInstance->DirtyMap);
   EfiConvertPointer (0x0, (VOID**)&mFvInstance);
 }
 
@@ -118,14 +123,307 @@ InstallVirtualAddressChangeHandler (
 }
 
 
+STATIC
+EFI_STATUS
+JournalWrite (
+  IN EFI_DEVICE_PATH_PROTOCOL *Device,
+  IN UINTN DirtyBlocks
+  )
+/*++
+
+  Routine Description:
+    Saves a copy of every dirty block to the journal file before the FD image
+    is touched, so that an interrupted dump can be completed on the next boot.
+
+  Arguments:
+    Device                - Device holding the variable store
+    DirtyBlocks           - Number of dirty blocks in the store
+
+  Returns:
+    EFI_SUCCESS           - The journal has been written and flushed
+    Others                - The journal could not be written
+
+--*/
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *File;
+  VAR_STORE_JOURNAL_HEADER *Header;
+  UINT32 *LbaList;
+  UINT8 *Data;
+  UINTN Size;
+  UINTN NumBlocks;
+  UINTN Lba;
+  UINTN Index;
+
+  Size = VAR_STORE_JOURNAL_SIZE (mFvInstance->BlockSize, DirtyBlocks);
+  Header = AllocatePool (Size);
+  if (Header == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Header->Signature = VAR_STORE_JOURNAL_SIGNATURE;
+  Header->Crc32 = 0;
+  Header->Offset = mFvInstance->Offset;
+  Header->BlockSize = (UINT32)mFvInstance->BlockSize;
+  Header->BlockCount = (UINT32)DirtyBlocks;
+
+  LbaList = (UINT32*)(Header + 1);
+  Data = (UINT8*)(LbaList + DirtyBlocks);
+  NumBlocks = mFvInstance->FvLength / mFvInstance->BlockSize;
+  for (Lba = 0, Index = 0; Lba < NumBlocks; Lba++) {
+    if (!IS_BLOCK_DIRTY (mFvInstance, Lba)) {
+      continue;
+    }
+
+    LbaList[Index] = (UINT32)Lba;
+    CopyMem (Data + Index * mFvInstance->BlockSize,
+      (VOID*)(mFvInstance->FvBase + Lba * mFvInstance->BlockSize),
+      mFvInstance->BlockSize);
+    Index++;
+  }
+  ASSERT (Index == DirtyBlocks);
+
+  Status = gBS->CalculateCrc32 (Header, Size, &Header->Crc32);
+  if (!EFI_ERROR (Status)) {
+    Status = FileOpen (Device,
+               mFvInstance->JournalFile,
+               &File,
+               EFI_FILE_MODE_CREATE |
+               EFI_FILE_MODE_WRITE |
+               EFI_FILE_MODE_READ);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = FileWrite (File, 0, (UINTN)Header, Size);
+    FileClose (File);
+  }
+
+  FreePool (Header);
+  return Status;
+}
+
+
+STATIC
+EFI_STATUS
+JournalReplay (
+  IN  EFI_DEVICE_PATH_PROTOCOL *Device,
+  OUT UINTN *Replayed
+  )
+/*++
+
+  Routine Description:
+    Completes a dump that was interrupted after its journal had been written,
+    by copying the journaled blocks that differ into the FD image. A journal
+    that is itself incomplete means the FD image was never touched, and it is
+    simply discarded.
+
+  Arguments:
+    Device                - Device holding the variable store
+    Replayed              - Number of blocks of the FD image that were rewritten
+
+  Returns:
+    EFI_SUCCESS           - A valid journal was found and has been replayed
+    EFI_NOT_FOUND         - There is no journal
+    Others                - The journal was invalid or could not be replayed
+
+--*/
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *File;
+  VAR_STORE_JOURNAL_HEADER Header;
+  VAR_STORE_JOURNAL_HEADER *Journal;
+  UINT32 *LbaList;
+  UINT8 *Data;
+  UINT8 *Block;
+  UINT32 Crc32;
+  UINTN Size;
+  UINTN NumBlocks;
+  UINTN FileOffset;
+  UINTN Index;
+
+  *Replayed = 0;
+  Journal = NULL;
+  Block = NULL;
+  NumBlocks = mFvInstance->FvLength / mFvInstance->BlockSize;
+
+  Status = FileOpen (Device,
+             mFvInstance->JournalFile,
+             &File,
+             EFI_FILE_MODE_READ);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Size = 0;
+  Status = FileRead (File, 0, (UINTN)&Header, sizeof (Header));
+  if (!EFI_ERROR (Status) &&
+      (Header.Signature != VAR_STORE_JOURNAL_SIGNATURE ||
+       Header.Offset != mFvInstance->Offset ||
+       Header.BlockSize != mFvInstance->BlockSize ||
+       Header.BlockCount == 0 ||
+       Header.BlockCount > NumBlocks)) {
+    Status = EFI_VOLUME_CORRUPTED;
+  }
+  if (!EFI_ERROR (Status)) {
+    Size = VAR_STORE_JOURNAL_SIZE (Header.BlockSize, Header.BlockCount);
+    Journal = AllocatePool (Size);
+    if (Journal == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    } else {
+      Status = FileRead (File, 0, (UINTN)Journal, Size);
+    }
+  }
+  FileClose (File);
+
+  if (!EFI_ERROR (Status)) {
+    Crc32 = Journal->Crc32;
+    Journal->Crc32 = 0;
+    Status = gBS->CalculateCrc32 (Journal, Size, &Journal->Crc32);
+    if (!EFI_ERROR (Status) && Journal->Crc32 != Crc32) {
+      Status = EFI_CRC_ERROR;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    if (Status != EFI_OUT_OF_RESOURCES) {
+      DEBUG ((DEBUG_WARN, "Discarding invalid journal '%s': %r\n",
+        mFvInstance->JournalFile, Status));
+      FileDelete (Device, mFvInstance->JournalFile);
+    }
+    goto Exit;
+  }
+
+  Block = AllocatePool (mFvInstance->BlockSize);
+  if (Block == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  Status = FileOpen (Device,
+             mFvInstance->MappedFile,
+             &File,
+             EFI_FILE_MODE_WRITE |
+             EFI_FILE_MODE_READ);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  LbaList = (UINT32*)(Journal + 1);
+  Data = (UINT8*)(LbaList + Journal->BlockCount);
+  for (Index = 0; Index < Journal->BlockCount; Index++) {
+    if (LbaList[Index] >= NumBlocks) {
+      Status = EFI_VOLUME_CORRUPTED;
+      break;
+    }
+
+    FileOffset = mFvInstance->Offset + LbaList[Index] * mFvInstance->BlockSize;
+    Status = FileRead (File, FileOffset, (UINTN)Block, mFvInstance->BlockSize);
+    if (!EFI_ERROR (Status) &&
+        CompareMem (Block, Data, mFvInstance->BlockSize) == 0) {
+      Data += mFvInstance->BlockSize;
+      continue;
+    }
+
+    Status = FileWrite (File, FileOffset, (UINTN)Data, mFvInstance->BlockSize);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Data += mFvInstance->BlockSize;
+    (*Replayed)++;
+  }
+  FileClose (File);
+
+  if (!EFI_ERROR (Status)) {
+    FileDelete (Device, mFvInstance->JournalFile);
+  }
+
+Exit:
+  if (Block != NULL) {
+    FreePool (Block);
+  }
+  if (Journal != NULL) {
+    FreePool (Journal);
+  }
+  return Status;
+}
+
+
+STATIC
+VOID
+MarkStaleBlocks (
+  IN EFI_FILE_PROTOCOL *File
+  )
+/*++
+
+  Routine Description:
+    Marks dirty every block whose copy in the FD image differs from memory.
+    Used when a store is first found, as the file may not be the one the
+    firmware was loaded from. Reads are cheap, unlike writes to the media.
+
+  Arguments:
+    File                  - The opened FD image
+
+  Returns:
+    None
+
+--*/
+{
+  EFI_STATUS Status;
+  UINT8 *Buffer;
+  UINTN NumBlocks;
+  UINTN Lba;
+  UINTN Offset;
+
+  NumBlocks = mFvInstance->FvLength / mFvInstance->BlockSize;
+
+  Buffer = AllocatePool (mFvInstance->FvLength);
+  if (Buffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+  } else {
+    Status = FileRead (File,
+               mFvInstance->Offset,
+               (UINTN)Buffer,
+               mFvInstance->FvLength);
+  }
+
+  if (EFI_ERROR (Status)) {
+    SetMem (mFvInstance->DirtyMap, DIRTY_MAP_SIZE (NumBlocks), 0xff);
+  } else {
+    for (Lba = 0; Lba < NumBlocks; Lba++) {
+      Offset = Lba * mFvInstance->BlockSize;
+      if (CompareMem (Buffer + Offset,
+            (VOID*)(mFvInstance->FvBase + Offset),
+            mFvInstance->BlockSize) != 0) {
+        MARK_BLOCK_DIRTY (mFvInstance, Lba);
+      }
+    }
+  }
+
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+}
+
+
 STATIC
 EFI_STATUS
 DoDump (
-  IN EFI_DEVICE_PATH_PROTOCOL *Device
+  IN EFI_DEVICE_PATH_PROTOCOL *Device,
+  IN BOOLEAN Resync
   )
 {
   EFI_STATUS Status;
   EFI_FILE_PROTOCOL *File;
+  UINT64 StartTime;
+  UINTN NumBlocks;
+  UINTN DirtyBlocks;
+  UINTN FirstLba;
+  UINTN Lba;
+  UINTN Written;
+  BOOLEAN Journaled;
+
+  StartTime = GetPerformanceCounter ();
+  NumBlocks = mFvInstance->FvLength / mFvInstance->BlockSize;
 
   Status = FileOpen (Device,
              mFvInstance->MappedFile,
@@ -136,12 +434,83 @@ DoDump (
     return Status;
   }
 
-  Status = FileWrite (File,
-             mFvInstance->Offset,
-             mFvInstance->FvBase,
-             mFvInstance->FvLength);
+  if (Resync) {
+    MarkStaleBlocks (File);
+  }
+
+  DirtyBlocks = 0;
+  for (Lba = 0; Lba < NumBlocks; Lba++) {
+    if (IS_BLOCK_DIRTY (mFvInstance, Lba)) {
+      DirtyBlocks++;
+    }
+  }
+
+  if (DirtyBlocks == 0) {
+    FileClose (File);
+    mFvInstance->Dirty = FALSE;
+    DEBUG ((DEBUG_INFO, "'%s' is up to date\n", mFvInstance->MappedFile));
+    return EFI_SUCCESS;
+  }
+
+  Journaled = FALSE;
+  if (FixedPcdGetBool (PcdVarStoreJournal)) {
+    Status = JournalWrite (Device, DirtyBlocks);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "Couldn't write journal '%s': %r\n",
+        mFvInstance->JournalFile, Status));
+    } else {
+      Journaled = TRUE;
+    }
+  }
+
+  //
+  // Write back runs of consecutive dirty blocks with one request each.
+  //
+  Status = EFI_SUCCESS;
+  Written = 0;
+  Lba = 0;
+  while (Lba < NumBlocks) {
+    if (!IS_BLOCK_DIRTY (mFvInstance, Lba)) {
+      Lba++;
+      continue;
+    }
+
+    FirstLba = Lba;
+    while (Lba < NumBlocks && IS_BLOCK_DIRTY (mFvInstance, Lba)) {
+      Lba++;
+    }
+
+    Status = FileWrite (File,
+               mFvInstance->Offset + FirstLba * mFvInstance->BlockSize,
+               mFvInstance->FvBase + FirstLba * mFvInstance->BlockSize,
+               (Lba - FirstLba) * mFvInstance->BlockSize);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    Written += (Lba - FirstLba) * mFvInstance->BlockSize;
+  }
   FileClose (File);
-  return Status;
+
+  if (EFI_ERROR (Status)) {
+    //
+    // Any journal is left behind to complete the dump on the next boot.
+    //
+    return Status;
+  }
+
+  if (Journaled) {
+    FileDelete (Device, mFvInstance->JournalFile);
+  }
+
+  ZeroMem (mFvInstance->DirtyMap, DIRTY_MAP_SIZE (NumBlocks));
+  mFvInstance->Dirty = FALSE;
+
+  DEBUG ((DEBUG_INFO, "Dumped %Lu of %Lu blocks (%Lu bytes) to '%s' in %Lu us\n",
+    (UINT64)DirtyBlocks, (UINT64)NumBlocks, (UINT64)Written,
+    mFvInstance->MappedFile,
+    DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - StartTime),
+      1000)));
+  return EFI_SUCCESS;
 }
 
 
@@ -165,7 +534,7 @@ DumpVars (
     return;
   }
 
-  Status = DoDump (mFvInstance->Device);
+  Status = DoDump (mFvInstance->Device, FALSE);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Couldn't dump '%s'\n", mFvInstance->MappedFile));
     ASSERT_EFI_ERROR (Status);
@@ -173,7 +542,6 @@ DumpVars (
   }
 
   DEBUG ((DEBUG_INFO, "Variables dumped!\n"));
-  mFvInstance->Dirty = FALSE;
 }
 
 
@@ -251,6 +619,7 @@ OnSimpleFileSystemInstall (
   UINTN HandleSize;
   EFI_HANDLE Handle;
   EFI_DEVICE_PATH_PROTOCOL *Device;
+  UINTN Replayed;
 
   if ((mFvInstance->Device != NULL) &&
       !EFI_ERROR (CheckStoreExists (mFvInstance->Device))) {
@@ -281,7 +650,24 @@ OnSimpleFileSystemInstall (
       continue;
     }
 
-    Status = DoDump (Device);
+    if (FixedPcdGetBool (PcdVarStoreJournal) &&
+        !EFI_ERROR (JournalReplay (Device, &Replayed)) &&
+        Replayed != 0) {
+      //
+      // The last dump was interrupted, so what got loaded from the FD image
+      // at boot is torn. The file has now been repaired: reset to load it
+      // afresh, making sure nothing gets dumped from memory on the way.
+      //
+      DEBUG ((DEBUG_WARN, "Recovered %Lu blocks of '%s' from journal\n",
+        (UINT64)Replayed, mFvInstance->MappedFile));
+      if (mFvInstance->Device != NULL) {
+        gBS->FreePool (mFvInstance->Device);
+        mFvInstance->Device = NULL;
+      }
+      EfiResetSystem (EfiResetCold, EFI_SUCCESS, 0, NULL);
+    }
+
+    Status = DoDump (Device, TRUE);
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "Couldn't update '%s'\n", mFvInstance->MappedFile));
       ASSERT_EFI_ERROR (Status);
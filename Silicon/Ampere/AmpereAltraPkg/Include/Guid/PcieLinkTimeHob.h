@@ -0,0 +1,32 @@
+/** @file
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef PCIE_LINK_TIME_HOB_H_
+#define PCIE_LINK_TIME_HOB_H_
+
+#include <Guid/RootComplexInfoHob.h>
+#include <Platform/Ac01.h>
+
+#define PCIE_LINK_TIME_HOB_GUID \
+  { 0x9f06ad1a, 0x1d77, 0x4dae, { 0x87, 0xe2, 0xd4, 0xaf, 0x1c, 0x0c, 0x7e, 0xc9 } }
+
+extern GUID gPcieLinkTimeHobGuid;
+
+//
+// Value of LinkUpTime for a controller which is inactive or never linked up
+//
+#define PCIE_LINK_TIME_NOT_UP     MAX_UINT32
+
+//
+// Time, in microseconds from the start of link polling, at which each PCIe
+// controller was first seen in L0.
+//
+typedef struct {
+  UINT32 LinkUpTime[AC01_PCIE_MAX_ROOT_COMPLEX][MaxPcieController];
+  UINT32 PollTime;                    // Total time spent polling
+} PCIE_LINK_TIME_INFO;
+
+#endif /* PCIE_LINK_TIME_HOB_H_ */
@@ -50,6 +50,12 @@
 
 #define NVPARAM_SIZE    0x8
 
+typedef struct {
+  UINT32     Param;   /* IN: Parameter ID to retrieve */
+  UINT32     Value;   /* OUT: Value of the parameter */
+  EFI_STATUS Status;  /* OUT: Status as returned by NVParamGet() */
+} NV_PARAM_REQUEST;
+
 /**
   Retrieve a non-volatile parameter.
 
@@ -73,6 +79,30 @@ NVParamGet (
   OUT UINT32 *Val
   );
 
+/**
+  Retrieve several non-volatile parameters.
+
+  Each entry is processed as by NVParamGet() and its result is stored in
+  its Status field. In DXE, parameters already read during this boot are
+  returned from the cache without a call to the secure firmware.
+
+  @param[in, out] Requests        Array of parameters to retrieve.
+  @param[in]      Count           Number of entries in Requests.
+  @param[in]      ACLRd           Permission for read operation.
+
+  @retval EFI_SUCCESS             All entries were processed. Check the
+                                  Status field of each of them.
+  @retval EFI_INVALID_PARAMETER   Requests is NULL.
+  @retval Others                  Service is unavailable. The entries not
+                                  processed are set to EFI_NOT_STARTED.
+**/
+EFI_STATUS
+NVParamGetBulk (
+  IN OUT NV_PARAM_REQUEST *Requests,
+  IN     UINTN            Count,
+  IN     UINT16           ACLRd
+  );
+
 /**
   Set a non-volatile parameter.
 
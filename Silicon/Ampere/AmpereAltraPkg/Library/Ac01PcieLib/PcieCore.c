@@ -8,6 +8,7 @@
 
 #include <PiDxe.h>
 
+#include <Guid/PcieLinkTimeHob.h>
 #include <Guid/PlatformInfoHob.h>
 #include <Guid/RootComplexInfoHob.h>
 #include <IndustryStandard/Pci.h>
@@ -1626,6 +1627,9 @@ PollLinkUp (
 
   @param RootComplex[in]  Pointer to AC01_ROOT_COMPLEX structure
   @param PcieIndex[in]    PCIe controller index
+  @param RasdesArmed[in]  TRUE if the RASDES counters of the controller were
+                          enabled at least 100ms ago, so the first check can
+                          read them right away
 
   @retval                 -1: Link recovery had failed
                           1: Link width and speed are not correct
@@ -1634,7 +1638,8 @@ PollLinkUp (
 INT32
 Ac01PcieCoreQoSLinkCheckRecovery (
   IN AC01_ROOT_COMPLEX   *RootComplex,
-  IN UINT8               PcieIndex
+  IN UINT8               PcieIndex,
+  IN BOOLEAN             RasdesArmed
   )
 {
   INT32       LinkStatusCheck, RasdesChecking;
@@ -1650,7 +1655,9 @@ Ac01PcieCoreQoSLinkCheckRecovery (
   do {
     if (RootComplex->Pcie[PcieIndex].LinkUp) {
       // Enable all of RASDES register to detect any training error
-      Ac01PFACommand (RootComplex, PcieIndex, PFA_MODE_ENABLE);
+      if (!RasdesArmed) {
+        Ac01PFACommand (RootComplex, PcieIndex, PFA_MODE_ENABLE);
+      }
 
       // Accessing Endpoint and checking current link capabilities
       Ac01PcieCoreGetEndpointInfo (RootComplex, PcieIndex, &EpMaxWidth, &EpMaxGen);
@@ -1660,7 +1667,10 @@ Ac01PcieCoreQoSLinkCheckRecovery (
       // any error status update. This allows detection of any error observed
       // during initial link training. Possible evaluation time can be
       // between 100ms to 200ms.
-      MicroSecondDelay (100000);
+      if (!RasdesArmed) {
+        MicroSecondDelay (100000);
+      }
+      RasdesArmed = FALSE;
 
       // Check for error
       RasdesChecking = Ac01PFACommand (RootComplex, PcieIndex, PFA_MODE_READ);
@@ -1705,6 +1715,8 @@ Ac01PcieCoreUpdateLink (
   UINT8                     PcieIndex;
   UINT32                    Index;
   UINT32                    Val;
+  BOOLEAN                   Armed[MaxPcieControllerOfRootComplexB];
+  BOOLEAN                   AnyArmed;
 
   *IsNextRoundNeeded = FALSE;
   *FailedPcieCount   = 0;
@@ -1717,9 +1729,11 @@ Ac01PcieCoreUpdateLink (
   }
 
   // Loop for all controllers
+  AnyArmed = FALSE;
   for (PcieIndex = 0; PcieIndex < RootComplex->MaxPcieController; PcieIndex++) {
     Pcie = &RootComplex->Pcie[PcieIndex];
     CfgBase = RootComplex->MmcfgBase + (RootComplex->Pcie[PcieIndex].DevNum << DEV_SHIFT);
+    Armed[PcieIndex] = FALSE;
 
     if (Pcie->Active && !Pcie->LinkUp) {
       if (PcieLinkUpCheck (Pcie)) {
@@ -1737,12 +1751,10 @@ Ac01PcieCoreUpdateLink (
           CAP_LINK_SPEED_GET (Val)
           ));
 
-        // Doing link checking and recovery if needed
-        Ac01PcieCoreQoSLinkCheckRecovery (RootComplex, PcieIndex);
-
-        // Un-mask Completion Timeout
-        DisableCompletionTimeOut (RootComplex, PcieIndex, FALSE);
-
+        // Enable all of RASDES register to detect any training error
+        Ac01PFACommand (RootComplex, PcieIndex, PFA_MODE_ENABLE);
+        Armed[PcieIndex] = TRUE;
+        AnyArmed = TRUE;
       } else {
         *IsNextRoundNeeded = FALSE;
         FailedPciePtr[*FailedPcieCount] = PcieIndex;
@@ -1750,47 +1762,197 @@ Ac01PcieCoreUpdateLink (
       }
     }
   }
+
+  if (!AnyArmed) {
+    return;
+  }
+
+  // Let all the links of the Root Complex gather RASDES errors during
+  // the same evaluation time, see Ac01PcieCoreQoSLinkCheckRecovery.
+  MicroSecondDelay (100000);
+
+  for (PcieIndex = 0; PcieIndex < RootComplex->MaxPcieController; PcieIndex++) {
+    if (!Armed[PcieIndex]) {
+      continue;
+    }
+
+    // Doing link checking and recovery if needed
+    Ac01PcieCoreQoSLinkCheckRecovery (RootComplex, PcieIndex, TRUE);
+
+    // Un-mask Completion Timeout
+    DisableCompletionTimeOut (RootComplex, PcieIndex, FALSE);
+  }
 }
 
 /**
-  Verify the link status and retry to initialize the Root Complex if there's any issue.
+  Get the link speed and width a controller should train to, the highest
+  both the Root Port and the Endpoint support.
+
+  @param RootComplex      Pointer to AC01_ROOT_COMPLEX structure
+  @param PcieIndex        PCIe controller index, whose link must be up
+  @param TargetWidth      Target link width, 0 if unknown
+  @param TargetGen        Target link speed, 0 if unknown
+**/
+STATIC
+VOID
+Ac01PcieCoreGetLinkTarget (
+  IN  AC01_ROOT_COMPLEX  *RootComplex,
+  IN  UINT8              PcieIndex,
+  OUT UINT8              *TargetWidth,
+  OUT UINT8              *TargetGen
+  )
+{
+  PHYSICAL_ADDRESS      CfgBase;
+  UINT32                Val;
+  UINT8                 EpMaxWidth, EpMaxGen;
+
+  CfgBase = RootComplex->MmcfgBase + (RootComplex->Pcie[PcieIndex].DevNum << DEV_SHIFT);
+
+  Ac01PcieCoreGetEndpointInfo (RootComplex, PcieIndex, &EpMaxWidth, &EpMaxGen);
+  Val = MmioRead32 (CfgBase + PCIE_CAPABILITY_BASE + LINK_CAPABILITIES_REG);
+  *TargetWidth = (UINT8)MIN (CAP_MAX_LINK_WIDTH_GET (Val), EpMaxWidth);
+  *TargetGen = (UINT8)MIN (CAP_MAX_LINK_SPEED_GET (Val), EpMaxGen);
+}
+
+/**
+  Poll the link of every active controller of all Root Complexes in turn,
+  until they have all trained to their target speed and width or the shared
+  deadline has passed. Links come up at Gen1 and retrain to their highest
+  speed afterwards, and Ac01PcieCoreLinkCheck fails a link until then.
 
   @param RootComplexList      Pointer to the Root Complex list
+  @param StartTick            System count the link up times are relative to
+  @param LinkTime             Link up time of each controller, updated for the
+                              controllers seen in L0 during this round
 **/
+STATIC
 VOID
-Ac01PcieCorePostSetupRC (
-  IN AC01_ROOT_COMPLEX *RootComplexList
+Ac01PcieCorePollLinks (
+  IN     AC01_ROOT_COMPLEX    *RootComplexList,
+  IN     UINT64               StartTick,
+  IN OUT PCIE_LINK_TIME_INFO  *LinkTime
   )
 {
-  UINT8   RCIndex, Idx;
-  BOOLEAN IsNextRoundNeeded, NextRoundNeeded;
-  UINT64  PrevTick, CurrTick, ElapsedCycle;
-  UINT64  TimerTicks64;
-  UINT8   ReInit;
-  INT8    FailedPciePtr[MaxPcieControllerOfRootComplexB];
-  INT8    FailedPcieCount;
+  AC01_ROOT_COMPLEX     *RootComplex;
+  AC01_PCIE_CONTROLLER  *Pcie;
+  UINT64                TimerFreq;
+  UINT64                RoundTick;
+  UINT64                Deadline;
+  UINT64                CurrTick;
+  UINT32                Pending;
+  UINT8                 RCIndex;
+  UINT8                 PcieIndex;
+  PHYSICAL_ADDRESS      CfgBase;
+  UINT32                Val;
+  BOOLEAN               Done[AC01_PCIE_MAX_ROOT_COMPLEX][MaxPcieController];
+  UINT8                 TargetWidth[AC01_PCIE_MAX_ROOT_COMPLEX][MaxPcieController];
+  UINT8                 TargetGen[AC01_PCIE_MAX_ROOT_COMPLEX][MaxPcieController];
 
-  ReInit = 0;
+  ZeroMem (Done, sizeof (Done));
+  ZeroMem (TargetGen, sizeof (TargetGen));
 
-_link_polling:
-  NextRoundNeeded = FALSE;
   //
   // It is not guaranteed the timer service is ready prior to PCI Dxe.
   // Calculate system ticks for link training.
   //
-  TimerTicks64 = ArmGenericTimerGetTimerFreq (); /* 1 Second */
-  PrevTick = ArmGenericTimerGetSystemCount ();
-  ElapsedCycle = 0;
+  TimerFreq = ArmGenericTimerGetTimerFreq ();
+  RoundTick = ArmGenericTimerGetSystemCount ();
+  Deadline = DivU64x32 (MultU64x32 (TimerFreq, LINK_POLL_TIMEOUT / 1000), 1000);
 
   do {
     CurrTick = ArmGenericTimerGetSystemCount ();
-    if (CurrTick < PrevTick) {
-      ElapsedCycle += MAX_UINT64 - PrevTick;
-      PrevTick = 0;
+    Pending = 0;
+
+    for (RCIndex = 0; RCIndex < AC01_PCIE_MAX_ROOT_COMPLEX; RCIndex++) {
+      RootComplex = &RootComplexList[RCIndex];
+      if (!RootComplex->Active) {
+        continue;
+      }
+
+      for (PcieIndex = 0; PcieIndex < RootComplex->MaxPcieController; PcieIndex++) {
+        Pcie = &RootComplex->Pcie[PcieIndex];
+        if (!Pcie->Active || Pcie->LinkUp || Done[RCIndex][PcieIndex]) {
+          continue;
+        }
+
+        if (!PcieLinkUpCheck (Pcie)) {
+          Pending++;
+          continue;
+        }
+
+        if (LinkTime->LinkUpTime[RCIndex][PcieIndex] == PCIE_LINK_TIME_NOT_UP) {
+          LinkTime->LinkUpTime[RCIndex][PcieIndex] = (UINT32)DivU64x64Remainder (
+                                                               MultU64x32 (CurrTick - StartTick, 1000000),
+                                                               TimerFreq,
+                                                               NULL
+                                                               );
+        }
+
+        if (TargetGen[RCIndex][PcieIndex] == 0) {
+          Ac01PcieCoreGetLinkTarget (
+            RootComplex,
+            PcieIndex,
+            &TargetWidth[RCIndex][PcieIndex],
+            &TargetGen[RCIndex][PcieIndex]
+            );
+          if (TargetWidth[RCIndex][PcieIndex] == 0 || TargetGen[RCIndex][PcieIndex] == 0) {
+            // The link check cannot pass, waiting longer does not help
+            Done[RCIndex][PcieIndex] = TRUE;
+            continue;
+          }
+        }
+
+        CfgBase = RootComplex->MmcfgBase + (Pcie->DevNum << DEV_SHIFT);
+        Val = MmioRead32 (CfgBase + PCIE_CAPABILITY_BASE + LINK_CONTROL_LINK_STATUS_REG);
+        if (CAP_NEGO_LINK_WIDTH_GET (Val) == TargetWidth[RCIndex][PcieIndex]
+            && CAP_LINK_SPEED_GET (Val) == TargetGen[RCIndex][PcieIndex]) {
+          Done[RCIndex][PcieIndex] = TRUE;
+        } else {
+          Pending++;
+        }
+      }
     }
-    ElapsedCycle += (CurrTick - PrevTick);
-    PrevTick = CurrTick;
-  } while (ElapsedCycle < TimerTicks64);
+  } while (Pending > 0 && CurrTick - RoundTick < Deadline);
+
+  LinkTime->PollTime = (UINT32)DivU64x64Remainder (
+                                 MultU64x32 (ArmGenericTimerGetSystemCount () - StartTick, 1000000),
+                                 TimerFreq,
+                                 NULL
+                                 );
+}
+
+/**
+  Verify the link status and retry to initialize the Root Complex if there's any issue.
+
+  @param RootComplexList      Pointer to the Root Complex list
+**/
+VOID
+Ac01PcieCorePostSetupRC (
+  IN AC01_ROOT_COMPLEX *RootComplexList
+  )
+{
+  UINT8               RCIndex, Idx;
+  BOOLEAN             IsNextRoundNeeded, NextRoundNeeded;
+  UINT8               ReInit;
+  INT8                FailedPciePtr[MaxPcieControllerOfRootComplexB];
+  INT8                FailedPcieCount;
+  UINT64              StartTick;
+  PCIE_LINK_TIME_INFO LinkTime;
+
+  ReInit = 0;
+  SetMem32 (LinkTime.LinkUpTime, sizeof (LinkTime.LinkUpTime), PCIE_LINK_TIME_NOT_UP);
+  StartTick = ArmGenericTimerGetSystemCount ();
+
+_link_polling:
+  NextRoundNeeded = FALSE;
+
+  //
+  // Link training was started on every controller by Ac01PcieCoreSetupRC,
+  // so wait for all of them at once rather than one after the other.
+  // RASDES errors are then gathered for all the links of a Root Complex
+  // at once by Ac01PcieCoreUpdateLink.
+  //
+  Ac01PcieCorePollLinks (RootComplexList, StartTick, &LinkTime);
 
   for (RCIndex = 0; RCIndex < AC01_PCIE_MAX_ROOT_COMPLEX; RCIndex++) {
     Ac01PcieCoreUpdateLink (&RootComplexList[RCIndex], &IsNextRoundNeeded, FailedPciePtr, &FailedPcieCount);
@@ -1822,4 +1984,22 @@ _link_polling:
 
     goto _link_polling;
   }
+
+  for (RCIndex = 0; RCIndex < AC01_PCIE_MAX_ROOT_COMPLEX; RCIndex++) {
+    for (Idx = 0; Idx < MaxPcieController; Idx++) {
+      if (LinkTime.LinkUpTime[RCIndex][Idx] != PCIE_LINK_TIME_NOT_UP) {
+        DEBUG ((
+          DEBUG_INFO,
+          "Socket%d RootComplex%d RP%d link up after %d us\n",
+          RootComplexList[RCIndex].Socket,
+          RootComplexList[RCIndex].ID,
+          Idx,
+          LinkTime.LinkUpTime[RCIndex][Idx]
+          ));
+      }
+    }
+  }
+  DEBUG ((DEBUG_INFO, "PCIe link polling took %d us\n", LinkTime.PollTime));
+
+  BuildGuidDataHob (&gPcieLinkTimeHobGuid, &LinkTime, sizeof (LinkTime));
 }
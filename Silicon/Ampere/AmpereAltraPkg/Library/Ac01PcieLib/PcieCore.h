@@ -38,6 +38,7 @@
 #define MEMRDY_TIMEOUT                   10          // 10 us
 #define PIPE_CLOCK_TIMEOUT               20000       // 20,000 us
 #define LTSSM_TRANSITION_TIMEOUT         100000      // 100 ms in total
+#define LINK_POLL_TIMEOUT                1000000     // 1 s shared by all controllers
 #define EP_LINKUP_TIMEOUT                (10 * 1000) // 10ms
 #define EP_LINKUP_EXTRA_TIMEOUT          (500 * 1000) // 500ms
 #define LINK_WAIT_INTERVAL_US            50
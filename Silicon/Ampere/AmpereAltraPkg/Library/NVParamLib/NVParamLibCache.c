@@ -0,0 +1,151 @@
+/** @file
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "NVParamLibCommon.h"
+
+STATIC NV_PARAM_CACHE *mNVParamCache = NULL;
+STATIC BOOLEAN        mNVParamCacheDisabled = FALSE;
+STATIC EFI_EVENT      mNVParamCacheExitBootServicesEvent = NULL;
+
+/**
+  This is a notification function registered on ExitBootServices event.
+  The cache lives in boot services memory, so stop using it and report
+  the statistics of this boot.
+
+  @param  Event        Event whose notification function is being invoked.
+  @param  Context      Pointer to the notification function's context
+**/
+STATIC
+VOID
+EFIAPI
+NVParamLibCacheExitBootServices (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  )
+{
+  if (mNVParamCache != NULL && !mNVParamCache->Reported) {
+    mNVParamCache->Reported = TRUE;
+    DEBUG ((
+      DEBUG_INFO,
+      "NVParam: %lu MM round trips, %lu cache hits, %lu invalidations\n",
+      mNVParamCache->MmRoundTrips,
+      mNVParamCache->Hits,
+      mNVParamCache->Invalidations
+      ));
+  }
+
+  mNVParamCache = NULL;
+  mNVParamCacheDisabled = TRUE;
+}
+
+/**
+  Return the cache of NVParam reads.
+
+  @return  Pointer to the cache, or NULL if reads are not cached in the
+           current phase.
+**/
+NV_PARAM_CACHE *
+NVParamGetCache (
+  VOID
+  )
+{
+  EFI_STATUS     Status;
+  EFI_HANDLE     Handle;
+  NV_PARAM_CACHE *Cache;
+
+  if (mNVParamCache != NULL || mNVParamCacheDisabled) {
+    return mNVParamCache;
+  }
+
+  Status = gBS->LocateProtocol (
+                  &gNVParamCacheGuid,
+                  NULL,
+                  (VOID **)&mNVParamCache
+                  );
+  if (!EFI_ERROR (Status)) {
+    return mNVParamCache;
+  }
+
+  Cache = AllocateZeroPool (sizeof (NV_PARAM_CACHE));
+  if (Cache == NULL) {
+    return NULL;
+  }
+
+  Handle = NULL;
+  Status = gBS->InstallProtocolInterface (
+                  &Handle,
+                  &gNVParamCacheGuid,
+                  EFI_NATIVE_INTERFACE,
+                  Cache
+                  );
+  if (EFI_ERROR (Status)) {
+    FreePool (Cache);
+    return NULL;
+  }
+
+  mNVParamCache = Cache;
+
+  return mNVParamCache;
+}
+
+/**
+  Prepare the NVParam cache of a DXE module.
+
+  @param ImageHandle        The image handle.
+  @param SystemTable        The system table.
+
+  @retval  EFI_SUCCESS      Operation succeeded.
+  @retval  Others           An error has occurred
+**/
+EFI_STATUS
+EFIAPI
+NVParamLibCacheConstructor (
+  IN EFI_HANDLE       ImageHandle,
+  IN EFI_SYSTEM_TABLE *SystemTable
+  )
+{
+  EFI_STATUS Status;
+
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  NVParamLibCacheExitBootServices,
+                  NULL,
+                  &gEfiEventExitBootServicesGuid,
+                  &mNVParamCacheExitBootServicesEvent
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  return Status;
+}
+
+/**
+  Destructor function of the NVParam cache.
+
+  @param ImageHandle        The image handle.
+  @param SystemTable        The system table.
+
+  @retval  EFI_SUCCESS      Operation succeeded.
+**/
+EFI_STATUS
+EFIAPI
+NVParamLibCacheDestructor (
+  IN EFI_HANDLE       ImageHandle,
+  IN EFI_SYSTEM_TABLE *SystemTable
+  )
+{
+  if (mNVParamCacheExitBootServicesEvent != NULL) {
+    gBS->CloseEvent (mNVParamCacheExitBootServicesEvent);
+  }
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,25 @@
+/** @file
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include "NVParamLibCommon.h"
+
+/**
+  Return the cache of NVParam reads.
+
+  Reads are not cached before DXE, as there is no memory to share the
+  cache between modules.
+
+  @return  NULL.
+**/
+NV_PARAM_CACHE *
+NVParamGetCache (
+  VOID
+  )
+{
+  return NULL;
+}
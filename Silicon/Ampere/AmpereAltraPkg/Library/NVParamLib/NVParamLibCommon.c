@@ -15,6 +15,85 @@
 
 #include "NVParamLibCommon.h"
 
+/**
+  Send a request to the NVParam service, accounting for it in the cache
+  statistics.
+
+  @param[in]  MmData              Pointer to the request.
+  @param[in]  MmDataSize          Size of the request.
+  @param[out] MmNVParamRes        Pointer to the response.
+
+  @retval EFI_SUCCESS             Operation succeeded.
+  @retval Others                  An error has occurred.
+**/
+STATIC
+EFI_STATUS
+NVParamRequest (
+  IN  UINT64                              *MmData,
+  IN  UINT32                              MmDataSize,
+  OUT EFI_MM_COMMUNICATE_NVPARAM_RESPONSE *MmNVParamRes
+  )
+{
+  NV_PARAM_CACHE *Cache;
+
+  Cache = NVParamGetCache ();
+  if (Cache != NULL) {
+    Cache->MmRoundTrips++;
+  }
+
+  return NVParamMmCommunicate (
+           MmData,
+           MmDataSize,
+           MmNVParamRes,
+           sizeof (*MmNVParamRes)
+           );
+}
+
+/**
+  Return the cache entry of a parameter.
+
+  @param[in]  Param               Parameter ID.
+
+  @return  Pointer to the entry, or NULL if the parameter is not cached.
+**/
+STATIC
+NV_PARAM_CACHE_ENTRY *
+NVParamCacheEntry (
+  IN UINT32 Param
+  )
+{
+  NV_PARAM_CACHE *Cache;
+
+  Cache = NVParamGetCache ();
+  if (Cache == NULL
+      || Param >= NV_PARAM_MAX_SIZE
+      || (Param % NVPARAM_SIZE) != 0) {
+    return NULL;
+  }
+
+  return &Cache->Entries[Param / NVPARAM_SIZE];
+}
+
+/**
+  Drop the cached value of a parameter before it is changed.
+
+  @param[in]  Param               Parameter ID.
+**/
+STATIC
+VOID
+NVParamCacheInvalidate (
+  IN UINT32 Param
+  )
+{
+  NV_PARAM_CACHE_ENTRY *Entry;
+
+  Entry = NVParamCacheEntry (Param);
+  if (Entry != NULL && Entry->State != NV_PARAM_CACHE_EMPTY) {
+    Entry->State = NV_PARAM_CACHE_EMPTY;
+    NVParamGetCache ()->Invalidations++;
+  }
+}
+
 /**
   Retrieve a non-volatile parameter.
 
@@ -41,21 +120,33 @@ NVParamGet (
   EFI_MM_COMMUNICATE_NVPARAM_RESPONSE MmNVParamRes;
   EFI_STATUS                          Status;
   UINT64                              MmData[5];
+  NV_PARAM_CACHE_ENTRY                *Entry;
 
   if (Val == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
+  //
+  // The read permission is part of the key, as the same parameter may be
+  // allowed for one caller and denied for another.
+  //
+  Entry = NVParamCacheEntry (Param);
+  if (Entry != NULL
+      && Entry->State != NV_PARAM_CACHE_EMPTY
+      && Entry->ACLRd == ACLRd) {
+    NVParamGetCache ()->Hits++;
+    if (Entry->State == NV_PARAM_CACHE_NOT_SET) {
+      return EFI_NOT_FOUND;
+    }
+    *Val = Entry->Value;
+    return EFI_SUCCESS;
+  }
+
   MmData[0] = MM_NVPARAM_FUNC_READ;
   MmData[1] = Param;
   MmData[2] = (UINT64)ACLRd;
 
-  Status = NVParamMmCommunicate (
-             MmData,
-             sizeof (MmData),
-             &MmNVParamRes,
-             sizeof (MmNVParamRes)
-             );
+  Status = NVParamRequest (MmData, sizeof (MmData), &MmNVParamRes);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -63,9 +154,18 @@ NVParamGet (
   switch (MmNVParamRes.Status) {
   case MM_NVPARAM_RES_SUCCESS:
     *Val = (UINT32)MmNVParamRes.Value;
+    if (Entry != NULL) {
+      Entry->Value = *Val;
+      Entry->ACLRd = ACLRd;
+      Entry->State = NV_PARAM_CACHE_VALID;
+    }
     return EFI_SUCCESS;
 
   case MM_NVPARAM_RES_NOT_SET:
+    if (Entry != NULL) {
+      Entry->ACLRd = ACLRd;
+      Entry->State = NV_PARAM_CACHE_NOT_SET;
+    }
     return EFI_NOT_FOUND;
 
   case MM_NVPARAM_RES_NO_PERM:
@@ -79,6 +179,59 @@ NVParamGet (
   }
 }
 
+/**
+  Retrieve several non-volatile parameters.
+
+  Each entry is processed as by NVParamGet() and its result is stored in
+  its Status field. In DXE, parameters already read during this boot are
+  returned from the cache without a call to the secure firmware.
+
+  @param[in, out] Requests        Array of parameters to retrieve.
+  @param[in]      Count           Number of entries in Requests.
+  @param[in]      ACLRd           Permission for read operation.
+
+  @retval EFI_SUCCESS             All entries were processed. Check the
+                                  Status field of each of them.
+  @retval EFI_INVALID_PARAMETER   Requests is NULL.
+  @retval Others                  Service is unavailable. The entries not
+                                  processed are set to EFI_NOT_STARTED.
+**/
+EFI_STATUS
+NVParamGetBulk (
+  IN OUT NV_PARAM_REQUEST *Requests,
+  IN     UINTN            Count,
+  IN     UINT16           ACLRd
+  )
+{
+  EFI_STATUS Status;
+  UINTN      Index;
+
+  if (Requests == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Requests[Index].Status = EFI_NOT_STARTED;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Status = NVParamGet (Requests[Index].Param, ACLRd, &Requests[Index].Value);
+    Requests[Index].Status = Status;
+
+    //
+    // Missing or protected parameters are reported per entry, anything
+    // else means the service itself failed.
+    //
+    if (EFI_ERROR (Status)
+        && Status != EFI_NOT_FOUND
+        && Status != EFI_ACCESS_DENIED) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Set a non-volatile parameter.
 
@@ -115,12 +268,9 @@ NVParamSet (
   MmData[3] = (UINT64)ACLWr;
   MmData[4] = (UINT64)Val;
 
-  Status = NVParamMmCommunicate (
-             MmData,
-             sizeof (MmData),
-             &MmNVParamRes,
-             sizeof (MmNVParamRes)
-             );
+  NVParamCacheInvalidate (Param);
+
+  Status = NVParamRequest (MmData, sizeof (MmData), &MmNVParamRes);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -169,12 +319,9 @@ NVParamClr (
   MmData[2] = 0;
   MmData[3] = (UINT64)ACLWr;
 
-  Status = NVParamMmCommunicate (
-             MmData,
-             sizeof (MmData),
-             &MmNVParamRes,
-             sizeof (MmNVParamRes)
-             );
+  NVParamCacheInvalidate (Param);
+
+  Status = NVParamRequest (MmData, sizeof (MmData), &MmNVParamRes);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -209,15 +356,17 @@ NVParamClrAll (
   EFI_MM_COMMUNICATE_NVPARAM_RESPONSE MmNVParamRes;
   EFI_STATUS                          Status;
   UINT64                              MmData[5];
+  NV_PARAM_CACHE                      *Cache;
 
   MmData[0] = MM_NVPARAM_FUNC_CLEAR_ALL;
 
-  Status = NVParamMmCommunicate (
-             MmData,
-             sizeof (MmData),
-             &MmNVParamRes,
-             sizeof (MmNVParamRes)
-             );
+  Cache = NVParamGetCache ();
+  if (Cache != NULL) {
+    ZeroMem (Cache->Entries, sizeof (Cache->Entries));
+    Cache->Invalidations++;
+  }
+
+  Status = NVParamRequest (MmData, sizeof (MmData), &MmNVParamRes);
   if (EFI_ERROR (Status)) {
     return Status;
   }
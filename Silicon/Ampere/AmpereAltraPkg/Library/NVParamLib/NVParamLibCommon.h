@@ -9,6 +9,8 @@
 #ifndef NV_PARAM_LIB_COMMON_H_
 #define NV_PARAM_LIB_COMMON_H_
 
+#include <Library/NVParamLib.h>
+
 #define EFI_MM_MAX_PAYLOAD_SIZE           0x50
 
 #define MM_NVPARAM_FUNC_READ              0x01
@@ -21,6 +23,12 @@
 #define MM_NVPARAM_RES_NO_PERM            0xAABBCC02
 #define MM_NVPARAM_RES_FAIL               0xAABBCCFF
 
+#define NV_PARAM_CACHE_ENTRIES            (NV_PARAM_MAX_SIZE / NVPARAM_SIZE)
+
+#define NV_PARAM_CACHE_EMPTY              0
+#define NV_PARAM_CACHE_VALID              1
+#define NV_PARAM_CACHE_NOT_SET            2
+
 #pragma pack (1)
 
 typedef struct {
@@ -47,6 +55,26 @@ typedef struct {
 
 #pragma pack ()
 
+typedef struct {
+  UINT32 Value;
+  UINT16 ACLRd;
+  UINT8  State;
+  UINT8  Reserved;
+} NV_PARAM_CACHE_ENTRY;
+
+//
+// Results of NVParam reads, shared by all DXE modules so that a write made
+// through any of them is seen by the others. It is installed on its own
+// handle under gNVParamCacheGuid by the first module that needs it.
+//
+typedef struct {
+  UINT64               MmRoundTrips;
+  UINT64               Hits;
+  UINT64               Invalidations;
+  BOOLEAN              Reported;
+  NV_PARAM_CACHE_ENTRY Entries[NV_PARAM_CACHE_ENTRIES];
+} NV_PARAM_CACHE;
+
 /**
   Provides an interface to access the NVParam services via MM interface.
 
@@ -67,4 +95,32 @@ NVParamMmCommunicate (
   OUT VOID   *Response,
   IN  UINT32 ResponseDataSize
   );
+
+/**
+  Return the cache of NVParam reads.
+
+  @return  Pointer to the cache, or NULL if reads are not cached in the
+           current phase.
+**/
+NV_PARAM_CACHE *
+NVParamGetCache (
+  VOID
+  );
+
+/**
+  Prepare the NVParam cache of a DXE module.
+
+  @param ImageHandle        The image handle.
+  @param SystemTable        The system table.
+
+  @retval  EFI_SUCCESS      Operation succeeded.
+  @retval  Others           An error has occurred
+**/
+EFI_STATUS
+EFIAPI
+NVParamLibCacheConstructor (
+  IN EFI_HANDLE       ImageHandle,
+  IN EFI_SYSTEM_TABLE *SystemTable
+  );
+
 #endif /* NV_PARAM_LIB_COMMON_H_ */
@@ -71,7 +71,7 @@ NVParamLibConstructor (
                   );
   ASSERT_EFI_ERROR (Status);
 
-  return Status;
+  return NVParamLibCacheConstructor (ImageHandle, SystemTable);
 }
 
 /**
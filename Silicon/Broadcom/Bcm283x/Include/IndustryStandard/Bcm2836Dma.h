@@ -0,0 +1,94 @@
+/** @file
+ *
+ *  System DMA controller (channels 0 to 14) register definitions.
+ *
+ *  SPDX-License-Identifier: BSD-2-Clause-Patent
+ *
+ **/
+
+#ifndef __BCM2836_DMA_H__
+#define __BCM2836_DMA_H__
+
+#include <IndustryStandard/Bcm2836.h>
+
+/*
+ * Peripherals, as seen by the DMA controller.
+ */
+#define BCM2836_DMA_PERIPHERAL_BUS_BASE     0x7E000000
+#define BCM2836_DMA_PERIPHERAL_BUS_ADDRESS(Address) \
+          ((UINT32)((Address) - BCM2836_SOC_REGISTERS) + BCM2836_DMA_PERIPHERAL_BUS_BASE)
+
+#define BCM2836_DMA_CHANNEL_COUNT           15
+#define BCM2836_DMA_CHANNEL_BASE(Channel) \
+          (BCM2836_DMA0_BASE_ADDRESS + (Channel) * BCM2836_DMA_CHANNEL_LENGTH)
+
+/* channel registers */
+#define BCM2836_DMA_CS                      0x00
+#define BCM2836_DMA_CONBLK_AD               0x04
+#define BCM2836_DMA_TI                      0x08
+#define BCM2836_DMA_SOURCE_AD               0x0C
+#define BCM2836_DMA_DEST_AD                 0x10
+#define BCM2836_DMA_TXFR_LEN                0x14
+#define BCM2836_DMA_STRIDE                  0x18
+#define BCM2836_DMA_NEXTCONBK               0x1C
+#define BCM2836_DMA_DEBUG                   0x20
+
+/* controller registers, relative to BCM2836_DMA_CTRL_BASE_ADDRESS */
+#define BCM2836_DMA_INT_STATUS              0x00
+#define BCM2836_DMA_ENABLE                  0x10
+
+#define BCM2836_DMA_CS_ACTIVE               BIT0
+#define BCM2836_DMA_CS_END                  BIT1
+#define BCM2836_DMA_CS_INT                  BIT2
+#define BCM2836_DMA_CS_DREQ                 BIT3
+#define BCM2836_DMA_CS_PAUSED               BIT4
+#define BCM2836_DMA_CS_ERROR                BIT8
+#define BCM2836_DMA_CS_PRIORITY(x)          (((x) & 0xF) << 16)
+#define BCM2836_DMA_CS_PANIC_PRIORITY(x)    (((x) & 0xF) << 20)
+#define BCM2836_DMA_CS_WAIT_FOR_WRITES      BIT28
+#define BCM2836_DMA_CS_DISDEBUG             BIT29
+#define BCM2836_DMA_CS_ABORT                BIT30
+#define BCM2836_DMA_CS_RESET                BIT31
+
+#define BCM2836_DMA_TI_INTEN                BIT0
+#define BCM2836_DMA_TI_WAIT_RESP            BIT3
+#define BCM2836_DMA_TI_DEST_INC             BIT4
+#define BCM2836_DMA_TI_DEST_WIDTH           BIT5
+#define BCM2836_DMA_TI_DEST_DREQ            BIT6
+#define BCM2836_DMA_TI_SRC_INC              BIT8
+#define BCM2836_DMA_TI_SRC_WIDTH            BIT9
+#define BCM2836_DMA_TI_SRC_DREQ             BIT10
+#define BCM2836_DMA_TI_BURST_LENGTH(x)      (((x) & 0xF) << 12)
+#define BCM2836_DMA_TI_PERMAP(x)            (((x) & 0x1F) << 16)
+#define BCM2836_DMA_TI_WAITS(x)             (((x) & 0x1F) << 21)
+#define BCM2836_DMA_TI_NO_WIDE_BURSTS       BIT26
+
+#define BCM2836_DMA_DEBUG_READ_LAST_NOT_SET BIT0
+#define BCM2836_DMA_DEBUG_FIFO_ERROR        BIT1
+#define BCM2836_DMA_DEBUG_READ_ERROR        BIT2
+#define BCM2836_DMA_DEBUG_LITE              BIT28
+
+/*
+ * Lite channels (7 and up) only have a 16-bit transfer length.
+ */
+#define BCM2836_DMA_MAX_LENGTH              0x3FFFFFFC
+#define BCM2836_DMA_LITE_MAX_LENGTH         0xFFFC
+
+/* peripheral DREQ lines */
+#define BCM2836_DMA_DREQ_EMMC               11
+#define BCM2836_DMA_DREQ_SDHOST             13
+
+/*
+ * Control blocks must be 32-byte aligned.
+ */
+typedef struct {
+  UINT32  TransferInformation;
+  UINT32  SourceAddress;
+  UINT32  DestinationAddress;
+  UINT32  TransferLength;
+  UINT32  Stride;
+  UINT32  NextControlBlock;
+  UINT32  Reserved[2];
+} BCM2836_DMA_CONTROL_BLOCK;
+
+#endif /* __BCM2836_DMA_H__ */
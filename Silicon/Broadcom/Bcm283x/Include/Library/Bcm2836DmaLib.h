@@ -0,0 +1,48 @@
+/** @file
+ *
+ *  Peripheral transfers using the system DMA controller.
+ *
+ *  SPDX-License-Identifier: BSD-2-Clause-Patent
+ *
+ **/
+
+#ifndef __BCM2836_DMA_LIB__
+#define __BCM2836_DMA_LIB__
+
+#include <IndustryStandard/Bcm2836Dma.h>
+
+typedef enum {
+  Bcm2836DmaFromDevice,
+  Bcm2836DmaToDevice
+} BCM2836_DMA_DIRECTION;
+
+/**
+  Move data between memory and a peripheral FIFO, paced by the
+  peripheral's DREQ line, and wait for the transfer to complete.
+
+  @param  Channel         DMA channel to use. It is reset before use.
+  @param  Dreq            Peripheral DREQ line pacing the transfer.
+  @param  Direction       Whether Buffer is the source or the destination.
+  @param  FifoAddress     CPU physical address of the peripheral FIFO register.
+  @param  Buffer          Memory side of the transfer.
+  @param  Length          Number of bytes to transfer, a multiple of 4.
+
+  @retval EFI_SUCCESS             The transfer completed.
+  @retval EFI_INVALID_PARAMETER   Channel or Length are not valid.
+  @retval EFI_BAD_BUFFER_SIZE     Length is too large for a single request.
+  @retval EFI_OUT_OF_RESOURCES    Buffer could not be mapped for DMA.
+  @retval EFI_TIMEOUT             The transfer did not complete in time.
+  @retval EFI_DEVICE_ERROR        The DMA controller reported an error.
+
+**/
+EFI_STATUS
+Bcm2836DmaTransfer (
+  IN  UINTN                 Channel,
+  IN  UINTN                 Dreq,
+  IN  BCM2836_DMA_DIRECTION Direction,
+  IN  UINTN                 FifoAddress,
+  IN  VOID                  *Buffer,
+  IN  UINTN                 Length
+  );
+
+#endif /* __BCM2836_DMA_LIB__ */
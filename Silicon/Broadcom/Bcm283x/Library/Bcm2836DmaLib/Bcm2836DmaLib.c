@@ -0,0 +1,205 @@
+/** @file
+ *
+ *  Peripheral transfers using the system DMA controller.
+ *
+ *  SPDX-License-Identifier: BSD-2-Clause-Patent
+ *
+ **/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/Bcm2836DmaLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DmaLib.h>
+#include <Library/IoLib.h>
+#include <Library/TimerLib.h>
+
+//
+// Allow 10ms per 512 bytes, which covers a 1-bit bus at 400KHz.
+//
+#define DMA_TIMEOUT_US(Length)    ((((Length) >> 9) + 1) * 10000)
+#define DMA_POLL_INTERVAL_US      1
+
+#define DMA_MAX_CONTROL_BLOCKS \
+          (EFI_PAGE_SIZE / sizeof (BCM2836_DMA_CONTROL_BLOCK))
+
+STATIC BCM2836_DMA_CONTROL_BLOCK  *mControlBlocks;
+STATIC EFI_PHYSICAL_ADDRESS       mControlBlocksBusAddress;
+STATIC VOID                       *mControlBlocksMapping;
+
+STATIC
+EFI_STATUS
+DmaInitControlBlocks (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+  UINTN      BufferSize;
+
+  if (mControlBlocks != NULL) {
+    return EFI_SUCCESS;
+  }
+
+  Status = DmaAllocateBuffer (EfiBootServicesData, 1, (VOID**)&mControlBlocks);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  BufferSize = EFI_PAGE_SIZE;
+  Status = DmaMap (MapOperationBusMasterCommonBuffer, mControlBlocks,
+             &BufferSize, &mControlBlocksBusAddress, &mControlBlocksMapping);
+  if (EFI_ERROR (Status)) {
+    DmaFreeBuffer (1, mControlBlocks);
+    mControlBlocks = NULL;
+    return Status;
+  }
+
+  ASSERT ((mControlBlocksBusAddress & (sizeof (BCM2836_DMA_CONTROL_BLOCK) - 1)) == 0);
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+DmaResetChannel (
+  IN  UINTN   ChannelBase
+  )
+{
+  MmioWrite32 (ChannelBase + BCM2836_DMA_CS, BCM2836_DMA_CS_RESET);
+  MmioWrite32 (ChannelBase + BCM2836_DMA_DEBUG,
+    BCM2836_DMA_DEBUG_READ_LAST_NOT_SET |
+    BCM2836_DMA_DEBUG_FIFO_ERROR |
+    BCM2836_DMA_DEBUG_READ_ERROR);
+}
+
+EFI_STATUS
+Bcm2836DmaTransfer (
+  IN  UINTN                 Channel,
+  IN  UINTN                 Dreq,
+  IN  BCM2836_DMA_DIRECTION Direction,
+  IN  UINTN                 FifoAddress,
+  IN  VOID                  *Buffer,
+  IN  UINTN                 Length
+  )
+{
+  EFI_STATUS                Status;
+  UINTN                     ChannelBase;
+  UINTN                     MaxLength;
+  UINTN                     BlockCount;
+  UINTN                     Index;
+  UINTN                     MappedLength;
+  UINTN                     Offset;
+  UINTN                     Timeout;
+  UINT32                    Cs;
+  UINT32                    TransferInformation;
+  UINT32                    FifoBusAddress;
+  EFI_PHYSICAL_ADDRESS      BufferBusAddress;
+  VOID                      *Mapping;
+  BCM2836_DMA_CONTROL_BLOCK *Cb;
+
+  if (Channel >= BCM2836_DMA_CHANNEL_COUNT ||
+      Length == 0 || (Length % sizeof (UINT32)) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ChannelBase = BCM2836_DMA_CHANNEL_BASE (Channel);
+  if ((MmioRead32 (ChannelBase + BCM2836_DMA_DEBUG) & BCM2836_DMA_DEBUG_LITE) != 0) {
+    MaxLength = BCM2836_DMA_LITE_MAX_LENGTH;
+  } else {
+    MaxLength = BCM2836_DMA_MAX_LENGTH;
+  }
+
+  BlockCount = (Length + MaxLength - 1) / MaxLength;
+  if (BlockCount > DMA_MAX_CONTROL_BLOCKS) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Status = DmaInitControlBlocks ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  MappedLength = Length;
+  Status = DmaMap (Direction == Bcm2836DmaToDevice ?
+             MapOperationBusMasterRead : MapOperationBusMasterWrite,
+             Buffer, &MappedLength, &BufferBusAddress, &Mapping);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (MappedLength < Length) {
+    DmaUnmap (Mapping);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  FifoBusAddress = BCM2836_DMA_PERIPHERAL_BUS_ADDRESS (FifoAddress);
+  if (Direction == Bcm2836DmaToDevice) {
+    TransferInformation = BCM2836_DMA_TI_DEST_DREQ | BCM2836_DMA_TI_SRC_INC;
+  } else {
+    TransferInformation = BCM2836_DMA_TI_SRC_DREQ | BCM2836_DMA_TI_DEST_INC;
+  }
+  TransferInformation |= BCM2836_DMA_TI_PERMAP (Dreq) | BCM2836_DMA_TI_WAIT_RESP;
+
+  //
+  // Chain as many control blocks as the channel's transfer length
+  // limit requires.
+  //
+  for (Index = 0, Offset = 0; Index < BlockCount; Index++, Offset += MaxLength) {
+    Cb = &mControlBlocks[Index];
+    ZeroMem (Cb, sizeof (*Cb));
+    Cb->TransferInformation = TransferInformation;
+    if (Direction == Bcm2836DmaToDevice) {
+      Cb->SourceAddress = (UINT32)(BufferBusAddress + Offset);
+      Cb->DestinationAddress = FifoBusAddress;
+    } else {
+      Cb->SourceAddress = FifoBusAddress;
+      Cb->DestinationAddress = (UINT32)(BufferBusAddress + Offset);
+    }
+    Cb->TransferLength = (UINT32)MIN (Length - Offset, MaxLength);
+    if (Index + 1 < BlockCount) {
+      Cb->NextControlBlock = (UINT32)(mControlBlocksBusAddress +
+                                      (Index + 1) * sizeof (*Cb));
+    }
+  }
+
+  MmioOr32 (BCM2836_DMA_CTRL_BASE_ADDRESS + BCM2836_DMA_ENABLE, 1U << Channel);
+  DmaResetChannel (ChannelBase);
+  MemoryFence ();
+
+  MmioWrite32 (ChannelBase + BCM2836_DMA_CONBLK_AD, (UINT32)mControlBlocksBusAddress);
+  MmioWrite32 (ChannelBase + BCM2836_DMA_CS,
+    BCM2836_DMA_CS_ACTIVE |
+    BCM2836_DMA_CS_WAIT_FOR_WRITES |
+    BCM2836_DMA_CS_PRIORITY (8) |
+    BCM2836_DMA_CS_PANIC_PRIORITY (8));
+
+  Status = EFI_TIMEOUT;
+  for (Timeout = DMA_TIMEOUT_US (Length); Timeout > 0; Timeout -= DMA_POLL_INTERVAL_US) {
+    Cs = MmioRead32 (ChannelBase + BCM2836_DMA_CS);
+    if ((Cs & BCM2836_DMA_CS_ERROR) != 0) {
+      DEBUG ((DEBUG_ERROR, "%a: channel %Lu error, DEBUG 0x%x\n", __FUNCTION__,
+        (UINT64)Channel, MmioRead32 (ChannelBase + BCM2836_DMA_DEBUG)));
+      Status = EFI_DEVICE_ERROR;
+      break;
+    }
+
+    if ((Cs & BCM2836_DMA_CS_END) != 0 && (Cs & BCM2836_DMA_CS_ACTIVE) == 0) {
+      Status = EFI_SUCCESS;
+      break;
+    }
+
+    MicroSecondDelay (DMA_POLL_INTERVAL_US);
+  }
+
+  if (Status == EFI_TIMEOUT) {
+    DEBUG ((DEBUG_ERROR, "%a: channel %Lu timed out, %u bytes left\n", __FUNCTION__,
+      (UINT64)Channel, MmioRead32 (ChannelBase + BCM2836_DMA_TXFR_LEN)));
+  }
+
+  //
+  // Leave the channel idle, aborting whatever did not complete.
+  //
+  DmaResetChannel (ChannelBase);
+  DmaUnmap (Mapping);
+  return Status;
+}
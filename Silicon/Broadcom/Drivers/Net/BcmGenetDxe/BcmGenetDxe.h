@@ -114,6 +114,7 @@
 #define GENET_DMA_DESC_COUNT                    256
 #define GENET_DMA_DESC_SIZE                     12
 #define GENET_DMA_DEFAULT_QUEUE                 16
+#define GENET_RX_COMPLETE_BATCH                 32
 
 #define GENET_DMA_RING_SIZE                     0x40
 #define GENET_DMA_RINGS_SIZE                    (GENET_DMA_RING_SIZE * (GENET_DMA_DEFAULT_QUEUE + 1))
@@ -218,15 +219,20 @@ typedef struct {
 
   UINT8                               *TxBuffer[GENET_DMA_DESC_COUNT];
   VOID                                *TxBufferMap[GENET_DMA_DESC_COUNT];
-  UINT8                               TxQueued;
+  UINT16                              TxQueued;
   UINT16                              TxNext;
   UINT16                              TxConsIndex;
   UINT16                              TxProdIndex;
+  UINT16                              TxCompleted;
 
   EFI_PHYSICAL_ADDRESS                RxBuffer;
   GENET_MAP_INFO                      RxBufferMap[GENET_DMA_DESC_COUNT];
   UINT16                              RxConsIndex;
   UINT16                              RxProdIndex;
+  UINT16                              RxPending;
+  UINT16                              RxCompleted;
+
+  EFI_NETWORK_STATISTICS              Stats;
 
   GENET_PHY_MODE                      PhyMode;
 
@@ -381,4 +387,9 @@ GenetRxComplete (
   IN GENET_PRIVATE_DATA *Genet
   );
 
+VOID
+GenetResetStatistics (
+  IN GENET_PRIVATE_DATA *Genet
+  );
+
 #endif /* GENET_UTIL_H__ */
@@ -133,6 +133,8 @@ GenetDriverBindingStart (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  GenetResetStatistics (Genet);
+
   Status = gBS->OpenProtocol (ControllerHandle,
                               &gBcmGenetPlatformDeviceProtocolGuid,
                               (VOID **)&Genet->Dev,
@@ -181,7 +183,7 @@ GenetDriverBindingStart (
   Genet->SnpMode.MCastFilterCount       = 0;
   Genet->SnpMode.IfType                 = NET_IFTYPE_ETHERNET;
   Genet->SnpMode.MacAddressChangeable   = TRUE;
-  Genet->SnpMode.MultipleTxSupported    = FALSE;
+  Genet->SnpMode.MultipleTxSupported    = TRUE;
   Genet->SnpMode.MediaPresentSupported  = TRUE;
   Genet->SnpMode.MediaPresent           = FALSE;
 
@@ -7,6 +7,7 @@
 **/
 
 #include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/DmaLib.h>
 #include <Library/IoLib.h>
@@ -547,9 +548,12 @@ GenetDmaInitRings (
   Genet->TxNext = 0;
   Genet->TxConsIndex = 0;
   Genet->TxProdIndex = 0;
+  Genet->TxCompleted = 0;
 
   Genet->RxConsIndex = 0;
   Genet->RxProdIndex = 0;
+  Genet->RxPending = 0;
+  Genet->RxCompleted = 0;
 
   // Configure TX queue
   GenetMmioWrite (Genet, GENET_TX_SCB_BURST_SIZE, 0x08);
@@ -744,6 +748,10 @@ GenetDmaTriggerTx (
 /**
   Simulate a "TX interrupt", return the next (completed) TX buffer to recycle.
 
+  The hardware consumer index is only sampled once the descriptors it reported
+  as completed on the previous sample have all been handed back, so draining
+  a full ring costs one register read per batch rather than one per buffer.
+
   @param  Genet[in]   Pointer to GENET_PRIVATE_DATA.
   @param  TxBuf[out]  Location to store pointer to next TX buffer to recycle.
 
@@ -754,15 +762,18 @@ GenetTxIntr (
   OUT VOID               **TxBuf
   )
 {
-  UINT32 Total;
+  if (Genet->TxCompleted == 0 && Genet->TxQueued > 0) {
+    Genet->TxCompleted = (UINT16)MIN (GenetTxPending (Genet), Genet->TxQueued);
+  }
 
-  Total = GenetTxPending (Genet);
-  if (Genet->TxQueued > 0 && Total > 0) {
+  if (Genet->TxCompleted > 0) {
     DmaUnmap (Genet->TxBufferMap[Genet->TxNext]);
     *TxBuf = Genet->TxBuffer[Genet->TxNext];
     Genet->TxQueued--;
+    Genet->TxCompleted--;
     Genet->TxNext = (Genet->TxNext + 1) % GENET_DMA_DESC_COUNT;
     Genet->TxConsIndex = (Genet->TxConsIndex + 1) & 0xFFFF;
+    Genet->Stats.TxGoodFrames++;
   } else {
     *TxBuf = NULL;
   }
@@ -776,9 +787,13 @@ GenetRxPending (
   UINT32 ProdIndex;
   UINT32 ConsIndex;
 
+  //
+  // Descriptors consumed since the last batch was returned to the hardware
+  // have not been reflected in the CONS_INDEX register yet.
+  //
   ConsIndex = GenetMmioRead (Genet,
                 GENET_RX_DMA_CONS_INDEX (GENET_DMA_DEFAULT_QUEUE)) & 0xFFFF;
-  ASSERT (ConsIndex == Genet->RxConsIndex);
+  ASSERT (ConsIndex == ((Genet->RxConsIndex - Genet->RxCompleted) & 0xFFFF));
 
   ProdIndex = GenetMmioRead (Genet,
                 GENET_RX_DMA_PROD_INDEX (GENET_DMA_DEFAULT_QUEUE)) & 0xFFFF;
@@ -798,14 +813,34 @@ GenetTxPending (
   return (ConsIndex - Genet->TxConsIndex) & 0xFFFF;
 }
 
+/**
+  Retire the RX descriptor returned by the last call to GenetRxIntr.
+
+  Retired descriptors are handed back to the hardware in batches: the
+  CONS_INDEX register is written once the current batch of received frames
+  has been drained, or once GENET_RX_COMPLETE_BATCH descriptors are
+  outstanding, whichever comes first.
+
+  @param  Genet[in]  Pointer to GENET_PRIVATE_DATA.
+
+**/
 VOID
 GenetRxComplete (
   IN GENET_PRIVATE_DATA *Genet
   )
 {
+  ASSERT (Genet->RxPending > 0);
+
   Genet->RxConsIndex = (Genet->RxConsIndex + 1) & 0xFFFF;
-  GenetMmioWrite (Genet, GENET_RX_DMA_CONS_INDEX (GENET_DMA_DEFAULT_QUEUE),
-                  Genet->RxConsIndex);
+  Genet->RxPending--;
+  Genet->RxCompleted++;
+
+  if (Genet->RxPending == 0 ||
+      Genet->RxCompleted >= GENET_RX_COMPLETE_BATCH) {
+    GenetMmioWrite (Genet, GENET_RX_DMA_CONS_INDEX (GENET_DMA_DEFAULT_QUEUE),
+                    Genet->RxConsIndex);
+    Genet->RxCompleted = 0;
+  }
 }
 
 /**
@@ -828,11 +863,17 @@ GenetRxIntr (
   )
 {
   EFI_STATUS    Status;
-  UINT32        Total;
   UINT32        DescStatus;
 
-  Total = GenetRxPending (Genet);
-  if (Total > 0) {
+  //
+  // Harvest everything the hardware has completed in one go; subsequent calls
+  // are served from the cached count without touching PROD_INDEX.
+  //
+  if (Genet->RxPending == 0) {
+    Genet->RxPending = (UINT16)GenetRxPending (Genet);
+  }
+
+  if (Genet->RxPending > 0) {
     *DescIndex = Genet->RxConsIndex % GENET_DMA_DESC_COUNT;
     DescStatus = GenetMmioRead (Genet, GENET_RX_DESC_STATUS (*DescIndex));
     *FrameLength = SHIFTOUT (DescStatus, GENET_RX_DESC_STATUS_BUFLEN);
@@ -843,3 +884,32 @@ GenetRxIntr (
 
   return Status;
 }
+
+/**
+  Reset the SNP statistics. The counters the driver does not keep are set
+  to all ones, which the UEFI specification uses to mark them unsupported.
+
+  @param  Genet[in]   Pointer to GENET_PRIVATE_DATA.
+
+**/
+VOID
+GenetResetStatistics (
+  IN GENET_PRIVATE_DATA *Genet
+  )
+{
+  EFI_NETWORK_STATISTICS  *Stats;
+
+  Stats = &Genet->Stats;
+  SetMem (Stats, sizeof (EFI_NETWORK_STATISTICS), 0xFF);
+  Stats->RxTotalFrames = 0;
+  Stats->RxGoodFrames = 0;
+  Stats->RxUndersizeFrames = 0;
+  Stats->RxDroppedFrames = 0;
+  Stats->RxUnicastFrames = 0;
+  Stats->RxBroadcastFrames = 0;
+  Stats->RxMulticastFrames = 0;
+  Stats->RxTotalBytes = 0;
+  Stats->TxTotalFrames = 0;
+  Stats->TxGoodFrames = 0;
+  Stats->TxTotalBytes = 0;
+}
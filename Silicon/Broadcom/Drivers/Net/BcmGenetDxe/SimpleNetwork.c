@@ -412,7 +412,44 @@ GenetSimpleNetworkStatistics (
   OUT EFI_NETWORK_STATISTICS     *StatisticsTable OPTIONAL
   )
 {
-  return EFI_UNSUPPORTED;
+  GENET_PRIVATE_DATA  *Genet;
+  EFI_STATUS          Status;
+
+  if (This == NULL || (StatisticsTable != NULL && StatisticsSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Genet = GENET_PRIVATE_DATA_FROM_SNP_THIS (This);
+  if (Genet->SnpMode.State == EfiSimpleNetworkStopped) {
+    return EFI_NOT_STARTED;
+  }
+  if (Genet->SnpMode.State != EfiSimpleNetworkInitialized) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Status = EfiAcquireLockOrFail (&Genet->Lock);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Couldn't get lock: %r\n", __FUNCTION__, Status));
+    return EFI_ACCESS_DENIED;
+  }
+
+  Status = EFI_SUCCESS;
+  if (StatisticsTable != NULL) {
+    if (*StatisticsSize < sizeof (EFI_NETWORK_STATISTICS)) {
+      Status = EFI_BUFFER_TOO_SMALL;
+    } else {
+      CopyMem (StatisticsTable, &Genet->Stats, sizeof (EFI_NETWORK_STATISTICS));
+    }
+    *StatisticsSize = sizeof (EFI_NETWORK_STATISTICS);
+  }
+
+  if (Reset && !EFI_ERROR (Status)) {
+    GenetResetStatistics (Genet);
+  }
+
+  EfiReleaseLock (&Genet->Lock);
+
+  return Status;
 }
 
 /**
@@ -655,6 +692,9 @@ GenetSimpleNetworkTransmit (
   GenetDmaTriggerTx (Genet, Desc, DmaDeviceAddress, DmaNumberOfBytes);
   Genet->TxQueued++;
 
+  Genet->Stats.TxTotalFrames++;
+  Genet->Stats.TxTotalBytes += BufferSize;
+
   EfiReleaseLock (&Genet->Lock);
 
   return EFI_SUCCESS;
@@ -738,23 +778,31 @@ GenetSimpleNetworkReceive (
 
   ASSERT (Genet->RxBufferMap[DescIndex].Mapping != NULL);
 
+  //
+  // Leave an oversized frame on the ring so that the caller can retry with a
+  // buffer of the size reported back.
+  //
+  if (FrameLength > 2 + Genet->SnpMode.MediaHeaderSize &&
+      *BufferSize < FrameLength - 2) {
+    DEBUG ((DEBUG_ERROR,
+      "%a: Buffer size (0x%X) is too small for frame (0x%X)\n",
+      __FUNCTION__, *BufferSize, FrameLength - 2));
+    *BufferSize = FrameLength - 2;
+    EfiReleaseLock (&Genet->Lock);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
   GenetDmaUnmapRxDescriptor (Genet, DescIndex);
 
   Frame = GENET_RX_BUFFER (Genet, DescIndex);
 
+  Genet->Stats.RxTotalFrames++;
+
   if (FrameLength > 2 + Genet->SnpMode.MediaHeaderSize) {
     // Received frame has 2 bytes of padding at the start
     Frame += 2;
     FrameLength -= 2;
 
-    if (*BufferSize < FrameLength) {
-      DEBUG ((DEBUG_ERROR,
-        "%a: Buffer size (0x%X) is too small for frame (0x%X)\n",
-        __FUNCTION__, *BufferSize, FrameLength));
-      Status = EFI_BUFFER_TOO_SMALL;
-      goto out;
-    }
-
     if (DestAddr != NULL) {
       CopyMem (&DestAddr->Addr[0], &Frame[0], NET_ETHER_ADDR_LEN);
     }
@@ -771,16 +819,27 @@ GenetSimpleNetworkReceive (
     CopyMem (Buffer, Frame, FrameLength);
     *BufferSize = FrameLength;
 
+    Genet->Stats.RxGoodFrames++;
+    Genet->Stats.RxTotalBytes += FrameLength;
+    if ((Frame[0] & 0x01) == 0) {
+      Genet->Stats.RxUnicastFrames++;
+    } else if (CompareMem (&Frame[0], &Genet->SnpMode.BroadcastAddress,
+                 NET_ETHER_ADDR_LEN) == 0) {
+      Genet->Stats.RxBroadcastFrames++;
+    } else {
+      Genet->Stats.RxMulticastFrames++;
+    }
+
     Status = EFI_SUCCESS;
   } else {
     DEBUG ((DEBUG_ERROR, "%a: Short packet (FrameLength 0x%X)",
       __FUNCTION__, FrameLength));
+    Genet->Stats.RxUndersizeFrames++;
+    Genet->Stats.RxDroppedFrames++;
     Status = EFI_NOT_READY;
   }
 
-out:
-  Status = GenetDmaMapRxDescriptor (Genet, DescIndex);
-  if (EFI_ERROR (Status)) {
+  if (EFI_ERROR (GenetDmaMapRxDescriptor (Genet, DescIndex))) {
     DEBUG ((DEBUG_ERROR, "%a: Failed to remap RX descriptor!\n", __FUNCTION__));
   }
 
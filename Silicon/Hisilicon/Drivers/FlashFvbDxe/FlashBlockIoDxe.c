@@ -95,9 +95,6 @@ FlashBlockIoFlushBlocks (
     IN EFI_BLOCK_IO_PROTOCOL*  This
 )
 {
-    // No Flush required for the NOR Flash driver
-    // because cache operations are not permitted.
-
-    // Nothing to do so just return without error
-    return EFI_SUCCESS;
+    // Write back the block the mirror is still combining changes for
+    return FlashFlushCache (INSTANCE_FROM_BLKIO_THIS(This));
 }
@@ -11,7 +11,12 @@
 
 #include "FlashFvbDxe.h"
 STATIC EFI_EVENT mFlashFvbVirtualAddrChangeEvent;
+STATIC EFI_EVENT mFlashFvbExitBootServicesEvent;
 STATIC UINTN     mFlashNvStorageVariableBase;
+STATIC UINT32    mFlashInstanceCount;
+
+// Once the OS owns the machine nothing is left pending between calls
+STATIC BOOLEAN   mFlashWriteThrough;
 
 
 //
@@ -102,6 +107,263 @@ FLASH_INSTANCE  mFlashInstanceTemplate =
 
 HISI_SPI_FLASH_PROTOCOL* mFlash;
 
+STATIC
+BOOLEAN
+FlashBlockIsBlank (
+    IN UINT8*                 Block,
+    IN UINTN                  BlockSize
+)
+{
+    UINT64*     Word;
+    UINTN       Count;
+
+    Word = (UINT64*)Block;
+    for (Count = BlockSize / sizeof (UINT64); Count > 0; Count--, Word++)
+    {
+        if (*Word != MAX_UINT64)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+  Write the pending block of the mirror back to NOR: a single erase if
+  one was requested, then a single program of the range that changed.
+
+  If NOR could not be updated, the block is read back into the mirror
+  so that the two agree again.
+**/
+EFI_STATUS
+FlashFlushCache (
+    IN FLASH_INSTANCE*        Instance
+)
+{
+    EFI_STATUS      Status;
+    UINTN           BlockSize;
+    UINTN           BlockOffset;
+    UINTN           Address;
+    UINTN           Start;
+    UINTN           End;
+    UINT8*          Block;
+
+    if ((Instance->Mirror == NULL) || (Instance->DirtyBlock == FLASH_NO_DIRTY_BLOCK))
+    {
+        return EFI_SUCCESS;
+    }
+
+    Status = EFI_SUCCESS;
+    BlockSize = Instance->Media.BlockSize;
+    BlockOffset = Instance->DirtyBlock * BlockSize;
+    Block = Instance->Mirror + BlockOffset;
+    Address = Instance->RegionBaseAddress - Instance->DeviceBaseAddress + BlockOffset;
+
+    if (Instance->DirtyErase)
+    {
+        Status = FlashUnlockAndEraseSingleBlock (Instance, Instance->RegionBaseAddress + BlockOffset);
+        Instance->Stats.Erases++;
+
+        // Everything that is not blank has to be programmed again
+        Start = 0;
+        End = BlockSize;
+        while ((End > 0) && (Block[End - 1] == 0xFF))
+        {
+            End--;
+        }
+    }
+    else
+    {
+        Start = Instance->DirtyStart;
+        End = Instance->DirtyEnd;
+    }
+
+    if (!EFI_ERROR(Status) && (End > Start))
+    {
+        Status = mFlash->Write(mFlash, (UINT32)(Address + Start), Block + Start, (UINT32)(End - Start));
+        Instance->Stats.Programs++;
+    }
+
+    Instance->DirtyBlock = FLASH_NO_DIRTY_BLOCK;
+
+    if (EFI_ERROR(Status))
+    {
+        DEBUG((EFI_D_ERROR, "[%a]:[%dL] Flush of block %Lu failed: %r\n", __FUNCTION__, __LINE__, (UINT64)(BlockOffset / BlockSize), Status));
+        if (EFI_ERROR(mFlash->Read(mFlash, (UINT32)Address, Block, (UINT32)BlockSize)))
+        {
+            // The mirror can no longer be trusted, fall back to NOR.
+            // Pool cannot be freed from ExitBootServices on, as that
+            // would change the memory map or call into boot services.
+            if (!mFlashWriteThrough)
+            {
+                FreePool (Instance->Mirror);
+            }
+            Instance->Mirror = NULL;
+        }
+        return EFI_DEVICE_ERROR;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Program a range of the region through the mirror. Programming can
+  only clear bits, so the mirror keeps the AND of old and new data,
+  just like NOR does.
+**/
+STATIC
+EFI_STATUS
+FlashCacheWrite (
+    IN FLASH_INSTANCE*        Instance,
+    IN UINTN                  RegionOffset,
+    IN UINTN                  Length,
+    IN UINT8*                 Buffer
+)
+{
+    EFI_STATUS      Status;
+    UINTN           BlockSize;
+    UINTN           Block;
+    UINTN           Offset;
+    UINTN           Count;
+    UINTN           Index;
+    UINTN           First;
+    UINTN           Last;
+    UINT8*          Data;
+    UINT8           Value;
+
+    BlockSize = Instance->Media.BlockSize;
+
+    while (Length > 0)
+    {
+        Block = RegionOffset / BlockSize;
+        Offset = RegionOffset % BlockSize;
+        Count = MIN (Length, BlockSize - Offset);
+
+        if (Instance->DirtyBlock != Block)
+        {
+            Status = FlashFlushCache (Instance);
+            if (EFI_ERROR(Status))
+            {
+                return Status;
+            }
+        }
+
+        First = Count;
+        Last = 0;
+        Data = Instance->Mirror + RegionOffset;
+        for (Index = 0; Index < Count; Index++)
+        {
+            Value = Data[Index] & Buffer[Index];
+            if (Value != Data[Index])
+            {
+                Data[Index] = Value;
+                First = MIN (First, Index);
+                Last = Index;
+            }
+        }
+
+        if (First == Count)
+        {
+            Instance->Stats.WritesSkipped++;
+        }
+        else if (Instance->DirtyBlock == FLASH_NO_DIRTY_BLOCK)
+        {
+            Instance->DirtyBlock = Block;
+            Instance->DirtyErase = FALSE;
+            Instance->DirtyStart = Offset + First;
+            Instance->DirtyEnd = Offset + Last + 1;
+        }
+        else
+        {
+            Instance->DirtyStart = MIN (Instance->DirtyStart, Offset + First);
+            Instance->DirtyEnd = MAX (Instance->DirtyEnd, Offset + Last + 1);
+        }
+
+        RegionOffset += Count;
+        Buffer += Count;
+        Length -= Count;
+    }
+
+    if (mFlashWriteThrough)
+    {
+        return FlashFlushCache (Instance);
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Erase a block through the mirror. Nothing reaches NOR until the
+  block is flushed, and not even then if it was already blank.
+**/
+STATIC
+EFI_STATUS
+FlashCacheEraseBlock (
+    IN FLASH_INSTANCE*        Instance,
+    IN UINTN                  BlockAddress
+)
+{
+    EFI_STATUS      Status;
+    UINTN           BlockSize;
+    UINTN           Block;
+    UINT8*          Data;
+
+    if (Instance->Mirror == NULL)
+    {
+        Instance->Stats.EraseRequests++;
+        Instance->Stats.Erases++;
+        return FlashUnlockAndEraseSingleBlock (Instance, BlockAddress);
+    }
+
+    BlockSize = Instance->Media.BlockSize;
+    Block = (BlockAddress - Instance->RegionBaseAddress) / BlockSize;
+    Data = Instance->Mirror + Block * BlockSize;
+    Instance->Stats.EraseRequests++;
+
+    if (Instance->DirtyBlock != Block)
+    {
+        Status = FlashFlushCache (Instance);
+        if (EFI_ERROR(Status))
+        {
+            return Status;
+        }
+
+        if (FlashBlockIsBlank (Data, BlockSize))
+        {
+            return EFI_SUCCESS;
+        }
+    }
+
+    SetMem (Data, BlockSize, 0xFF);
+    Instance->DirtyBlock = Block;
+    Instance->DirtyErase = TRUE;
+
+    if (mFlashWriteThrough)
+    {
+        return FlashFlushCache (Instance);
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+FlashFlushAll (
+    VOID
+)
+{
+    UINT32          Index;
+
+    for (Index = 0; Index < mFlashInstanceCount; Index++)
+    {
+        if (mFlashInstances[Index] != NULL)
+        {
+            FlashFlushCache (mFlashInstances[Index]);
+        }
+    }
+}
+
 ///
 /// The Firmware Volume Block Protocol is the low-level interface
 /// to a firmware volume. File-level access to a firmware volume
@@ -548,6 +810,13 @@ FvbRead (
                                      );
     ReadAddress = StartAddress - Instance->DeviceBaseAddress + Offset;
 
+    if (Instance->Mirror != NULL)
+    {
+        CopyMem (Buffer, Instance->Mirror + (StartAddress - Instance->RegionBaseAddress + Offset), *NumBytes);
+        Instance->Stats.MirrorReads++;
+        return EFI_SUCCESS;
+    }
+
     Status = mFlash->Read(mFlash, (UINT32)ReadAddress, Buffer, *NumBytes);
     if (EFI_SUCCESS != Status)
     {
@@ -680,6 +949,11 @@ FvbWrite (
     BlockAddress = GET_BLOCK_ADDRESS (Instance->RegionBaseAddress, Lba, BlockSize);
     WriteAddress = BlockAddress - Instance->DeviceBaseAddress + Offset;
 
+    if (Instance->Mirror != NULL)
+    {
+        return FlashCacheWrite (Instance, BlockAddress - Instance->RegionBaseAddress + Offset, *NumBytes, Buffer);
+    }
+
     Status = mFlash->Write(mFlash, (UINT32)WriteAddress, (UINT8*)Buffer, *NumBytes);
     if (EFI_SUCCESS != Status)
     {
@@ -819,7 +1093,7 @@ FvbEraseBlocks (
 
             // Erase it
 
-            Status = FlashUnlockAndEraseSingleBlock (Instance, BlockAddress);
+            Status = FlashCacheEraseBlock (Instance, BlockAddress);
             if (EFI_ERROR(Status))
             {
                 VA_END (Args);
@@ -934,6 +1208,20 @@ FlashCreateInstance (
 
     CopyGuid (&Instance->DevicePath.Vendor.Guid, FlashGuid);
 
+    // Reads are served from DRAM from now on, so load the whole region once
+    Instance->DirtyBlock = FLASH_NO_DIRTY_BLOCK;
+    Instance->Mirror = AllocateRuntimePool (FlashSize);
+    if (Instance->Mirror != NULL)
+    {
+        Status = mFlash->Read(mFlash, (UINT32)(FlashRegionBase - FlashDeviceBase), Instance->Mirror, (UINT32)FlashSize);
+        if (EFI_ERROR(Status))
+        {
+            DEBUG((EFI_D_ERROR, "[%a]:[%dL] Fail to mirror flash: %r\n", __FUNCTION__, __LINE__, Status));
+            FreePool (Instance->Mirror);
+            Instance->Mirror = NULL;
+        }
+    }
+
     if (SupportFvb)
     {
         Instance->SupportFvb = TRUE;
@@ -949,6 +1237,10 @@ FlashCreateInstance (
 
         if (EFI_ERROR(Status))
         {
+            if (Instance->Mirror != NULL)
+            {
+                FreePool(Instance->Mirror);
+            }
             FreePool(Instance);
             return Status;
         }
@@ -965,6 +1257,10 @@ FlashCreateInstance (
                  );
         if (EFI_ERROR(Status))
         {
+            if (Instance->Mirror != NULL)
+            {
+                FreePool(Instance->Mirror);
+            }
             FreePool(Instance);
             return Status;
         }
@@ -1088,6 +1384,11 @@ FlashWriteBlocks (
 
     WriteAddress = BlockAddress - Instance->DeviceBaseAddress;
 
+    if (Instance->Mirror != NULL)
+    {
+        return FlashCacheWrite (Instance, BlockAddress - Instance->RegionBaseAddress, BufferSizeInBytes, Buffer);
+    }
+
     Status = mFlash->Write(mFlash, (UINT32)WriteAddress, (UINT8*)Buffer, BufferSizeInBytes);
     if (EFI_SUCCESS != Status)
     {
@@ -1146,6 +1447,13 @@ FlashReadBlocks (
 
     ReadAddress = StartAddress - Instance->DeviceBaseAddress;
 
+    if (Instance->Mirror != NULL)
+    {
+        CopyMem (Buffer, Instance->Mirror + (StartAddress - Instance->RegionBaseAddress), BufferSizeInBytes);
+        Instance->Stats.MirrorReads++;
+        return EFI_SUCCESS;
+    }
+
     Status = mFlash->Read(mFlash, (UINT32)ReadAddress, Buffer, BufferSizeInBytes);
     if (EFI_SUCCESS != Status)
     {
@@ -1163,11 +1471,83 @@ FlashFvbVirtualNotifyEvent (
   IN VOID             *Context
   )
 {
+  UINT32 Index;
+
+  mFlashWriteThrough = TRUE;
+  for (Index = 0; Index < mFlashInstanceCount; Index++) {
+    if (mFlashInstances[Index] != NULL) {
+      EfiConvertPointer (0x0, (VOID**)&mFlashInstances[Index]->Mirror);
+    }
+  }
+
   EfiConvertPointer (0x0, (VOID**)&mFlash);
   EfiConvertPointer (0x0, (VOID**)&mFlashNvStorageVariableBase);
   return;
 }
 
+STATIC
+VOID
+EFIAPI
+FlashFvbExitBootServicesEvent (
+  IN EFI_EVENT        Event,
+  IN VOID             *Context
+  )
+{
+  UINT32          Index;
+  FLASH_INSTANCE* Instance;
+
+  mFlashWriteThrough = TRUE;
+  FlashFlushAll ();
+
+  for (Index = 0; Index < mFlashInstanceCount; Index++) {
+    Instance = mFlashInstances[Index];
+    if (Instance == NULL) {
+      continue;
+    }
+
+    DEBUG ((EFI_D_INFO, "Flash[%d]: %lu mirror reads, %lu skipped writes, %lu programs, %lu of %lu erases avoided\n",
+      Index,
+      (UINT64)Instance->Stats.MirrorReads,
+      (UINT64)Instance->Stats.WritesSkipped,
+      (UINT64)Instance->Stats.Programs,
+      (UINT64)(Instance->Stats.EraseRequests - Instance->Stats.Erases),
+      (UINT64)Instance->Stats.EraseRequests));
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+FlashFvbResetNotify (
+  IN EFI_RESET_TYPE   ResetType,
+  IN EFI_STATUS       ResetStatus,
+  IN UINTN            DataSize,
+  IN VOID             *ResetData OPTIONAL
+  )
+{
+  FlashFlushAll ();
+}
+
+STATIC
+VOID
+EFIAPI
+FlashFvbOnResetNotificationInstall (
+  IN EFI_EVENT        Event,
+  IN VOID             *Context
+  )
+{
+  EFI_STATUS                      Status;
+  EFI_RESET_NOTIFICATION_PROTOCOL *ResetNotify;
+
+  Status = gBS->LocateProtocol (&gEfiResetNotificationProtocolGuid, NULL, (VOID **)&ResetNotify);
+  if (!EFI_ERROR (Status)) {
+    Status = ResetNotify->RegisterResetNotify (ResetNotify, FlashFvbResetNotify);
+    ASSERT_EFI_ERROR (Status);
+
+    gBS->CloseEvent (Event);
+  }
+}
+
 EFI_STATUS
 EFIAPI
 FlashFvbInitialize (
@@ -1180,6 +1560,8 @@ FlashFvbInitialize (
     FLASH_DESCRIPTION*      FlashDevices;
     UINT32                  FlashDeviceCount;
     BOOLEAN                 ContainVariableStorage;
+    EFI_EVENT               ResetNotifyEvent;
+    VOID*                   Registration;
 
 
     Status = FlashPlatformGetDevices (&FlashDevices, &FlashDeviceCount);
@@ -1189,7 +1571,13 @@ FlashFvbInitialize (
         return Status;
     }
 
-    mFlashInstances = AllocatePool ((UINT32)(sizeof(FLASH_INSTANCE*) * FlashDeviceCount));
+    // Kept in runtime memory: the notify events walk it after ExitBootServices
+    mFlashInstances = AllocateRuntimeZeroPool ((UINT32)(sizeof(FLASH_INSTANCE*) * FlashDeviceCount));
+    if (mFlashInstances == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    mFlashInstanceCount = FlashDeviceCount;
 
     Status = gBS->LocateProtocol (&gHisiSpiFlashProtocolGuid, NULL, (VOID*) &mFlash);
     if (EFI_ERROR(Status))
@@ -1233,5 +1621,28 @@ FlashFvbInitialize (
                   );
     ASSERT_EFI_ERROR (Status);
 
+    //
+    // Nothing may be left pending in the mirror once the OS takes over
+    // or the system resets
+    //
+    Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  FlashFvbExitBootServicesEvent,
+                  NULL,
+                  &gEfiEventExitBootServicesGuid,
+                  &mFlashFvbExitBootServicesEvent
+                  );
+    ASSERT_EFI_ERROR (Status);
+
+    ResetNotifyEvent = EfiCreateProtocolNotifyEvent (
+                           &gEfiResetNotificationProtocolGuid,
+                           TPL_CALLBACK,
+                           FlashFvbOnResetNotificationInstall,
+                           NULL,
+                           &Registration
+                       );
+    ASSERT (ResetNotifyEvent != NULL);
+
     return Status;
 }
@@ -32,6 +32,7 @@
 
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/UefiRuntimeLib.h>
+#include <Protocol/ResetNotification.h>
 
 #include <Guid/VariableFormat.h>
 #include <Guid/SystemNvDataGuid.h>
@@ -53,6 +54,18 @@ typedef struct
 
 #define GET_BLOCK_ADDRESS(BaseAddr,Lba,LbaSize)( BaseAddr + (UINTN)((Lba) * LbaSize) )
 
+// No block of the mirror has changes waiting to be written to NOR
+#define FLASH_NO_DIRTY_BLOCK                  MAX_UINTN
+
+typedef struct
+{
+    UINTN       MirrorReads;      // Reads served from the DRAM mirror
+    UINTN       EraseRequests;    // Blocks callers asked to erase
+    UINTN       Erases;           // Blocks actually erased on NOR
+    UINTN       WritesSkipped;    // Writes that left the contents unchanged
+    UINTN       Programs;         // Program operations issued to NOR
+} FLASH_STATS;
+
 #define FLASH_SIGNATURE                       SIGNATURE_32('s', 'p', 'i', '0')
 #define INSTANCE_FROM_FVB_THIS(a)             CR(a, FLASH_INSTANCE, FvbProtocol, FLASH_SIGNATURE)
 #define INSTANCE_FROM_BLKIO_THIS(a)           CR(a, FLASH_INSTANCE, BlockIoProtocol, FLASH_SIGNATURE)
@@ -87,6 +100,17 @@ struct _FLASH_INSTANCE
     EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL FvbProtocol;
 
     FLASH_DEVICE_PATH                   DevicePath;
+
+    // DRAM copy of the region, NULL when reads and writes go to NOR directly
+    UINT8*                              Mirror;
+
+    // The one block whose erase and program operations are being combined
+    UINTN                               DirtyBlock;
+    BOOLEAN                             DirtyErase;
+    UINTN                               DirtyStart;
+    UINTN                               DirtyEnd;
+
+    FLASH_STATS                         Stats;
 };
 
 
@@ -219,4 +243,9 @@ FlashReadBlocks (
     OUT VOID*                Buffer
 );
 
+EFI_STATUS
+FlashFlushCache (
+    IN FLASH_INSTANCE*       Instance
+);
+
 #endif
@@ -185,6 +185,9 @@
 #define lower_32_bits(n) ((UINT32)(n))
 #define MAX_TARGET_ID 4
 
+// Poll period of the completion queues while non-blocking commands are outstanding
+#define SAS_POLL_INTERVAL              EFI_TIMER_PERIOD_MILLISECONDS (1)
+
 // Generic HW DMA host memory structures
 struct hisi_sas_cmd_hdr {
     UINT32 dw0;
@@ -257,6 +260,20 @@ UINT32 status[260];
 
 struct hisi_sas_slot {
     BOOLEAN used;
+    BOOLEAN done;
+    BOOLEAN sense;
+    UINT8 target;
+    EFI_STATUS status;
+    EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET *packet;
+    EFI_EVENT event;
+    VOID *buffer_map;
+    UINT64 start;
+};
+
+struct hisi_sas_target_stats {
+    UINT64 cmds;
+    UINT64 total_ns;
+    UINT64 max_ns;
 };
 
 struct hisi_hba {
@@ -269,6 +286,8 @@ struct hisi_hba {
     struct hisi_sas_itct         *itct;
     struct hisi_sas_breakpoint   *breakpoint;
     struct hisi_sas_slot         *slots;
+    struct hisi_sas_target_stats stats[MAX_TARGET_ID];
+    UINT32 outstanding;
     UINT32 base;
     int queue;
     int port_id;
@@ -291,14 +310,129 @@ typedef struct {
     SAS_V1_TRANSPORT_DEVICE_PATH    *DevicePath;
     struct hisi_hba *hba;
     EFI_EVENT TimerEvent;
+    EFI_EVENT ExitBootServicesEvent;
 } SAS_V1_INFO;
 
 #define SAS_DEVICE_SIGNATURE SIGNATURE_32 ('S','A','S','0')
 #define SAS_FROM_PASS_THRU(a) CR (a, SAS_V1_INFO, ExtScsiPassThru, SAS_DEVICE_SIGNATURE)
 
+// Called at TPL_NOTIFY for each entry taken off a completion queue
+STATIC VOID slot_complete (
+  struct hisi_hba *hba,
+  UINT32 slot_idx,
+  UINT32 data
+  )
+{
+  struct hisi_sas_slot *slot;
+  struct hisi_sas_sts *sts;
+  struct hisi_sas_target_stats *stats;
+  EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET *Packet;
+  EFI_SCSI_SENSE_DATA *SensePtr;
+  UINT64 ns;
+  UINT8 *p;
+
+  if (slot_idx >= SLOT_ENTRIES || !hba->slots[slot_idx].used) {
+    DEBUG ((EFI_D_ERROR, "sas completion for idle slot %d\n", slot_idx));
+    return;
+  }
+
+  slot = &hba->slots[slot_idx];
+  sts = &hba->status_buf[slot_idx / QUEUE_SLOTS][slot_idx % QUEUE_SLOTS];
+  Packet = slot->packet;
+  slot->status = EFI_SUCCESS;
+
+  // Check whether dma transfer error
+  if ((data & CMPLT_HDR_ERR_RCRD_XFRD_MSK) &&
+    !(data & CMPLT_HDR_RSPNS_XFRD_MSK)) {
+    DEBUG ((EFI_D_VERBOSE, "sas retry data=0x%x\n", data));
+    DEBUG ((EFI_D_VERBOSE, "sts[0]=0x%x\n", sts->status[0]));
+    DEBUG ((EFI_D_VERBOSE, "sts[1]=0x%x\n", sts->status[1]));
+    DEBUG ((EFI_D_VERBOSE, "sts[2]=0x%x\n", sts->status[2]));
+    slot->status = EFI_NOT_READY;
+  }
+
+  if (slot->buffer_map) {
+    DmaUnmap (slot->buffer_map);
+    slot->buffer_map = NULL;
+  }
+
+  p = (UINT8 *)&sts->status[0];
+  slot->sense = p[SENSE_DATA_PRES] != 0;
+  SensePtr = Packet->SenseData;
+  if (slot->sense && SensePtr != NULL) {
+    // Disk not ready normal return for ScsiDiskTestUnitReady do next try
+    SensePtr->Sense_Key = EFI_SCSI_SK_NOT_READY;
+    SensePtr->Addnl_Sense_Code = EFI_SCSI_ASC_NOT_READY;
+    SensePtr->Addnl_Sense_Code_Qualifier = EFI_SCSI_ASCQ_IN_PROGRESS;
+  }
+
+  if (slot->target < MAX_TARGET_ID) {
+    ns = GetTimeInNanoSecond (GetPerformanceCounter () - slot->start);
+    stats = &hba->stats[slot->target];
+    stats->cmds++;
+    stats->total_ns += ns;
+    stats->max_ns = MAX (stats->max_ns, ns);
+  }
+
+  if (slot->event == NULL) {
+    // The blocking caller picks up the result and frees the slot
+    slot->done = TRUE;
+    return;
+  }
+
+  // Non-blocking requests report errors through the packet; no delay is
+  // inserted before a retry, as that would stall every other command.
+  if (EFI_ERROR (slot->status)) {
+    Packet->HostAdapterStatus = EFI_EXT_SCSI_STATUS_HOST_ADAPTER_OTHER;
+  }
+  slot->used = FALSE;
+  hba->outstanding--;
+  gBS->SignalEvent (slot->event);
+}
+
+// Drain the completion queues of every queue which has posted entries.
+// Must be called at TPL_NOTIFY.
+STATIC VOID check_completions (struct hisi_hba *hba)
+{
+  struct hisi_sas_complete_hdr *complete_hdr;
+  UINT32 base = hba->base;
+  UINT32 pending, rd, wr;
+  int queue;
+
+  pending = READ_REG32(base, OQ_INT_SRC);
+  if (pending == 0) {
+    return;
+  }
+
+  // Clear int before looking at the queues, so that an entry posted
+  // meanwhile raises it again
+  WRITE_REG32(base, OQ_INT_SRC, pending);
+
+  for (queue = 0; queue < QUEUE_CNT; queue++) {
+    if (!(pending & BIT(queue))) {
+      continue;
+    }
+
+    rd = READ_REG32(base, COMPL_Q_0_RD_PTR + (0x14 * queue));
+    wr = READ_REG32(base, COMPL_Q_0_WR_PTR + (0x14 * queue));
+    while (rd != wr) {
+      complete_hdr = &hba->complete_hdr[queue][rd];
+      slot_complete (hba,
+        (complete_hdr->data & CMPLT_HDR_IPTT_MSK) >> CMPLT_HDR_IPTT_OFF,
+        complete_hdr->data);
+      rd = (rd + 1) % QUEUE_SLOTS;
+    }
+
+    // Update read point
+    WRITE_REG32(base, COMPL_Q_0_RD_PTR + (0x14 * queue), rd);
+  }
+}
+
 STATIC EFI_STATUS prepare_cmd (
   struct hisi_hba *hba,
-  EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET    *Packet
+  UINT8 target,
+  EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET    *Packet,
+  EFI_EVENT Event
   )
 {
   struct hisi_sas_slot *slot;
@@ -309,15 +443,19 @@ STATIC EFI_STATUS prepare_cmd (
   EFI_SCSI_SENSE_DATA *SensePtr = Packet->SenseData;
   VOID   *Buffer = NULL;
   UINTN BufferSize = 0;
-  int queue = hba->queue;
+  int queue;
   UINT32 r, w = 0, slot_idx = 0;
   UINT32 base = hba->base;
-  UINT8 *p;
+  BOOLEAN sense;
   EFI_PHYSICAL_ADDRESS  BufferAddress;
   EFI_STATUS            Status = EFI_SUCCESS;
-  VOID                  *BufferMap = NULL;
+  EFI_TPL               OldTpl;
   DMA_MAP_OPERATION DmaOperation = MapOperationBusMasterCommonBuffer;
 
+  // Slots and queue pointers are shared with the completion poll timer
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  queue = hba->queue;
   while (1) {
     w = READ_REG32(base, DLVRY_Q_0_WR_PTR + (queue * 0x14));
     r = READ_REG32(base, DLVRY_Q_0_RD_PTR + (queue * 0x14));
@@ -327,6 +465,7 @@ STATIC EFI_STATUS prepare_cmd (
       queue = (queue + 1) % QUEUE_CNT;
       if (queue == hba->queue) {
         DEBUG ((EFI_D_ERROR, "could not find free slot\n"));
+        gBS->RestoreTPL (OldTpl);
         return EFI_NOT_READY;
       }
       continue;
@@ -345,6 +484,12 @@ STATIC EFI_STATUS prepare_cmd (
     ZeroMem (SensePtr, sizeof (EFI_SCSI_SENSE_DATA));
 
   slot->used = TRUE;
+  slot->done = FALSE;
+  slot->sense = FALSE;
+  slot->target = target;
+  slot->packet = Packet;
+  slot->event = Event;
+  slot->buffer_map = NULL;
   hba->queue = (queue + 1) % QUEUE_CNT;
 
   // Only consider ssp
@@ -386,8 +531,10 @@ STATIC EFI_STATUS prepare_cmd (
     struct hisi_sas_sge *sg;
     UINT32 remain, len, pos = 0, i = 0;
 
-    Status = DmaMap (DmaOperation, Buffer, &BufferSize, &BufferAddress, &BufferMap);
+    Status = DmaMap (DmaOperation, Buffer, &BufferSize, &BufferAddress, &slot->buffer_map);
     if (EFI_ERROR (Status)) {
+      slot->used = FALSE;
+      gBS->RestoreTPL (OldTpl);
       return Status;
     }
     remain = len = BufferSize;
@@ -414,56 +561,88 @@ STATIC EFI_STATUS prepare_cmd (
   MemoryFence();
 
   // Start dma
+  slot->start = GetPerformanceCounter ();
+  hba->outstanding++;
   WRITE_REG32(base, DLVRY_Q_0_WR_PTR + queue * 0x14, ++w % QUEUE_SLOTS);
 
-  // Wait for dma complete
-  while (slot->used) {
-    if (READ_REG32(base, OQ_INT_SRC) & BIT(queue)) {
-      struct hisi_sas_complete_hdr *complete_hdr;
-      UINT32 data, rd;
-      rd = READ_REG32(base, COMPL_Q_0_RD_PTR + (0x14 * queue));
+  gBS->RestoreTPL (OldTpl);
 
-      complete_hdr = &hba->complete_hdr[queue][rd];
-      data = complete_hdr->data;
-
-      // Check whether dma transfer error
-      if ((data & CMPLT_HDR_ERR_RCRD_XFRD_MSK) &&
-        !(data & CMPLT_HDR_RSPNS_XFRD_MSK)) {
-        DEBUG ((EFI_D_VERBOSE, "sas retry data=0x%x\n", data));
-        DEBUG ((EFI_D_VERBOSE, "sts[0]=0x%x\n", sts->status[0]));
-        DEBUG ((EFI_D_VERBOSE, "sts[1]=0x%x\n", sts->status[1]));
-        DEBUG ((EFI_D_VERBOSE, "sts[2]=0x%x\n", sts->status[2]));
-        Status = EFI_NOT_READY;
-        // wait 1 second and retry, some disk need long time to be ready
-        // and ScsiDisk treat retry over 3 times as error
-        MicroSecondDelay(1000000);
-      }
-       // Update read point
-       WRITE_REG32(base, COMPL_Q_0_RD_PTR + (0x14 * queue), w);
-       // Clear int
-       WRITE_REG32(base, OQ_INT_SRC, BIT(queue));
-       slot->used = FALSE;
-       break;
+  // Non-blocking: the poll timer completes the slot and signals Event
+  if (Event != NULL) {
+    return EFI_SUCCESS;
+  }
+
+  // Wait for dma complete
+  while (1) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    check_completions (hba);
+    gBS->RestoreTPL (OldTpl);
+    if (slot->done) {
+      break;
     }
     // Wait for status change in polling
     NanoSecondDelay (100);
   }
 
-  if (BufferMap)
-       DmaUnmap (BufferMap);
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  Status = slot->status;
+  sense = slot->sense;
+  slot->used = FALSE;
+  hba->outstanding--;
+  gBS->RestoreTPL (OldTpl);
 
-  p = (UINT8 *)&sts->status[0];
-  if (p[SENSE_DATA_PRES]) {
-    // Disk not ready normal return for ScsiDiskTestUnitReady do next try
-    SensePtr->Sense_Key = EFI_SCSI_SK_NOT_READY;
-    SensePtr->Addnl_Sense_Code = EFI_SCSI_ASC_NOT_READY;
-    SensePtr->Addnl_Sense_Code_Qualifier = EFI_SCSI_ASCQ_IN_PROGRESS;
+  if (Status == EFI_NOT_READY) {
+    // wait 1 second and retry, some disk need long time to be ready
+    // and ScsiDisk treat retry over 3 times as error
+    MicroSecondDelay(1000000);
+  }
+
+  if (sense) {
     // wait 1 second for disk spin up, refer drivers/scsi/sd.c
     MicroSecondDelay(1000000);
   }
   return Status;
 }
 
+STATIC
+VOID
+EFIAPI
+SasV1PollCompletions (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  SAS_V1_INFO *SasV1Info = Context;
+
+  if (SasV1Info->hba->outstanding != 0) {
+    check_completions (SasV1Info->hba);
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+SasV1ExitBootServices (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  SAS_V1_INFO *SasV1Info = Context;
+  struct hisi_sas_target_stats *stats;
+  int i;
+
+  for (i = 0; i < MAX_TARGET_ID; i++) {
+    stats = &SasV1Info->hba->stats[i];
+    if (stats->cmds == 0) {
+      continue;
+    }
+    DEBUG ((EFI_D_INFO, "sas target %d: %ld commands, avg %ld us, max %ld us\n",
+      i, stats->cmds,
+      DivU64x64Remainder (stats->total_ns, stats->cmds * 1000, NULL),
+      DivU64x32 (stats->max_ns, 1000)));
+  }
+}
+
 STATIC VOID hisi_sas_v1_init(struct hisi_hba *hba, PLATFORM_SAS_PROTOCOL *plat)
 {
   int i, j;
@@ -672,7 +851,7 @@ SasV1ExtScsiPassThruFunction (
   SAS_V1_INFO *SasV1Info = SAS_FROM_PASS_THRU(This);
   struct hisi_hba *hba = SasV1Info->hba;
 
-  return prepare_cmd(hba, Packet);
+  return prepare_cmd(hba, Target[0], Packet, Event);
 }
 
 STATIC
@@ -916,7 +1095,7 @@ SasDriverBindingStart (
 
   CopyMem (&SasV1Info->ExtScsiPassThru, &SasV1ExtScsiPassThruProtocolTemplate, sizeof (EFI_EXT_SCSI_PASS_THRU_PROTOCOL));
   SasV1Info->ExtScsiPassThruMode.AdapterId = 2;
-  SasV1Info->ExtScsiPassThruMode.Attributes = EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_PHYSICAL | EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_LOGICAL;
+  SasV1Info->ExtScsiPassThruMode.Attributes = EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_PHYSICAL | EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_LOGICAL | EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_NONBLOCKIO;
   SasV1Info->ExtScsiPassThruMode.IoAlign  = 64; //cache line align
   SasV1Info->ExtScsiPassThru.Mode = &SasV1Info->ExtScsiPassThruMode;
 
@@ -933,6 +1112,28 @@ SasDriverBindingStart (
                            sizeof (*DevicePath) - sizeof (DevicePath->End));
   SetDevicePathEndNode (&DevicePath->End);
 
+  // Completes non-blocking commands
+  Status = gBS->CreateEvent (
+                EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                TPL_NOTIFY,
+                SasV1PollCompletions,
+                SasV1Info,
+                &SasV1Info->TimerEvent
+                );
+  ASSERT_EFI_ERROR (Status);
+  Status = gBS->SetTimer (SasV1Info->TimerEvent, TimerPeriodic, SAS_POLL_INTERVAL);
+  ASSERT_EFI_ERROR (Status);
+
+  Status = gBS->CreateEventEx (
+                EVT_NOTIFY_SIGNAL,
+                TPL_CALLBACK,
+                SasV1ExitBootServices,
+                SasV1Info,
+                &gEfiEventExitBootServicesGuid,
+                &SasV1Info->ExitBootServicesEvent
+                );
+  ASSERT_EFI_ERROR (Status);
+
   Status = gBS->InstallMultipleProtocolInterfaces (
                 &Controller,
                 &gEfiDevicePathProtocolGuid, DevicePath,
@@ -987,6 +1188,7 @@ SasDriverBindingStop (
            );
 
     gBS->CloseEvent (SasV1Info->TimerEvent);
+    gBS->CloseEvent (SasV1Info->ExitBootServicesEvent);
 
     for (i = 0; i < QUEUE_CNT; i++) {
       s = sizeof(struct hisi_sas_cmd_hdr) * QUEUE_SLOTS;
@@ -454,9 +454,15 @@ struct _DATABASE_RECORD {
   /// Indicate the PCH SMI types.
   ///
   PCH_SMI_TYPES                 PchSmiType;
+  ///
+  /// Link in the dispatch index, see PRIVATE_DATA.SmiStsDataBase
+  ///
+  LIST_ENTRY                    SmiStsLink;
+  UINT8                         SmiStsIndex;
 };
 
 #define DATABASE_RECORD_FROM_LINK(_record)  CR (_record, DATABASE_RECORD, Link, DATABASE_RECORD_SIGNATURE)
+#define DATABASE_RECORD_FROM_SMI_STS_LINK(_record)  CR (_record, DATABASE_RECORD, SmiStsLink, DATABASE_RECORD_SIGNATURE)
 #define DATABASE_RECORD_FROM_CHILDCONTEXT(_record)  CR (_record, DATABASE_RECORD, ChildContext, DATABASE_RECORD_SIGNATURE)
 
 ///
@@ -581,6 +587,22 @@ typedef struct {
   PROTOCOL_SIGNATURE \
   )
 
+///
+/// Dispatch index of the records: one bucket per R_ACPI_IO_SMI_STS bit, plus one
+/// for the sources which do not report through R_ACPI_IO_SMI_STS.
+///
+#define SMI_STS_INDEX_UNINDEXED   32
+#define SMI_STS_INDEX_MAX         33
+
+///
+/// Dispatch statistics of the sources of one dispatch index bucket
+///
+typedef struct {
+  UINT64                      Count;        ///< Number of times a source was serviced
+  UINT64                      TotalTicks;   ///< TSC ticks spent in callbacks and source clearing
+  UINT64                      MaxTicks;     ///< Longest single service, in TSC ticks
+} PCH_SMM_SOURCE_STATS;
+
 ///
 /// Create private data for the protocols that we'll publish
 ///
@@ -589,6 +611,9 @@ typedef struct {
   EFI_HANDLE                  SmiHandle;
   EFI_HANDLE                  InstallMultProtHandle;
   PCH_SMM_QUALIFIED_PROTOCOL  Protocols[PCH_SMM_PROTOCOL_TYPE_MAX];
+  LIST_ENTRY                  SmiStsDataBase[SMI_STS_INDEX_MAX];
+  UINT32                      SmiStsIndexed;  ///< SMI_STS bits which have records
+  PCH_SMM_SOURCE_STATS        SourceStats[SMI_STS_INDEX_MAX];
 } PRIVATE_DATA;
 
 extern PRIVATE_DATA           mPrivateData;
@@ -611,6 +636,17 @@ SmmCoreInsertRecord (
   OUT EFI_HANDLE                        *DispatchHandle
   );
 
+/**
+  The internal function used to take a database record out of the database.
+  The record itself is not freed.
+
+  @param[in]  Record                    Record to remove from database.
+**/
+VOID
+SmmCoreRemoveRecord (
+  IN  DATABASE_RECORD                   *Record
+  );
+
 /**
   Get the Sleep type
 
@@ -219,6 +219,7 @@ InitializePchSmmDispatcher (
 {
   EFI_STATUS           Status;
   VOID                 *SmmReadyToLockRegistration;
+  UINTN                Index;
 
   //
   // Access ACPI Base Addresses Register
@@ -244,6 +245,9 @@ InitializePchSmmDispatcher (
   // Initialize Callback DataBase
   //
   InitializeListHead (&mPrivateData.CallbackDataBase);
+  for (Index = 0; Index < SMI_STS_INDEX_MAX; Index++) {
+    InitializeListHead (&mPrivateData.SmiStsDataBase[Index]);
+  }
 
   //
   // Enable SMIs on the PCH now that we have a callback
@@ -273,6 +277,37 @@ InitializePchSmmDispatcher (
   return EFI_SUCCESS;
 }
 
+/**
+  Get the dispatch index bucket of a source, i.e. the R_ACPI_IO_SMI_STS bit which
+  has to be set for the source to be active.
+
+  @param[in]  SrcDesc                   Pointer to the PCH_SMM_SOURCE_DESC instance.
+
+  @retval     The R_ACPI_IO_SMI_STS bit, or SMI_STS_INDEX_UNINDEXED if the source
+              does not report through R_ACPI_IO_SMI_STS.
+**/
+STATIC
+UINT8
+SmmCoreGetSmiStsIndex (
+  IN CONST PCH_SMM_SOURCE_DESC          *SrcDesc
+  )
+{
+  //
+  // SourceIsActive() rejects the source when either of these bits is clear.
+  //
+  if ((SrcDesc->PmcSmiSts.Reg.Type == ACPI_ADDR_TYPE) &&
+      (SrcDesc->PmcSmiSts.Reg.Data.acpi == R_ACPI_IO_SMI_STS) &&
+      (SrcDesc->PmcSmiSts.Bit < SMI_STS_INDEX_UNINDEXED)) {
+    return SrcDesc->PmcSmiSts.Bit;
+  }
+  if ((SrcDesc->Sts[0].Reg.Type == ACPI_ADDR_TYPE) &&
+      (SrcDesc->Sts[0].Reg.Data.acpi == R_ACPI_IO_SMI_STS) &&
+      (SrcDesc->Sts[0].Bit < SMI_STS_INDEX_UNINDEXED)) {
+    return SrcDesc->Sts[0].Bit;
+  }
+  return SMI_STS_INDEX_UNINDEXED;
+}
+
 /**
   The internal function used to create and insert a database record
 
@@ -311,6 +346,16 @@ SmmCoreInsertRecord (
   //
   InsertTailList (&mPrivateData.CallbackDataBase, &Record->Link);
 
+  //
+  // Also index it by the SMI_STS bit of its source so that the dispatcher
+  // only evaluates the records whose SMI_STS bit is set
+  //
+  Record->SmiStsIndex = SmmCoreGetSmiStsIndex (&Record->SrcDesc);
+  InsertTailList (&mPrivateData.SmiStsDataBase[Record->SmiStsIndex], &Record->SmiStsLink);
+  if (Record->SmiStsIndex != SMI_STS_INDEX_UNINDEXED) {
+    mPrivateData.SmiStsIndexed |= 1u << Record->SmiStsIndex;
+  }
+
   //
   // Child's handle will be the address linked list link in the record
   //
@@ -319,6 +364,26 @@ SmmCoreInsertRecord (
   return EFI_SUCCESS;
 }
 
+/**
+  The internal function used to take a database record out of the database.
+  The record itself is not freed.
+
+  @param[in]  Record                    Record to remove from database.
+**/
+VOID
+SmmCoreRemoveRecord (
+  IN  DATABASE_RECORD                   *Record
+  )
+{
+  RemoveEntryList (&Record->Link);
+  RemoveEntryList (&Record->SmiStsLink);
+
+  if ((Record->SmiStsIndex != SMI_STS_INDEX_UNINDEXED) &&
+      IsListEmpty (&mPrivateData.SmiStsDataBase[Record->SmiStsIndex])) {
+    mPrivateData.SmiStsIndexed &= ~(1u << Record->SmiStsIndex);
+  }
+}
+
 /**
   Unregister a child SMI source dispatch function with a parent SMM driver
 
@@ -570,7 +635,7 @@ PchSmmCoreUnRegister (
     return EFI_INVALID_PARAMETER;
   }
 
-  RemoveEntryList (&RecordToDelete->Link);
+  SmmCoreRemoveRecord (RecordToDelete);
 
   //
   // Loop through all the souces in record linked list to see if any source enable is equal.
@@ -648,6 +713,80 @@ ClearPendingSmiStatus (
   }
 }
 
+/**
+  Find the first registered record whose source is active. Only the records of the
+  SMI_STS bits which are set, and the records not indexed by SMI_STS, are evaluated.
+
+  @param[in] SciEn                      Sci Enable status
+  @param[in] SmiEnValue                 SMI enable
+  @param[in] SmiStsValue                SMI status
+
+  @retval    The active record, or NULL if there is none.
+**/
+STATIC
+DATABASE_RECORD *
+SmmCoreFindActiveRecord (
+  IN BOOLEAN  SciEn,
+  IN UINT32   SmiEnValue,
+  IN UINT32   SmiStsValue
+  )
+{
+  UINT32              Pending;
+  UINTN               Index;
+  LIST_ENTRY          *Bucket;
+  LIST_ENTRY          *Link;
+  DATABASE_RECORD     *Record;
+
+  Pending = SmiStsValue & mPrivateData.SmiStsIndexed;
+
+  do {
+    if (Pending != 0) {
+      Index    = (UINTN) LowBitSet32 (Pending);
+      Pending &= Pending - 1;
+    } else {
+      Index    = SMI_STS_INDEX_UNINDEXED;
+    }
+
+    Bucket = &mPrivateData.SmiStsDataBase[Index];
+    for (Link = GetFirstNode (Bucket); !IsNull (Bucket, Link); Link = GetNextNode (Bucket, Link)) {
+      Record = DATABASE_RECORD_FROM_SMI_STS_LINK (Link);
+      if (SourceIsActive (&Record->SrcDesc, SciEn, SmiEnValue, SmiStsValue)) {
+        return Record;
+      }
+    }
+  } while (Index != SMI_STS_INDEX_UNINDEXED);
+
+  return NULL;
+}
+
+/**
+  Print how often, and for how long, the sources of each SMI_STS bit have been serviced.
+**/
+STATIC
+VOID
+PchSmmDumpSourceStats (
+  VOID
+  )
+{
+  UINTN                 Index;
+  PCH_SMM_SOURCE_STATS  *Stats;
+
+  for (Index = 0; Index < SMI_STS_INDEX_MAX; Index++) {
+    Stats = &mPrivateData.SourceStats[Index];
+    if (Stats->Count == 0) {
+      continue;
+    }
+    DEBUG ((
+      DEBUG_INFO,
+      "PchSmiDispatcher: SMI_STS[%Lu] %ld SMIs, avg %ld max %ld TSC ticks\n",
+      (UINT64)Index,
+      Stats->Count,
+      DivU64x64Remainder (Stats->TotalTicks, Stats->Count, NULL),
+      Stats->MaxTicks
+      ));
+  }
+}
+
 /**
   The callback function to handle subsequent SMIs.  This callback will be called by SmmCoreDispatcher.
 
@@ -677,9 +816,13 @@ PchSmmCoreDispatcher (
   BOOLEAN             SxChildWasDispatched;
 
   DATABASE_RECORD     *RecordInDb;
-  LIST_ENTRY          *LinkInDb;
   DATABASE_RECORD     *RecordToExhaust;
   LIST_ENTRY          *LinkToExhaust;
+  LIST_ENTRY          *Bucket;
+  UINT8               SmiStsIndex;
+  UINT64              StartTick;
+  UINT64              Ticks;
+  PCH_SMM_SOURCE_STATS  *Stats;
 
   PCH_SMM_CONTEXT     Context;
   VOID                *CommBuffer;
@@ -721,8 +864,6 @@ PchSmmCoreDispatcher (
     while ((!EosSet) && (EscapeCount > 0)) {
       EscapeCount--;
 
-      LinkInDb = GetFirstNode (&mPrivateData.CallbackDataBase);
-
       //
       // Cache SciEn, SmiEnValue and SmiStsValue to determine if source is active
       //
@@ -730,146 +871,142 @@ PchSmmCoreDispatcher (
       SmiEnValue  = IoRead32 ((UINTN) (mAcpiBaseAddr + R_ACPI_IO_SMI_EN));
       SmiStsValue = IoRead32 ((UINTN) (mAcpiBaseAddr + R_ACPI_IO_SMI_STS));
 
-      while (!IsNull (&mPrivateData.CallbackDataBase, LinkInDb)) {
-        RecordInDb = DATABASE_RECORD_FROM_LINK (LinkInDb);
+      //
+      // look for the first active source
+      //
+      RecordInDb = SmmCoreFindActiveRecord (SciEn, SmiEnValue, SmiStsValue);
+      if (RecordInDb == NULL) {
+        //
+        // No active source, clear pending SMI status and try to clear EOS
+        //
+        ClearPendingSmiStatus (SmiStsValue, SciEn);
+        EosSet = PchSmmSetAndCheckEos ();
+      } else {
+        //
+        // We found a source. If this is a sleep type, we have to go to
+        // appropriate sleep state anyway.No matter there is sleep child or not
+        //
+        if (RecordInDb->ProtocolType == SxType) {
+          SxChildWasDispatched = TRUE;
+        }
+        //
+        // "cache" the source description and don't query I/O anymore
+        //
+        CopyMem ((VOID *) &ActiveSource, (VOID *) &(RecordInDb->SrcDesc), sizeof (PCH_SMM_SOURCE_DESC));
+        StartTick     = AsmReadTsc ();
+        SmiStsIndex   = RecordInDb->SmiStsIndex;
+        Bucket        = &mPrivateData.SmiStsDataBase[SmiStsIndex];
+        LinkToExhaust = &RecordInDb->SmiStsLink;
 
         //
-        // look for the first active source
+        // exhaust the rest of the queue looking for the same source. Records with
+        // the same source are always in the same dispatch index bucket.
         //
-        if (!SourceIsActive (&RecordInDb->SrcDesc, SciEn, SmiEnValue, SmiStsValue)) {
+        while (!IsNull (Bucket, LinkToExhaust)) {
+          RecordToExhaust = DATABASE_RECORD_FROM_SMI_STS_LINK (LinkToExhaust);
           //
-          // Didn't find the source yet, keep looking
+          // RecordToExhaust->Link might be removed (unregistered) by Callback function, and then the
+          // system will hang in ASSERT() while calling GetNextNode().
+          // To prevent the issue, we need to get next record in DB here (before Callback function).
           //
-          LinkInDb = GetNextNode (&mPrivateData.CallbackDataBase, &RecordInDb->Link);
+          LinkToExhaust = GetNextNode (Bucket, &RecordToExhaust->SmiStsLink);
 
-          //
-          // if it's the last one, try to clear EOS
-          //
-          if (IsNull (&mPrivateData.CallbackDataBase, LinkInDb)) {
+          if (CompareSources (&RecordToExhaust->SrcDesc, &ActiveSource)) {
             //
-            // Clear pending SMI status before EOS
+            // These source descriptions are equal, so this callback should be
+            // dispatched.
             //
-            ClearPendingSmiStatus (SmiStsValue, SciEn);
-            EosSet = PchSmmSetAndCheckEos ();
-          }
-        } else {
-          //
-          // We found a source. If this is a sleep type, we have to go to
-          // appropriate sleep state anyway.No matter there is sleep child or not
-          //
-          if (RecordInDb->ProtocolType == SxType) {
-            SxChildWasDispatched = TRUE;
-          }
-          //
-          // "cache" the source description and don't query I/O anymore
-          //
-          CopyMem ((VOID *) &ActiveSource, (VOID *) &(RecordInDb->SrcDesc), sizeof (PCH_SMM_SOURCE_DESC));
-          LinkToExhaust = LinkInDb;
+            if (RecordToExhaust->ContextFunctions.GetContext != NULL) {
+              //
+              // This child requires that we get a calling context from
+              // hardware and compare that context to the one supplied
+              // by the child.
+              //
+              ASSERT (RecordToExhaust->ContextFunctions.CmpContext != NULL);
 
-          //
-          // exhaust the rest of the queue looking for the same source
-          //
-          while (!IsNull (&mPrivateData.CallbackDataBase, LinkToExhaust)) {
-            RecordToExhaust = DATABASE_RECORD_FROM_LINK (LinkToExhaust);
-            //
-            // RecordToExhaust->Link might be removed (unregistered) by Callback function, and then the
-            // system will hang in ASSERT() while calling GetNextNode().
-            // To prevent the issue, we need to get next record in DB here (before Callback function).
-            //
-            LinkToExhaust = GetNextNode (&mPrivateData.CallbackDataBase, &RecordToExhaust->Link);
+              //
+              // Make sure contexts match before dispatching event to child
+              //
+              RecordToExhaust->ContextFunctions.GetContext (RecordToExhaust, &Context);
+              ContextsMatch = RecordToExhaust->ContextFunctions.CmpContext (&Context, &RecordToExhaust->ChildContext);
 
-            if (CompareSources (&RecordToExhaust->SrcDesc, &ActiveSource)) {
+            } else {
               //
-              // These source descriptions are equal, so this callback should be
-              // dispatched.
+              // This child doesn't require any more calling context beyond what
+              // it supplied in registration.  Simply pass back what it gave us.
               //
-              if (RecordToExhaust->ContextFunctions.GetContext != NULL) {
-                //
-                // This child requires that we get a calling context from
-                // hardware and compare that context to the one supplied
-                // by the child.
-                //
-                ASSERT (RecordToExhaust->ContextFunctions.CmpContext != NULL);
+              Context       = RecordToExhaust->ChildContext;
+              ContextsMatch = TRUE;
+            }
 
+            if (ContextsMatch) {
+              if (RecordToExhaust->ProtocolType == PchSmiDispatchType) {
                 //
-                // Make sure contexts match before dispatching event to child
+                // For PCH SMI dispatch protocols
                 //
-                RecordToExhaust->ContextFunctions.GetContext (RecordToExhaust, &Context);
-                ContextsMatch = RecordToExhaust->ContextFunctions.CmpContext (&Context, &RecordToExhaust->ChildContext);
-
+                PchSmiTypeCallbackDispatcher (RecordToExhaust);
               } else {
                 //
-                // This child doesn't require any more calling context beyond what
-                // it supplied in registration.  Simply pass back what it gave us.
+                // For EFI standard SMI dispatch protocols
                 //
-                Context       = RecordToExhaust->ChildContext;
-                ContextsMatch = TRUE;
-              }
-
-              if (ContextsMatch) {
-                if (RecordToExhaust->ProtocolType == PchSmiDispatchType) {
-                  //
-                  // For PCH SMI dispatch protocols
-                  //
-                  PchSmiTypeCallbackDispatcher (RecordToExhaust);
-                } else {
-                  //
-                  // For EFI standard SMI dispatch protocols
-                  //
-                  if (RecordToExhaust->Callback != NULL) {
-                    if (RecordToExhaust->ContextFunctions.GetCommBuffer != NULL) {
-                      //
-                      // This callback function needs CommBuffer and CommBufferSize.
-                      // Get those from child and then pass to callback function.
-                      //
-                      RecordToExhaust->ContextFunctions.GetCommBuffer (RecordToExhaust, &CommBuffer, &CommBufferSize);
-                    } else {
-                      //
-                      // Child doesn't support the CommBuffer and CommBufferSize.
-                      // Just pass NULL value to callback function.
-                      //
-                      CommBuffer     = NULL;
-                      CommBufferSize = 0;
-                    }
-
-                    PERF_START_EX (NULL, "SmmFunction", NULL, AsmReadTsc (), RecordToExhaust->ProtocolType);
-                    RecordToExhaust->Callback ((EFI_HANDLE) & RecordToExhaust->Link, &Context, CommBuffer, &CommBufferSize);
-                    PERF_END_EX (NULL, "SmmFunction", NULL, AsmReadTsc (), RecordToExhaust->ProtocolType);
-                    if (RecordToExhaust->ProtocolType == SxType) {
-                      SxChildWasDispatched = TRUE;
-                    }
+                if (RecordToExhaust->Callback != NULL) {
+                  if (RecordToExhaust->ContextFunctions.GetCommBuffer != NULL) {
+                    //
+                    // This callback function needs CommBuffer and CommBufferSize.
+                    // Get those from child and then pass to callback function.
+                    //
+                    RecordToExhaust->ContextFunctions.GetCommBuffer (RecordToExhaust, &CommBuffer, &CommBufferSize);
                   } else {
-                    ASSERT (FALSE);
+                    //
+                    // Child doesn't support the CommBuffer and CommBufferSize.
+                    // Just pass NULL value to callback function.
+                    //
+                    CommBuffer     = NULL;
+                    CommBufferSize = 0;
+                  }
+
+                  PERF_START_EX (NULL, "SmmFunction", NULL, AsmReadTsc (), RecordToExhaust->ProtocolType);
+                  RecordToExhaust->Callback ((EFI_HANDLE) & RecordToExhaust->Link, &Context, CommBuffer, &CommBufferSize);
+                  PERF_END_EX (NULL, "SmmFunction", NULL, AsmReadTsc (), RecordToExhaust->ProtocolType);
+                  if (RecordToExhaust->ProtocolType == SxType) {
+                    SxChildWasDispatched = TRUE;
                   }
+                } else {
+                  ASSERT (FALSE);
                 }
               }
             }
           }
+        }
 
-          if (RecordInDb->ClearSource == NULL) {
-            //
-            // Clear the SMI associated w/ the source using the default function
-            //
-            PchSmmClearSource (&ActiveSource);
-          } else {
-            //
-            // This source requires special handling to clear
-            //
-            RecordInDb->ClearSource (&ActiveSource);
-          }
-          //
-          // Clear pending SMI status before EOS
+        if (RecordInDb->ClearSource == NULL) {
           //
-          ClearPendingSmiStatus (SmiStsValue, SciEn);
+          // Clear the SMI associated w/ the source using the default function
           //
-          // Also, try to clear EOS
-          //
-          EosSet = PchSmmSetAndCheckEos ();
+          PchSmmClearSource (&ActiveSource);
+        } else {
           //
-          // Queue is empty, reset the search
+          // This source requires special handling to clear
           //
-          break;
+          RecordInDb->ClearSource (&ActiveSource);
         }
+
+        Ticks = AsmReadTsc () - StartTick;
+        Stats = &mPrivateData.SourceStats[SmiStsIndex];
+        Stats->Count++;
+        Stats->TotalTicks += Ticks;
+        if (Ticks > Stats->MaxTicks) {
+          Stats->MaxTicks = Ticks;
+        }
+
+        //
+        // Clear pending SMI status before EOS
+        //
+        ClearPendingSmiStatus (SmiStsValue, SciEn);
+        //
+        // Also, try to clear EOS
+        //
+        EosSet = PchSmmSetAndCheckEos ();
       }
     }
   }
@@ -897,6 +1034,7 @@ PchSmmCoreDispatcher (
     // A child of the SmmSxDispatch protocol was dispatched during this call;
     // put the system to sleep.
     //
+    PchSmmDumpSourceStats ();
     PchSmmSxGoToSleep ();
   }
   //
@@ -253,6 +253,8 @@ FmpSetImage (
   EFI_STATUS                 Status;
   EFI_STATUS                 VarStatus;
   MICROCODE_FMP_PRIVATE_DATA *MicrocodeFmpPrivate;
+  UINT64                     StartTick;
+  UINT64                     EndTick;
 
   if (Image == NULL || AbortReason == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -265,8 +267,11 @@ FmpSetImage (
     return EFI_INVALID_PARAMETER;
   }
 
+  StartTick = GetPerformanceCounter ();
   Status = MicrocodeWrite(MicrocodeFmpPrivate, (VOID *)Image, ImageSize, &MicrocodeFmpPrivate->LastAttempt.LastAttemptVersion, &MicrocodeFmpPrivate->LastAttempt.LastAttemptStatus, AbortReason);
-  DEBUG((DEBUG_INFO, "SetImage - LastAttempt Version - 0x%x, Status - 0x%x\n", MicrocodeFmpPrivate->LastAttempt.LastAttemptVersion, MicrocodeFmpPrivate->LastAttempt.LastAttemptStatus));
+  EndTick = GetPerformanceCounter ();
+  MicrocodeFmpPrivate->LastAttempt.LastAttemptUpdateTime = (UINT32)DivU64x32 (GetTimeInNanoSecond (EndTick - StartTick), 1000);
+  DEBUG((DEBUG_INFO, "SetImage - LastAttempt Version - 0x%x, Status - 0x%x, Time - %dus\n", MicrocodeFmpPrivate->LastAttempt.LastAttemptVersion, MicrocodeFmpPrivate->LastAttempt.LastAttemptStatus, MicrocodeFmpPrivate->LastAttempt.LastAttemptUpdateTime));
   VarStatus = gRT->SetVariable(
                      MICROCODE_FMP_LAST_ATTEMPT_VARIABLE_NAME,
                      &gEfiCallerIdGuid,
@@ -624,16 +629,40 @@ InitializedProcessorMicrocodeIndex (
   IN MICROCODE_FMP_PRIVATE_DATA *MicrocodeFmpPrivate
   )
 {
-  UINTN       CpuIndex;
-  UINTN       MicrocodeIndex;
-  UINTN       TargetCpuIndex;
-  UINT32      AttemptStatus;
-  EFI_STATUS  Status;
+  UINTN                Index;
+  UINTN                CpuIndex;
+  UINTN                MicrocodeIndex;
+  UINTN                TargetCpuIndex;
+  UINT32               AttemptStatus;
+  EFI_STATUS           Status;
+  PROCESSOR_INFO       *ProcessorInfo;
+  PROCESSOR_TYPE_INFO  *ProcessorTypeInfo;
+
+  for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorTypeCount; Index++) {
+    MicrocodeFmpPrivate->ProcessorTypeInfo[Index].ResolvedCpuIndex = (UINTN)-1;
+  }
 
   for (CpuIndex = 0; CpuIndex < MicrocodeFmpPrivate->ProcessorCount; CpuIndex++) {
     if (MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].MicrocodeIndex != (UINTN)-1) {
       continue;
     }
+
+    //
+    // The result only depends on the processor type and current revision,
+    // reuse it from a resolved processor of the same type.
+    //
+    ProcessorTypeInfo = NULL;
+    if (MicrocodeFmpPrivate->ProcessorTypeInfo != NULL) {
+      ProcessorTypeInfo = &MicrocodeFmpPrivate->ProcessorTypeInfo[MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].ProcessorTypeIndex];
+      if (ProcessorTypeInfo->ResolvedCpuIndex != (UINTN)-1) {
+        ProcessorInfo = &MicrocodeFmpPrivate->ProcessorInfo[ProcessorTypeInfo->ResolvedCpuIndex];
+        if (ProcessorInfo->MicrocodeRevision == MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].MicrocodeRevision) {
+          MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].MicrocodeIndex = ProcessorInfo->MicrocodeIndex;
+          continue;
+        }
+      }
+    }
+
     for (MicrocodeIndex = 0; MicrocodeIndex < MicrocodeFmpPrivate->DescriptorCount; MicrocodeIndex++) {
       if (!MicrocodeFmpPrivate->MicrocodeInfo[MicrocodeIndex].InUse) {
         continue;
@@ -652,6 +681,10 @@ InitializedProcessorMicrocodeIndex (
         MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].MicrocodeIndex = MicrocodeIndex;
       }
     }
+
+    if ((ProcessorTypeInfo != NULL) && (ProcessorTypeInfo->ResolvedCpuIndex == (UINTN)-1)) {
+      ProcessorTypeInfo->ResolvedCpuIndex = CpuIndex;
+    }
   }
 }
 
@@ -719,6 +752,57 @@ InitializeMicrocodeDescriptor (
   return EFI_SUCCESS;
 }
 
+/**
+  Group the processors by (ProcessorSignature, PlatformId).
+
+  @param[in] MicrocodeFmpPrivate private data structure to be initialized.
+
+  @return EFI_SUCCESS           Processor type information is initialized.
+  @return EFI_OUT_OF_RESOURCES  No enough resource for the initialization.
+**/
+EFI_STATUS
+InitializeProcessorTypeInfo (
+  IN MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate
+  )
+{
+  UINTN                                CpuIndex;
+  UINTN                                Index;
+  PROCESSOR_INFO                       *ProcessorInfo;
+  PROCESSOR_TYPE_INFO                  *ProcessorTypeInfo;
+
+  //
+  // There can not be more types than processors.
+  //
+  MicrocodeFmpPrivate->ProcessorTypeCount = 0;
+  MicrocodeFmpPrivate->ProcessorTypeInfo = AllocateZeroPool (sizeof(PROCESSOR_TYPE_INFO) * MicrocodeFmpPrivate->ProcessorCount);
+  if (MicrocodeFmpPrivate->ProcessorTypeInfo == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (CpuIndex = 0; CpuIndex < MicrocodeFmpPrivate->ProcessorCount; CpuIndex++) {
+    ProcessorInfo = &MicrocodeFmpPrivate->ProcessorInfo[CpuIndex];
+    for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorTypeCount; Index++) {
+      ProcessorTypeInfo = &MicrocodeFmpPrivate->ProcessorTypeInfo[Index];
+      if ((ProcessorTypeInfo->ProcessorSignature == ProcessorInfo->ProcessorSignature) &&
+          (ProcessorTypeInfo->PlatformId == ProcessorInfo->PlatformId)) {
+        break;
+      }
+    }
+    ProcessorTypeInfo = &MicrocodeFmpPrivate->ProcessorTypeInfo[Index];
+    if (Index == MicrocodeFmpPrivate->ProcessorTypeCount) {
+      ProcessorTypeInfo->ProcessorSignature = ProcessorInfo->ProcessorSignature;
+      ProcessorTypeInfo->PlatformId = ProcessorInfo->PlatformId;
+      ProcessorTypeInfo->CpuIndex = CpuIndex;
+      ProcessorTypeInfo->ResolvedCpuIndex = (UINTN)-1;
+      MicrocodeFmpPrivate->ProcessorTypeCount++;
+    }
+    ProcessorTypeInfo->ProcessorCount++;
+    ProcessorInfo->ProcessorTypeIndex = Index;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Initialize MicrocodeFmpDriver multiprocessor information.
 
@@ -762,9 +846,27 @@ InitializeProcessorInfo (
   for (Index = 0; Index < NumberOfProcessors; Index++) {
     MicrocodeFmpPrivate->ProcessorInfo[Index].CpuIndex = Index;
     MicrocodeFmpPrivate->ProcessorInfo[Index].MicrocodeIndex = (UINTN)-1;
-    if (Index == BspIndex) {
-      CollectProcessorInfo (&MicrocodeFmpPrivate->ProcessorInfo[Index]);
-    } else {
+  }
+
+  //
+  // Collect the information on all APs at once rather than waking them one by one.
+  //
+  CollectProcessorInfo (&MicrocodeFmpPrivate->ProcessorInfo[BspIndex]);
+  Status = MpService->StartupAllAPs (
+                        MpService,
+                        CollectAllProcessorInfo,
+                        FALSE,
+                        NULL,
+                        0,
+                        MicrocodeFmpPrivate,
+                        NULL
+                        );
+  if (EFI_ERROR(Status) && (Status != EFI_NOT_STARTED)) {
+    DEBUG((DEBUG_ERROR, "InitializeProcessorInfo - StartupAllAPs - %r\n", Status));
+    for (Index = 0; Index < NumberOfProcessors; Index++) {
+      if (Index == BspIndex) {
+        continue;
+      }
       Status = MpService->StartupThisAP (
                             MpService,
                             CollectProcessorInfo,
@@ -778,6 +880,13 @@ InitializeProcessorInfo (
     }
   }
 
+  Status = InitializeProcessorTypeInfo (MicrocodeFmpPrivate);
+  if (EFI_ERROR(Status)) {
+    FreePool (MicrocodeFmpPrivate->ProcessorInfo);
+    MicrocodeFmpPrivate->ProcessorInfo = NULL;
+    return Status;
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -813,6 +922,18 @@ DumpPrivateInfo (
       ProcessorInfo[Index].MicrocodeIndex
       ));
   }
+  DEBUG ((DEBUG_INFO, "  ProcessorTypeCount - 0x%x\n", MicrocodeFmpPrivate->ProcessorTypeCount));
+  for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorTypeCount; Index++) {
+    DEBUG ((
+      DEBUG_INFO,
+      "  ProcessorTypeInfo[0x%x] - 0x%08x, 0x%02x, (0x%x, 0x%x)\n",
+      Index,
+      MicrocodeFmpPrivate->ProcessorTypeInfo[Index].ProcessorSignature,
+      MicrocodeFmpPrivate->ProcessorTypeInfo[Index].PlatformId,
+      MicrocodeFmpPrivate->ProcessorTypeInfo[Index].CpuIndex,
+      MicrocodeFmpPrivate->ProcessorTypeInfo[Index].ProcessorCount
+      ));
+  }
 
   DEBUG ((DEBUG_INFO, "MicrocodeInfo:\n"));
   MicrocodeInfo = MicrocodeFmpPrivate->MicrocodeInfo;
@@ -893,6 +1014,7 @@ InitializePrivateData (
 
   MicrocodeFmpPrivate->LastAttempt.LastAttemptVersion = 0x0;
   MicrocodeFmpPrivate->LastAttempt.LastAttemptStatus = 0x0;
+  MicrocodeFmpPrivate->LastAttempt.LastAttemptUpdateTime = 0x0;
   VarSize = sizeof(MicrocodeFmpPrivate->LastAttempt);
   VarStatus = gRT->GetVariable(
                      MICROCODE_FMP_LAST_ATTEMPT_VARIABLE_NAME,
@@ -902,7 +1024,7 @@ InitializePrivateData (
                      &MicrocodeFmpPrivate->LastAttempt
                      );
   DEBUG((DEBUG_INFO, "GetLastAttempt - %r\n", VarStatus));
-  DEBUG((DEBUG_INFO, "GetLastAttempt Version - 0x%x, State - 0x%x\n", MicrocodeFmpPrivate->LastAttempt.LastAttemptVersion, MicrocodeFmpPrivate->LastAttempt.LastAttemptStatus));
+  DEBUG((DEBUG_INFO, "GetLastAttempt Version - 0x%x, State - 0x%x, Time - %dus\n", MicrocodeFmpPrivate->LastAttempt.LastAttemptVersion, MicrocodeFmpPrivate->LastAttempt.LastAttemptStatus, MicrocodeFmpPrivate->LastAttempt.LastAttemptUpdateTime));
 
   Result = GetMicrocodeRegion(&MicrocodeFmpPrivate->MicrocodePatchAddress, &MicrocodeFmpPrivate->MicrocodePatchRegionSize);
   if (!Result) {
@@ -918,6 +1040,7 @@ InitializePrivateData (
 
   Status = InitializeMicrocodeDescriptor(MicrocodeFmpPrivate);
   if (EFI_ERROR(Status)) {
+    FreePool (MicrocodeFmpPrivate->ProcessorTypeInfo);
     FreePool (MicrocodeFmpPrivate->ProcessorInfo);
     DEBUG((DEBUG_ERROR, "InitializeMicrocodeDescriptor - %r\n", Status));
     return Status;
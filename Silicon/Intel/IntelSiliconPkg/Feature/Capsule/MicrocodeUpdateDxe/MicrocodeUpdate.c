@@ -125,6 +125,33 @@ MicrocodeLoadAp (
   MicrocodeLoadBuffer->Revision = LoadMicrocode (MicrocodeLoadBuffer->Address);
 }
 
+/**
+  Load Microcode on every Application Processor of one processor type.
+  The function prototype for invoking a function on an Application Processor.
+
+  @param[in,out] Buffer  The pointer to private data buffer.
+**/
+VOID
+EFIAPI
+MicrocodeLoadAllAp (
+  IN OUT VOID  *Buffer
+  )
+{
+  MICROCODE_BROADCAST_LOAD_BUFFER      *MicrocodeLoadBuffer;
+  EFI_STATUS                           Status;
+  UINTN                                CpuIndex;
+
+  MicrocodeLoadBuffer = Buffer;
+  Status = MicrocodeLoadBuffer->MpService->WhoAmI (MicrocodeLoadBuffer->MpService, &CpuIndex);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+  if (MicrocodeLoadBuffer->ProcessorInfo[CpuIndex].ProcessorTypeIndex != MicrocodeLoadBuffer->ProcessorTypeIndex) {
+    return;
+  }
+  MicrocodeLoadBuffer->Revision[CpuIndex] = LoadMicrocode (MicrocodeLoadBuffer->Address);
+}
+
 /**
   Load new Microcode on this processor
 
@@ -166,6 +193,96 @@ LoadMicrocodeOnThis (
   }
 }
 
+/**
+  Load new Microcode on every processor of the same type as the target processor.
+
+  All Application Processors load in parallel, and the revision each of them
+  reports is checked, so that processors of one type do not end up running
+  different Microcode revisions.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+  @param[in]  CpuIndex                   The index of the target processor.
+  @param[in]  Address                    The address of new Microcode.
+
+  @return  Loaded Microcode signature of the target processor, or the first
+           mismatching signature reported by another processor of the type.
+
+**/
+UINT32
+LoadMicrocodeOnAll (
+  IN  MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN  UINTN                       CpuIndex,
+  IN  UINT64                      Address
+  )
+{
+  EFI_STATUS                           Status;
+  EFI_MP_SERVICES_PROTOCOL             *MpService;
+  MICROCODE_BROADCAST_LOAD_BUFFER      MicrocodeLoadBuffer;
+  PROCESSOR_INFO                       *ProcessorInfo;
+  UINT32                               *Revision;
+  UINT32                               TargetRevision;
+  UINTN                                Index;
+  UINTN                                LoadedCount;
+
+  ProcessorInfo = MicrocodeFmpPrivate->ProcessorInfo;
+  if ((MicrocodeFmpPrivate->ProcessorTypeInfo == NULL) ||
+      (MicrocodeFmpPrivate->ProcessorTypeInfo[ProcessorInfo[CpuIndex].ProcessorTypeIndex].ProcessorCount <= 1)) {
+    return LoadMicrocodeOnThis (MicrocodeFmpPrivate, CpuIndex, Address);
+  }
+
+  Revision = AllocateZeroPool (sizeof(UINT32) * MicrocodeFmpPrivate->ProcessorCount);
+  if (Revision == NULL) {
+    return LoadMicrocodeOnThis (MicrocodeFmpPrivate, CpuIndex, Address);
+  }
+
+  MpService = MicrocodeFmpPrivate->MpService;
+  MicrocodeLoadBuffer.MpService = MpService;
+  MicrocodeLoadBuffer.ProcessorInfo = ProcessorInfo;
+  MicrocodeLoadBuffer.ProcessorTypeIndex = ProcessorInfo[CpuIndex].ProcessorTypeIndex;
+  MicrocodeLoadBuffer.Address = Address;
+  MicrocodeLoadBuffer.Revision = Revision;
+
+  Status = MpService->StartupAllAPs (
+                        MpService,
+                        MicrocodeLoadAllAp,
+                        FALSE,
+                        NULL,
+                        0,
+                        &MicrocodeLoadBuffer,
+                        NULL
+                        );
+  if (EFI_ERROR(Status) && (Status != EFI_NOT_STARTED)) {
+    DEBUG((DEBUG_ERROR, "LoadMicrocodeOnAll - StartupAllAPs - %r\n", Status));
+    FreePool (Revision);
+    return LoadMicrocodeOnThis (MicrocodeFmpPrivate, CpuIndex, Address);
+  }
+  if (ProcessorInfo[MicrocodeFmpPrivate->BspIndex].ProcessorTypeIndex == MicrocodeLoadBuffer.ProcessorTypeIndex) {
+    Revision[MicrocodeFmpPrivate->BspIndex] = LoadMicrocode (Address);
+  }
+
+  //
+  // Disabled processors did not run the procedure and report 0.
+  //
+  TargetRevision = Revision[CpuIndex];
+  LoadedCount = 0;
+  for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorCount; Index++) {
+    if (Revision[Index] == 0) {
+      continue;
+    }
+    LoadedCount++;
+    if (Revision[Index] != Revision[CpuIndex]) {
+      DEBUG((DEBUG_ERROR, "LoadMicrocodeOnAll - CPU 0x%x reports revision 0x%x\n", Index, Revision[Index]));
+      if (TargetRevision == Revision[CpuIndex]) {
+        TargetRevision = Revision[Index];
+      }
+    }
+  }
+  DEBUG((DEBUG_INFO, "LoadMicrocodeOnAll - 0x%x processors loaded revision 0x%x\n", LoadedCount, Revision[CpuIndex]));
+
+  FreePool (Revision);
+  return TargetRevision;
+}
+
 /**
   Collect processor information.
   The function prototype for invoking a function on an Application Processor.
@@ -186,6 +303,30 @@ CollectProcessorInfo (
   ProcessorInfo->MicrocodeRevision = GetCurrentMicrocodeSignature();
 }
 
+/**
+  Collect processor information on all Application Processors at once.
+  The function prototype for invoking a function on an Application Processor.
+
+  @param[in,out] Buffer  The pointer to the Microcode driver private data.
+**/
+VOID
+EFIAPI
+CollectAllProcessorInfo (
+  IN OUT VOID  *Buffer
+  )
+{
+  MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate;
+  EFI_STATUS                  Status;
+  UINTN                       CpuIndex;
+
+  MicrocodeFmpPrivate = Buffer;
+  Status = MicrocodeFmpPrivate->MpService->WhoAmI (MicrocodeFmpPrivate->MpService, &CpuIndex);
+  if (EFI_ERROR (Status) || (CpuIndex >= MicrocodeFmpPrivate->ProcessorCount)) {
+    return;
+  }
+  CollectProcessorInfo (&MicrocodeFmpPrivate->ProcessorInfo[CpuIndex]);
+}
+
 /**
   Get current Microcode information.
 
@@ -322,7 +463,8 @@ GetMatchedProcessor (
   IN OUT UINTN                   *TargetCpuIndex
   )
 {
-  UINTN  Index;
+  UINTN                Index;
+  PROCESSOR_TYPE_INFO  *ProcessorTypeInfo;
 
   if (*TargetCpuIndex != (UINTN)-1) {
     Index = *TargetCpuIndex;
@@ -334,6 +476,22 @@ GetMatchedProcessor (
     }
   }
 
+  //
+  // Processor types are recorded in the order of their first processor, so the
+  // first matched type also gives the first matched processor.
+  //
+  if (MicrocodeFmpPrivate->ProcessorTypeInfo != NULL) {
+    for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorTypeCount; Index++) {
+      ProcessorTypeInfo = &MicrocodeFmpPrivate->ProcessorTypeInfo[Index];
+      if ((ProcessorSignature == ProcessorTypeInfo->ProcessorSignature) &&
+          ((ProcessorFlags & (1 << ProcessorTypeInfo->PlatformId)) != 0)) {
+        *TargetCpuIndex = ProcessorTypeInfo->CpuIndex;
+        return &MicrocodeFmpPrivate->ProcessorInfo[ProcessorTypeInfo->CpuIndex];
+      }
+    }
+    return NULL;
+  }
+
   for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorCount; Index++) {
     if ((ProcessorSignature == MicrocodeFmpPrivate->ProcessorInfo[Index].ProcessorSignature) &&
         ((ProcessorFlags & (1 << MicrocodeFmpPrivate->ProcessorInfo[Index].PlatformId)) != 0)) {
@@ -578,7 +736,7 @@ VerifyMicrocode (
   // try load MCU
   //
   if (TryLoad) {
-    CurrentRevision = LoadMicrocodeOnThis(MicrocodeFmpPrivate, ProcessorInfo->CpuIndex, (UINTN)MicrocodeEntryPoint + sizeof(CPU_MICROCODE_HEADER));
+    CurrentRevision = LoadMicrocodeOnAll(MicrocodeFmpPrivate, ProcessorInfo->CpuIndex, (UINTN)MicrocodeEntryPoint + sizeof(CPU_MICROCODE_HEADER));
     if (MicrocodeEntryPoint->UpdateRevision != CurrentRevision) {
       DEBUG((DEBUG_ERROR, "VerifyMicrocode - fail on LoadMicrocode\n"));
       *LastAttemptStatus = LAST_ATTEMPT_STATUS_ERROR_AUTH_ERROR;
@@ -606,17 +764,33 @@ GetNextMicrocode (
   IN CPU_MICROCODE_HEADER                    *MicrocodeEntryPoint
   )
 {
+  UINTN                                   Low;
+  UINTN                                   High;
   UINTN                                   Index;
 
-  for (Index = 0; Index < MicrocodeFmpPrivate->DescriptorCount; Index++) {
-    if (MicrocodeEntryPoint == MicrocodeFmpPrivate->MicrocodeInfo[Index].MicrocodeEntryPoint) {
-      if (Index == (UINTN)MicrocodeFmpPrivate->DescriptorCount - 1) {
-        // it is last one
-        return NULL;
-      } else {
-        // return next one
-        return MicrocodeFmpPrivate->MicrocodeInfo[Index + 1].MicrocodeEntryPoint;
-      }
+  //
+  // MicrocodeInfo is collected by walking the region, so it is sorted by address.
+  //
+  Low = 0;
+  High = MicrocodeFmpPrivate->DescriptorCount;
+  while (Low < High) {
+    Index = Low + (High - Low) / 2;
+    if ((UINTN)MicrocodeFmpPrivate->MicrocodeInfo[Index].MicrocodeEntryPoint < (UINTN)MicrocodeEntryPoint) {
+      Low = Index + 1;
+    } else {
+      High = Index;
+    }
+  }
+
+  Index = Low;
+  if ((Index < MicrocodeFmpPrivate->DescriptorCount) &&
+      (MicrocodeEntryPoint == MicrocodeFmpPrivate->MicrocodeInfo[Index].MicrocodeEntryPoint)) {
+    if (Index == (UINTN)MicrocodeFmpPrivate->DescriptorCount - 1) {
+      // it is last one
+      return NULL;
+    } else {
+      // return next one
+      return MicrocodeFmpPrivate->MicrocodeInfo[Index + 1].MicrocodeEntryPoint;
     }
   }
 
@@ -638,17 +812,33 @@ GetNextFitMicrocode (
   IN CPU_MICROCODE_HEADER                    *MicrocodeEntryPoint
   )
 {
+  UINTN                                   Low;
+  UINTN                                   High;
   UINTN                                   Index;
 
-  for (Index = 0; Index < MicrocodeFmpPrivate->FitMicrocodeEntryCount; Index++) {
-    if (MicrocodeEntryPoint == MicrocodeFmpPrivate->FitMicrocodeInfo[Index].MicrocodeEntryPoint) {
-      if (Index == (UINTN) MicrocodeFmpPrivate->FitMicrocodeEntryCount - 1) {
-        // it is last one
-        return NULL;
-      } else {
-        // return next one
-        return MicrocodeFmpPrivate->FitMicrocodeInfo[Index + 1].MicrocodeEntryPoint;
-      }
+  //
+  // FitMicrocodeInfo is sorted by address in InitializeFitMicrocodeInfo().
+  //
+  Low = 0;
+  High = MicrocodeFmpPrivate->FitMicrocodeEntryCount;
+  while (Low < High) {
+    Index = Low + (High - Low) / 2;
+    if ((UINTN)MicrocodeFmpPrivate->FitMicrocodeInfo[Index].MicrocodeEntryPoint < (UINTN)MicrocodeEntryPoint) {
+      Low = Index + 1;
+    } else {
+      High = Index;
+    }
+  }
+
+  Index = Low;
+  if ((Index < MicrocodeFmpPrivate->FitMicrocodeEntryCount) &&
+      (MicrocodeEntryPoint == MicrocodeFmpPrivate->FitMicrocodeInfo[Index].MicrocodeEntryPoint)) {
+    if (Index == (UINTN) MicrocodeFmpPrivate->FitMicrocodeEntryCount - 1) {
+      // it is last one
+      return NULL;
+    } else {
+      // return next one
+      return MicrocodeFmpPrivate->FitMicrocodeInfo[Index + 1].MicrocodeEntryPoint;
     }
   }
 
@@ -30,6 +30,7 @@
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/DevicePathLib.h>
 #include <Library/HobLib.h>
+#include <Library/TimerLib.h>
 #include <Library/MicrocodeFlashAccessLib.h>
 
 #include <Register/Cpuid.h>
@@ -45,6 +46,10 @@
 typedef struct {
   UINT32 LastAttemptVersion;
   UINT32 LastAttemptStatus;
+  //
+  // Time spent in the last SetImage(), in microseconds.
+  //
+  UINT32 LastAttemptUpdateTime;
 } MICROCODE_FMP_LAST_ATTEMPT_VARIABLE;
 
 typedef struct {
@@ -66,13 +71,35 @@ typedef struct {
   UINT8                  PlatformId;
   UINT32                 MicrocodeRevision;
   UINTN                  MicrocodeIndex;
+  UINTN                  ProcessorTypeIndex;
 } PROCESSOR_INFO;
 
+//
+// Processors sharing one (ProcessorSignature, PlatformId) pair.
+// Microcode matching only depends on this pair, so it is done once per type
+// instead of once per processor.
+//
+typedef struct {
+  UINT32                 ProcessorSignature;
+  UINT8                  PlatformId;
+  UINTN                  CpuIndex;          // The first processor of this type.
+  UINTN                  ProcessorCount;
+  UINTN                  ResolvedCpuIndex;  // The processor whose MicrocodeIndex is resolved, (UINTN)-1 if none.
+} PROCESSOR_TYPE_INFO;
+
 typedef struct {
   UINT64                 Address;
   UINT32                 Revision;
 } MICROCODE_LOAD_BUFFER;
 
+typedef struct {
+  EFI_MP_SERVICES_PROTOCOL  *MpService;
+  PROCESSOR_INFO            *ProcessorInfo;
+  UINTN                     ProcessorTypeIndex;
+  UINT64                    Address;
+  UINT32                    *Revision;      // Per processor, 0 if the processor did not load.
+} MICROCODE_BROADCAST_LOAD_BUFFER;
+
 struct _MICROCODE_FMP_PRIVATE_DATA {
   UINT32                               Signature;
   EFI_FIRMWARE_MANAGEMENT_PROTOCOL     Fmp;
@@ -89,6 +116,8 @@ struct _MICROCODE_FMP_PRIVATE_DATA {
   UINTN                                BspIndex;
   UINTN                                ProcessorCount;
   PROCESSOR_INFO                       *ProcessorInfo;
+  UINTN                                ProcessorTypeCount;
+  PROCESSOR_TYPE_INFO                  *ProcessorTypeInfo;
   UINT32                               FitMicrocodeEntryCount;
   FIT_MICROCODE_INFO                   *FitMicrocodeInfo;
 };
@@ -142,6 +171,18 @@ CollectProcessorInfo (
   IN OUT VOID  *Buffer
   );
 
+/**
+  Collect processor information on all Application Processors at once.
+  The function prototype for invoking a function on an Application Processor.
+
+  @param[in,out] Buffer  The pointer to the Microcode driver private data.
+**/
+VOID
+EFIAPI
+CollectAllProcessorInfo (
+  IN OUT VOID  *Buffer
+  );
+
 /**
   Get current Microcode information.
 
@@ -66,6 +66,38 @@ typedef struct {
   PCI_DEVICE_DATA                  *PciDeviceData;
 } PCI_DEVICE_INFORMATION;
 
+//
+// Number of recently used leaf (4K) page tables remembered per VTd engine.
+// Leaf tables are never freed or merged once a 2M page has been split, so a
+// cached entry stays valid for the life of the driver.
+//
+#define VTD_PAGE_TABLE_CACHE_SIZE           16
+
+typedef struct {
+  VTD_SECOND_LEVEL_PAGING_ENTRY    *SecondLevelPagingEntry;
+  UINT64                           BaseAddress;
+  UINT64                           *L1PageTable;
+} VTD_PAGE_TABLE_CACHE_ENTRY;
+
+//
+// Latency histogram buckets for SetAccessAttribute(), in TSC ticks.
+// Bucket N counts calls taking less than 2^(VTD_LATENCY_BUCKET_SHIFT + 2 * N) ticks,
+// the last bucket counts everything slower.
+//
+#define VTD_LATENCY_BUCKET_NUMBER           8
+#define VTD_LATENCY_BUCKET_SHIFT            10
+
+typedef struct {
+  UINT64                           MapRequests;
+  UINT64                           UnmapRequests;
+  UINT64                           MapLatency[VTD_LATENCY_BUCKET_NUMBER];
+  UINT64                           UnmapLatency[VTD_LATENCY_BUCKET_NUMBER];
+  UINT64                           PageTableCacheHits;
+  UINT64                           PageTableCacheMisses;
+  UINT64                           Invalidations;
+  UINT64                           InvalidationsSkipped;
+} VTD_TRANSLATION_STATISTICS;
+
 typedef struct {
   UINTN                            VtdUnitBaseAddress;
   UINT16                           Segment;
@@ -76,7 +108,10 @@ typedef struct {
   VTD_SECOND_LEVEL_PAGING_ENTRY    *FixedSecondLevelPagingEntry;
   BOOLEAN                          HasDirtyContext;
   BOOLEAN                          HasDirtyPages;
+  BOOLEAN                          HasNewPages;
   PCI_DEVICE_INFORMATION           PciDeviceInfo;
+  VTD_PAGE_TABLE_CACHE_ENTRY       PageTableCache[VTD_PAGE_TABLE_CACHE_SIZE];
+  VTD_TRANSLATION_STATISTICS       Statistics;
 } VTD_UNIT_INFORMATION;
 
 //
@@ -402,6 +437,16 @@ DumpSecondLevelPagingEntry (
   IN VOID *SecondLevelPagingEntry
   );
 
+/**
+  Dump the translation table statistics of the VTd engine owning the root entry table.
+
+  @param[in]  RootEntryTable  The root entry table or extended root entry table.
+**/
+VOID
+DumpVtdTranslationStatistics (
+  IN VOID *RootEntryTable
+  );
+
 /**
   Set VTd attribute for a system memory.
 
@@ -362,6 +362,7 @@ DumpDmarContextEntryTable (
       DumpSecondLevelPagingEntry ((VOID *)(UINTN)VTD_64BITS_ADDRESS(ContextEntry[Index2].Bits.SecondLevelPageTranslationPointerLo, ContextEntry[Index2].Bits.SecondLevelPageTranslationPointerHi));
     }
   }
+  DumpVtdTranslationStatistics (RootEntry);
   DEBUG ((DEBUG_INFO,"=========================\n"));
 }
 
@@ -427,9 +428,69 @@ DumpSecondLevelPagingEntry (
   DEBUG ((DEBUG_VERBOSE,"================\n"));
 }
 
+/**
+  Dump one SetAccessAttribute() latency histogram.
+
+  @param[in]  Name     The name of the histogram.
+  @param[in]  Latency  The histogram buckets.
+**/
+VOID
+DumpVtdLatencyHistogram (
+  IN CHAR8   *Name,
+  IN UINT64  *Latency
+  )
+{
+  UINTN  Index;
+
+  DEBUG ((DEBUG_INFO,"  %a Latency (TSC ticks):\n", Name));
+  for (Index = 0; Index < VTD_LATENCY_BUCKET_NUMBER - 1; Index++) {
+    DEBUG ((DEBUG_INFO,"    < 2^%02d - %ld\n", VTD_LATENCY_BUCKET_SHIFT + 2 * Index, Latency[Index]));
+  }
+  DEBUG ((DEBUG_INFO,"    >= 2^%02d - %ld\n", VTD_LATENCY_BUCKET_SHIFT + 2 * (VTD_LATENCY_BUCKET_NUMBER - 2), Latency[Index]));
+}
+
+/**
+  Dump the translation table statistics of the VTd engine owning the root entry table.
+
+  @param[in]  RootEntryTable  The root entry table or extended root entry table.
+**/
+VOID
+DumpVtdTranslationStatistics (
+  IN VOID *RootEntryTable
+  )
+{
+  UINTN                       VtdIndex;
+  VTD_TRANSLATION_STATISTICS  *Statistics;
+
+  for (VtdIndex = 0; VtdIndex < mVtdUnitNumber; VtdIndex++) {
+    if ((RootEntryTable == mVtdUnitInformation[VtdIndex].RootEntryTable) ||
+        (RootEntryTable == mVtdUnitInformation[VtdIndex].ExtRootEntryTable)) {
+      break;
+    }
+  }
+  if (VtdIndex == mVtdUnitNumber) {
+    return;
+  }
+
+  Statistics = &mVtdUnitInformation[VtdIndex].Statistics;
+  DEBUG ((DEBUG_INFO,"VTd Translation Statistics (%d):\n", VtdIndex));
+  DEBUG ((DEBUG_INFO,"  Map Requests           - %ld\n", Statistics->MapRequests));
+  DEBUG ((DEBUG_INFO,"  Unmap Requests         - %ld\n", Statistics->UnmapRequests));
+  DEBUG ((DEBUG_INFO,"  Page Table Cache Hits  - %ld\n", Statistics->PageTableCacheHits));
+  DEBUG ((DEBUG_INFO,"  Page Table Cache Miss  - %ld\n", Statistics->PageTableCacheMisses));
+  DEBUG ((DEBUG_INFO,"  Invalidations          - %ld\n", Statistics->Invalidations));
+  DEBUG ((DEBUG_INFO,"  Invalidations Skipped  - %ld\n", Statistics->InvalidationsSkipped));
+  DumpVtdLatencyHistogram ("Map", Statistics->MapLatency);
+  DumpVtdLatencyHistogram ("Unmap", Statistics->UnmapLatency);
+}
+
 /**
   Invalid page entry.
 
+  Only entries the hardware may have cached need the context cache and IOTLB
+  to be invalidated. Entries which just became present only need the write
+  buffer to be flushed.
+
   @param VtdIndex  The VTd engine index.
 **/
 VOID
@@ -439,9 +500,14 @@ InvalidatePageEntry (
 {
   if (mVtdUnitInformation[VtdIndex].HasDirtyContext || mVtdUnitInformation[VtdIndex].HasDirtyPages) {
     InvalidateVtdIOTLBGlobal (VtdIndex);
+    mVtdUnitInformation[VtdIndex].Statistics.Invalidations++;
+  } else if (mVtdUnitInformation[VtdIndex].HasNewPages) {
+    InvalidateVtdIOTLBGlobal (VtdIndex);
+    mVtdUnitInformation[VtdIndex].Statistics.InvalidationsSkipped++;
   }
   mVtdUnitInformation[VtdIndex].HasDirtyContext = FALSE;
   mVtdUnitInformation[VtdIndex].HasDirtyPages = FALSE;
+  mVtdUnitInformation[VtdIndex].HasNewPages = FALSE;
 }
 
 #define VTD_PG_R                   BIT0
@@ -504,6 +570,31 @@ PageAttributeToLength (
   return 0;
 }
 
+/**
+  Return if the VTd engine may have cached a page entry.
+
+  Without caching mode, the hardware never caches not-present entries (neither
+  read nor write permitted), so such an entry can be made present without
+  invalidating the IOTLB.
+
+  @param[in]  VtdIndex         The index used to identify a VTd engine.
+  @param[in]  PageEntry        The value of the page entry before it is modified.
+
+  @retval TRUE   The page entry may be cached, the IOTLB must be invalidated.
+  @retval FALSE  The page entry is not cached.
+**/
+BOOLEAN
+IsPageEntryCached (
+  IN  UINTN                             VtdIndex,
+  IN  UINT64                            PageEntry
+  )
+{
+  if (mVtdUnitInformation[VtdIndex].CapReg.Bits.CM != 0) {
+    return TRUE;
+  }
+  return (BOOLEAN)((PageEntry & (VTD_PG_R | VTD_PG_W)) != 0);
+}
+
 /**
   Return page table entry to match the address.
 
@@ -530,12 +621,25 @@ GetSecondLevelPageTableEntry (
   UINT64                *L2PageTable;
   UINT64                *L3PageTable;
   UINT64                *L4PageTable;
+  VTD_PAGE_TABLE_CACHE_ENTRY  *CacheEntry;
 
   Index4 = ((UINTN)RShiftU64 (Address, 39)) & PAGING_VTD_INDEX_MASK;
   Index3 = ((UINTN)Address >> 30) & PAGING_VTD_INDEX_MASK;
   Index2 = ((UINTN)Address >> 21) & PAGING_VTD_INDEX_MASK;
   Index1 = ((UINTN)Address >> 12) & PAGING_VTD_INDEX_MASK;
 
+  //
+  // Look up the leaf page table of this 2M region in the page table cache first
+  //
+  CacheEntry = &mVtdUnitInformation[VtdIndex].PageTableCache[Index2 % VTD_PAGE_TABLE_CACHE_SIZE];
+  if ((CacheEntry->SecondLevelPagingEntry == SecondLevelPagingEntry) &&
+      (CacheEntry->BaseAddress == (Address & ~(UINT64)PAGING_2M_MASK))) {
+    mVtdUnitInformation[VtdIndex].Statistics.PageTableCacheHits++;
+    L1PageTable = CacheEntry->L1PageTable;
+    goto Leaf;
+  }
+  mVtdUnitInformation[VtdIndex].Statistics.PageTableCacheMisses++;
+
   L4PageTable = (UINT64 *)SecondLevelPagingEntry;
   if (L4PageTable[Index4] == 0) {
     L4PageTable[Index4] = (UINT64)(UINTN)AllocateZeroPages (1);
@@ -584,6 +688,11 @@ GetSecondLevelPageTableEntry (
 
   // 4k
   L1PageTable = (UINT64 *)(UINTN)(L2PageTable[Index2] & PAGING_4K_ADDRESS_MASK_64);
+  CacheEntry->SecondLevelPagingEntry = SecondLevelPagingEntry;
+  CacheEntry->BaseAddress            = Address & ~(UINT64)PAGING_2M_MASK;
+  CacheEntry->L1PageTable            = L1PageTable;
+
+Leaf:
   if ((L1PageTable[Index1] == 0) && (Address != 0)) {
     *PageAttribute = PageNone;
     return NULL;
@@ -771,6 +880,7 @@ SetSecondLevelPagingAttribute (
   PAGE_ATTRIBUTE                 SplitAttribute;
   EFI_STATUS                     Status;
   BOOLEAN                        IsEntryModified;
+  UINT64                         OriginalPageEntry;
 
   DEBUG ((DEBUG_VERBOSE,"SetSecondLevelPagingAttribute (%d) (0x%016lx - 0x%016lx : %x) \n", VtdIndex, BaseAddress, Length, IoMmuAccess));
   DEBUG ((DEBUG_VERBOSE,"  SecondLevelPagingEntry Base - 0x%x\n", SecondLevelPagingEntry));
@@ -792,10 +902,15 @@ SetSecondLevelPagingAttribute (
     }
     PageEntryLength = PageAttributeToLength (PageAttribute);
     SplitAttribute = NeedSplitPage (BaseAddress, Length, PageAttribute);
+    OriginalPageEntry = PageEntry->Uint64;
     if (SplitAttribute == PageNone) {
       ConvertSecondLevelPageEntryAttribute (VtdIndex, PageEntry, IoMmuAccess, &IsEntryModified);
       if (IsEntryModified) {
-        mVtdUnitInformation[VtdIndex].HasDirtyPages = TRUE;
+        if (IsPageEntryCached (VtdIndex, OriginalPageEntry)) {
+          mVtdUnitInformation[VtdIndex].HasDirtyPages = TRUE;
+        } else {
+          mVtdUnitInformation[VtdIndex].HasNewPages = TRUE;
+        }
       }
       //
       // Convert success, move to next
@@ -808,7 +923,11 @@ SetSecondLevelPagingAttribute (
         DEBUG ((DEBUG_ERROR, "SplitSecondLevelPage - %r\n", Status));
         return RETURN_UNSUPPORTED;
       }
-      mVtdUnitInformation[VtdIndex].HasDirtyPages = TRUE;
+      if (IsPageEntryCached (VtdIndex, OriginalPageEntry)) {
+        mVtdUnitInformation[VtdIndex].HasDirtyPages = TRUE;
+      } else {
+        mVtdUnitInformation[VtdIndex].HasNewPages = TRUE;
+      }
       //
       // Just split current page
       // Convert success in next around
@@ -857,6 +976,39 @@ SetPageAttribute (
   return Status;
 }
 
+/**
+  Account one SetAccessAttribute() call in the translation statistics.
+
+  @param[in]  VtdIndex          The index used to identify a VTd engine.
+  @param[in]  IoMmuAccess       The IOMMU access.
+  @param[in]  Ticks             The TSC ticks spent in the call.
+**/
+VOID
+RecordAccessAttributeLatency (
+  IN UINTN                 VtdIndex,
+  IN UINT64                IoMmuAccess,
+  IN UINT64                Ticks
+  )
+{
+  VTD_TRANSLATION_STATISTICS  *Statistics;
+  UINTN                       Bucket;
+
+  Bucket = 0;
+  while ((Bucket < VTD_LATENCY_BUCKET_NUMBER - 1) &&
+         (Ticks >= LShiftU64 (1, VTD_LATENCY_BUCKET_SHIFT + 2 * Bucket))) {
+    Bucket++;
+  }
+
+  Statistics = &mVtdUnitInformation[VtdIndex].Statistics;
+  if (IoMmuAccess != 0) {
+    Statistics->MapRequests++;
+    Statistics->MapLatency[Bucket]++;
+  } else {
+    Statistics->UnmapRequests++;
+    Statistics->UnmapLatency[Bucket]++;
+  }
+}
+
 /**
   Set VTd attribute for a system memory.
 
@@ -893,7 +1045,9 @@ SetAccessAttribute (
   UINT64                        Pt;
   UINTN                         PciDataIndex;
   UINT16                        DomainIdentifier;
+  UINT64                        StartTicks;
 
+  StartTicks = AsmReadTsc ();
   SecondLevelPagingEntry = NULL;
 
   DEBUG ((DEBUG_VERBOSE,"SetAccessAttribute (S%04x B%02x D%02x F%02x) (0x%016lx - 0x%08x, %x)\n", Segment, SourceId.Bits.Bus, SourceId.Bits.Device, SourceId.Bits.Function, BaseAddress, (UINTN)Length, IoMmuAccess));
@@ -967,6 +1121,8 @@ SetAccessAttribute (
 
   InvalidatePageEntry (VtdIndex);
 
+  RecordAccessAttributeLatency (VtdIndex, IoMmuAccess, AsmReadTsc () - StartTicks);
+
   return EFI_SUCCESS;
 }
 
@@ -145,5 +145,6 @@ DumpDmarExtContextEntryTable (
       }
     }
   }
+  DumpVtdTranslationStatistics (ExtRootEntry);
   DEBUG ((DEBUG_INFO,"=========================\n"));
 }
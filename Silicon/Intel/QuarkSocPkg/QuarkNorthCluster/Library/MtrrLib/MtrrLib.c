@@ -21,6 +21,14 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define CACHE_FIXED_MTRR_ENABLED                      0x400
 #define IA32_MTRR_CAP_VCNT_MASK                       0xFF
 
+//
+// Limits of the variable MTRR calculation, and the way of covering a span
+// with the MTRRs of each of its memory ranges, see MtrrLibCalculateMtrrs()
+//
+#define MTRR_LIB_MAX_MAP_RANGES                       64
+#define MTRR_LIB_MAX_POINTS                           128
+#define MTRR_LIB_COVER_DIRECT                         0xFF
+
 //
 // Context to save and restore when MTRRs are programmed
 //
@@ -614,324 +622,6 @@ MtrrGetMemoryAttributeInVariableMtrr (
 }
 
 
-/**
-  Checks overlap between given memory range and MTRRs.
-
-  @param[in]  FirmwareVariableMtrrCount  The number of variable MTRRs available
-                                         to firmware.
-  @param[in]  Start                      The start address of memory range.
-  @param[in]  End                        The end address of memory range.
-  @param[in]  VariableMtrr               The array to shadow variable MTRRs content
-
-  @retval TRUE             Overlap exists.
-  @retval FALSE            No overlap.
-
-**/
-BOOLEAN
-CheckMemoryAttributeOverlap (
-  IN UINTN             FirmwareVariableMtrrCount,
-  IN PHYSICAL_ADDRESS  Start,
-  IN PHYSICAL_ADDRESS  End,
-  IN VARIABLE_MTRR     *VariableMtrr
-  )
-{
-  UINT32  Index;
-
-  for (Index = 0; Index < FirmwareVariableMtrrCount; Index++) {
-    if (
-         VariableMtrr[Index].Valid &&
-         !(
-           (Start > (VariableMtrr[Index].BaseAddress +
-                     VariableMtrr[Index].Length - 1)
-           ) ||
-           (End < VariableMtrr[Index].BaseAddress)
-         )
-       ) {
-      return TRUE;
-    }
-  }
-
-  return FALSE;
-}
-
-
-/**
-  Marks a variable MTRR as non-valid.
-
-  @param[in]   Index         The index of the array VariableMtrr to be invalidated
-  @param[in]   VariableMtrr  The array to shadow variable MTRRs content
-  @param[out]  UsedMtrr      The number of MTRRs which has already been used
-
-**/
-VOID
-InvalidateShadowMtrr (
-  IN   UINTN              Index,
-  IN   VARIABLE_MTRR      *VariableMtrr,
-  OUT  UINT32             *UsedMtrr
-  )
-{
-  VariableMtrr[Index].Valid = FALSE;
-  *UsedMtrr = *UsedMtrr - 1;
-}
-
-
-/**
-  Combines memory attributes.
-
-  If overlap exists between given memory range and MTRRs, try to combine them.
-
-  @param[in]       FirmwareVariableMtrrCount  The number of variable MTRRs
-                                              available to firmware.
-  @param[in]       Attributes                 The memory type to set.
-  @param[in, out]  Base                       The base address of memory range.
-  @param[in, out]  Length                     The length of memory range.
-  @param[in]       VariableMtrr               The array to shadow variable MTRRs content
-  @param[in, out]  UsedMtrr                   The number of MTRRs which has already been used
-  @param[out]      OverwriteExistingMtrr      Returns whether an existing MTRR was used
-
-  @retval EFI_SUCCESS            Memory region successfully combined.
-  @retval EFI_ACCESS_DENIED      Memory region cannot be combined.
-
-**/
-RETURN_STATUS
-CombineMemoryAttribute (
-  IN     UINT32             FirmwareVariableMtrrCount,
-  IN     UINT64             Attributes,
-  IN OUT UINT64             *Base,
-  IN OUT UINT64             *Length,
-  IN     VARIABLE_MTRR      *VariableMtrr,
-  IN OUT UINT32             *UsedMtrr,
-  OUT    BOOLEAN            *OverwriteExistingMtrr
-  )
-{
-  UINT32  Index;
-  UINT64  CombineStart;
-  UINT64  CombineEnd;
-  UINT64  MtrrEnd;
-  UINT64  EndAddress;
-  BOOLEAN CoveredByExistingMtrr;
-
-  *OverwriteExistingMtrr = FALSE;
-  CoveredByExistingMtrr = FALSE;
-  EndAddress = *Base +*Length - 1;
-
-  for (Index = 0; Index < FirmwareVariableMtrrCount; Index++) {
-
-    MtrrEnd = VariableMtrr[Index].BaseAddress + VariableMtrr[Index].Length - 1;
-    if (
-         !VariableMtrr[Index].Valid ||
-         (
-           *Base > (MtrrEnd) ||
-           (EndAddress < VariableMtrr[Index].BaseAddress)
-         )
-       ) {
-      continue;
-    }
-
-    //
-    // Combine same attribute MTRR range
-    //
-    if (Attributes == VariableMtrr[Index].Type) {
-      //
-      // if the MTRR range contain the request range, set a flag, then continue to
-      // invalidate any MTRR of the same request range with higher priority cache type.
-      //
-      if (VariableMtrr[Index].BaseAddress <= *Base && MtrrEnd >= EndAddress) {
-        CoveredByExistingMtrr = TRUE;
-        continue;
-      }
-      //
-      // invalid this MTRR, and program the combine range
-      //
-      CombineStart  =
-        (*Base) < VariableMtrr[Index].BaseAddress ?
-          (*Base) :
-          VariableMtrr[Index].BaseAddress;
-      CombineEnd    = EndAddress > MtrrEnd ? EndAddress : MtrrEnd;
-
-      //
-      // Record the MTRR usage status in VariableMtrr array.
-      //
-      InvalidateShadowMtrr (Index, VariableMtrr, UsedMtrr);
-      *Base       = CombineStart;
-      *Length     = CombineEnd - CombineStart + 1;
-      EndAddress  = CombineEnd;
-      *OverwriteExistingMtrr = TRUE;
-      continue;
-    } else {
-      //
-      // The cache type is different, but the range is convered by one MTRR
-      //
-      if (VariableMtrr[Index].BaseAddress == *Base && MtrrEnd == EndAddress) {
-        InvalidateShadowMtrr (Index, VariableMtrr, UsedMtrr);
-        continue;
-      }
-
-    }
-
-    if ((Attributes== MTRR_CACHE_WRITE_THROUGH &&
-         VariableMtrr[Index].Type == MTRR_CACHE_WRITE_BACK) ||
-        (Attributes == MTRR_CACHE_WRITE_BACK &&
-         VariableMtrr[Index].Type == MTRR_CACHE_WRITE_THROUGH) ||
-        (Attributes == MTRR_CACHE_UNCACHEABLE) ||
-        (VariableMtrr[Index].Type == MTRR_CACHE_UNCACHEABLE)
-     ) {
-      *OverwriteExistingMtrr = TRUE;
-      continue;
-    }
-    //
-    // Other type memory overlap is invalid
-    //
-    return RETURN_ACCESS_DENIED;
-  }
-
-  if (CoveredByExistingMtrr) {
-    *Length = 0;
-  }
-
-  return RETURN_SUCCESS;
-}
-
-
-/**
-  Calculates the maximum value which is a power of 2, but less the MemoryLength.
-
-  @param[in]  MemoryLength        The number to pass in.
-
-  @return The maximum value which is align to power of 2 and less the MemoryLength
-
-**/
-UINT64
-Power2MaxMemory (
-  IN UINT64                     MemoryLength
-  )
-{
-  UINT64  Result;
-
-  if (RShiftU64 (MemoryLength, 32) != 0) {
-    Result = LShiftU64 (
-               (UINT64) GetPowerOfTwo32 (
-                          (UINT32) RShiftU64 (MemoryLength, 32)
-                          ),
-               32
-               );
-  } else {
-    Result = (UINT64) GetPowerOfTwo32 ((UINT32) MemoryLength);
-  }
-
-  return Result;
-}
-
-
-/**
-  Determines the MTRR numbers used to program a memory range.
-
-  This function first checks the alignment of the base address.
-  If the alignment of the base address <= Length, cover the memory range
- (BaseAddress, alignment) by a MTRR, then BaseAddress += alignment and
-  Length -= alignment. Repeat the step until alignment > Length.
-
-  Then this function determines which direction of programming the variable
-  MTRRs for the remaining length will use fewer MTRRs.
-
-  @param[in]  BaseAddress Length of Memory to program MTRR
-  @param[in]  Length      Length of Memory to program MTRR
-  @param[in]  MtrrNumber  Pointer to the number of necessary MTRRs
-
-  @retval TRUE        Positive direction is better.
-          FALSE       Negative direction is better.
-
-**/
-BOOLEAN
-GetMtrrNumberAndDirection (
-  IN UINT64      BaseAddress,
-  IN UINT64      Length,
-  IN UINTN       *MtrrNumber
-  )
-{
-  UINT64  TempQword;
-  UINT64  Alignment;
-  UINT32  Positive;
-  UINT32  Subtractive;
-
-  *MtrrNumber = 0;
-
-  if (BaseAddress != 0) {
-    do {
-      //
-      // Calculate the alignment of the base address.
-      //
-      Alignment = LShiftU64 (1, (UINTN)LowBitSet64 (BaseAddress));
-
-      if (Alignment > Length) {
-        break;
-      }
-
-      (*MtrrNumber)++;
-      BaseAddress += Alignment;
-      Length -= Alignment;
-    } while (TRUE);
-
-    if (Length == 0) {
-      return TRUE;
-    }
-  }
-
-  TempQword   = Length;
-  Positive    = 0;
-  Subtractive = 0;
-
-  do {
-    TempQword -= Power2MaxMemory (TempQword);
-    Positive++;
-  } while (TempQword != 0);
-
-  TempQword = Power2MaxMemory (LShiftU64 (Length, 1)) - Length;
-  Subtractive++;
-  do {
-    TempQword -= Power2MaxMemory (TempQword);
-    Subtractive++;
-  } while (TempQword != 0);
-
-  if (Positive <= Subtractive) {
-    *MtrrNumber += Positive;
-    return TRUE;
-  } else {
-    *MtrrNumber += Subtractive;
-    return FALSE;
-  }
-}
-
-/**
-  Invalid variable MTRRs according to the value in the shadow array.
-
-  This function programs MTRRs according to the values specified
-  in the shadow array.
-
-  @param[in, out]  VariableSettings   Variable MTRR settings
-  @param[in]       VariableMtrrCount  Number of variable MTRRs
-  @param[in, out]  VariableMtrr       Shadow of variable MTRR contents
-
-**/
-VOID
-InvalidateMtrr (
-  IN OUT MTRR_VARIABLE_SETTINGS  *VariableSettings,
-  IN     UINTN                   VariableMtrrCount,
-  IN OUT VARIABLE_MTRR           *VariableMtrr
-  )
-{
-  UINTN         Index;
-
-  for (Index = 0; Index < VariableMtrrCount; Index++) {
-    if (!VariableMtrr[Index].Valid && VariableMtrr[Index].Used) {
-       VariableSettings->Mtrr[Index].Base = 0;
-       VariableSettings->Mtrr[Index].Mask = 0;
-       VariableMtrr[Index].Used = FALSE;
-    }
-  }
-}
-
-
 /**
   Programs variable MTRRs
 
@@ -1422,335 +1112,783 @@ MtrrDebugPrintAllMtrrs (
 
 
 /**
-  Worker function attempts to set the attributes for a memory range.
-
-  If MtrrSettings is not NULL, set the attributes into the input MTRR
-  settings buffer.
-  If MtrrSettings is NULL, set the attributes into MTRRs registers.
+  Returns the largest naturally aligned power of 2 block that starts at
+  BaseAddress and fits in Length.
 
-  @param[in, out]  MtrrSetting       A buffer holding all MTRRs content.
-  @param[in]       BaseAddress       The physical address that is the start
-                                     address of a memory region.
-  @param[in]       Length            The size in bytes of the memory region.
-  @param[in]       Attribute         The bit mask of attributes to set for the
-                                     memory region.
+  @param[in]  BaseAddress  The base address of the memory range.
+  @param[in]  Length       The length of the memory range.
 
-  @retval RETURN_SUCCESS            The attributes were set for the memory
-                                    region.
-  @retval RETURN_INVALID_PARAMETER  Length is zero.
-  @retval RETURN_UNSUPPORTED        The processor does not support one or
-                                    more bytes of the memory resource range
-                                    specified by BaseAddress and Length.
-  @retval RETURN_UNSUPPORTED        The bit mask of attributes is not support
-                                    for the memory resource range specified
-                                    by BaseAddress and Length.
-  @retval RETURN_ACCESS_DENIED      The attributes for the memory resource
-                                    range specified by BaseAddress and Length
-                                    cannot be modified.
-  @retval RETURN_OUT_OF_RESOURCES   There are not enough system resources to
-                                    modify the attributes of the memory
-                                    resource range.
+  @return The length of the block.
 
 **/
-RETURN_STATUS
-MtrrSetMemoryAttributeWorker (
-  IN OUT MTRR_SETTINGS           *MtrrSetting,
-  IN PHYSICAL_ADDRESS            BaseAddress,
-  IN UINT64                      Length,
-  IN MTRR_MEMORY_CACHE_TYPE      Attribute
+UINT64
+MtrrLibBiggestAlignment (
+  IN UINT64     BaseAddress,
+  IN UINT64     Length
   )
 {
-  UINT64                    TempQword;
-  RETURN_STATUS             Status;
-  UINT64                    MemoryType;
-  UINT64                    Alignment;
-  BOOLEAN                   OverLap;
-  BOOLEAN                   Positive;
-  UINT32                    MsrNum;
-  UINTN                     MtrrNumber;
-  VARIABLE_MTRR             VariableMtrr[MTRR_NUMBER_OF_VARIABLE_MTRR];
-  UINT32                    UsedMtrr;
-  UINT64                    MtrrValidBitsMask;
-  UINT64                    MtrrValidAddressMask;
-  BOOLEAN                   OverwriteExistingMtrr;
-  UINT32                    FirmwareVariableMtrrCount;
-  MTRR_CONTEXT              MtrrContext;
-  BOOLEAN                   MtrrContextValid;
-  BOOLEAN                   FixedSettingsValid[MTRR_NUMBER_OF_FIXED_MTRR];
-  BOOLEAN                   FixedSettingsModified[MTRR_NUMBER_OF_FIXED_MTRR];
-  MTRR_FIXED_SETTINGS       WorkingFixedSettings;
-  UINT32                    VariableMtrrCount;
-  MTRR_VARIABLE_SETTINGS    OriginalVariableSettings;
-  BOOLEAN                   ProgramVariableSettings;
-  MTRR_VARIABLE_SETTINGS    WorkingVariableSettings;
-  UINT32                    Index;
-  UINT64                    ClearMask;
-  UINT64                    OrMask;
-  UINT64                    NewValue;
-  MTRR_VARIABLE_SETTINGS    *VariableSettings;
+  UINT64  Alignment;
 
-  MtrrContextValid  = FALSE;
-  VariableMtrrCount = 0;
-  ZeroMem (&WorkingFixedSettings, sizeof (WorkingFixedSettings));
-  for (Index = 0; Index < MTRR_NUMBER_OF_FIXED_MTRR; Index++) {
-    FixedSettingsValid[Index]    = FALSE;
-    FixedSettingsModified[Index] = FALSE;
+  Alignment = GetPowerOfTwo64 (Length);
+  if (BaseAddress != 0 && (BaseAddress & (Alignment - 1)) != 0) {
+    Alignment = LShiftU64 (1, (UINTN)LowBitSet64 (BaseAddress));
   }
-  ProgramVariableSettings = FALSE;
 
-  if (!IsMtrrSupported ()) {
-    Status = RETURN_UNSUPPORTED;
-    goto Done;
+  return Alignment;
+}
+
+
+/**
+  Returns the number of variable MTRRs needed to cover a memory range on its
+  own, i.e. the number of naturally aligned power of 2 blocks it is made of.
+
+  @param[in]  BaseAddress  The base address of the memory range.
+  @param[in]  Length       The length of the memory range.
+
+  @return The number of variable MTRRs.
+
+**/
+UINT32
+MtrrLibGetBlockCount (
+  IN UINT64     BaseAddress,
+  IN UINT64     Length
+  )
+{
+  UINT64  Alignment;
+  UINT32  Count;
+
+  for (Count = 0; Length != 0; Count++) {
+    Alignment    = MtrrLibBiggestAlignment (BaseAddress, Length);
+    BaseAddress += Alignment;
+    Length      -= Alignment;
   }
 
-  MtrrLibInitializeMtrrMask (&MtrrValidBitsMask, &MtrrValidAddressMask);
+  return Count;
+}
 
-  TempQword = 0;
-  MemoryType = (UINT64)Attribute;
-  OverwriteExistingMtrr = FALSE;
+
+/**
+  Sets the memory type of a memory range in a memory map.
+
+  A memory map is a list of contiguous memory ranges, sorted by address, that
+  covers the whole physical address space. Adjacent ranges never have the same
+  memory type.
+
+  @param[in, out]  Map          The memory map.
+  @param[in, out]  MapCount     The number of ranges in the memory map.
+  @param[in]       BaseAddress  The base address of the memory range.
+  @param[in]       Length       The length of the memory range.
+  @param[in]       Type         The memory type to set.
+
+  @retval RETURN_SUCCESS           The memory type was set.
+  @retval RETURN_OUT_OF_RESOURCES  The memory map has no room for the range.
+
+**/
+RETURN_STATUS
+MtrrLibSetMemoryRange (
+  IN OUT MTRR_MEMORY_RANGE       *Map,
+  IN OUT UINTN                   *MapCount,
+  IN     UINT64                  BaseAddress,
+  IN     UINT64                  Length,
+  IN     MTRR_MEMORY_CACHE_TYPE  Type
+  )
+{
+  MTRR_MEMORY_RANGE  NewRange[3];
+  UINTN              NewCount;
+  UINTN              First;
+  UINTN              Last;
+  UINTN              Index;
+  UINTN              Count;
+  UINT64             Limit;
+
+  Limit = BaseAddress + Length;
 
   //
-  // Check for an invalid parameter
+  // Find the ranges holding the first and the last byte
   //
-  if (Length == 0) {
-    Status = RETURN_INVALID_PARAMETER;
-    goto Done;
+  for (First = 0; Map[First].BaseAddress + Map[First].Length <= BaseAddress; First++) {
+  }
+  for (Last = First; Map[Last].BaseAddress + Map[Last].Length < Limit; Last++) {
   }
 
-  if (
-       (BaseAddress & ~MtrrValidAddressMask) != 0 ||
-       (Length & ~MtrrValidAddressMask) != 0
-     ) {
-    Status = RETURN_UNSUPPORTED;
-    goto Done;
+  NewCount = 0;
+  if (Map[First].BaseAddress < BaseAddress) {
+    NewRange[NewCount].BaseAddress = Map[First].BaseAddress;
+    NewRange[NewCount].Length      = BaseAddress - Map[First].BaseAddress;
+    NewRange[NewCount].Type        = Map[First].Type;
+    NewCount++;
+  }
+  NewRange[NewCount].BaseAddress = BaseAddress;
+  NewRange[NewCount].Length      = Length;
+  NewRange[NewCount].Type        = Type;
+  NewCount++;
+  if (Map[Last].BaseAddress + Map[Last].Length > Limit) {
+    NewRange[NewCount].BaseAddress = Limit;
+    NewRange[NewCount].Length      = Map[Last].BaseAddress + Map[Last].Length - Limit;
+    NewRange[NewCount].Type        = Map[Last].Type;
+    NewCount++;
   }
 
-  //
-  // Check if Fixed MTRR
-  //
-  Status = RETURN_SUCCESS;
-  if (BaseAddress < BASE_1MB) {
-    while ((BaseAddress < BASE_1MB) && (Length > 0) && Status == RETURN_SUCCESS) {
-      Status = ProgramFixedMtrr (MemoryType, &BaseAddress, &Length, &MsrNum, &ClearMask, &OrMask);
-      if (RETURN_ERROR (Status)) {
-        goto Done;
-      }
-      if (MtrrSetting != NULL) {
-        MtrrSetting->Fixed.Mtrr[MsrNum] = (MtrrSetting->Fixed.Mtrr[MsrNum] & ~ClearMask) | OrMask;
-        MtrrSetting->MtrrDefType |= CACHE_FIXED_MTRR_ENABLED;
-      } else {
-        if (!FixedSettingsValid[MsrNum]) {
-          WorkingFixedSettings.Mtrr[MsrNum] = MtrrRegisterRead (mMtrrLibFixedMtrrTable[MsrNum].Msr);
-          FixedSettingsValid[MsrNum] = TRUE;
-        }
-        NewValue = (WorkingFixedSettings.Mtrr[MsrNum] & ~ClearMask) | OrMask;
-        if (WorkingFixedSettings.Mtrr[MsrNum] != NewValue) {
-          WorkingFixedSettings.Mtrr[MsrNum] = NewValue;
-          FixedSettingsModified[MsrNum] = TRUE;
-        }
-      }
-    }
-
-    if (Length == 0) {
-      //
-      // A Length of 0 can only make sense for fixed MTTR ranges.
-      // Since we just handled the fixed MTRRs, we can skip the
-      // variable MTRR section.
-      //
-      goto Done;
-    }
+  Count = *MapCount - (Last - First + 1) + NewCount;
+  if (Count > MTRR_LIB_MAX_MAP_RANGES) {
+    return RETURN_OUT_OF_RESOURCES;
   }
 
+  CopyMem (
+    &Map[First + NewCount],
+    &Map[Last + 1],
+    (*MapCount - Last - 1) * sizeof (MTRR_MEMORY_RANGE)
+    );
+  CopyMem (&Map[First], NewRange, NewCount * sizeof (MTRR_MEMORY_RANGE));
+
   //
-  // Since memory ranges below 1MB will be overridden by the fixed MTRRs,
-  // we can set the base to 0 to save variable MTRRs.
+  // Merge adjacent ranges of the same type
   //
-  if (BaseAddress == BASE_1MB) {
-    BaseAddress = 0;
-    Length += SIZE_1MB;
+  for (Index = 1, *MapCount = 1; Index < Count; Index++) {
+    if (Map[Index].Type == Map[*MapCount - 1].Type) {
+      Map[*MapCount - 1].Length += Map[Index].Length;
+    } else {
+      CopyMem (&Map[*MapCount], &Map[Index], sizeof (MTRR_MEMORY_RANGE));
+      (*MapCount)++;
+    }
   }
 
+  return RETURN_SUCCESS;
+}
+
+
+/**
+  Builds the memory map produced by variable MTRRs and the default memory type.
+
+  @param[in]   VariableMtrr       The shadow of the variable MTRRs.
+  @param[in]   VariableMtrrCount  The number of variable MTRRs in VariableMtrr.
+  @param[in]   DefaultType        The default memory type.
+  @param[in]   Limit              The size of the physical address space.
+  @param[out]  Map                The memory map.
+  @param[out]  MapCount           The number of ranges in the memory map.
+
+  @retval RETURN_SUCCESS           The memory map was built.
+  @retval RETURN_OUT_OF_RESOURCES  The memory map has too many ranges.
+
+**/
+RETURN_STATUS
+MtrrLibGetMemoryMap (
+  IN  VARIABLE_MTRR           *VariableMtrr,
+  IN  UINTN                   VariableMtrrCount,
+  IN  MTRR_MEMORY_CACHE_TYPE  DefaultType,
+  IN  UINT64                  Limit,
+  OUT MTRR_MEMORY_RANGE       *Map,
+  OUT UINTN                   *MapCount
+  )
+{
+  RETURN_STATUS  Status;
+  UINT64         Boundary[2 * MTRR_NUMBER_OF_VARIABLE_MTRR + 2];
+  UINTN          BoundaryCount;
+  UINT64         Address;
+  UINT64         MtrrType;
+  BOOLEAN        Covered;
+  UINTN          Index;
+  UINTN          Index2;
+
   //
-  // Read all variable MTRRs
+  // Collect the addresses at which the memory type may change
   //
-  VariableMtrrCount = GetVariableMtrrCountWorker ();
-  FirmwareVariableMtrrCount = GetFirmwareVariableMtrrCountWorker ();
-  if (MtrrSetting != NULL) {
-    VariableSettings = &MtrrSetting->Variables;
-  } else {
-    MtrrGetVariableMtrrWorker (NULL, VariableMtrrCount, &OriginalVariableSettings);
-    CopyMem (&WorkingVariableSettings, &OriginalVariableSettings, sizeof (WorkingVariableSettings));
-    ProgramVariableSettings = TRUE;
-    VariableSettings = &WorkingVariableSettings;
+  Boundary[0] = 0;
+  Boundary[1] = Limit;
+  BoundaryCount = 2;
+  for (Index = 0; Index < VariableMtrrCount; Index++) {
+    if (VariableMtrr[Index].Valid) {
+      Boundary[BoundaryCount++] = VariableMtrr[Index].BaseAddress;
+      Boundary[BoundaryCount++] = MIN (VariableMtrr[Index].BaseAddress + VariableMtrr[Index].Length, Limit);
+    }
+  }
+  for (Index = 1; Index < BoundaryCount; Index++) {
+    Address = Boundary[Index];
+    for (Index2 = Index; Index2 > 0 && Boundary[Index2 - 1] > Address; Index2--) {
+      Boundary[Index2] = Boundary[Index2 - 1];
+    }
+    Boundary[Index2] = Address;
   }
 
-  //
-  // Check for overlap
-  //
-  UsedMtrr = MtrrGetMemoryAttributeInVariableMtrrWorker (
-               VariableSettings,
-               FirmwareVariableMtrrCount,
-               MtrrValidBitsMask,
-               MtrrValidAddressMask,
-               VariableMtrr
-               );
-  OverLap = CheckMemoryAttributeOverlap (
-              FirmwareVariableMtrrCount,
-              BaseAddress,
-              BaseAddress + Length - 1,
-              VariableMtrr
-              );
-  if (OverLap) {
-    Status = CombineMemoryAttribute (
-               FirmwareVariableMtrrCount,
-               MemoryType,
-               &BaseAddress,
-               &Length,
-               VariableMtrr,
-               &UsedMtrr,
-               &OverwriteExistingMtrr
-               );
-    if (RETURN_ERROR (Status)) {
-      goto Done;
+  Map[0].BaseAddress = 0;
+  Map[0].Length      = Limit;
+  Map[0].Type        = DefaultType;
+  *MapCount          = 1;
+
+  for (Index = 0; Index + 1 < BoundaryCount; Index++) {
+    Address = Boundary[Index];
+    if (Address == Boundary[Index + 1]) {
+      continue;
     }
 
-    if (Length == 0) {
+    MtrrType = MTRR_CACHE_INVALID_TYPE;
+    Covered  = FALSE;
+    for (Index2 = 0; Index2 < VariableMtrrCount; Index2++) {
+      if (VariableMtrr[Index2].Valid &&
+          Address >= VariableMtrr[Index2].BaseAddress &&
+          Address < VariableMtrr[Index2].BaseAddress + VariableMtrr[Index2].Length) {
+        MtrrType = MtrrPrecedence (MtrrType, VariableMtrr[Index2].Type);
+        Covered  = TRUE;
+      }
+    }
+    if (!Covered) {
+      continue;
+    }
+    if (MtrrType == MTRR_CACHE_INVALID_TYPE) {
       //
-      // Combined successfully, invalidate the now-unused MTRRs
+      // The overlapping MTRRs conflict, and the memory type is undefined
       //
-      InvalidateMtrr (VariableSettings, VariableMtrrCount, VariableMtrr);
-      Status = RETURN_SUCCESS;
-      goto Done;
+      MtrrType = MTRR_CACHE_UNCACHEABLE;
+    }
+
+    Status = MtrrLibSetMemoryRange (
+               Map,
+               MapCount,
+               Address,
+               Boundary[Index + 1] - Address,
+               (MTRR_MEMORY_CACHE_TYPE)MtrrType
+               );
+    if (RETURN_ERROR (Status)) {
+      return Status;
     }
   }
 
-  //
-  // The memory type is the same with the type specified by
-  // MTRR_LIB_IA32_MTRR_DEF_TYPE.
-  //
-  if ((!OverwriteExistingMtrr) && (Attribute == MtrrGetDefaultMemoryType ())) {
-    //
-    // Invalidate the now-unused MTRRs
-    //
-    InvalidateMtrr (VariableSettings, VariableMtrrCount, VariableMtrr);
-    goto Done;
+  return RETURN_SUCCESS;
+}
+
+
+/**
+  Adds an address to the sorted list of addresses at which a variable MTRR
+  may start or end. The address is dropped if the list is full.
+
+  @param[in, out]  Point       The list of addresses.
+  @param[in, out]  PointCount  The number of addresses in the list.
+  @param[in]       Address     The address to add.
+
+**/
+VOID
+MtrrLibAddPoint (
+  IN OUT UINT64   *Point,
+  IN OUT UINTN    *PointCount,
+  IN     UINT64   Address
+  )
+{
+  UINTN  Index;
+
+  for (Index = *PointCount; Index > 0 && Point[Index - 1] >= Address; Index--) {
+    if (Point[Index - 1] == Address) {
+      return;
+    }
   }
 
-  Positive = GetMtrrNumberAndDirection (BaseAddress, Length, &MtrrNumber);
+  if (*PointCount == MTRR_LIB_MAX_POINTS) {
+    return;
+  }
 
-  if ((UsedMtrr + MtrrNumber) > FirmwareVariableMtrrCount) {
-    Status = RETURN_OUT_OF_RESOURCES;
-    goto Done;
+  CopyMem (&Point[Index + 1], &Point[Index], (*PointCount - Index) * sizeof (UINT64));
+  Point[Index] = Address;
+  (*PointCount)++;
+}
+
+
+/**
+  Adds the variable MTRRs covering a memory range on its own.
+
+  @param[in, out]  Mtrrs        The variable MTRRs.
+  @param[in, out]  MtrrCount    The number of variable MTRRs.
+  @param[in]       BaseAddress  The base address of the memory range.
+  @param[in]       Length       The length of the memory range.
+  @param[in]       Type         The memory type of the memory range.
+
+**/
+VOID
+MtrrLibAddMtrrs (
+  IN OUT MTRR_MEMORY_RANGE       *Mtrrs,
+  IN OUT UINT32                  *MtrrCount,
+  IN     UINT64                  BaseAddress,
+  IN     UINT64                  Length,
+  IN     MTRR_MEMORY_CACHE_TYPE  Type
+  )
+{
+  UINT64  Alignment;
+
+  while (Length != 0) {
+    Alignment = MtrrLibBiggestAlignment (BaseAddress, Length);
+    Mtrrs[*MtrrCount].BaseAddress = BaseAddress;
+    Mtrrs[*MtrrCount].Length      = Alignment;
+    Mtrrs[*MtrrCount].Type        = Type;
+    (*MtrrCount)++;
+    BaseAddress += Alignment;
+    Length      -= Alignment;
   }
+}
 
-  //
-  // Invalidate the now-unused MTRRs
-  //
-  InvalidateMtrr (VariableSettings, VariableMtrrCount, VariableMtrr);
+
+/**
+  Calculates the smallest set of variable MTRRs which produces a memory map.
+
+  Every address at which a variable MTRR may start or end is a vertex, and the
+  cheapest way to cover the memory map from address 0 to each vertex is found
+  in address order. The span between two vertices is covered either by the
+  MTRRs of each of its memory ranges, or by MTRRs of a single type over the
+  whole span plus the MTRRs of the memory ranges whose type takes precedence
+  over that one, like UC over any type and WT over WB. The latter is how a
+  memory range ending just below a power of 2 takes two MTRRs instead of many.
+  The vertices are the boundaries of the memory ranges, plus each boundary
+  rounded up and down to every power of 2.
+
+  @param[in]       Map          The memory map.
+  @param[in]       MapCount     The number of ranges in the memory map.
+  @param[in]       DefaultType  The memory type of the memory no MTRR covers.
+  @param[out]      Mtrrs        The variable MTRRs to program.
+  @param[in, out]  MtrrCount    On input, the number of variable MTRRs available.
+                                On output, the number of variable MTRRs needed.
+
+  @retval RETURN_SUCCESS           The variable MTRRs were calculated.
+  @retval RETURN_OUT_OF_RESOURCES  More variable MTRRs are needed than available.
+
+**/
+RETURN_STATUS
+MtrrLibCalculateMtrrs (
+  IN     MTRR_MEMORY_RANGE       *Map,
+  IN     UINTN                   MapCount,
+  IN     MTRR_MEMORY_CACHE_TYPE  DefaultType,
+  OUT    MTRR_MEMORY_RANGE       *Mtrrs,
+  IN OUT UINT32                  *MtrrCount
+  )
+{
+  UINT64                  Point[MTRR_LIB_MAX_POINTS];
+  UINT8                   PointType[MTRR_LIB_MAX_POINTS];
+  UINT32                  Cost[MTRR_LIB_MAX_POINTS];
+  UINT8                   Prev[MTRR_LIB_MAX_POINTS];
+  UINT8                   Cover[MTRR_LIB_MAX_POINTS];
+  UINT32                  BaseCost[MTRR_CACHE_INVALID_TYPE];
+  BOOLEAN                 BaseValid[MTRR_CACHE_INVALID_TYPE];
+  UINTN                   PointCount;
+  UINT64                  Limit;
+  UINT64                  Address;
+  UINT64                  Alignment;
+  UINT64                  RunStart;
+  UINT8                   RunType;
+  UINT32                  RunBlocks;
+  UINT32                  SpanBlocks;
+  UINT32                  DirectCost;
+  UINT32                  BestCost;
+  UINT8                   BestCover;
+  UINT32                  Count;
+  UINTN                   Index;
+  UINTN                   Start;
+  UINTN                   End;
+  UINT8                   Type;
+
+  Limit = Map[MapCount - 1].BaseAddress + Map[MapCount - 1].Length;
 
   //
-  // Find first unused MTRR
+  // The boundaries of the memory ranges go first, so they are never dropped
   //
-  for (MsrNum = 0; MsrNum < VariableMtrrCount; MsrNum++) {
-    if ((VariableSettings->Mtrr[MsrNum].Mask & CACHE_MTRR_ENABLED) == 0) {
-      break;
+  PointCount = 0;
+  for (Index = 0; Index < MapCount; Index++) {
+    MtrrLibAddPoint (Point, &PointCount, Map[Index].BaseAddress);
+  }
+  MtrrLibAddPoint (Point, &PointCount, Limit);
+  for (Index = 1; Index < MapCount; Index++) {
+    Address = Map[Index].BaseAddress;
+    for (Alignment = LShiftU64 (1, (UINTN)LowBitSet64 (Address) + 1); Alignment <= Limit; Alignment = LShiftU64 (Alignment, 1)) {
+      MtrrLibAddPoint (Point, &PointCount, Address & ~(Alignment - 1));
+      MtrrLibAddPoint (Point, &PointCount, (Address + Alignment - 1) & ~(Alignment - 1));
     }
   }
 
-  if (BaseAddress != 0) {
-    do {
-      //
-      // Calculate the alignment of the base address.
-      //
-      Alignment = LShiftU64 (1, (UINTN)LowBitSet64 (BaseAddress));
+  for (Index = 0, Start = 0; Index + 1 < PointCount; Index++) {
+    while (Map[Start].BaseAddress + Map[Start].Length <= Point[Index]) {
+      Start++;
+    }
+    PointType[Index] = (UINT8)Map[Start].Type;
+  }
 
-      if (Alignment > Length) {
-        break;
+  Cost[0] = 0;
+  for (Index = 1; Index < PointCount; Index++) {
+    Cost[Index] = MAX_UINT32;
+  }
+
+  for (Start = 0; Start + 1 < PointCount; Start++) {
+    DirectCost = 0;
+    for (Type = 0; Type < MTRR_CACHE_INVALID_TYPE; Type++) {
+      BaseCost[Type]  = 0;
+      BaseValid[Type] = (BOOLEAN)(Type == MTRR_CACHE_WRITE_COMBINING ||
+                                  Type == MTRR_CACHE_WRITE_THROUGH ||
+                                  Type == MTRR_CACHE_WRITE_PROTECTED ||
+                                  Type == MTRR_CACHE_WRITE_BACK);
+    }
+    RunStart = Point[Start];
+    RunType  = PointType[Start];
+
+    for (End = Start + 1; End < PointCount; End++) {
+      if (PointType[End - 1] != RunType) {
+        //
+        // A memory range of RunType ends at Point[End - 1]; account for it
+        //
+        RunBlocks = MtrrLibGetBlockCount (RunStart, Point[End - 1] - RunStart);
+        if (RunType != DefaultType) {
+          DirectCost += RunBlocks;
+        }
+        for (Type = 0; Type < MTRR_CACHE_INVALID_TYPE; Type++) {
+          if (RunType == Type) {
+            continue;
+          }
+          if (MtrrPrecedence (Type, RunType) == RunType) {
+            BaseCost[Type] += RunBlocks;
+          } else {
+            BaseValid[Type] = FALSE;
+          }
+        }
+        RunStart = Point[End - 1];
+        RunType  = PointType[End - 1];
       }
 
       //
-      // Find unused MTRR
+      // Cost of covering [Point[Start], Point[End]) directly
+      //
+      RunBlocks = MtrrLibGetBlockCount (RunStart, Point[End] - RunStart);
+      BestCost  = DirectCost + ((RunType != DefaultType) ? RunBlocks : 0);
+      BestCover = MTRR_LIB_COVER_DIRECT;
+
+      //
+      // Cost of covering [Point[Start], Point[End]) with MTRRs of one type,
+      // overridden where needed
       //
-      for (; MsrNum < VariableMtrrCount; MsrNum++) {
-        if ((VariableSettings->Mtrr[MsrNum].Mask & CACHE_MTRR_ENABLED) == 0) {
-          break;
+      SpanBlocks = MtrrLibGetBlockCount (Point[Start], Point[End] - Point[Start]);
+      for (Type = 0; Type < MTRR_CACHE_INVALID_TYPE; Type++) {
+        if (!BaseValid[Type]) {
+          continue;
+        }
+        if (RunType == Type) {
+          Count = SpanBlocks + BaseCost[Type];
+        } else if (MtrrPrecedence (Type, RunType) == RunType) {
+          Count = SpanBlocks + BaseCost[Type] + RunBlocks;
+        } else {
+          continue;
+        }
+        if (Count < BestCost) {
+          BestCost  = Count;
+          BestCover = Type;
         }
       }
 
+      if (Cost[Start] + BestCost < Cost[End]) {
+        Cost[End]  = Cost[Start] + BestCost;
+        Prev[End]  = (UINT8)Start;
+        Cover[End] = BestCover;
+      }
+    }
+  }
+
+  if (Cost[PointCount - 1] > *MtrrCount) {
+    *MtrrCount = Cost[PointCount - 1];
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Walk back the cheapest path and produce its MTRRs
+  //
+  Count = 0;
+  for (End = PointCount - 1; End != 0; End = Start) {
+    Start = Prev[End];
+    if (Cover[End] != MTRR_LIB_COVER_DIRECT) {
+      MtrrLibAddMtrrs (
+        Mtrrs,
+        &Count,
+        Point[Start],
+        Point[End] - Point[Start],
+        (MTRR_MEMORY_CACHE_TYPE)Cover[End]
+        );
+    }
+    for (Index = Start; Index < End; ) {
+      RunStart = Point[Index];
+      RunType  = PointType[Index];
+      while (Index < End && PointType[Index] == RunType) {
+        Index++;
+      }
+      if ((Cover[End] == MTRR_LIB_COVER_DIRECT) ? (RunType != DefaultType) : (RunType != Cover[End])) {
+        MtrrLibAddMtrrs (Mtrrs, &Count, RunStart, Point[Index] - RunStart, (MTRR_MEMORY_CACHE_TYPE)RunType);
+      }
+    }
+  }
+  ASSERT (Count == Cost[PointCount - 1]);
+
+  *MtrrCount = Count;
+  return RETURN_SUCCESS;
+}
+
+
+/**
+  Worker function sets the memory types of memory ranges in variable MTRRs.
+
+  Rather than adding MTRRs for the memory ranges, the variable MTRRs available
+  to firmware are calculated again for the memory map that results, so that as
+  few of them as possible are used. Memory below 1MB is left to the fixed MTRRs.
+
+  @param[in, out]  VariableSettings  The variable MTRR settings. Only updated
+                                     when RETURN_SUCCESS is returned.
+  @param[in]       DefaultType       The default memory type.
+  @param[in]       Ranges            The memory ranges to set. When memory
+                                     ranges overlap, the last one wins.
+  @param[in]       RangeCount        The number of memory ranges.
+
+  @retval RETURN_SUCCESS           The variable MTRR settings were updated.
+  @retval RETURN_OUT_OF_RESOURCES  There are not enough variable MTRRs.
+
+**/
+RETURN_STATUS
+MtrrLibSetVariableMemoryAttributes (
+  IN OUT MTRR_VARIABLE_SETTINGS   *VariableSettings,
+  IN     MTRR_MEMORY_CACHE_TYPE   DefaultType,
+  IN     CONST MTRR_MEMORY_RANGE  *Ranges,
+  IN     UINTN                    RangeCount
+  )
+{
+  RETURN_STATUS      Status;
+  UINT64             MtrrValidBitsMask;
+  UINT64             MtrrValidAddressMask;
+  UINT32             FirmwareVariableMtrrCount;
+  VARIABLE_MTRR      VariableMtrr[MTRR_NUMBER_OF_VARIABLE_MTRR];
+  MTRR_MEMORY_RANGE  Map[MTRR_LIB_MAX_MAP_RANGES];
+  UINTN              MapCount;
+  MTRR_MEMORY_RANGE  Mtrrs[MTRR_NUMBER_OF_VARIABLE_MTRR];
+  UINT32             MtrrCount;
+  UINT64             BaseAddress;
+  UINT64             Length;
+  UINTN              Index;
+
+  MtrrLibInitializeMtrrMask (&MtrrValidBitsMask, &MtrrValidAddressMask);
+  FirmwareVariableMtrrCount = GetFirmwareVariableMtrrCountWorker ();
+
+  MtrrGetMemoryAttributeInVariableMtrrWorker (
+    VariableSettings,
+    FirmwareVariableMtrrCount,
+    MtrrValidBitsMask,
+    MtrrValidAddressMask,
+    VariableMtrr
+    );
+  Status = MtrrLibGetMemoryMap (
+             VariableMtrr,
+             FirmwareVariableMtrrCount,
+             DefaultType,
+             MtrrValidBitsMask + 1,
+             Map,
+             &MapCount
+             );
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    BaseAddress = Ranges[Index].BaseAddress;
+    Length      = Ranges[Index].Length;
+    if (BaseAddress < BASE_1MB) {
+      if (BaseAddress + Length <= BASE_1MB) {
+        continue;
+      }
+      Length     -= BASE_1MB - BaseAddress;
+      BaseAddress = BASE_1MB;
+    }
+    Status = MtrrLibSetMemoryRange (Map, &MapCount, BaseAddress, Length, Ranges[Index].Type);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  //
+  // Since memory ranges below 1MB will be overridden by the fixed MTRRs,
+  // give them the type of the memory above 1MB to save variable MTRRs.
+  //
+  for (Index = 0; Map[Index].BaseAddress + Map[Index].Length <= BASE_1MB; Index++) {
+  }
+  Status = MtrrLibSetMemoryRange (Map, &MapCount, 0, BASE_1MB, Map[Index].Type);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  MtrrCount = FirmwareVariableMtrrCount;
+  Status = MtrrLibCalculateMtrrs (Map, MapCount, DefaultType, Mtrrs, &MtrrCount);
+  DEBUG ((DEBUG_CACHE, "  %d variable MTRRs needed, %d available\n", MtrrCount, FirmwareVariableMtrrCount));
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < FirmwareVariableMtrrCount; Index++) {
+    if (Index < MtrrCount) {
       ProgramVariableMtrr (
         VariableSettings,
-        MsrNum,
-        BaseAddress,
-        Alignment,
-        MemoryType,
+        Index,
+        Mtrrs[Index].BaseAddress,
+        Mtrrs[Index].Length,
+        Mtrrs[Index].Type,
         MtrrValidAddressMask
         );
-      BaseAddress += Alignment;
-      Length -= Alignment;
-    } while (TRUE);
-
-    if (Length == 0) {
-      goto Done;
+    } else {
+      VariableSettings->Mtrr[Index].Base = 0;
+      VariableSettings->Mtrr[Index].Mask = 0;
     }
   }
 
-  TempQword = Length;
+  return RETURN_SUCCESS;
+}
 
-  if (!Positive) {
-    Length = Power2MaxMemory (LShiftU64 (TempQword, 1));
 
-    //
-    // Find unused MTRR
-    //
-    for (; MsrNum < VariableMtrrCount; MsrNum++) {
-      if ((VariableSettings->Mtrr[MsrNum].Mask & CACHE_MTRR_ENABLED) == 0) {
-        break;
-      }
-    }
+/**
+  Worker function attempts to set the attributes for a memory range.
 
-    ProgramVariableMtrr (
-      VariableSettings,
-      MsrNum,
-      BaseAddress,
-      Length,
-      MemoryType,
-      MtrrValidAddressMask
-      );
-    BaseAddress += Length;
-    TempQword   = Length - TempQword;
-    MemoryType  = MTRR_CACHE_UNCACHEABLE;
+  If MtrrSettings is not NULL, set the attributes into the input MTRR
+  settings buffer.
+  If MtrrSettings is NULL, set the attributes into MTRRs registers.
+
+  @param[in, out]  MtrrSetting       A buffer holding all MTRRs content.
+  @param[in]       BaseAddress       The physical address that is the start
+                                     address of a memory region.
+  @param[in]       Length            The size in bytes of the memory region.
+  @param[in]       Attribute         The bit mask of attributes to set for the
+                                     memory region.
+
+  @retval RETURN_SUCCESS            The attributes were set for the memory
+                                    region.
+  @retval RETURN_INVALID_PARAMETER  Length is zero.
+  @retval RETURN_UNSUPPORTED        The processor does not support one or
+                                    more bytes of the memory resource range
+                                    specified by BaseAddress and Length.
+  @retval RETURN_UNSUPPORTED        The bit mask of attributes is not support
+                                    for the memory resource range specified
+                                    by BaseAddress and Length.
+  @retval RETURN_ACCESS_DENIED      The attributes for the memory resource
+                                    range specified by BaseAddress and Length
+                                    cannot be modified.
+  @retval RETURN_OUT_OF_RESOURCES   There are not enough system resources to
+                                    modify the attributes of the memory
+                                    resource range.
+
+**/
+RETURN_STATUS
+MtrrSetMemoryAttributeWorker (
+  IN OUT MTRR_SETTINGS           *MtrrSetting,
+  IN PHYSICAL_ADDRESS            BaseAddress,
+  IN UINT64                      Length,
+  IN MTRR_MEMORY_CACHE_TYPE      Attribute
+  )
+{
+  RETURN_STATUS             Status;
+  UINT64                    MemoryType;
+  UINT32                    MsrNum;
+  UINT64                    MtrrValidBitsMask;
+  UINT64                    MtrrValidAddressMask;
+  MTRR_MEMORY_RANGE         Range;
+  MTRR_CONTEXT              MtrrContext;
+  BOOLEAN                   MtrrContextValid;
+  BOOLEAN                   FixedSettingsValid[MTRR_NUMBER_OF_FIXED_MTRR];
+  BOOLEAN                   FixedSettingsModified[MTRR_NUMBER_OF_FIXED_MTRR];
+  MTRR_FIXED_SETTINGS       WorkingFixedSettings;
+  UINT32                    VariableMtrrCount;
+  MTRR_VARIABLE_SETTINGS    OriginalVariableSettings;
+  BOOLEAN                   ProgramVariableSettings;
+  MTRR_VARIABLE_SETTINGS    WorkingVariableSettings;
+  UINT32                    Index;
+  UINT64                    ClearMask;
+  UINT64                    OrMask;
+  UINT64                    NewValue;
+  MTRR_VARIABLE_SETTINGS    *VariableSettings;
+
+  MtrrContextValid  = FALSE;
+  VariableMtrrCount = 0;
+  ZeroMem (&WorkingFixedSettings, sizeof (WorkingFixedSettings));
+  for (Index = 0; Index < MTRR_NUMBER_OF_FIXED_MTRR; Index++) {
+    FixedSettingsValid[Index]    = FALSE;
+    FixedSettingsModified[Index] = FALSE;
   }
+  ProgramVariableSettings = FALSE;
 
-  do {
-    //
-    // Find unused MTRR
-    //
-    for (; MsrNum < VariableMtrrCount; MsrNum++) {
-      if ((VariableSettings->Mtrr[MsrNum].Mask & CACHE_MTRR_ENABLED) == 0) {
-        break;
+  if (!IsMtrrSupported ()) {
+    Status = RETURN_UNSUPPORTED;
+    goto Done;
+  }
+
+  MtrrLibInitializeMtrrMask (&MtrrValidBitsMask, &MtrrValidAddressMask);
+
+  MemoryType = (UINT64)Attribute;
+
+  //
+  // Check for an invalid parameter
+  //
+  if (Length == 0) {
+    Status = RETURN_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if (
+       (BaseAddress & ~MtrrValidAddressMask) != 0 ||
+       (Length & ~MtrrValidAddressMask) != 0 ||
+       Length > MtrrValidBitsMask + 1 - BaseAddress
+     ) {
+    Status = RETURN_UNSUPPORTED;
+    goto Done;
+  }
+
+  //
+  // Check if Fixed MTRR
+  //
+  Status = RETURN_SUCCESS;
+  if (BaseAddress < BASE_1MB) {
+    while ((BaseAddress < BASE_1MB) && (Length > 0) && Status == RETURN_SUCCESS) {
+      Status = ProgramFixedMtrr (MemoryType, &BaseAddress, &Length, &MsrNum, &ClearMask, &OrMask);
+      if (RETURN_ERROR (Status)) {
+        goto Done;
+      }
+      if (MtrrSetting != NULL) {
+        MtrrSetting->Fixed.Mtrr[MsrNum] = (MtrrSetting->Fixed.Mtrr[MsrNum] & ~ClearMask) | OrMask;
+        MtrrSetting->MtrrDefType |= CACHE_FIXED_MTRR_ENABLED;
+      } else {
+        if (!FixedSettingsValid[MsrNum]) {
+          WorkingFixedSettings.Mtrr[MsrNum] = MtrrRegisterRead (mMtrrLibFixedMtrrTable[MsrNum].Msr);
+          FixedSettingsValid[MsrNum] = TRUE;
+        }
+        NewValue = (WorkingFixedSettings.Mtrr[MsrNum] & ~ClearMask) | OrMask;
+        if (WorkingFixedSettings.Mtrr[MsrNum] != NewValue) {
+          WorkingFixedSettings.Mtrr[MsrNum] = NewValue;
+          FixedSettingsModified[MsrNum] = TRUE;
+        }
       }
     }
 
-    Length = Power2MaxMemory (TempQword);
-    if (!Positive) {
-      BaseAddress -= Length;
+    if (Length == 0) {
+      //
+      // A Length of 0 can only make sense for fixed MTTR ranges.
+      // Since we just handled the fixed MTRRs, we can skip the
+      // variable MTRR section.
+      //
+      goto Done;
     }
+  }
 
-    ProgramVariableMtrr (
-      VariableSettings,
-      MsrNum,
-      BaseAddress,
-      Length,
-      MemoryType,
-      MtrrValidAddressMask
-      );
-
-    if (Positive) {
-      BaseAddress += Length;
-    }
-    TempQword -= Length;
+  //
+  // Read all variable MTRRs
+  //
+  VariableMtrrCount = GetVariableMtrrCountWorker ();
+  if (MtrrSetting != NULL) {
+    VariableSettings = &MtrrSetting->Variables;
+  } else {
+    MtrrGetVariableMtrrWorker (NULL, VariableMtrrCount, &OriginalVariableSettings);
+    CopyMem (&WorkingVariableSettings, &OriginalVariableSettings, sizeof (WorkingVariableSettings));
+    ProgramVariableSettings = TRUE;
+    VariableSettings = &WorkingVariableSettings;
+  }
 
-  } while (TempQword > 0);
+  Range.BaseAddress = BaseAddress;
+  Range.Length      = Length;
+  Range.Type        = Attribute;
+  Status = MtrrLibSetVariableMemoryAttributes (
+             VariableSettings,
+             MtrrGetDefaultMemoryTypeWorker (MtrrSetting),
+             &Range,
+             1
+             );
 
 Done:
 
@@ -1890,6 +2028,135 @@ MtrrSetMemoryAttributeInMtrrSettings (
            );
 }
 
+/**
+  This function attempts to set the attributes into MTRR setting buffer for multiple memory ranges.
+
+  The variable MTRRs are calculated once for the memory map resulting from all
+  the ranges, which may take fewer of them than setting the ranges one by one.
+  If MtrrSetting is NULL, the MTRRs are programmed by a single MtrrSetAllMtrrs()
+  call, so caching is disabled and the cache flushed only once.
+
+  @param[in, out]  MtrrSetting  MTRR setting buffer to be set, or NULL to set
+                                the MTRRs themselves.
+  @param[in]       Scratch      Not used.
+  @param[in, out]  ScratchSize  Not used.
+  @param[in]       Ranges       Pointer to an array of MTRR_MEMORY_RANGE.
+                                When range overlap happens, the last one takes higher priority.
+  @param[in]       RangeCount   Count of MTRR_MEMORY_RANGE.
+
+  @retval RETURN_SUCCESS            The attributes were set for all the memory ranges.
+  @retval RETURN_INVALID_PARAMETER  Length in any range is zero.
+  @retval RETURN_UNSUPPORTED        The processor does not support one or more bytes of the
+                                    memory resource range specified by BaseAddress and Length in any range.
+  @retval RETURN_UNSUPPORTED        The bit mask of attributes is not support for the memory resource
+                                    range specified by BaseAddress and Length in any range.
+  @retval RETURN_OUT_OF_RESOURCES   There are not enough system resources to modify the attributes of
+                                    the memory resource ranges.
+
+**/
+RETURN_STATUS
+EFIAPI
+MtrrSetMemoryAttributesInMtrrSettings (
+  IN OUT MTRR_SETTINGS           *MtrrSetting,
+  IN     VOID                    *Scratch,
+  IN OUT UINTN                   *ScratchSize,
+  IN     CONST MTRR_MEMORY_RANGE *Ranges,
+  IN     UINTN                   RangeCount
+  )
+{
+  RETURN_STATUS             Status;
+  MTRR_SETTINGS             OriginalSettings;
+  MTRR_SETTINGS             WorkingSettings;
+  UINT64                    MtrrValidBitsMask;
+  UINT64                    MtrrValidAddressMask;
+  UINT64                    BaseAddress;
+  UINT64                    Length;
+  UINT32                    MsrNum;
+  UINT64                    ClearMask;
+  UINT64                    OrMask;
+  UINTN                     Index;
+
+  DEBUG((DEBUG_CACHE, "MtrrSetMemoryAttributesInMtrrSettings(%p) %d ranges\n", MtrrSetting, RangeCount));
+  for (Index = 0; Index < RangeCount; Index++) {
+    DEBUG((DEBUG_CACHE, "  %a:%016lx-%016lx\n", mMtrrMemoryCacheTypeShortName[Ranges[Index].Type & 0x7], Ranges[Index].BaseAddress, Ranges[Index].Length));
+  }
+
+  if (!IsMtrrSupported ()) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  MtrrLibInitializeMtrrMask (&MtrrValidBitsMask, &MtrrValidAddressMask);
+
+  //
+  // Check for an invalid parameter
+  //
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (Ranges[Index].Length == 0) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    if ((Ranges[Index].BaseAddress & ~MtrrValidAddressMask) != 0 ||
+        (Ranges[Index].Length & ~MtrrValidAddressMask) != 0 ||
+        Ranges[Index].Length > MtrrValidBitsMask + 1 - Ranges[Index].BaseAddress) {
+      return RETURN_UNSUPPORTED;
+    }
+    if (Ranges[Index].Type != CacheUncacheable &&
+        Ranges[Index].Type != CacheWriteCombining &&
+        Ranges[Index].Type != CacheWriteThrough &&
+        Ranges[Index].Type != CacheWriteProtected &&
+        Ranges[Index].Type != CacheWriteBack) {
+      return RETURN_UNSUPPORTED;
+    }
+  }
+
+  ZeroMem (&OriginalSettings, sizeof (OriginalSettings));
+  if (MtrrSetting != NULL) {
+    CopyMem (&OriginalSettings, MtrrSetting, sizeof (OriginalSettings));
+  } else {
+    MtrrGetAllMtrrs (&OriginalSettings);
+  }
+  CopyMem (&WorkingSettings, &OriginalSettings, sizeof (WorkingSettings));
+
+  //
+  // Set the fixed MTRRs of the ranges below 1MB
+  //
+  for (Index = 0; Index < RangeCount; Index++) {
+    BaseAddress = Ranges[Index].BaseAddress;
+    Length      = Ranges[Index].Length;
+    while ((BaseAddress < BASE_1MB) && (Length > 0)) {
+      Status = ProgramFixedMtrr (Ranges[Index].Type, &BaseAddress, &Length, &MsrNum, &ClearMask, &OrMask);
+      if (RETURN_ERROR (Status)) {
+        return Status;
+      }
+      WorkingSettings.Fixed.Mtrr[MsrNum] = (WorkingSettings.Fixed.Mtrr[MsrNum] & ~ClearMask) | OrMask;
+      WorkingSettings.MtrrDefType |= CACHE_FIXED_MTRR_ENABLED;
+    }
+  }
+
+  //
+  // Calculate the variable MTRRs for all the ranges at once
+  //
+  Status = MtrrLibSetVariableMemoryAttributes (
+             &WorkingSettings.Variables,
+             MtrrGetDefaultMemoryTypeWorker (&WorkingSettings),
+             Ranges,
+             RangeCount
+             );
+  DEBUG((DEBUG_CACHE, "  Status = %r\n", Status));
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+  WorkingSettings.MtrrDefType |= CACHE_MTRR_ENABLED;
+
+  if (MtrrSetting != NULL) {
+    CopyMem (MtrrSetting, &WorkingSettings, sizeof (WorkingSettings));
+    MtrrDebugPrintAllMtrrsWorker (MtrrSetting);
+  } else if (CompareMem (&WorkingSettings, &OriginalSettings, sizeof (WorkingSettings)) != 0) {
+    MtrrSetAllMtrrs (&WorkingSettings);
+  }
+
+  return RETURN_SUCCESS;
+}
+
 /**
   Worker function setting variable MTRRs
 
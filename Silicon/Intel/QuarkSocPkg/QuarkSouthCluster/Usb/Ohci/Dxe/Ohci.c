@@ -278,6 +278,7 @@ OhciControlTransfer (
   ED_DESCRIPTOR                  *HeadEd;
   ED_DESCRIPTOR                  *Ed;
   TD_DESCRIPTOR                  *HeadTd;
+  TD_DESCRIPTOR                  *TailTd;
   TD_DESCRIPTOR                  *SetupTd;
   TD_DESCRIPTOR                  *DataTd;
   TD_DESCRIPTOR                  *StatusTd;
@@ -384,6 +385,7 @@ OhciControlTransfer (
     goto UNMAP_SETUP_BUFF;
   }
   HeadTd = SetupTd;
+  TailTd = SetupTd;
   OhciSetTDField (SetupTd, TD_PDATA, 0);
   OhciSetTDField (SetupTd, TD_BUFFER_ROUND, 1);
   OhciSetTDField (SetupTd, TD_DIR_PID, TD_SETUP_PID);
@@ -441,7 +443,8 @@ OhciControlTransfer (
     DataTd->ActualSendLength = (UINT32)ActualSendLength;
     DataTd->DataBuffer = (UINT32)DataMapPhyAddr;
     DataTd->NextTDPointer = 0;
-    OhciLinkTD (HeadTd, DataTd);
+    OhciLinkTD (TailTd, DataTd);
+    TailTd = DataTd;
     DataToggle ^= 1;
     DataMapPhyAddr += ActualSendLength;
     LeftLength -= ActualSendLength;
@@ -468,7 +471,8 @@ OhciControlTransfer (
   StatusTd->ActualSendLength = 0;
   StatusTd->DataBuffer = 0;
   StatusTd->NextTDPointer = 0;
-  OhciLinkTD (HeadTd, StatusTd);
+  OhciLinkTD (TailTd, StatusTd);
+  TailTd = StatusTd;
   //
   // Empty Stage
   //
@@ -491,7 +495,7 @@ OhciControlTransfer (
   EmptyTd->ActualSendLength = 0;
   EmptyTd->DataBuffer = 0;
   EmptyTd->NextTDPointer = 0;
-  OhciLinkTD (HeadTd, EmptyTd);
+  OhciLinkTD (TailTd, EmptyTd);
   Ed->TdTailPointer = (UINT32)(UINTN)EmptyTd;
   OhciAttachTDListToED (Ed, HeadTd);
   //
@@ -559,7 +563,7 @@ FREE_TD_BUFF:
   while (HeadTd) {
     DataTd = HeadTd;
     HeadTd = (TD_DESCRIPTOR *)(UINTN)(HeadTd->NextTDPointer);
-    UsbHcFreeMem(Ohc->MemPool, DataTd, sizeof(TD_DESCRIPTOR));
+    OhciFreeTD (Ohc, DataTd);
   }
 
 UNMAP_SETUP_BUFF:
@@ -568,7 +572,7 @@ UNMAP_SETUP_BUFF:
   }
 
 FREE_ED_BUFF:
-  UsbHcFreeMem(Ohc->MemPool, Ed, sizeof(ED_DESCRIPTOR));
+  OhciFreeED (Ohc, Ed);
 
 CTRL_EXIT:
   return Status;
@@ -629,16 +633,18 @@ OhciBulkTransfer(
   )
 {
   USB_OHCI_HC_DEV                *Ohc;
-  ED_DESCRIPTOR                  *HeadEd;
   ED_DESCRIPTOR                  *Ed;
+  UINT8                          EdDir;
   UINT32                         DataPidDir;
   TD_DESCRIPTOR                  *HeadTd;
+  TD_DESCRIPTOR                  *TailTd;
   TD_DESCRIPTOR                  *DataTd;
   TD_DESCRIPTOR                  *EmptyTd;
   EFI_STATUS                     Status;
   UINT8                          EndPointNum;
   UINTN                          TimeCount;
   OHCI_ED_RESULT                 EdResult;
+  ED_DESCRIPTOR_WORD2            EdWord2;
 
   EFI_PCI_IO_PROTOCOL_OPERATION  MapOp;
   VOID                           *Mapping;
@@ -646,12 +652,12 @@ OhciBulkTransfer(
   EFI_PHYSICAL_ADDRESS           MapPyhAddr;
   UINTN                          LeftLength;
   UINTN                          ActualSendLength;
-  BOOLEAN                        FirstTD;
 
   Mapping = NULL;
   MapLength = 0;
   MapPyhAddr = 0;
   LeftLength = 0;
+  HeadTd = NULL;
   Status = EFI_SUCCESS;
 
   if (Data == NULL || DataLength == NULL || DataToggle == NULL || TransferResult == NULL ||
@@ -664,9 +670,11 @@ OhciBulkTransfer(
   Ohc = USB_OHCI_HC_DEV_FROM_THIS (This);
 
   if ((EndPointAddress & 0x80) != 0) {
+    EdDir = ED_IN_DIR;
     DataPidDir = TD_IN_PID;
     MapOp = EfiPciIoOperationBusMasterWrite;
   } else {
+    EdDir = ED_OUT_DIR;
     DataPidDir = TD_OUT_PID;
     MapOp = EfiPciIoOperationBusMasterRead;
   }
@@ -674,59 +682,41 @@ OhciBulkTransfer(
   EndPointNum = (EndPointAddress & 0xF);
   EdResult.NextToggle = *DataToggle;
 
-  Status = OhciSetHcControl (Ohc, BULK_ENABLE, 0);
-  if (EFI_ERROR(Status)) {
-    DEBUG ((EFI_D_INFO, "OhciControlTransfer: fail to disable BULK_ENABLE\r\n"));
-    *TransferResult = EFI_USB_ERR_SYSTEM;
-    return EFI_DEVICE_ERROR;
-  }
-  Status = OhciSetHcCommandStatus (Ohc, BULK_LIST_FILLED, 0);
-  if (EFI_ERROR(Status)) {
-    DEBUG ((EFI_D_INFO, "OhciControlTransfer: fail to disable BULK_LIST_FILLED\r\n"));
-    *TransferResult = EFI_USB_ERR_SYSTEM;
-    return EFI_DEVICE_ERROR;
-  }
-  gBS->Stall(20 * 1000);
-
-  OhciSetMemoryPointer (Ohc, HC_BULK_HEAD, NULL);
-
-  Ed = OhciCreateED (Ohc);
+  //
+  // The ED of the endpoint stays on the bulk list, skipped and without TDs
+  // while idle, so the bulk list keeps running across transfers.
+  //
+  Ed = OhciGetBulkEd (Ohc, DeviceAddress, EndPointNum, EdDir);
   if (Ed == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
-  OhciSetEDField (Ed, ED_SKIP, 1);
-  OhciSetEDField (Ed, ED_FUNC_ADD, DeviceAddress);
-  OhciSetEDField (Ed, ED_ENDPT_NUM, EndPointNum);
-  OhciSetEDField (Ed, ED_DIR, ED_FROM_TD_DIR);
   OhciSetEDField (Ed, ED_SPEED, HI_SPEED);
-  OhciSetEDField (Ed, ED_FORMAT | ED_HALTED | ED_DTTOGGLE, 0);
+  OhciSetEDField (Ed, ED_FORMAT | ED_HALTED, 0);
+  OhciSetEDField (Ed, ED_DTTOGGLE, *DataToggle);
   OhciSetEDField (Ed, ED_MAX_PACKET, MaxPacketLength);
   OhciSetEDField (Ed, ED_PDATA, 0);
   OhciSetEDField (Ed, ED_ZERO, 0);
-  OhciSetEDField (Ed, ED_TDHEAD_PTR, 0);
-  OhciSetEDField (Ed, ED_TDTAIL_PTR, 0);
-  OhciSetEDField (Ed, ED_NEXT_EDPTR, 0);
-  HeadEd = OhciAttachEDToList (Ohc, BULK_LIST, Ed, NULL);
 
-  if(Data != NULL) {
-    MapLength = *DataLength;
-    Status = Ohc->PciIo->Map (Ohc->PciIo, MapOp, (UINT8 *)Data, &MapLength, &MapPyhAddr, &Mapping);
-    if (EFI_ERROR(Status)) {
-      DEBUG ((EFI_D_INFO, "OhciBulkTransfer: Fail to Map Data Buffer for Bulk\r\n"));
-      goto FREE_ED_BUFF;
-    }
+  MapLength = *DataLength;
+  Status = Ohc->PciIo->Map (Ohc->PciIo, MapOp, (UINT8 *)Data, &MapLength, &MapPyhAddr, &Mapping);
+  if (EFI_ERROR(Status)) {
+    DEBUG ((EFI_D_INFO, "OhciBulkTransfer: Fail to Map Data Buffer for Bulk\r\n"));
+    return Status;
   }
   //
   //Data Stage
   //
+  // A TD may cross one page boundary, so each covers up to the end of the
+  // next page, in whole packets except for the last one. The TDs take their
+  // data toggle from the ED, which carries it from one TD to the next.
+  //
   LeftLength = MapLength;
-  ActualSendLength = MapLength;
-  HeadTd = NULL;
-  FirstTD = TRUE;
+  TailTd = NULL;
   while (LeftLength > 0) {
-    ActualSendLength = LeftLength;
-    if (LeftLength > MaxPacketLength) {
-      ActualSendLength = MaxPacketLength;
+    ActualSendLength = 2 * EFI_PAGE_SIZE - ((UINTN)MapPyhAddr & EFI_PAGE_MASK);
+    ActualSendLength -= ActualSendLength % MaxPacketLength;
+    if (LeftLength < ActualSendLength) {
+      ActualSendLength = LeftLength;
     }
     DataTd = OhciCreateTD (Ohc);
     if (DataTd == NULL) {
@@ -738,7 +728,7 @@ OhciBulkTransfer(
     OhciSetTDField (DataTd, TD_BUFFER_ROUND, 1);
     OhciSetTDField (DataTd, TD_DIR_PID, DataPidDir);
     OhciSetTDField (DataTd, TD_DELAY_INT, TD_NO_DELAY);
-    OhciSetTDField (DataTd, TD_DT_TOGGLE, *DataToggle);
+    DataTd->Word0.DataToggle = 0;
     OhciSetTDField (DataTd, TD_ERROR_CNT, 0);
     OhciSetTDField (DataTd, TD_COND_CODE, TD_TOBE_PROCESSED);
     OhciSetTDField (DataTd, TD_CURR_BUFFER_PTR, (UINT32) MapPyhAddr);
@@ -747,13 +737,12 @@ OhciBulkTransfer(
     DataTd->ActualSendLength = (UINT32)ActualSendLength;
     DataTd->DataBuffer = (UINT32)MapPyhAddr;
     DataTd->NextTDPointer = 0;
-    if (FirstTD) {
+    if (TailTd == NULL) {
       HeadTd = DataTd;
-      FirstTD = FALSE;
     } else {
-      OhciLinkTD (HeadTd, DataTd);
+      OhciLinkTD (TailTd, DataTd);
     }
-    *DataToggle ^= 1;
+    TailTd = DataTd;
     MapPyhAddr += ActualSendLength;
     LeftLength -= ActualSendLength;
   }
@@ -770,7 +759,6 @@ OhciBulkTransfer(
   OhciSetTDField (EmptyTd, TD_BUFFER_ROUND, 0);
   OhciSetTDField (EmptyTd, TD_DIR_PID, 0);
   OhciSetTDField (EmptyTd, TD_DELAY_INT, 0);
-  //OhciSetTDField (EmptyTd, TD_DT_TOGGLE, CurrentToggle);
   EmptyTd->Word0.DataToggle = 0;
   OhciSetTDField (EmptyTd, TD_ERROR_CNT, 0);
   OhciSetTDField (EmptyTd, TD_COND_CODE, 0);
@@ -780,32 +768,40 @@ OhciBulkTransfer(
   EmptyTd->ActualSendLength = 0;
   EmptyTd->DataBuffer = 0;
   EmptyTd->NextTDPointer = 0;
-  OhciLinkTD (HeadTd, EmptyTd);
+  OhciLinkTD (TailTd, EmptyTd);
   Ed->TdTailPointer = (UINT32)(UINTN)EmptyTd;
   OhciAttachTDListToED (Ed, HeadTd);
 
+  //
+  // A host controller reset empties the bulk list, put the EDs back on it.
+  //
+  if (OhciGetMemoryPointer (Ohc, HC_BULK_HEAD) != Ohc->BulkEd[0]) {
+    OhciSetMemoryPointer (Ohc, HC_BULK_HEAD, Ohc->BulkEd[0]);
+  }
+
   OhciSetEDField (Ed, ED_SKIP, 0);
   Status = OhciSetHcCommandStatus (Ohc, BULK_LIST_FILLED, 1);
   if (EFI_ERROR(Status)) {
     *TransferResult = EFI_USB_ERR_SYSTEM;
     Status = EFI_DEVICE_ERROR;
-    DEBUG ((EFI_D_INFO, "OhciControlTransfer: Fail to enable BULK_LIST_FILLED\r\n"));
+    DEBUG ((EFI_D_INFO, "OhciBulkTransfer: Fail to enable BULK_LIST_FILLED\r\n"));
     goto FREE_OHCI_TDBUFF;
   }
-  Status = OhciSetHcControl (Ohc, BULK_ENABLE, 1);
-  if (EFI_ERROR(Status)) {
-    *TransferResult = EFI_USB_ERR_SYSTEM;
-    Status = EFI_DEVICE_ERROR;
-    DEBUG ((EFI_D_INFO, "OhciControlTransfer: Fail to enable BULK_ENABLE\r\n"));
-    goto FREE_OHCI_TDBUFF;
+  if (OhciGetHcControl (Ohc, BULK_ENABLE) == 0) {
+    Status = OhciSetHcControl (Ohc, BULK_ENABLE, 1);
+    if (EFI_ERROR(Status)) {
+      *TransferResult = EFI_USB_ERR_SYSTEM;
+      Status = EFI_DEVICE_ERROR;
+      DEBUG ((EFI_D_INFO, "OhciBulkTransfer: Fail to enable BULK_ENABLE\r\n"));
+      goto FREE_OHCI_TDBUFF;
+    }
   }
-  gBS->Stall(20 * 1000);
 
   TimeCount = 0;
   Status = CheckIfDone (Ohc, BULK_LIST, Ed, HeadTd, &EdResult);
-  while (Status == EFI_NOT_READY && TimeCount <= TimeOut) {
-    gBS->Stall (1000);
-    TimeCount++;
+  while (Status == EFI_NOT_READY && TimeCount <= TimeOut * 1000) {
+    gBS->Stall (OHCI_BULK_POLL_INTERVAL);
+    TimeCount += OHCI_BULK_POLL_INTERVAL;
     Status = CheckIfDone (Ohc, BULK_LIST, Ed, HeadTd, &EdResult);
   }
 
@@ -816,33 +812,34 @@ OhciBulkTransfer(
       DEBUG ((EFI_D_INFO, "Bulk pipe timeout, > %d mS\r\n", TimeOut));
     } else {
       DEBUG ((EFI_D_INFO, "Bulk pipe broken\r\n"));
-      *DataToggle = EdResult.NextToggle;
     }
     *DataLength = 0;
   } else {
     DEBUG ((EFI_D_INFO, "Bulk transfer successed\r\n"));
   }
-  //*DataToggle = (UINT8) OhciGetEDField (Ed, ED_DTTOGGLE);
 
 FREE_OHCI_TDBUFF:
+  //
+  // The host controller may still be working on the ED in the current
+  // frame, so leave the ED and its TDs alone until the next one starts.
+  //
   OhciSetEDField (Ed, ED_SKIP, 1);
-  if (HeadEd == Ed) {
-    OhciSetMemoryPointer (Ohc, HC_BULK_HEAD, NULL);
-  }else {
-    HeadEd->NextED = Ed->NextED;
-  }
+  OhciWaitForNextFrame (Ohc);
+  //
+  // The ED carries the toggle of the next packet of the endpoint. Empty it
+  // by moving HeadP to TailP in one write that keeps the toggle and halt bits.
+  //
+  *DataToggle = (UINT8) OhciGetEDField (Ed, ED_DTTOGGLE);
+  EdWord2 = Ed->Word2;
+  EdWord2.TdHeadPointer = RIGHT_SHIFT_4 (Ed->TdTailPointer);
+  Ed->Word2 = EdWord2;
   while (HeadTd) {
     DataTd = HeadTd;
     HeadTd = (TD_DESCRIPTOR *)(UINTN)(HeadTd->NextTDPointer);
-    UsbHcFreeMem(Ohc->MemPool, DataTd, sizeof(TD_DESCRIPTOR));
+    OhciFreeTD (Ohc, DataTd);
   }
 
-  if(Mapping != NULL) {
-    Ohc->PciIo->Unmap(Ohc->PciIo, Mapping);
-  }
-
-FREE_ED_BUFF:
-  UsbHcFreeMem(Ohc->MemPool, Ed, sizeof(ED_DESCRIPTOR));
+  Ohc->PciIo->Unmap(Ohc->PciIo, Mapping);
 
   return Status;
 }
@@ -2047,6 +2044,7 @@ OhciAllocateDev (
   if(Ohc->MemPool == NULL) {
     goto FREE_DEV_BUFFER;
   }
+  OhciInitDescriptorPool (Ohc);
 
   Bytes = 4096;
   Pages = EFI_SIZE_TO_PAGES (Bytes);
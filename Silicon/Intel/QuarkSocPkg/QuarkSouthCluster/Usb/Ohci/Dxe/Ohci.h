@@ -47,6 +47,28 @@ extern EFI_COMPONENT_NAME2_PROTOCOL  gOhciComponentName2;
 
 #define USB_OHCI_HC_DEV_SIGNATURE     SIGNATURE_32('o','h','c','i')
 
+//
+// Descriptors preallocated for the free lists
+//
+#define OHCI_TD_POOL_SIZE             64
+#define OHCI_ED_POOL_SIZE             8
+
+//
+// Bulk EDs kept on the bulk list
+//
+#define OHCI_BULK_ED_NUM              4
+
+//
+// Interval, in microseconds, to poll for the completion of a bulk transfer
+//
+#define OHCI_BULK_POLL_INTERVAL       50
+
+//
+// Time, in microseconds, to wait for a new frame before assuming that the
+// host controller is not running
+//
+#define OHCI_FRAME_WAIT_TIMEOUT       2000
+
 typedef struct _HCCA_MEMORY_BLOCK{
   UINT32                    HccaInterruptTable[32];    // 32-bit Physical Address to ED_DESCRIPTOR
   UINT16                    HccaFrameNumber;
@@ -72,6 +94,15 @@ struct _USB_OHCI_HC_DEV {
   INTERRUPT_CONTEXT_ENTRY   *InterruptContextList;
   VOID                      *MemPool;
 
+  //
+  // Free lists of TDs and EDs, linked through NextTDPointer and NextED
+  //
+  TD_DESCRIPTOR             *FreeTdList;
+  ED_DESCRIPTOR             *FreeEdList;
+
+  ED_DESCRIPTOR             *BulkEd[OHCI_BULK_ED_NUM];
+  UINTN                     NextBulkEd;
+
   UINT32                    ToggleFlag;
 
   EFI_EVENT                 HouseKeeperTimer;
@@ -29,6 +29,13 @@ OhciCreateTD (
 {
   TD_DESCRIPTOR           *Td;
 
+  if (Ohc->FreeTdList != NULL) {
+    Td = Ohc->FreeTdList;
+    Ohc->FreeTdList = (TD_DESCRIPTOR *)(UINTN)(Td->NextTDPointer);
+    ZeroMem (Td, sizeof (TD_DESCRIPTOR));
+    return Td;
+  }
+
   Td = UsbHcAllocateMem(Ohc->MemPool, sizeof(TD_DESCRIPTOR));
   if (Td == NULL) {
     DEBUG ((EFI_D_INFO, "STV allocate TD fail !\r\n"));
@@ -47,6 +54,9 @@ OhciCreateTD (
 
   Free a TD
 
+  The TD is kept on the free list for the next OhciCreateTD, and is
+  only returned to the memory pool with the pool itself.
+
   @Param  Ohc                   UHC private data
   @Param  Td                    Pointer to a TD to free
 
@@ -62,7 +72,8 @@ OhciFreeTD (
   if (Td == NULL) {
     return EFI_SUCCESS;
   }
-  UsbHcFreeMem(Ohc->MemPool, Td, sizeof(TD_DESCRIPTOR));
+  Td->NextTDPointer = (UINT32)(UINTN)Ohc->FreeTdList;
+  Ohc->FreeTdList = Td;
 
   return EFI_SUCCESS;
 }
@@ -83,10 +94,17 @@ OhciCreateED (
   )
 {
   ED_DESCRIPTOR   *Ed;
-  Ed = UsbHcAllocateMem(Ohc->MemPool, sizeof (ED_DESCRIPTOR));
-  if (Ed == NULL) {
-    DEBUG ((EFI_D_INFO, "STV allocate ED fail !\r\n"));
-    return NULL;
+
+  if (Ohc->FreeEdList != NULL) {
+    Ed = Ohc->FreeEdList;
+    Ohc->FreeEdList = (ED_DESCRIPTOR *)(UINTN)(Ed->NextED);
+    ZeroMem (Ed, sizeof (ED_DESCRIPTOR));
+  } else {
+    Ed = UsbHcAllocateMem(Ohc->MemPool, sizeof (ED_DESCRIPTOR));
+    if (Ed == NULL) {
+      DEBUG ((EFI_D_INFO, "STV allocate ED fail !\r\n"));
+      return NULL;
+    }
   }
   Ed->Word0.Skip = 1;
   Ed->TdTailPointer = 0;
@@ -100,6 +118,9 @@ OhciCreateED (
 
   Free a ED
 
+  The ED is kept on the free list for the next OhciCreateED, and is
+  only returned to the memory pool with the pool itself.
+
   @Param  Ohc                   UHC private data
   @Param  Ed                    Pointer to a ED to free
 
@@ -116,11 +137,138 @@ OhciFreeED (
   if (Ed == NULL) {
     return EFI_SUCCESS;
   }
-  UsbHcFreeMem(Ohc->MemPool, Ed, sizeof(ED_DESCRIPTOR));
+  Ed->NextED = (UINT32)(UINTN)Ohc->FreeEdList;
+  Ohc->FreeEdList = Ed;
 
   return EFI_SUCCESS;
 }
 
+/**
+
+  Preallocate the TDs and EDs of the free lists
+
+  Descriptors come from the DMA-coherent memory pool, so transfers only
+  fall back to allocating from the pool once the free lists run out.
+
+  @Param  Ohc                   Device private data
+
+**/
+VOID
+OhciInitDescriptorPool (
+  IN USB_OHCI_HC_DEV      *Ohc
+  )
+{
+  TD_DESCRIPTOR           *Td;
+  ED_DESCRIPTOR           *Ed;
+  UINTN                   Index;
+
+  for (Index = 0; Index < OHCI_TD_POOL_SIZE; Index++) {
+    Td = UsbHcAllocateMem (Ohc->MemPool, sizeof (TD_DESCRIPTOR));
+    if (Td == NULL) {
+      return;
+    }
+    OhciFreeTD (Ohc, Td);
+  }
+
+  for (Index = 0; Index < OHCI_ED_POOL_SIZE; Index++) {
+    Ed = UsbHcAllocateMem (Ohc->MemPool, sizeof (ED_DESCRIPTOR));
+    if (Ed == NULL) {
+      return;
+    }
+    OhciFreeED (Ohc, Ed);
+  }
+}
+
+/**
+
+  Get the bulk ED of an endpoint
+
+  Bulk EDs stay on the bulk list, skipped while idle, so that a transfer
+  does not have to stop the bulk list to add or remove its ED. Once
+  OHCI_BULK_ED_NUM EDs are in use, new endpoints reuse them in turn.
+
+  @Param  Ohc                   Device private data
+  @Param  DeviceAddress         Device address of the endpoint
+  @Param  EndPointNum           End point number
+  @Param  EdDir                 ED direction, ED_IN_DIR or ED_OUT_DIR
+
+  @retval                       The idle ED of the endpoint, or NULL if it
+                                cannot be allocated
+
+**/
+ED_DESCRIPTOR *
+OhciGetBulkEd (
+  IN USB_OHCI_HC_DEV      *Ohc,
+  IN UINT8                DeviceAddress,
+  IN UINT8                EndPointNum,
+  IN UINT8                EdDir
+  )
+{
+  ED_DESCRIPTOR           *Ed;
+  UINTN                   Index;
+
+  for (Index = 0; Index < OHCI_BULK_ED_NUM && Ohc->BulkEd[Index] != NULL; Index++) {
+    Ed = Ohc->BulkEd[Index];
+    if (Ed->Word0.FunctionAddress == DeviceAddress && Ed->Word0.EndPointNum == EndPointNum &&
+        Ed->Word0.Direction == EdDir) {
+      return Ed;
+    }
+  }
+
+  if (Index < OHCI_BULK_ED_NUM) {
+    Ed = OhciCreateED (Ohc);
+    if (Ed == NULL) {
+      return NULL;
+    }
+    OhciSetEDField (Ed, ED_SKIP, 1);
+    OhciSetEDField (Ed, ED_TDHEAD_PTR | ED_TDTAIL_PTR | ED_NEXT_EDPTR, 0);
+    if (Index > 0) {
+      OhciSetEDField (Ohc->BulkEd[Index - 1], ED_NEXT_EDPTR, (UINT32)(UINTN)Ed);
+    }
+    Ohc->BulkEd[Index] = Ed;
+  } else {
+    //
+    // The EDs are only used by one transfer at a time, so the oldest one
+    // is idle and can be given to the new endpoint in place.
+    //
+    Ed = Ohc->BulkEd[Ohc->NextBulkEd];
+    Ohc->NextBulkEd = (Ohc->NextBulkEd + 1) % OHCI_BULK_ED_NUM;
+  }
+
+  OhciSetEDField (Ed, ED_FUNC_ADD, DeviceAddress);
+  OhciSetEDField (Ed, ED_ENDPT_NUM, EndPointNum);
+  OhciSetEDField (Ed, ED_DIR, EdDir);
+
+  return Ed;
+}
+
+/**
+
+  Wait for the host controller to start a new frame
+
+  The host controller may go on using an ED it has already fetched until the
+  next frame starts, even after the ED has been skipped.
+
+  @Param  Ohc                   Device private data
+
+**/
+VOID
+OhciWaitForNextFrame (
+  IN USB_OHCI_HC_DEV      *Ohc
+  )
+{
+  UINT32                  FrameNumber;
+  UINTN                   TimeCount;
+
+  FrameNumber = OhciGetFrameNumber (Ohc) & 0xFFFF;
+  for (TimeCount = 0; TimeCount < OHCI_FRAME_WAIT_TIMEOUT; TimeCount += OHCI_BULK_POLL_INTERVAL) {
+    gBS->Stall (OHCI_BULK_POLL_INTERVAL);
+    if ((OhciGetFrameNumber (Ohc) & 0xFFFF) != FrameNumber) {
+      return;
+    }
+  }
+}
+
 /**
 
   Free  ED
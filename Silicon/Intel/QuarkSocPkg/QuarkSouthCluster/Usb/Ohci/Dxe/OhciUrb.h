@@ -81,6 +81,51 @@ OhciFreeED (
   IN ED_DESCRIPTOR        *Ed
   );
 
+/**
+
+  Preallocate the TDs and EDs of the free lists
+
+  @Param  Ohc                   Device private data
+
+**/
+VOID
+OhciInitDescriptorPool (
+  IN USB_OHCI_HC_DEV      *Ohc
+  );
+
+/**
+
+  Get the bulk ED of an endpoint
+
+  @Param  Ohc                   Device private data
+  @Param  DeviceAddress         Device address of the endpoint
+  @Param  EndPointNum           End point number
+  @Param  EdDir                 ED direction, ED_IN_DIR or ED_OUT_DIR
+
+  @retval                       The idle ED of the endpoint, or NULL if it
+                                cannot be allocated
+
+**/
+ED_DESCRIPTOR *
+OhciGetBulkEd (
+  IN USB_OHCI_HC_DEV      *Ohc,
+  IN UINT8                DeviceAddress,
+  IN UINT8                EndPointNum,
+  IN UINT8                EdDir
+  );
+
+/**
+
+  Wait for the host controller to start a new frame
+
+  @Param  Ohc                   Device private data
+
+**/
+VOID
+OhciWaitForNextFrame (
+  IN USB_OHCI_HC_DEV      *Ohc
+  );
+
 /**
 
   Free  ED
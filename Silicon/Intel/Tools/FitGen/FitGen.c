@@ -272,6 +272,31 @@ typedef struct {
 
 FIT_TABLE_CONTEXT   gFitTableContext = {0};
 
+//
+// Index of every FFS file in the top level FVs of the input image, sorted by
+// file name so that argument parsing does not rescan the image per lookup.
+//
+typedef struct {
+  EFI_GUID   Name;
+  UINT32     Ordinal;
+  UINT32     FileSize;
+  UINT8      *FileData;
+} FFS_INDEX_ENTRY;
+
+typedef struct {
+  UINT8            *Buffer;
+  UINTN            Size;
+  UINT32           Count;
+  FFS_INDEX_ENTRY  *Entry;
+} FFS_INDEX;
+
+FFS_INDEX           gFfsIndex = {0};
+
+//
+// Chunk size used to find the ranges an in-place update has to rewrite
+//
+#define INCREMENTAL_WRITE_CHUNK  0x1000
+
 unsigned int
 xtoi (
   char  *str
@@ -601,6 +626,184 @@ FindNextFvHeader (
   return NULL;
 }
 
+int
+CompareFfsIndexEntry (
+  IN CONST VOID  *Left,
+  IN CONST VOID  *Right
+  )
+{
+  CONST FFS_INDEX_ENTRY  *LeftEntry;
+  CONST FFS_INDEX_ENTRY  *RightEntry;
+  int                    Result;
+
+  LeftEntry  = (CONST FFS_INDEX_ENTRY *)Left;
+  RightEntry = (CONST FFS_INDEX_ENTRY *)Right;
+
+  Result = memcmp (&LeftEntry->Name, &RightEntry->Name, sizeof (EFI_GUID));
+  if (Result != 0) {
+    return Result;
+  }
+  if (LeftEntry->Ordinal < RightEntry->Ordinal) {
+    return -1;
+  }
+  return (LeftEntry->Ordinal > RightEntry->Ordinal) ? 1 : 0;
+}
+
+VOID
+FreeFfsIndex (
+  VOID
+  )
+{
+  if (gFfsIndex.Entry != NULL) {
+    free (gFfsIndex.Entry);
+  }
+  memset (&gFfsIndex, 0, sizeof (gFfsIndex));
+}
+
+STATUS
+BuildFfsIndex (
+  IN UINT8     *FdBuffer,
+  IN UINT32    FdSize
+  )
+/*++
+
+Routine Description:
+
+  Walk every FV in the image once and index its FFS files by name.
+  FindFileFromFvByGuid() answers lookups on this buffer from the index until
+  FreeFfsIndex() is called, so the buffer must not be modified meanwhile.
+
+Arguments:
+
+  FdBuffer       - FD binary buffer
+  FdSize         - FD size
+
+Returns:
+
+  STATUS_SUCCESS - The index was built.
+  STATUS_ERROR   - No sufficient memory.
+
+--*/
+{
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  EFI_FFS_FILE_HEADER         *FileHeader;
+  FFS_INDEX_ENTRY             *Entry;
+  UINT64                      FvLength;
+  UINTN                       Offset;
+  UINTN                       FileLength;
+  UINTN                       FileOccupiedSize;
+  UINT32                      MaxCount;
+
+  FreeFfsIndex ();
+
+  MaxCount = 0;
+  FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *)FindNextFvHeader (FdBuffer, FdSize);
+  while (FvHeader != NULL) {
+    FvLength   = FvHeader->FvLength;
+    FileHeader = (EFI_FFS_FILE_HEADER *)((UINTN)FvHeader + FvHeader->HeaderLength);
+    Offset     = (UINTN) FileHeader - (UINTN) FvHeader;
+
+    while (Offset < FvLength) {
+      FileLength = (*(UINT32 *)(FileHeader->Size)) & 0x00FFFFFF;
+      FileOccupiedSize = GETOCCUPIEDSIZE(FileLength, 8);
+      if (FileOccupiedSize == 0) {
+        break;
+      }
+
+      if (gFfsIndex.Count == MaxCount) {
+        MaxCount = (MaxCount == 0) ? 0x100 : MaxCount * 2;
+        Entry = (FFS_INDEX_ENTRY *) realloc (gFfsIndex.Entry, MaxCount * sizeof (FFS_INDEX_ENTRY));
+        if (Entry == NULL) {
+          Error (NULL, 0, 0, "No sufficient memory to allocate!", NULL);
+          FreeFfsIndex ();
+          return STATUS_ERROR;
+        }
+        gFfsIndex.Entry = Entry;
+      }
+
+      Entry = &gFfsIndex.Entry[gFfsIndex.Count];
+      memcpy (&Entry->Name, &FileHeader->Name, sizeof (EFI_GUID));
+      Entry->Ordinal  = gFfsIndex.Count;
+      Entry->FileData = (UINT8 *)FileHeader + sizeof(EFI_FFS_FILE_HEADER);
+      Entry->FileSize = (UINT32)(FileLength - sizeof(EFI_FFS_FILE_HEADER));
+#if (PI_SPECIFICATION_VERSION < 0x00010000)
+      if (FileHeader->Attributes & FFS_ATTRIB_TAIL_PRESENT) {
+        Entry->FileSize -= sizeof(EFI_FFS_FILE_TAIL);
+      }
+#endif
+      gFfsIndex.Count++;
+
+      FileHeader = (EFI_FFS_FILE_HEADER *)((UINTN)FileHeader + FileOccupiedSize);
+      Offset = (UINTN) FileHeader - (UINTN) FvHeader;
+    }
+
+    //
+    // Next FV
+    //
+    if ((UINTN)FdBuffer + FdSize > (UINTN)FvHeader + FvLength) {
+      FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *)FindNextFvHeader ((UINT8 *)FvHeader + (UINTN)FvLength, (UINTN)FdBuffer + FdSize - ((UINTN)FvHeader + (UINTN)FvLength));
+    } else {
+      FvHeader = NULL;
+    }
+  }
+
+  qsort (gFfsIndex.Entry, gFfsIndex.Count, sizeof (FFS_INDEX_ENTRY), CompareFfsIndexEntry);
+  gFfsIndex.Buffer = FdBuffer;
+  gFfsIndex.Size   = FdSize;
+
+  return STATUS_SUCCESS;
+}
+
+UINT8  *
+FindFileFromFfsIndex (
+  IN EFI_GUID  *Guid,
+  OUT UINT32   *FileSize
+  )
+/*++
+
+Routine Description:
+
+  Find the first file with GUID, in image order, from the FFS index
+
+Arguments:
+
+  Guid           - File GUID value to be searched
+  FileSize       - Guid File size
+
+Returns:
+
+  FileLocation   - Guid File location.
+  NULL           - Guid File is not found.
+
+--*/
+{
+  UINT32  Low;
+  UINT32  High;
+  UINT32  Middle;
+
+  //
+  // Lower bound: the lowest ordinal among entries with this name
+  //
+  Low  = 0;
+  High = gFfsIndex.Count;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (memcmp (&gFfsIndex.Entry[Middle].Name, Guid, sizeof (EFI_GUID)) < 0) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  if (Low == gFfsIndex.Count ||
+      memcmp (&gFfsIndex.Entry[Low].Name, Guid, sizeof (EFI_GUID)) != 0) {
+    return NULL;
+  }
+
+  *FileSize = gFfsIndex.Entry[Low].FileSize;
+  return gFfsIndex.Entry[Low].FileData;
+}
+
 UINT8  *
 FindFileFromFvByGuid (
   IN UINT8     *FvBuffer,
@@ -637,6 +840,10 @@ Returns:
   UINTN                       FileLength;
   UINTN                       FileOccupiedSize;
 
+  if ((gFfsIndex.Entry != NULL) && (gFfsIndex.Buffer == FvBuffer) && (gFfsIndex.Size == FvSize)) {
+    return FindFileFromFfsIndex (Guid, FileSize);
+  }
+
   //
   // Find the FFS file
   //
@@ -2919,6 +3126,93 @@ Returns:
   return STATUS_SUCCESS;
 }
 
+STATUS
+UpdateOutputFile (
+  IN CHAR8   *FileName,
+  IN UINT8   *FileData,
+  IN UINT8   *OriginalData,
+  IN UINT32  FileSize
+  )
+/*++
+
+Routine Description:
+
+  Update a file that currently holds OriginalData in place, rewriting only
+  the chunks that differ from FileData. The FIT table, its pointer and any
+  optional modules are a tiny part of a full flash image.
+
+Arguments:
+
+  FileName      - The file name
+  FileData      - The new file data
+  OriginalData  - The data the file holds now
+  FileSize      - The file size
+
+Returns:
+
+  STATUS_SUCCESS - Write file data successfully
+  STATUS_ERROR   - The file data is not written
+
+--*/
+{
+  FILE                        *FpOut;
+  UINT32                      Offset;
+  UINT32                      Start;
+  UINT32                      Length;
+  UINT32                      Written;
+
+  if (!CheckPath(FileName)) {
+    Error (NULL, 0, 0, "File path is invalid!", NULL);
+    return STATUS_ERROR;
+  }
+
+  if ((FpOut = fopen (FileName, "r+b")) == NULL) {
+    return WriteOutputFile (FileName, FileData, FileSize);
+  }
+
+  Written = 0;
+  Offset  = 0;
+  while (Offset < FileSize) {
+    Length = FileSize - Offset;
+    if (Length > INCREMENTAL_WRITE_CHUNK) {
+      Length = INCREMENTAL_WRITE_CHUNK;
+    }
+    if (memcmp (FileData + Offset, OriginalData + Offset, Length) == 0) {
+      Offset += Length;
+      continue;
+    }
+
+    //
+    // Coalesce adjacent modified chunks into one write
+    //
+    Start = Offset;
+    while (Offset < FileSize) {
+      Length = FileSize - Offset;
+      if (Length > INCREMENTAL_WRITE_CHUNK) {
+        Length = INCREMENTAL_WRITE_CHUNK;
+      }
+      if (memcmp (FileData + Offset, OriginalData + Offset, Length) == 0) {
+        break;
+      }
+      Offset += Length;
+    }
+
+    if ((fseek (FpOut, Start, SEEK_SET) != 0) ||
+        (fwrite (FileData + Start, 1, Offset - Start, FpOut) != Offset - Start)) {
+      Error (NULL, 0, 0, "Write output file error!", NULL);
+      fclose (FpOut);
+      return STATUS_ERROR;
+    }
+    Written += Offset - Start;
+  }
+
+  fclose (FpOut);
+
+  printf ("Updated 0x%x of 0x%x bytes in place\n", Written, FileSize);
+
+  return STATUS_SUCCESS;
+}
+
 UINT32
 GetFvRecoveryInfoFromFd (
   IN UINT8                       *FdBuffer,
@@ -3116,16 +3410,24 @@ Returns:
   UINT32                      FdFileSize;
 
   UINT8                       *AcmBuffer;
+  UINT8                       *OriginalBuffer;
+  CHAR8                       *InputFileName;
+  CHAR8                       *OutputFileName;
 
-  FileBufferRaw = NULL;
+  FileBufferRaw  = NULL;
+  OriginalBuffer = NULL;
   //
   // Step 0: Check FV or FD
   //
   if (((strcmp (argv[1], "-D") == 0) ||
        (strcmp (argv[1], "-d") == 0)) ) {
     IsFv = FALSE;
+    InputFileName  = argv[2];
+    OutputFileName = argv[3];
   } else {
     IsFv = TRUE;
+    InputFileName  = argv[1];
+    OutputFileName = argv[2];
   }
 
   //
@@ -3157,10 +3459,26 @@ Returns:
     }
   }
 
+  //
+  // Keep the original image when patching it in place, so that only the
+  // modified ranges have to be written back.
+  //
+  if (strcmp (InputFileName, OutputFileName) == 0) {
+    OriginalBuffer = malloc (FdFileSize);
+    if (OriginalBuffer != NULL) {
+      memcpy (OriginalBuffer, FdFileBuffer, FdFileSize);
+    }
+  }
+
   //
   // Step 2: Calculate FIT entry number.
   //
+  Status = BuildFfsIndex (FdFileBuffer, FdFileSize);
+  if (Status != STATUS_SUCCESS) {
+    goto exitFunc;
+  }
   FitEntryNumber = GetFitEntryNumber (argc, argv, FdFileBuffer, FdFileSize);
+  FreeFfsIndex ();
   if (!gFitTableContext.Clear) {
     if (FitEntryNumber == 0) {
       Status = STATUS_ERROR;
@@ -3249,13 +3567,18 @@ Returns:
   //
   // Step 5: Write OutputFvRecovery.fv data
   //
-  if (IsFv) {
+  if (OriginalBuffer != NULL) {
+    Status = UpdateOutputFile (OutputFileName, FdFileBuffer, OriginalBuffer, FdFileSize);
+  } else if (IsFv) {
     Status = WriteOutputFile (argv[2], FileBuffer, FvRecoveryFileSize);
   } else {
     Status = WriteOutputFile (argv[3], FdFileBuffer, FdFileSize);
   }
 
 exitFunc:
+  if (OriginalBuffer != NULL) {
+    free ((VOID *)OriginalBuffer);
+  }
   if (FileBufferRaw != NULL) {
     free ((VOID *)FileBufferRaw);
   }
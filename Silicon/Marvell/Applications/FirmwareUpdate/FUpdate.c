@@ -18,6 +18,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/ShellCEntryLib.h>
 #include <Library/ShellCommandLib.h>
 #include <Library/ShellLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
 
@@ -30,6 +31,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define CMD_NAME_STRING       L"fupdate"
 
 #define SHELL_USE_DEVICE_PATH_PARAM  L"-p"
+#define SHELL_DIFFERENTIAL_PARAM     L"-d"
 #define SHELL_DEVICE_NAME_PARAM      L"DeviceName"
 #define SHELL_FILE_NAME_PARAM        L"LocalFileName"
 #define SHELL_HELP_PARAM             L"help"
@@ -37,10 +39,18 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #define MAIN_HDR_MAGIC        0xB105B002
 
+//
+// Number of sectors read back at once in differential mode. It also caps
+// the length of a single erase/program run, so the progress indicator
+// keeps moving.
+//
+#define DIFF_CHUNK_SECTORS    16
+
 STATIC EFI_DEVICE_PATH_FROM_TEXT_PROTOCOL  *EfiDevicePathFromTextProtocol;
 STATIC MARVELL_SPI_MASTER_PROTOCOL         *SpiMasterProtocol;
 STATIC MARVELL_SPI_FLASH_PROTOCOL          *SpiFlashProtocol;
 STATIC EFI_BLOCK_IO_PROTOCOL               *BlkIo;
+STATIC BOOLEAN                             mDifferentialUpdate;
 
 STATIC CONST CHAR16 gShellFUpdateFileName[] = L"ShellCommands";
 STATIC EFI_HANDLE gShellFUpdateHiiHandle = NULL;
@@ -49,6 +59,7 @@ STATIC CONST SHELL_PARAM_ITEM ParamList[] = {
   {SHELL_HELP_PARAM,            TypeFlag},
   {SHELL_LIST_PARAM,            TypeFlag},
   {SHELL_USE_DEVICE_PATH_PARAM, TypeFlag},
+  {SHELL_DIFFERENTIAL_PARAM,    TypeFlag},
   {SHELL_FILE_NAME_PARAM,       TypePosition},
   {SHELL_DEVICE_NAME_PARAM,     TypePosition},
   {NULL ,                       TypeMax}
@@ -407,6 +418,227 @@ ProgramBlockDevice (
   return EFI_SUCCESS;
 }
 
+/**
+  Erase and program a run of contiguous SPI flash sectors, then read it
+  back and check it against the image.
+
+  @param[in]   SpiFlash            SPI flash device.
+  @param[in]   Offset              Offset of the run, aligned to a sector.
+  @param[in]   Length              Length of the run, a multiple of the
+                                   sector size.
+  @param[in]  *Image               Pointer to the image in memory.
+  @param[in]   ImageSize           Size of the image.
+  @param[in]  *Tail                Previous content of the last sector of
+                                   the image, restored past its end.
+  @param[in]  *VerifyBuffer        Buffer of at least Length bytes.
+
+**/
+STATIC
+EFI_STATUS
+ProgramSpiRun (
+  IN SPI_DEVICE *SpiFlash,
+  IN UINTN       Offset,
+  IN UINTN       Length,
+  IN UINT8      *Image,
+  IN UINTN       ImageSize,
+  IN UINT8      *Tail,
+  IN UINT8      *VerifyBuffer
+  )
+{
+  EFI_STATUS     Status;
+  UINTN          ImageLength;
+  UINTN          TailOffset;
+
+  ImageLength = MIN (Length, ImageSize - Offset);
+
+  Status = SpiFlashProtocol->Erase (SpiFlash, Offset, Length);
+  if (EFI_ERROR (Status)) {
+    Print (L"%s: Cannot erase flash at 0x%Lx\n", CMD_NAME_STRING, (UINT64)Offset);
+    return Status;
+  }
+
+  Status = SpiFlashProtocol->Write (SpiFlash,
+                               (UINT32)Offset,
+                               ImageLength,
+                               Image + Offset);
+  if (EFI_ERROR (Status)) {
+    Print (L"%s: Cannot write flash at 0x%Lx\n", CMD_NAME_STRING, (UINT64)Offset);
+    return Status;
+  }
+
+  //
+  // The image does not fill its last sector: put back what was there.
+  //
+  if (ImageLength < Length) {
+    TailOffset = ImageSize % SpiFlash->Info->SectorSize;
+    Status = SpiFlashProtocol->Write (SpiFlash,
+                                 (UINT32)(Offset + ImageLength),
+                                 Length - ImageLength,
+                                 Tail + TailOffset);
+    if (EFI_ERROR (Status)) {
+      Print (L"%s: Cannot restore flash at 0x%Lx\n",
+        CMD_NAME_STRING,
+        (UINT64)(Offset + ImageLength));
+      return Status;
+    }
+  }
+
+  Status = SpiFlashProtocol->Read (SpiFlash,
+                               (UINT32)Offset,
+                               ImageLength,
+                               VerifyBuffer);
+  if (EFI_ERROR (Status)) {
+    Print (L"%s: Cannot read back flash at 0x%Lx\n", CMD_NAME_STRING, (UINT64)Offset);
+    return Status;
+  }
+
+  if (CompareMem (VerifyBuffer, Image + Offset, ImageLength) != 0) {
+    Print (L"%s: Verification failed at 0x%Lx\n", CMD_NAME_STRING, (UINT64)Offset);
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Update firmware image in the SPI flash, programming only the sectors
+  whose content differs from the image.
+
+  The flash is read back in chunks of DIFF_CHUNK_SECTORS sectors and
+  compared with the image. Sectors that already match are left alone and
+  runs of contiguous differing sectors are erased and programmed with a
+  single request each. Since nothing but the flash content decides what
+  is written, running the command again after an interrupted update
+  resumes it where it stopped.
+
+  @param[in]   SpiFlash            SPI flash device.
+  @param[in]   ImageSize           Size of the image.
+  @param[in]  *Image               Pointer to the image in memory.
+
+**/
+STATIC
+EFI_STATUS
+ProgramSpiFlashDifferential (
+  IN SPI_DEVICE *SpiFlash,
+  IN UINTN       ImageSize,
+  IN UINT8      *Image
+  )
+{
+  EFI_STATUS     Status;
+  UINTN          SectorSize;
+  UINTN          ChunkSize;
+  UINTN          ChunkOffset;
+  UINTN          ChunkLength;
+  UINTN          Offset;
+  UINTN          RunOffset;
+  UINTN          RunLength;
+  UINTN          SectorsSkipped;
+  UINTN          SectorsProgrammed;
+  UINT64         StartTime;
+  UINT64         ElapsedTime;
+  UINT8          *ReadBuffer;
+  UINT8          *VerifyBuffer;
+  UINT8          *Tail;
+  BOOLEAN        Differs;
+
+  SectorSize = SpiFlash->Info->SectorSize;
+  ChunkSize = SectorSize * DIFF_CHUNK_SECTORS;
+
+  ReadBuffer = AllocatePool (ChunkSize);
+  VerifyBuffer = AllocatePool (ChunkSize);
+  Tail = AllocatePool (SectorSize);
+  if (ReadBuffer == NULL || VerifyBuffer == NULL || Tail == NULL) {
+    Print (L"%s: Fail to allocate buffer\n", CMD_NAME_STRING);
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  Status = EFI_SUCCESS;
+  SectorsSkipped = 0;
+  SectorsProgrammed = 0;
+  RunOffset = 0;
+  RunLength = 0;
+  StartTime = GetPerformanceCounter ();
+
+  for (ChunkOffset = 0; ChunkOffset < ImageSize; ChunkOffset += ChunkSize) {
+    Print (L"   \rUpdating, %d%%", (UINT32)((ChunkOffset * 100) / ImageSize));
+
+    ChunkLength = MIN (ChunkSize,
+                    ALIGN_VALUE (ImageSize - ChunkOffset, SectorSize));
+    Status = SpiFlashProtocol->Read (SpiFlash,
+                                 (UINT32)ChunkOffset,
+                                 ChunkLength,
+                                 ReadBuffer);
+    if (EFI_ERROR (Status)) {
+      Print (L"\n%s: Cannot read flash at 0x%Lx\n", CMD_NAME_STRING, (UINT64)ChunkOffset);
+      goto Exit;
+    }
+
+    for (Offset = ChunkOffset;
+         Offset < ChunkOffset + ChunkLength;
+         Offset += SectorSize) {
+      if (ImageSize - Offset < SectorSize) {
+        CopyMem (Tail, ReadBuffer + (Offset - ChunkOffset), SectorSize);
+      }
+
+      Differs = CompareMem (ReadBuffer + (Offset - ChunkOffset),
+                  Image + Offset,
+                  MIN (SectorSize, ImageSize - Offset)) != 0;
+      if (Differs) {
+        if (RunLength == 0) {
+          RunOffset = Offset;
+        }
+        RunLength += SectorSize;
+      } else {
+        SectorsSkipped++;
+      }
+
+      //
+      // Program the pending run once it is broken by an unchanged sector,
+      // has grown to a full chunk, or reaches the end of the image.
+      //
+      if (RunLength > 0 &&
+          (!Differs || RunLength == ChunkSize || Offset + SectorSize >= ImageSize)) {
+        Status = ProgramSpiRun (SpiFlash,
+                   RunOffset,
+                   RunLength,
+                   Image,
+                   ImageSize,
+                   Tail,
+                   VerifyBuffer);
+        if (EFI_ERROR (Status)) {
+          Print (L"\n");
+          goto Exit;
+        }
+        SectorsProgrammed += RunLength / SectorSize;
+        RunLength = 0;
+      }
+    }
+  }
+
+  ElapsedTime = GetTimeInNanoSecond (GetPerformanceCounter () - StartTime);
+
+  Print (L"   \rUpdating, 100%%\n");
+  Print (L"%s: %lu sectors unchanged, %lu sectors (%lu bytes) programmed in %lu ms\n",
+    CMD_NAME_STRING,
+    (UINT64)SectorsSkipped,
+    (UINT64)SectorsProgrammed,
+    (UINT64)SectorsProgrammed * SectorSize,
+    DivU64x32 (ElapsedTime, 1000000));
+
+Exit:
+  if (ReadBuffer != NULL) {
+    FreePool (ReadBuffer);
+  }
+  if (VerifyBuffer != NULL) {
+    FreePool (VerifyBuffer);
+  }
+  if (Tail != NULL) {
+    FreePool (Tail);
+  }
+
+  return Status;
+}
 
 /**
   Update firmware image in the SPI flash.
@@ -464,10 +696,16 @@ ProgramSpiFlash (
   }
 
   // Update firmware image in flash at offset 0x0
-  Status = SpiFlashProtocol->Update (SpiFlash,
-                               0x0,
-                               FileSize,
-                               (UINT8 *)FileBuffer);
+  if (mDifferentialUpdate) {
+    Status = ProgramSpiFlashDifferential (SpiFlash,
+               (UINTN)FileSize,
+               (UINT8 *)FileBuffer);
+  } else {
+    Status = SpiFlashProtocol->Update (SpiFlash,
+                                 0x0,
+                                 FileSize,
+                                 (UINT8 *)FileBuffer);
+  }
   if (EFI_ERROR (Status)) {
     Print (L"%s: Error while performing flash update\n", CMD_NAME_STRING);
     goto FlashProbeError;
@@ -611,8 +849,12 @@ FUpdateUsage (
   )
 {
   Print (L"\nFirmware update command\n"
-         "fupdate <LocalFilePath> [-p] [Device]\n\n"
+         "fupdate <LocalFilePath> [-d] [-p] [Device]\n\n"
          "LocalFilePath - path to local firmware image file\n"
+         "-d            - Differential update of the SPI flash: only\n"
+         "                sectors that differ from the image are\n"
+         "                programmed. Run it again to resume an\n"
+         "                interrupted update.\n"
          "-p            - When flag is selected Device is interpreted\n"
          "                as device path, not device handle.\n"
          "Device        - Select device which will be flashed.\n"
@@ -622,6 +864,8 @@ FUpdateUsage (
          "EXAMPLES:\n"
          " * Update firmware in SPI flash from file fs2:flash-image.bin\n"
          "     fupdate fs2:flash-image.bin\n"
+         " * Update only changed sectors of SPI flash from file fs2:flash-image.bin\n"
+         "     fupdate fs2:flash-image.bin -d\n"
          " * Update firmware in device with handle 5F from file flash-image.bin\n"
          "     fupdate flash-image.bin 5F\n"
          " * Update firmware in device with selected path from file flash.bin\n"
@@ -681,6 +925,13 @@ ShellCommandRunFUpdate (
     return SHELL_ABORTED;
   }
 
+  mDifferentialUpdate = ShellCommandLineGetFlag (CheckPackage,
+                          SHELL_DIFFERENTIAL_PARAM);
+  if (mDifferentialUpdate && FlashCommand != ProgramSpiFlash) {
+    Print (L"%s: -d is only supported for SPI flash, ignoring it\n",
+      CMD_NAME_STRING);
+  }
+
   // Prepare local file to be burned into flash
   Status = PrepareFirmwareImage (CheckPackage,
              &FileHandle,
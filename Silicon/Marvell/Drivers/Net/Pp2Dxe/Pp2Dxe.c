@@ -98,7 +98,7 @@ EFI_SIMPLE_NETWORK_MODE Pp2SnpModeTemplate = {
   },                                                    // Permanent Address
   NET_IFTYPE_ETHERNET,                                  // IfType
   TRUE,                                                 // MacAddressChangeable
-  FALSE,                                                // MultipleTxSupported
+  TRUE,                                                 // MultipleTxSupported
   TRUE,                                                 // MediaPresentSupported
   FALSE                                                 // MediaPresent
 };
@@ -142,6 +142,53 @@ QueueRemove (
   return Buffer;
 }
 
+STATIC
+UINTN
+QueueCount (
+  IN PP2DXE_CONTEXT *Pp2Context
+  )
+{
+  return (Pp2Context->CompletionQueueTail + QUEUE_DEPTH -
+          Pp2Context->CompletionQueueHead) % QUEUE_DEPTH;
+}
+
+/*
+ * Move buffers of the frames, which were already sent by the HW,
+ * from the in-flight ring to the completion queue.
+ */
+STATIC
+VOID
+Pp2DxeTxReclaim (
+  IN PP2DXE_CONTEXT *Pp2Context
+  )
+{
+  PP2DXE_PORT *Port = &Pp2Context->Port;
+  EFI_STATUS Status;
+  UINT32 TxSent;
+  VOID *Buffer;
+
+  if (Pp2Context->TxInFlightCount == 0) {
+    return;
+  }
+
+  /* Reading the counter resets it, so all reported frames must be consumed */
+  TxSent = Mvpp2TxqSentDescProc(Port, &Port->Txqs[0]);
+  ASSERT (TxSent <= Pp2Context->TxInFlightCount);
+
+  while (TxSent > 0 && Pp2Context->TxInFlightCount > 0) {
+    Buffer = Pp2Context->TxInFlight[Pp2Context->TxInFlightHead];
+    Pp2Context->TxInFlight[Pp2Context->TxInFlightHead] = NULL;
+    Pp2Context->TxInFlightHead = (Pp2Context->TxInFlightHead + 1) % TX_INFLIGHT_DEPTH;
+    Pp2Context->TxInFlightCount--;
+    Pp2Context->Stats.TxGoodFrames++;
+    TxSent--;
+
+    /* Room in the completion queue is guaranteed by Pp2SnpTransmit */
+    Status = QueueInsert (Pp2Context, Buffer);
+    ASSERT_EFI_ERROR (Status);
+  }
+}
+
 STATIC
 EFI_STATUS
 Pp2DxeBmPoolInit (
@@ -424,6 +471,12 @@ Pp2DxeLatePortInitialize (
 
   Port->Rxqs[0].Descs = Mvpp2Shared->BufferLocation.RxDescs[Port->Id];
 
+  Pp2Context->RxStaging = AllocatePool (RX_STAGING_DEPTH * RX_BUFFER_SIZE);
+  if (Pp2Context->RxStaging == NULL) {
+    DEBUG((DEBUG_ERROR, "Failed to allocate Rx staging ring\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
   for (Queue = 0; Queue < TxqNumber; Queue++) {
     MVPP2_RX_QUEUE *Rxq = &Port->Rxqs[Queue];
 
@@ -770,6 +823,33 @@ Pp2SnpStationAddress (
   return EFI_SUCCESS;
 }
 
+/*
+ * Reset the SNP statistics. Counters the driver does not keep are set to
+ * all ones, which the UEFI specification uses to mark them unsupported.
+ */
+STATIC
+VOID
+Pp2SnpResetStats (
+  IN PP2DXE_CONTEXT *Pp2Context
+  )
+{
+  EFI_NETWORK_STATISTICS *Stats = &Pp2Context->Stats;
+
+  SetMem (Stats, sizeof (EFI_NETWORK_STATISTICS), 0xFF);
+  Stats->RxTotalFrames = 0;
+  Stats->RxGoodFrames = 0;
+  Stats->RxOversizeFrames = 0;
+  Stats->RxDroppedFrames = 0;
+  Stats->RxUnicastFrames = 0;
+  Stats->RxBroadcastFrames = 0;
+  Stats->RxMulticastFrames = 0;
+  Stats->RxCrcErrorFrames = 0;
+  Stats->RxTotalBytes = 0;
+  Stats->TxTotalFrames = 0;
+  Stats->TxGoodFrames = 0;
+  Stats->TxTotalBytes = 0;
+}
+
 EFI_STATUS
 EFIAPI
 Pp2SnpNetStat (
@@ -779,7 +859,56 @@ Pp2SnpNetStat (
   OUT EFI_NETWORK_STATISTICS     *StatisticsTable  OPTIONAL
   )
 {
-  return EFI_UNSUPPORTED;
+  PP2DXE_CONTEXT *Pp2Context = INSTANCE_FROM_SNP(This);
+  UINT32 State = This->Mode->State;
+  EFI_STATUS Status = EFI_SUCCESS;
+  EFI_TPL SavedTpl;
+
+  if (!Reset && StatisticsSize == NULL && StatisticsTable == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  if (StatisticsSize == NULL && StatisticsTable != NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SavedTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  /* Check that driver was started and initialised */
+  if (State != EfiSimpleNetworkInitialized) {
+    switch (State) {
+    case EfiSimpleNetworkStopped:
+      DEBUG((DEBUG_WARN, "Pp2Dxe%d: not started\n", Pp2Context->Instance));
+      ReturnUnlock (SavedTpl, EFI_NOT_STARTED);
+    case EfiSimpleNetworkStarted:
+    /* Fall through */
+    default:
+      DEBUG((DEBUG_ERROR, "Pp2Dxe%d: wrong state\n", Pp2Context->Instance));
+      ReturnUnlock (SavedTpl, EFI_DEVICE_ERROR);
+    }
+  }
+
+  if (StatisticsSize != NULL) {
+    if (*StatisticsSize < sizeof (EFI_NETWORK_STATISTICS)) {
+      Status = EFI_BUFFER_TOO_SMALL;
+    }
+
+    if (StatisticsTable != NULL) {
+      CopyMem (
+        StatisticsTable,
+        &Pp2Context->Stats,
+        MIN (*StatisticsSize, sizeof (EFI_NETWORK_STATISTICS))
+        );
+    }
+
+    *StatisticsSize = sizeof (EFI_NETWORK_STATISTICS);
+  }
+
+  if (Reset) {
+    Pp2SnpResetStats (Pp2Context);
+  }
+
+  ReturnUnlock (SavedTpl, Status);
 }
 
 EFI_STATUS
@@ -833,6 +962,9 @@ Pp2SnpGetStatus (
   }
   Snp->Mode->MediaPresent = LinkUp;
 
+  /* Lazily collect the frames completed since the last call */
+  Pp2DxeTxReclaim (Pp2Context);
+
   if (TxBuf != NULL) {
     *TxBuf = QueueRemove (Pp2Context);
   }
@@ -857,9 +989,6 @@ Pp2SnpTransmit (
   MVPP2_SHARED *Mvpp2Shared = Pp2Context->Port.Priv;
   MVPP2_TX_QUEUE *AggrTxq = Mvpp2Shared->AggrTxqs;
   MVPP2_TX_DESC *TxDesc;
-  EFI_STATUS Status;
-  INTN PollingCount;
-  INTN TxSent;
   UINT8 *DataPtr = Buffer;
   UINT16 EtherType;
   UINT32 State = This->Mode->State;
@@ -899,6 +1028,22 @@ Pp2SnpTransmit (
 
   EtherType = HTONS (*EtherTypePtr);
 
+  /* Make room in the rings by collecting already sent frames */
+  Pp2DxeTxReclaim (Pp2Context);
+
+  /*
+   * Every in-flight buffer has to fit in the completion queue
+   * once it is sent, so account for both of them.
+   */
+  if (Pp2Context->TxInFlightCount >= TX_INFLIGHT_DEPTH ||
+      QueueCount (Pp2Context) + Pp2Context->TxInFlightCount >= QUEUE_DEPTH - 1) {
+    ReturnUnlock (SavedTpl, EFI_NOT_READY);
+  }
+
+  if (Mvpp2AggrDescNumCheck(Mvpp2Shared, AggrTxq, 1, 0) != 0) {
+    ReturnUnlock (SavedTpl, EFI_NOT_READY);
+  }
+
   /* Fetch next descriptor */
   TxDesc = Mvpp2TxqNextDescGet(AggrTxq);
 
@@ -930,39 +1075,112 @@ Pp2SnpTransmit (
 
   /* Issue send */
   Mvpp2AggrTxqPendDescAdd(Port, 1);
+  AggrTxq->count++;
+
+  Pp2Context->Stats.TxTotalFrames++;
+  Pp2Context->Stats.TxTotalBytes += BufferSize;
 
   /*
-   * Egress processing:
-   * Wait until packet is passed from per-cpu aggregated queue
-   * to physical per-port TXQ.
+   * Do not wait for the HW to send the packet. The buffer is kept
+   * in the in-flight ring and passed to the completion queue
+   * by Pp2DxeTxReclaim, once the HW reports it as sent.
    */
-  PollingCount = 0;
-  TxSent = Mvpp2AggrTxqPendDescNumGet(Mvpp2Shared, 0);
-  do {
-    if (PollingCount++ > MVPP2_TX_SEND_MAX_POLLING_COUNT) {
-      DEBUG((DEBUG_ERROR, "Pp2Dxe: transmit polling failed\n"));
-      ReturnUnlock(SavedTpl, EFI_TIMEOUT);
+  Pp2Context->TxInFlight[(Pp2Context->TxInFlightHead + Pp2Context->TxInFlightCount) %
+                         TX_INFLIGHT_DEPTH] = Buffer;
+  Pp2Context->TxInFlightCount++;
+
+  ReturnUnlock (SavedTpl, EFI_SUCCESS);
+}
+
+/*
+ * Copy all frames received so far out of the RXQ to the staging ring,
+ * so that the RX descriptors and BM buffers can be reused by the HW
+ * right away, instead of one at a time on every Pp2SnpReceive call.
+ */
+STATIC
+VOID
+Pp2DxeRxHarvest (
+  IN PP2DXE_CONTEXT *Pp2Context
+  )
+{
+  PP2DXE_PORT *Port = &Pp2Context->Port;
+  MVPP2_SHARED *Mvpp2Shared = Pp2Context->Port.Priv;
+  MVPP2_RX_QUEUE *Rxq = &Port->Rxqs[0];
+  EFI_NETWORK_STATISTICS *Stats = &Pp2Context->Stats;
+  UINTN PhysAddr[RX_STAGING_DEPTH];
+  UINTN VirtAddr[RX_STAGING_DEPTH];
+  INTN PoolId[RX_STAGING_DEPTH];
+  MVPP2_RX_DESC *RxDesc;
+  INTN ReceivedPackets;
+  UINT32 StatusReg;
+  UINTN PktLength;
+  UINT8 *DataPtr;
+  INTN Index;
+  UINTN Slot;
+
+  ReceivedPackets = Mvpp2RxqReceived(Port, Rxq->Id);
+  ReceivedPackets = MIN (ReceivedPackets, (INTN)(RX_STAGING_DEPTH - Pp2Context->RxStagingCount));
+
+  for (Index = 0; Index < ReceivedPackets; Index++) {
+    RxDesc = Mvpp2RxqNextDescGet(Rxq);
+    StatusReg = RxDesc->status;
+
+    /* extract addresses from descriptor */
+    PhysAddr[Index] = RxDesc->BufPhysAddrKeyHash & MVPP22_ADDR_MASK;
+    VirtAddr[Index] = RxDesc->BufCookieBmQsetClsInfo & MVPP22_ADDR_MASK;
+    PoolId[Index] = (StatusReg & MVPP2_RXD_BM_POOL_ID_MASK) >> MVPP2_RXD_BM_POOL_ID_OFFS;
+
+    Stats->RxTotalFrames++;
+
+    /* Drop packets with error or with buffer header (MC, SG) */
+    if (StatusReg & MVPP2_RXD_ERR_SUMMARY) {
+      if ((StatusReg & MVPP2_RXD_ERR_CODE_MASK) == MVPP2_RXD_ERR_CRC) {
+        Stats->RxCrcErrorFrames++;
+      }
+      Stats->RxDroppedFrames++;
+      continue;
     }
-    TxSent = Mvpp2AggrTxqPendDescNumGet(Mvpp2Shared, 0);
-  } while (TxSent);
 
-  /* Wait for packet to be transmitted by hardware. */
-  PollingCount = 0;
-  TxSent = Mvpp2TxqSentDescProc(Port, &Port->Txqs[0]);
-  while (!TxSent) {
-    if (PollingCount++ > MVPP2_TX_SEND_MAX_POLLING_COUNT) {
-      DEBUG((DEBUG_ERROR, "Pp2Dxe: transmit polling failed\n"));
-      ReturnUnlock(SavedTpl, EFI_TIMEOUT);
+    if (StatusReg & MVPP2_RXD_BUF_HDR) {
+      Stats->RxDroppedFrames++;
+      continue;
+    }
+
+    PktLength = (UINTN) RxDesc->DataSize - 2;
+    if (PktLength > RX_BUFFER_SIZE) {
+      Stats->RxOversizeFrames++;
+      Stats->RxDroppedFrames++;
+      continue;
+    }
+
+    Slot = (Pp2Context->RxStagingHead + Pp2Context->RxStagingCount) % RX_STAGING_DEPTH;
+    DataPtr = Pp2Context->RxStaging + Slot * RX_BUFFER_SIZE;
+    CopyMem (DataPtr, (VOID*) (PhysAddr[Index] + 2), PktLength);
+    Pp2Context->RxStagingLength[Slot] = PktLength;
+    Pp2Context->RxStagingCount++;
+
+    Stats->RxGoodFrames++;
+    Stats->RxTotalBytes += PktLength;
+    if (NET_MAC_IS_MULTICAST ((EFI_MAC_ADDRESS *)DataPtr, &Pp2Context->Snp.Mode->BroadcastAddress, NET_ETHER_ADDR_LEN)) {
+      Stats->RxMulticastFrames++;
+    } else if (CompareMem (DataPtr, &Pp2Context->Snp.Mode->BroadcastAddress, NET_ETHER_ADDR_LEN) == 0) {
+      Stats->RxBroadcastFrames++;
+    } else {
+      Stats->RxUnicastFrames++;
     }
-    TxSent = Mvpp2TxqSentDescProc(Port, &Port->Txqs[0]);
   }
 
-  /*
-   * At this point TxSent has increased - HW sent the packet
-   * Add buffer to completion queue and return.
-   */
-  Status = QueueInsert (Pp2Context, Buffer);
-  ReturnUnlock (SavedTpl, Status);
+  if (ReceivedPackets == 0) {
+    return;
+  }
+
+  /* Refill: pass all harvested buffers back to BM */
+  for (Index = 0; Index < ReceivedPackets; Index++) {
+    Mvpp2BmPoolPut(Mvpp2Shared, PoolId[Index], PhysAddr[Index], VirtAddr[Index]);
+  }
+
+  /* Update counters with all packets received and refilled at once */
+  Mvpp2RxqStatusUpdate(Port, Rxq->Id, ReceivedPackets, ReceivedPackets);
 }
 
 EFI_STATUS
@@ -977,55 +1195,39 @@ Pp2SnpReceive (
   OUT UINT16                     *EtherType OPTIONAL
   )
 {
-  INTN ReceivedPackets;
   PP2DXE_CONTEXT *Pp2Context = INSTANCE_FROM_SNP(This);
   PP2DXE_PORT *Port = &Pp2Context->Port;
-  MVPP2_SHARED *Mvpp2Shared = Pp2Context->Port.Priv;
-  UINTN PhysAddr, VirtAddr;
-  EFI_STATUS Status = EFI_SUCCESS;
   EFI_TPL SavedTpl;
-  UINT32 StatusReg;
-  INTN PoolId;
   UINTN PktLength;
   UINT8 *DataPtr;
-  MVPP2_RX_DESC *RxDesc;
-  MVPP2_RX_QUEUE *Rxq = &Port->Rxqs[0];
 
   ASSERT (Port != NULL);
-  ASSERT (Rxq != NULL);
+  ASSERT (Port->Rxqs != NULL);
 
   SavedTpl = gBS->RaiseTPL (TPL_CALLBACK);
-  ReceivedPackets = Mvpp2RxqReceived(Port, Rxq->Id);
 
-  if (ReceivedPackets == 0) {
-    ReturnUnlock(SavedTpl, EFI_NOT_READY);
+  /* Serve from the staging ring and poll the RXQ only once it is drained */
+  if (Pp2Context->RxStagingCount == 0) {
+    Pp2DxeRxHarvest (Pp2Context);
   }
 
-  /* Process one packet per call */
-  RxDesc = Mvpp2RxqNextDescGet(Rxq);
-  StatusReg = RxDesc->status;
-
-  /* extract addresses from descriptor */
-  PhysAddr = RxDesc->BufPhysAddrKeyHash & MVPP22_ADDR_MASK;
-  VirtAddr = RxDesc->BufCookieBmQsetClsInfo & MVPP22_ADDR_MASK;
-
-  /* Drop packets with error or with buffer header (MC, SG) */
-  if ((StatusReg & MVPP2_RXD_BUF_HDR) || (StatusReg & MVPP2_RXD_ERR_SUMMARY)) {
-    DEBUG((DEBUG_WARN, "Pp2Dxe: dropping packet\n"));
-    Status = EFI_DEVICE_ERROR;
-    goto drop;
+  if (Pp2Context->RxStagingCount == 0) {
+    ReturnUnlock(SavedTpl, EFI_NOT_READY);
   }
 
-  PktLength = (UINTN) RxDesc->DataSize - 2;
+  PktLength = Pp2Context->RxStagingLength[Pp2Context->RxStagingHead];
   if (PktLength > *BufferSize) {
     *BufferSize = PktLength;
     DEBUG((DEBUG_ERROR, "Pp2Dxe: buffer too small\n"));
     ReturnUnlock(SavedTpl, EFI_BUFFER_TOO_SMALL);
   }
 
-  CopyMem (Buffer, (VOID*) (PhysAddr + 2), PktLength);
+  CopyMem (Buffer, Pp2Context->RxStaging + Pp2Context->RxStagingHead * RX_BUFFER_SIZE, PktLength);
   *BufferSize = PktLength;
 
+  Pp2Context->RxStagingHead = (Pp2Context->RxStagingHead + 1) % RX_STAGING_DEPTH;
+  Pp2Context->RxStagingCount--;
+
   if (HeaderSize != NULL) {
     *HeaderSize = Pp2Context->Snp.Mode->MediaHeaderSize;
   }
@@ -1049,15 +1251,7 @@ Pp2SnpReceive (
     *EtherType = NTOHS (*(UINT16 *)(&DataPtr[12]));
   }
 
-drop:
-  /* Refill: pass packet back to BM */
-  PoolId = (StatusReg & MVPP2_RXD_BM_POOL_ID_MASK) >> MVPP2_RXD_BM_POOL_ID_OFFS;
-  Mvpp2BmPoolPut(Mvpp2Shared, PoolId, PhysAddr, VirtAddr);
-
-  /* Update counters with 1 packet received and 1 packet refilled */
-  Mvpp2RxqStatusUpdate(Port, Rxq->Id, 1, 1);
-
-  ReturnUnlock(SavedTpl, Status);
+  ReturnUnlock(SavedTpl, EFI_SUCCESS);
 }
 
 EFI_STATUS
@@ -1425,6 +1619,8 @@ Pp2DxeInitialiseController (
     Pp2Context->Instance = DeviceInstance;
     DeviceInstance++;
 
+    Pp2SnpResetStats (Pp2Context);
+
     /* Prepare AIP Protocol */
     Pp2Context->Aip.GetInformation    = Pp2AipGetInformation;
     Pp2Context->Aip.SetInformation    = Pp2AipSetInformation;
@@ -142,12 +142,6 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define WRAP                              (2 + ETH_HLEN + 4 + 32)
 #define MTU                               1500
 
-/*
- * Maximum retries of checking, wheter HW really sent the packet
- * after it was done is software.
- */
-#define MVPP2_TX_SEND_MAX_POLLING_COUNT   10000
-
 /* Structures */
 typedef struct {
   /* Physical number of this Tx queue */
@@ -324,6 +318,19 @@ typedef struct {
 } PP2_DEVICE_PATH;
 
 #define QUEUE_DEPTH 64
+
+/*
+ * Maximum number of frames handed over to the hardware, but not yet
+ * reported as sent. It is bound by the size of the physical TXQ.
+ */
+#define TX_INFLIGHT_DEPTH MVPP2_MAX_TXD
+
+/*
+ * Number of received frames, which can be copied out of the RXQ
+ * to the driver's staging ring during a single poll.
+ */
+#define RX_STAGING_DEPTH MVPP2_MAX_RXD
+
 typedef struct {
   UINT32                      Signature;
   INTN                        Instance;
@@ -338,6 +345,14 @@ typedef struct {
   VOID                        *CompletionQueue[QUEUE_DEPTH];
   UINTN                       CompletionQueueHead;
   UINTN                       CompletionQueueTail;
+  VOID                        *TxInFlight[TX_INFLIGHT_DEPTH];
+  UINTN                       TxInFlightHead;
+  UINTN                       TxInFlightCount;
+  UINT8                       *RxStaging;
+  UINTN                       RxStagingLength[RX_STAGING_DEPTH];
+  UINTN                       RxStagingHead;
+  UINTN                       RxStagingCount;
+  EFI_NETWORK_STATISTICS      Stats;
   EFI_EVENT                   EfiExitBootServicesEvent;
   PP2_DEVICE_PATH             *DevicePath;
   EFI_ADAPTER_INFORMATION_PROTOCOL Aip;